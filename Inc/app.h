@@ -14,13 +14,56 @@
 #define APP_H_
 
 #include "stm32f1xx_hal.h"
+#include "stepper.h"
 
 /**
  * Fixed interval to trigger the button
  */
 #define APP_BUTTON_TRIGGER_INTERVAL			(10)
 
+/**
+ * Number of milliseconds in idle state until cached EEPROM variables are
+ * written to flash
+ */
+#define APP_EE_FLUSH_IDLE_TIME				(60 * 1000)
+
+/**
+ * Number of milliseconds in service state without a move until the car
+ * returns to the idle position
+ */
+#define APP_SERVICE_TIMEOUT					(60 * 1000)
+
+/**
+ * Application state enumeration type
+ */
+typedef enum appState_e {
+	APP_STATE_INIT			    = 0,
+	APP_STATE_IDLE			    = 1,
+	APP_STATE_DRIVING_UP	    = 2,
+	APP_STATE_DRIVING_DOWN	    = 3,
+
+	APP_STATE_SETUP_INIT        = 20,
+    APP_STATE_SETUP_FLOOR2_1    = 21,
+    APP_STATE_SETUP_FLOOR1_0    = 22,
+
+    APP_STATE_SERVICE           = 30,
+} appState_t;
+
+/**
+ * Floor enumeration type
+ */
+typedef enum appFloor_e {
+	APP_FLOOR_0		= 0,
+	APP_FLOOR_1		= 1,
+	APP_FLOOR_2		= 2,
+} appFloor_t;
+
 void app_init();
 void app_handler();
+uint8_t app_getState(void);
+uint8_t app_getFloor(void);
+uint16_t app_getTrips(void);
+uint16_t app_requServiceMove(stpCmd_t cmd, uint32_t steps);
+uint16_t app_requStop(void);
 
 #endif /* APP_H_ */
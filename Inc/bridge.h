@@ -0,0 +1,58 @@
+/**
+ * @file bridge.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB to UART bridge
+ *
+ * The bridge connects the USB CDC interface to USART1, which is the service
+ * console otherwise. It is started by PROTO_CMD_BRIDGE. Then:
+ *
+ * - The received USB packets are copied from the receive slots of cdc.h into
+ *   the DMA transmit ring of the UART. If the ring is full, the slots are
+ *   kept and the host is NAKed, so no data is lost.
+ * - The input of the UART DMA ring is passed to the transmit queue of cdc.h.
+ * - The line coding of the host (CDC_SET_LINE_CODING) is applied to the
+ *   UART. The UART frames 8 data bits with or without parity and 7 data
+ *   bits with parity. Other line codings (7 data bits without parity, 5, 6
+ *   and 16 data bits, 1.5 stop bits, mark and space parity) are rejected and
+ *   the UART keeps its format.
+ *
+ * A break from the host (CDC_SEND_BREAK) or the loss of the USB connection
+ * stops the bridge and returns USART1 to the service console (or the Modbus
+ * slave) with its own format.
+ */
+#ifndef BRIDGE_H_
+#define BRIDGE_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Size of the CDC line coding structure
+ */
+#define BRG_LINE_CODING_SIZE        (7)
+
+/**
+ * Statistics of the bridge
+ */
+typedef struct brgStats_s {
+    uint32_t toUart;        /* Bytes from USB to the UART */
+    uint32_t toUsb;         /* Bytes from the UART to USB */
+    uint32_t rejected;      /* Line codings not supported by the UART */
+} brgStats_t;
+
+void brg_init(void);
+void brg_handler(void);
+void brg_enable(void);
+void brg_disable(void);
+uint8_t brg_isEnabled(void);
+void brg_setLineCoding(const uint8_t* pbuf);
+void brg_getLineCoding(uint8_t* pbuf);
+void brg_sendBreak(void);
+void brg_getStats(brgStats_t* stats);
+
+#endif /* BRIDGE_H_ */
@@ -0,0 +1,77 @@
+/**
+ * @file cdc.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Packet buffers of the USB CDC interface
+ *
+ * The OUT endpoint receives directly into a ring of CDC_RX_SLOTS slots of one
+ * USB packet each. The consumer reads a received packet in place with
+ * cdc_rxPeek() and frees the slot with cdc_rxRelease(). If no slot is free,
+ * the endpoint is not armed again: the host is NAKed until a slot is
+ * released, so no data is lost and nothing is copied.
+ *
+ * cdc_write() never blocks: it copies the data into the transmit queue or
+ * refuses it completely. Full packets are sent at once, the next transfer is
+ * chained from the transfer complete callback. A short packet is only sent
+ * after CDC_TX_FLUSH_TIME, so small writes are coalesced into full packets.
+ */
+#ifndef CDC_H_
+#define CDC_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Size of a slot (one full speed bulk packet)
+ */
+#define CDC_PACKET_SIZE             (64)
+
+/**
+ * Number of receive slots (power of two)
+ */
+#ifndef CDC_RX_SLOTS
+#define CDC_RX_SLOTS                (8)
+#endif
+
+/**
+ * Size of the transmit queue in bytes (power of two)
+ */
+#ifndef CDC_TX_BUFFER_SIZE
+#define CDC_TX_BUFFER_SIZE          (1024)
+#endif
+
+/**
+ * Time in ms until a short packet is sent
+ */
+#ifndef CDC_TX_FLUSH_TIME
+#define CDC_TX_FLUSH_TIME           (1)
+#endif
+
+/**
+ * Statistics of the CDC buffers
+ */
+typedef struct cdcStats_s {
+    uint32_t rxPackets;     /* Received packets */
+    uint32_t rxStalls;      /* Times the endpoint was NAKed because all slots were used */
+    uint32_t txBytes;       /* Sent bytes */
+    uint32_t txTransfers;   /* Started transfers */
+    uint32_t txDropped;     /* Bytes refused because the queue was full */
+} cdcStats_t;
+
+void cdc_handler(void);
+uint8_t cdc_isConfigured(void);
+uint8_t* cdc_rxInit(void);
+uint8_t* cdc_rxReceived(uint32_t len);
+const uint8_t* cdc_rxPeek(uint16_t* len);
+void cdc_rxRelease(void);
+void cdc_txInit(void);
+uint16_t cdc_write(const uint8_t* data, uint16_t len);
+uint16_t cdc_txFree(void);
+void cdc_txComplete(void);
+void cdc_getStats(cdcStats_t* stats);
+
+#endif /* CDC_H_ */
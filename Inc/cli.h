@@ -0,0 +1,135 @@
+/**
+ * @file cli.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Debug command line interface at USART1
+ *
+ * The output is queued into a ring and sent by DMA (DMA1 channel 4) in
+ * bursts of contiguous chunks. The next burst is started by the transfer
+ * complete interrupt, the caller never waits for the UART.
+ *
+ * The input is received by circular DMA (DMA1 channel 5). The half transfer,
+ * transfer complete and IDLE line interrupts publish the DMA position,
+ * cli_handler() splits the input into lines and runs the service console
+ * commands (type "help"). There is no interrupt per received byte.
+ *
+ * cli_setRawInput() passes the input to another consumer instead of the
+ * console (e.g. the USB bridge, see bridge.h). The log output is suspended
+ * meanwhile. The interrupts queue a receive event with their tick, so the
+ * consumer sees the timing of the input at the line and not the latency of
+ * the main loop (see cli_getRxEvent()).
+ *
+ * <code>
+ * // Copy a message into the ring
+ * cli_write((const uint8_t*)"hello\n", 6);
+ *
+ * // Zero copy: format directly into the ring
+ * uint16_t len;
+ * uint8_t* p = cli_txAcquire(&len);
+ * if(len >= 4)
+ * {
+ *    p[0] = 'a'; p[1] = 'b'; p[2] = 'c'; p[3] = '\n';
+ *    cli_txCommit(4);
+ * }
+ * </code>
+ */
+#ifndef CLI_H_
+#define CLI_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Size of the transmit ring in bytes (power of two)
+ */
+#ifndef CLI_TX_BUFFER_SIZE
+#define CLI_TX_BUFFER_SIZE          (512)
+#endif
+
+/**
+ * Size of the circular receive buffer in bytes. The main loop must process
+ * the input before the DMA wraps around (89ms at 115200 baud). A background
+ * erase of the flash stalls the main loop and the UART interrupts for 20 to
+ * 40ms, the buffer holds it with the jitter of the main loop.
+ */
+#ifndef CLI_RX_BUFFER_SIZE
+#define CLI_RX_BUFFER_SIZE          (1024)
+#endif
+
+/**
+ * Number of receive events which are queued for the raw consumer (power of
+ * two). More events are merged into the newest one.
+ */
+#define CLI_RX_EVENTS               (8)
+
+/**
+ * Maximum length of a console command line
+ */
+#define CLI_LINE_SIZE               (64)
+
+/**
+ * Maximum number of arguments of a console command (incl. the command)
+ */
+#define CLI_MAX_ARGS                (4)
+
+/**
+ * Send the deferred log frames of mlog.h at the UART from the boot on. The
+ * binary frames mix with the text of the console and the Modbus frames, by
+ * default they are sent at the ITM until the console command "log on".
+ */
+#ifndef CLI_LOG_OUTPUT
+#define CLI_LOG_OUTPUT              (0)
+#endif
+
+/**
+ * Statistics of the command line interface
+ */
+typedef struct cliStats_s {
+    uint32_t sent;          /* Bytes sent by DMA */
+    uint32_t bursts;        /* Number of DMA transfers */
+    uint32_t dropped;       /* Bytes dropped because the ring was full */
+    uint16_t highWatermark; /* Maximum fill level of the transmit ring */
+    uint32_t received;      /* Bytes received by DMA */
+    uint32_t rxLost;        /* Bytes overwritten before they were processed */
+    uint32_t rxErrors;      /* Receive errors (restart of the reception) */
+    uint32_t lines;         /* Console command lines */
+} cliStats_t;
+
+/**
+ * Receive event (IDLE line, half or complete transfer) of the raw input
+ */
+typedef struct cliRxEvent_s {
+    uint32_t received;  /* Total number of received bytes at the interrupt */
+    uint32_t tick;      /* Tick of the interrupt */
+    uint32_t silence;   /* Idle time of the line before the input in ms, 0 if the input continues the input before */
+    uint8_t idle;       /* The line was idle at the interrupt */
+} cliRxEvent_t;
+
+/**
+ * Consumer of the raw input
+ *
+ * Returns the number of consumed bytes. The rest is passed again at the next
+ * call of cli_handler().
+ */
+typedef uint16_t (*cliRawInput_t)(const uint8_t* data, uint16_t len);
+
+void cli_init(void);
+void cli_handler(void);
+void cli_uartIrqHandler(void);
+uint16_t cli_write(const uint8_t* data, uint16_t len);
+uint8_t* cli_txAcquire(uint16_t* len);
+void cli_txCommit(uint16_t len);
+uint16_t cli_txFree(void);
+void cli_print(const char* str);
+void cli_printNum(uint32_t val);
+void cli_getStats(cliStats_t* stats);
+void cli_setRawInput(cliRawInput_t input);
+cliRawInput_t cli_getRawInput(void);
+const cliRxEvent_t* cli_getRxEvent(void);
+void cli_setFormat(uint32_t baudRate, uint32_t wordLength, uint32_t stopBits, uint32_t parity);
+
+#endif /* CLI_H_ */
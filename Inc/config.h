@@ -60,7 +60,34 @@
 #define CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR     (0x5555)
 #define CFG_TIMEOUT_FLOOR2_ARRIVE_IDX       (4)
 
+/**
+ * Number of drives since the first power on (wraps around)
+ */
+#define CFG_TRIP_COUNT_DEFAULT              (0)
+#define CFG_TRIP_COUNT_VADDR                (0x6666)
+#define CFG_TRIP_COUNT_IDX                  (5)
+
+/**
+ * Modbus slave address at USART1 (0: service console, see modbus.h)
+ */
+#define CFG_MODBUS_ADDR_DEFAULT             (0)
+#define CFG_MODBUS_ADDR_MAX                 (247)
+#define CFG_MODBUS_ADDR_MIN                 (0)
+#define CFG_MODBUS_ADDR_VADDR               (0x7777)
+#define CFG_MODBUS_ADDR_IDX                 (6)
+
+/**
+ * Valid range of a configuration variable
+ */
+typedef struct cfgRange_s {
+	uint16_t virtAddress;
+	uint16_t min;
+	uint16_t max;
+} cfgRange_t;
 
 extern uint16_t VirtAddVarTab[];
 
+const cfgRange_t* cfg_getRange(uint16_t virtAddress);
+uint8_t cfg_isValid(uint16_t virtAddress, uint16_t data);
+
 #endif /* CONFIG_H_ */
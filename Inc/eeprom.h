@@ -28,47 +28,106 @@
 
 /* Exported constants --------------------------------------------------------*/
 
-/* EEPROM start address in Flash */
-#define EEPROM_START_ADDRESS    ((uint32_t)0x0800F800) /* EEPROM emulation start address:
-                                                  after 61KByte of used Flash memory */
+/* Number of flash pages used by the EEPROM emulation log (minimum 2).
+ * The pages are used as a circular log so every additional page spreads the
+ * erase cycles over more flash. The VEEPROM region in the linker script must
+ * cover EE_PAGE_COUNT pages starting at EEPROM_START_ADDRESS.
+ */
+#ifndef EE_PAGE_COUNT
+#define EE_PAGE_COUNT           ((uint16_t)3)
+#endif
+
+/* EEPROM end address in Flash (end of the 64KByte device) */
+#define EEPROM_END_ADDRESS      ((uint32_t)0x08010000)
 
-/* Pages 0 and 1 base and end addresses */
-#define PAGE0_BASE_ADDRESS      ((uint32_t)(EEPROM_START_ADDRESS + 0x000))
-#define PAGE0_END_ADDRESS       ((uint32_t)(EEPROM_START_ADDRESS + (FLASH_PAGE_SIZE - 1)))
+/* EEPROM start address in Flash */
+#define EEPROM_START_ADDRESS    ((uint32_t)(EEPROM_END_ADDRESS - (EE_PAGE_COUNT * FLASH_PAGE_SIZE)))
 
-#define PAGE1_BASE_ADDRESS      ((uint32_t)(EEPROM_START_ADDRESS + FLASH_PAGE_SIZE))
-#define PAGE1_END_ADDRESS       ((uint32_t)(EEPROM_START_ADDRESS + (2 * FLASH_PAGE_SIZE - 1)))
+/* Page header layout: status, sequence number, erase counter, reserved */
+#define EE_PAGE_STATUS_OFFSET   ((uint32_t)0x00)
+#define EE_PAGE_SEQ_OFFSET      ((uint32_t)0x02)
+#define EE_PAGE_ERASES_OFFSET   ((uint32_t)0x04)
+#define EE_PAGE_HEADER_SIZE     ((uint32_t)0x08)
 
-/* Used Flash pages for EEPROM emulation */
-#define PAGE0                   ((uint16_t)0x0000)
-#define PAGE1                   ((uint16_t)0x0001)
+/* Size of one record: 16 bit data followed by the 16 bit virtual address */
+#define EE_RECORD_SIZE          ((uint32_t)0x04)
 
 /* No valid page define */
 #define NO_VALID_PAGE           ((uint16_t)0x00AB)
 
 /* Page status definitions */
 #define ERASED                  ((uint16_t)0xFFFF)     /* PAGE is empty */
-#define RECEIVE_DATA            ((uint16_t)0xEEEE)     /* PAGE is marked to receive data */
-#define VALID_PAGE              ((uint16_t)0x0000)     /* PAGE containing valid data */
+#define RECEIVE_DATA            ((uint16_t)0xEEEE)     /* PAGE is the head of the log */
+#define VALID_PAGE              ((uint16_t)0x0000)     /* PAGE is full and contains valid data */
 
-/* Valid pages in read and write defines */
-#define READ_FROM_VALID_PAGE    ((uint8_t)0x00)
-#define WRITE_IN_VALID_PAGE     ((uint8_t)0x01)
+/* Reserved virtual addresses: transaction markers, the completion marker of
+ * the migration of a legacy page and voided records
+ */
+#define EE_VADDR_TXN_BEGIN      ((uint16_t)0xFFFE)
+#define EE_VADDR_TXN_COMMIT     ((uint16_t)0xFFFD)
+#define EE_VADDR_MIGRATED       ((uint16_t)0xFFFC)
+#define EE_VADDR_VOID           ((uint16_t)0x0000)
 
 /* Page full define */
 #define PAGE_FULL               ((uint8_t)0x80)
 
 /* Variables' number */
-#define NumbOfVar               ((uint8_t)0x04)
+#define NumbOfVar               ((uint8_t)0x07)
+
+/* Number of variables in the write-behind cache */
+#define EE_CACHE_SIZE           ((uint8_t)NumbOfVar)
+
+/* Maximum age of a dirty cache entry until it is written to flash */
+#ifndef EE_CACHE_FLUSH_DELAY_MS
+#define EE_CACHE_FLUSH_DELAY_MS ((uint32_t)(15 * 60 * 1000))
+#endif
 
 /* Exported types ------------------------------------------------------------*/
+
+/**
+ * EEPROM emulation statistics since the last ee_init()
+ */
+typedef struct eeStats_s {
+  uint32_t writes;      /* Variables written by the user */
+  uint32_t programs;    /* Half words programmed into flash */
+  uint32_t erases;      /* Pages erased */
+  uint32_t reclaims;    /* Pages reclaimed by the garbage collection */
+  uint32_t copies;      /* Live records copied by the garbage collection */
+  uint32_t transactions;/* Committed transactions */
+  uint32_t discarded;   /* Uncommitted transactions discarded by ee_init() */
+  uint32_t cacheWrites; /* Writes into the write-behind cache */
+  uint32_t coalesced;   /* Cache writes which replaced a dirty value */
+  uint32_t flushes;     /* Cache flushes with at least one dirty variable */
+  uint32_t flushedVars; /* Dirty variables written by cache flushes */
+} eeStats_t;
+
+/**
+ * Variable of a transaction
+ */
+typedef struct eeVar_s {
+  uint16_t virtAddress;
+  uint16_t data;
+} eeVar_t;
+
 /* Exported macro ------------------------------------------------------------*/
 /* Exported functions ------------------------------------------------------- */
 uint16_t ee_init(void);
+void ee_handler(void);
+uint8_t ee_isBusy(void);
 uint16_t ee_readVariable(uint16_t VirtAddress, uint16_t* Data);
 uint16_t ee_readVariableOrDefault(uint16_t VirtAddress, uint16_t* Data, const uint16_t dataDefault);
 uint16_t ee_writeVariable(uint16_t VirtAddress, uint16_t Data);
 uint16_t ee_writeVariableIfDifferent(uint16_t VirtAddress, uint16_t Data);
+uint16_t ee_writeVariables(const eeVar_t* Vars, uint16_t Count);
+uint16_t ee_readVariablesOrDefault(eeVar_t* Vars, uint16_t Count);
+
+uint16_t ee_cacheWrite(uint16_t VirtAddress, uint16_t Data);
+uint16_t ee_flush(void);
+void ee_requestFlush(void);
+uint8_t ee_getDirtyCount(void);
+
+void ee_getStats(eeStats_t* Stats);
+uint16_t ee_getPageEraseCount(uint16_t Page);
 
 #endif /* __EEPROM_H */
 
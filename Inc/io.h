@@ -11,45 +11,109 @@
  *
  * Use this abstraction layer for easy change management on GPIO's and for
  * better readable code.
+ *
+ * Every input and output passes the pin functions of the backend:
+ *
+ * - Default (target): direct register access. An output is a single store to
+ *   BSRR or BRR, an input a load of IDR. The functions can be used from the
+ *   step interrupt running from RAM.
+ * - IO_BACKEND: header of another backend, e.g. io_sim.h of the host
+ *   simulation. It defines IO_SET(), IO_CLR(), IO_TGL() and IO_GET().
+ * - IO_RECORD: records every edge of the pins on top of the backend into a
+ *   RAM ring (see iorec.h).
+ *
+ * All macros are expressions without a trailing semicolon.
  */
 
 #ifndef IO_H_
 #define IO_H_
 
 #include "stm32f1xx_hal.h"
+#include "main.h"
+
+/*
+ * Backend
+ */
+#if defined(IO_BACKEND)
+
+#include IO_BACKEND
+
+#else
+
+#define IO_SET(port_, pin_)         ((port_)->BSRR = (pin_))
+#define IO_CLR(port_, pin_)         ((port_)->BRR = (pin_))
+/* Read-modify-write: the main loop must not toggle pins of a port an interrupt writes */
+#define IO_TGL(port_, pin_)         ((port_)->ODR ^= (pin_))
+#define IO_GET(port_, pin_)         (((port_)->IDR & (pin_)) != 0)
+
+/**
+ * Index of a port (GPIOA = 0)
+ */
+#define IO_PORT_INDEX(port_)        ((uint8_t)(((uint32_t)(port_) - GPIOA_BASE) / (GPIOB_BASE - GPIOA_BASE)))
+
+#endif
+
+#if defined(IO_RECORD)
+
+#include "iorec.h"
+
+#define io_pinSet(port_, pin_)      io_recSet((port_), (pin_))
+#define io_pinClr(port_, pin_)      io_recClr((port_), (pin_))
+#define io_pinTgl(port_, pin_)      io_recTgl((port_), (pin_))
+#define io_pinGet(port_, pin_)      io_recGet((port_), (pin_))
+
+#else
+
+#define io_pinSet(port_, pin_)      IO_SET((port_), (pin_))
+#define io_pinClr(port_, pin_)      IO_CLR((port_), (pin_))
+#define io_pinTgl(port_, pin_)      IO_TGL((port_), (pin_))
+#define io_pinGet(port_, pin_)      IO_GET((port_), (pin_))
+
+#endif
+
+/**
+ * Level of an output
+ */
+#define io_pinOut(port_, pin_)      (((port_)->ODR & (pin_)) != 0)
 
 /*
  * Outputs
  */
-#define io_setStpEnable()       HAL_GPIO_WritePin(MTR_nENABLE_GPIO_Port, MTR_nENABLE_Pin, GPIO_PIN_RESET);
-#define io_clrStpEnable()       HAL_GPIO_WritePin(MTR_nENABLE_GPIO_Port, MTR_nENABLE_Pin, GPIO_PIN_SET);
+#define io_setStpEnable()       io_pinClr(MTR_nENABLE_GPIO_Port, MTR_nENABLE_Pin)
+#define io_clrStpEnable()       io_pinSet(MTR_nENABLE_GPIO_Port, MTR_nENABLE_Pin)
+
+#define io_setStpReset()        io_pinClr(MTR_nRESET_GPIO_Port, MTR_nRESET_Pin)
+#define io_clrStpReset()        io_pinSet(MTR_nRESET_GPIO_Port, MTR_nRESET_Pin)
 
-#define io_setStpReset()        HAL_GPIO_WritePin(MTR_nRESET_GPIO_Port, MTR_nRESET_Pin, GPIO_PIN_RESET);
-#define io_clrStpReset()        HAL_GPIO_WritePin(MTR_nRESET_GPIO_Port, MTR_nRESET_Pin, GPIO_PIN_SET);
+#define io_setStpSleep()        io_pinClr(MTR_nSLEEP_GPIO_Port, MTR_nSLEEP_Pin)
+#define io_clrStpSleep()        io_pinSet(MTR_nSLEEP_GPIO_Port, MTR_nSLEEP_Pin)
 
-#define io_setStpSleep()        HAL_GPIO_WritePin(MTR_nSLEEP_GPIO_Port, MTR_nSLEEP_Pin, GPIO_PIN_RESET);
-#define io_clrStpSleep()        HAL_GPIO_WritePin(MTR_nSLEEP_GPIO_Port, MTR_nSLEEP_Pin, GPIO_PIN_SET);
+/* Used by the step interrupt running from RAM */
+#define io_tglStpStep()         io_pinTgl(MTR_STEP_GPIO_Port, MTR_STEP_Pin)
 
-#define io_tglStpStep()         HAL_GPIO_TogglePin(MTR_STEP_GPIO_Port, MTR_STEP_Pin);
+/* Direction up */
+#define io_setStpDir()          io_pinSet(MTR_DIR_GPIO_Port, MTR_DIR_Pin)
+#define io_clrStpDir()          io_pinClr(MTR_DIR_GPIO_Port, MTR_DIR_Pin)
+#define io_isStpDir()           io_pinOut(MTR_DIR_GPIO_Port, MTR_DIR_Pin)
 
-#define io_setMtrMs1()          HAL_GPIO_WritePin(MTR_MS1_GPIO_Port, MTR_MS1_Pin, GPIO_PIN_SET);
-#define io_clrMtrMs1()          HAL_GPIO_WritePin(MTR_MS1_GPIO_Port, MTR_MS1_Pin, GPIO_PIN_RESET);
+#define io_setMtrMs1()          io_pinSet(MTR_MS1_GPIO_Port, MTR_MS1_Pin)
+#define io_clrMtrMs1()          io_pinClr(MTR_MS1_GPIO_Port, MTR_MS1_Pin)
 
-#define io_setMtrMs2()          HAL_GPIO_WritePin(MTR_MS2_GPIO_Port, MTR_MS2_Pin, GPIO_PIN_SET);
-#define io_clrMtrMs2()          HAL_GPIO_WritePin(MTR_MS2_GPIO_Port, MTR_MS2_Pin, GPIO_PIN_RESET);
+#define io_setMtrMs2()          io_pinSet(MTR_MS2_GPIO_Port, MTR_MS2_Pin)
+#define io_clrMtrMs2()          io_pinClr(MTR_MS2_GPIO_Port, MTR_MS2_Pin)
 
-#define io_setMtrMs3()          HAL_GPIO_WritePin(MTR_MS3_GPIO_Port, MTR_MS3_Pin, GPIO_PIN_SET);
-#define io_clrMtrMs3()          HAL_GPIO_WritePin(MTR_MS3_GPIO_Port, MTR_MS3_Pin, GPIO_PIN_RESET);
+#define io_setMtrMs3()          io_pinSet(MTR_MS3_GPIO_Port, MTR_MS3_Pin)
+#define io_clrMtrMs3()          io_pinClr(MTR_MS3_GPIO_Port, MTR_MS3_Pin)
 
-#define io_setLd1()             HAL_GPIO_WritePin(LD1_OUT_GPIO_Port, LD1_OUT_Pin, GPIO_PIN_RESET);
-#define io_clrLd1()             HAL_GPIO_WritePin(LD1_OUT_GPIO_Port, LD1_OUT_Pin, GPIO_PIN_SET);
-#define io_tglLd1()             HAL_GPIO_TogglePin(LD1_OUT_GPIO_Port, LD1_OUT_Pin);
+#define io_setLd1()             io_pinClr(LD1_OUT_GPIO_Port, LD1_OUT_Pin)
+#define io_clrLd1()             io_pinSet(LD1_OUT_GPIO_Port, LD1_OUT_Pin)
+#define io_tglLd1()             io_pinTgl(LD1_OUT_GPIO_Port, LD1_OUT_Pin)
 
 /*
  * Inputs
  */
-#define io_isSw1()              (HAL_GPIO_ReadPin(SW1_IN_GPIO_Port, SW1_IN_Pin) == GPIO_PIN_RESET)
-#define io_isSw2()              (HAL_GPIO_ReadPin(SW2_IN_GPIO_Port, SW2_IN_Pin) == GPIO_PIN_RESET)
+#define io_isSw1()              (!io_pinGet(SW1_IN_GPIO_Port, SW1_IN_Pin))
+#define io_isSw2()              (!io_pinGet(SW2_IN_GPIO_Port, SW2_IN_Pin))
 
 
 #endif /* IO_H_ */
@@ -0,0 +1,57 @@
+/**
+ * @file iorec.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Recording backend of io.h
+ *
+ * Build with IO_RECORD to pass all pin functions of io.h through this
+ * module. Every change of an output and every change of an input level seen
+ * by a read is recorded with a timestamp into a RAM ring of IO_REC_SIZE
+ * edges. The ring keeps the latest edges, older ones are overwritten and
+ * counted as lost. Read the edges by io_recRead() or with the debugger.
+ *
+ * The timestamp is the DWT cycle counter (72 MHz) unless the backend defines
+ * IO_REC_TIMESTAMP().
+ */
+#ifndef IOREC_H_
+#define IOREC_H_
+
+#include "stm32f1xx_hal.h"
+#include "irq.h"
+
+/**
+ * Number of recorded edges (power of two)
+ */
+#ifndef IO_REC_SIZE
+#define IO_REC_SIZE                 (256)
+#endif
+
+/**
+ * Number of recorded ports (GPIOA to GPIOC)
+ */
+#define IO_REC_PORTS                (3)
+
+/**
+ * Edge of a pin (8 bytes)
+ */
+typedef struct ioEdge_s {
+    uint32_t time;      /* Timestamp */
+    uint16_t pin;       /* Pin mask */
+    uint8_t port;       /* Port index, GPIOA = 0 */
+    uint8_t level;      /* New level */
+} ioEdge_t;
+
+void io_recInit(void);
+void io_recSet(GPIO_TypeDef* port, uint16_t pin) IRQ_RAM_FUNC;
+void io_recClr(GPIO_TypeDef* port, uint16_t pin) IRQ_RAM_FUNC;
+void io_recTgl(GPIO_TypeDef* port, uint16_t pin) IRQ_RAM_FUNC;
+uint8_t io_recGet(GPIO_TypeDef* port, uint16_t pin) IRQ_RAM_FUNC;
+uint16_t io_recRead(ioEdge_t* edges, uint16_t max);
+uint32_t io_recGetLost(void);
+
+#endif /* IOREC_H_ */
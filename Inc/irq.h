@@ -0,0 +1,46 @@
+/**
+ * @file irq.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Interrupt vector table interface
+ *
+ * The vector table is moved to RAM so that interrupt handlers which are
+ * placed in RAM keep running while the flash is busy with an erase or
+ * program operation. On the STM32F1 every instruction fetch from flash
+ * stalls until the flash operation has finished.
+ */
+
+#ifndef IRQ_H_
+#define IRQ_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Number of vector table entries (system exceptions and interrupts)
+ */
+#define IRQ_VECTOR_COUNT            (16 + USBWakeUp_IRQn + 1)
+
+/**
+ * Place a function into RAM. The function can be called from flash code.
+ */
+#define IRQ_RAM_FUNC                __attribute__((section(".RamFunc"), long_call, noinline))
+
+/**
+ * Interrupt priority of handlers placed in RAM. All flash resident handlers
+ * use IRQ_PRIO_FLASH so that they never block a RAM handler while the flash
+ * is busy.
+ */
+#define IRQ_PRIO_RAM                (0)
+#define IRQ_PRIO_FLASH              (1)
+
+typedef void (*irqHandler_t)(void);
+
+void irq_init(void);
+void irq_setHandler(IRQn_Type irqn, irqHandler_t handler);
+
+#endif /* IRQ_H_ */
@@ -0,0 +1,91 @@
+/**
+ * @file isr.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Cycle cost of the interrupt handlers
+ *
+ * Build with ISR_PROFILE to measure every run of the instrumented interrupt
+ * handlers with the DWT cycle counter (72 MHz). ISR_ENTER() at the start and
+ * ISR_EXIT() at the end of a handler record the cycles in between into the
+ * statistics of the source: count, min, max, sum and a log2 histogram.
+ *
+ * The step interrupt (TIM3) preempts all other instrumented interrupts, its
+ * cycles are subtracted from the preempted handler, so every source only
+ * counts its own cycles. A measurement includes a few cycles of the
+ * instrumentation itself. The functions run from RAM like the step interrupt.
+ *
+ * The statistics are read by PROTO_CMD_ISR (proto-client.py <port> isr) or by
+ * the debugger (isrData). Without ISR_PROFILE the ISR_x macros do nothing and
+ * isr.c is empty.
+ */
+#ifndef ISR_H_
+#define ISR_H_
+
+#include "stm32f1xx_hal.h"
+#include "irq.h"
+
+/**
+ * Number of bins of the histogram. Bin 0 counts less than
+ * 2 ^ (ISR_HIST_SHIFT + 1) cycles, bin n counts 2 ^ (n + ISR_HIST_SHIFT) up
+ * to 2 ^ (n + ISR_HIST_SHIFT + 1) - 1 cycles, the last bin also all longer
+ * runs.
+ */
+#define ISR_HIST_BINS               (10)
+#define ISR_HIST_SHIFT              (5)
+
+/**
+ * Instrumented interrupt sources
+ */
+typedef enum isrSource_e {
+    ISR_SRC_TIM3        = 0, /* Step timer, stp_irqHandler() or TIM3_IRQHandler() */
+    ISR_SRC_USB_LP      = 1,
+    ISR_SRC_DMA1_CH4    = 2, /* USART1 TX */
+    ISR_SRC_DMA1_CH5    = 3, /* USART1 RX */
+    ISR_SRC_SYSTICK     = 4,
+
+    ISR_SRC_COUNT
+} isrSource_t;
+
+/**
+ * Statistics of a source
+ */
+typedef struct isrStats_s {
+    uint32_t count;
+    uint32_t min;       /* UINT32_MAX without a run */
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[ISR_HIST_BINS];
+} isrStats_t;
+
+/**
+ * Start of a measurement
+ */
+typedef struct isrFrame_s {
+    uint32_t start;     /* Cycle counter at the entry */
+    uint32_t nested;    /* Preempting cycles at the entry */
+} isrFrame_t;
+
+#ifdef ISR_PROFILE
+
+#define ISR_ENTER()                 isrFrame_t isrFrame_; isr_enter(&isrFrame_)
+#define ISR_EXIT(source_)           isr_exit(&isrFrame_, (source_))
+
+#else
+
+#define ISR_ENTER()                 ((void)0)
+#define ISR_EXIT(source_)           ((void)0)
+
+#endif /* ISR_PROFILE */
+
+void isr_init(void);
+void isr_enter(isrFrame_t* frame) IRQ_RAM_FUNC;
+void isr_exit(const isrFrame_t* frame, isrSource_t source) IRQ_RAM_FUNC;
+void isr_getStats(isrSource_t source, isrStats_t* stats);
+void isr_clear(isrSource_t source);
+
+#endif /* ISR_H_ */
@@ -0,0 +1,94 @@
+/**
+ * @file loop.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Latency and CPU load of the main loop
+ *
+ * Build with LOOP_PROFILE to measure the main loop with the DWT cycle
+ * counter. LOOP_BEGIN() at the start of an iteration measures the previous
+ * iteration, LOOP_MARK() after every handler measures the call of the
+ * handler. The results are collected over a window of LOOP_WINDOW_MS and
+ * published as a status record at the end of the window.
+ *
+ * The shortest iteration since the start is the idle reference: an iteration
+ * where no handler had work. Iterations shorter than twice the reference are
+ * idle, all others busy. The CPU load is the part of the window which was not
+ * spent by the idle iterations at the cost of the reference, so it includes
+ * the busy handlers and all interrupts.
+ *
+ * The record is read by PROTO_CMD_LOOP (proto-client.py <port> loop), by the
+ * stats command of the console or by the debugger (loopData). Without
+ * LOOP_PROFILE the LOOP_x macros do nothing and loop.c is empty.
+ */
+#ifndef LOOP_H_
+#define LOOP_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Length of a window
+ */
+#define LOOP_WINDOW_MS              (1000)
+
+/**
+ * Handlers of the main loop
+ */
+typedef enum loopHandler_e {
+    LOOP_H_APP          = 0,
+    LOOP_H_STP          = 1,
+    LOOP_H_EE           = 2,
+    LOOP_H_MLOG         = 3,
+    LOOP_H_ITM          = 4,
+    LOOP_H_CLI          = 5,
+    LOOP_H_MB           = 6,
+    LOOP_H_BRG          = 7,
+    LOOP_H_PROTO        = 8,
+    LOOP_H_TLM          = 9,
+    LOOP_H_CDC          = 10,
+
+    LOOP_H_COUNT
+} loopHandler_t;
+
+/**
+ * Status record of the main loop (40 bytes). All durations in cycles.
+ */
+typedef struct loopStats_s {
+    uint32_t windows;       /* Completed windows, the record changes with every window */
+    uint32_t iterations;    /* Iterations of the window */
+    uint32_t idle;          /* Idle iterations of the window */
+    uint32_t min;           /* Shortest iteration of the window */
+    uint32_t avg;           /* Average iteration of the window */
+    uint32_t max;           /* Longest iteration of the window */
+    uint32_t idleCycles;    /* Idle reference */
+    uint16_t load;          /* CPU load of the window in 0.1 % */
+    uint8_t worst;          /* Handler with the longest call of the window (loopHandler_t) */
+    uint8_t peak;           /* Handler with the longest call since the last clear */
+    uint32_t worstCycles;   /* Longest call of the window */
+    uint32_t peakCycles;    /* Longest call since the last clear */
+} loopStats_t;
+
+#ifdef LOOP_PROFILE
+
+#define LOOP_BEGIN()                loop_begin()
+#define LOOP_MARK(handler_)         loop_mark(handler_)
+
+#else
+
+#define LOOP_BEGIN()                ((void)0)
+#define LOOP_MARK(handler_)         ((void)0)
+
+#endif /* LOOP_PROFILE */
+
+void loop_init(void);
+void loop_begin(void);
+void loop_mark(loopHandler_t handler);
+void loop_getStats(loopStats_t* stats);
+void loop_clear(void);
+const char* loop_getName(loopHandler_t handler);
+
+#endif /* LOOP_H_ */
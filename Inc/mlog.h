@@ -8,28 +8,139 @@
  * contents is not permitted without prior written authorization.
  *
  * @brief Logging macros
+ *
+ * The log macros do not format the message on the target. They record the
+ * token of the format string, a timestamp and the raw arguments (max.
+ * MLOG_MAX_ARGS integers of 32 bit, checked at compile time) into a RAM ring
+ * buffer. The format strings are
+ * placed into the section .mlog which is not loaded into the flash. The
+ * post build script dumps this section as string table and the host script
+ * mlog-decode.py rebuilds the text:
+ *
+ * <code>
+ * python3 mlog-decode.py Debug/elevator.mlog < uart.bin
+ * </code>
+ *
+ * The ring buffer is written to the registered sinks (see mlog_addSink()) by
+ * mlog_handler() at the main loop. Without a sink the frames are written to
+ * mlog_output(). Define MLOG_PRINTF to use the formatted output of printf instead
+ * (or of MLOG_PRINTF_FUNC, e.g. sim_log() of the host simulation).
  */
 #ifndef MLOG_H_
 #define MLOG_H_
 
+#include <stdint.h>
 #include <stdio.h>
 
 #define MLOG_ENABLED	(MLOG_DEBUG | MLOG_INFO | MLOG_WARNING)
 
+/**
+ * Size of the log ring buffer in 32 bit words (power of two)
+ */
+#ifndef MLOG_BUFFER_WORDS
+#define MLOG_BUFFER_WORDS			(256)
+#endif
+
+/**
+ * Maximum number of arguments of a log message
+ */
+#define MLOG_MAX_ARGS				(4)
+
+/**
+ * Sync byte of a log frame
+ *
+ * A frame is a sequence of 32 bit little endian words:
+ * [token | nargs << 16 | MLOG_FRAME_SYNC << 24] [tick in ms] [arg 0] ...
+ */
+#define MLOG_FRAME_SYNC				(0xA5)
+
+/**
+ * Token of the frame which reports the number of dropped messages
+ */
+#define MLOG_TOKEN_DROPPED			(0xFFFF)
+
+/**
+ * Maximum number of log sinks
+ */
+#define MLOG_MAX_SINKS				(2)
+
+/**
+ * Output function of the log frames
+ *
+ * A write holds whole frames, so a sink may drop a write which does not fit
+ * without losing the sync of the stream.
+ */
+typedef void (*mlogSink_t)(const uint8_t* data, uint16_t len);
+
+#if defined(MLOG_PRINTF)
+
+/**
+ * Output function of the formatted messages (printf compatible)
+ */
+#ifndef MLOG_PRINTF_FUNC
+#define MLOG_PRINTF_FUNC			printf
+#else
+int MLOG_PRINTF_FUNC(const char* fmt, ...);
+#endif
+
+#define MLOG_WRITE(f_, ...)			MLOG_PRINTF_FUNC((f_), ##__VA_ARGS__)
+
+#else
+
+/**
+ * Token of a format string: the offset of the string at the section .mlog
+ */
+#define MLOG_TOKEN(f_)				__extension__({ \
+		static const char mlogFmt[] __attribute__((section(".mlog"), used)) = f_; \
+		(uint16_t)(uintptr_t)mlogFmt; })
+
+/**
+ * Number of the variadic arguments (0 to MLOG_MAX_ARGS, X for 5 to 12)
+ */
+#define MLOG_NARGS(...)				MLOG_NARGS_(0, ##__VA_ARGS__, X, X, X, X, X, X, X, X, 4, 3, 2, 1, 0)
+#define MLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n_, ...)	n_
+
+/**
+ * Argument of a log frame: an integer of at most 32 bit. Floating point, 64
+ * bit and pointer arguments do not compile.
+ */
+#define MLOG_ARG(a_)				__extension__({ \
+		_Static_assert(sizeof(a_) <= 4 && __builtin_classify_type(a_) <= 4, \
+				"log arguments must be integers of at most 32 bit"); \
+		(uint32_t)(a_); })
+
+#define MLOG_CAT(a_, b_)			MLOG_CAT_(a_, b_)
+#define MLOG_CAT_(a_, b_)			a_##b_
+
+#define MLOG_WRITE(f_, ...)			MLOG_CAT(MLOG_WRITE_, MLOG_NARGS(__VA_ARGS__))(f_, ##__VA_ARGS__)
+#define MLOG_WRITE_0(f_)			mlog_write(MLOG_TOKEN(f_), 0)
+#define MLOG_WRITE_1(f_, a_)		mlog_write(MLOG_TOKEN(f_), 1, MLOG_ARG(a_))
+#define MLOG_WRITE_2(f_, a_, b_)	mlog_write(MLOG_TOKEN(f_), 2, MLOG_ARG(a_), MLOG_ARG(b_))
+#define MLOG_WRITE_3(f_, a_, b_, c_)	mlog_write(MLOG_TOKEN(f_), 3, MLOG_ARG(a_), MLOG_ARG(b_), MLOG_ARG(c_))
+#define MLOG_WRITE_4(f_, a_, b_, c_, d_)	mlog_write(MLOG_TOKEN(f_), 4, MLOG_ARG(a_), MLOG_ARG(b_), MLOG_ARG(c_), MLOG_ARG(d_))
+#define MLOG_WRITE_X(f_, ...)		__extension__({ \
+		_Static_assert(0, "more than MLOG_MAX_ARGS log arguments"); })
+
+#if MLOG_MAX_ARGS != 4
+#error "MLOG_WRITE_n are defined for MLOG_MAX_ARGS 4"
+#endif
+
+#endif
+
 #if defined(MLOG_DEBUG)
-#define mDebug(f_, ...) 			printf(("[dbg] " f_), ##__VA_ARGS__)
+#define mDebug(f_, ...) 			MLOG_WRITE(("[dbg] " f_), ##__VA_ARGS__)
 #else
 #define mDebug(f_, ...)				( (void)0 )
 #endif
 
 #if defined (MLOG_INFO)
-#define mInfo(f_, ...) 				printf(("[inf] " f_), ##__VA_ARGS__)
+#define mInfo(f_, ...) 				MLOG_WRITE(("[inf] " f_), ##__VA_ARGS__)
 #else
 #define mInfo(f_, ...)				( (void)0 )
 #endif
 
 #if defined (MLOG_WARNING)
-#define mWarning(f_, ...) 			printf(("[warn] " f_), ##__VA_ARGS__)
+#define mWarning(f_, ...) 			MLOG_WRITE(("[warn] " f_), ##__VA_ARGS__)
 #else
 #define mWarning(f_, ...)				( (void)0 )
 #endif
@@ -41,7 +152,14 @@
  * function at important risk situations to stop the application
  */
 #ifndef mFatal
-#define mFatal(f_, ...) 			{printf(("[fatal] " f_), ##__VA_ARGS__); while(1){}; }
+#define mFatal(f_, ...) 			{MLOG_WRITE(("[fatal] " f_), ##__VA_ARGS__); mlog_handler(); while(1){}; }
 #endif
 
+void mlog_write(uint16_t token, uint8_t nargs, ...);
+void mlog_handler(void);
+uint32_t mlog_getDropped(void);
+uint8_t mlog_addSink(mlogSink_t sink);
+void mlog_removeSink(mlogSink_t sink);
+void mlog_output(const uint8_t* data, uint16_t len);
+
 #endif /* MLOG_H_ */
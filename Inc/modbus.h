@@ -0,0 +1,72 @@
+/**
+ * @file modbus.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Modbus RTU slave at USART1
+ *
+ * If the configuration variable CFG_MODBUS_ADDR is not 0, USART1 is a Modbus
+ * RTU slave with this address instead of the service console (takes effect
+ * after a reset). The slave uses the DMA rings of cli.h: the raw input is
+ * collected into a frame which ends after 3.5 character times without new
+ * input (1.75 ms above 19200 baud), the response is queued into the DMA
+ * transmit ring. The silence is measured by the ticks of the receive
+ * interrupts (see cliRxEvent_t). The main loop only handles complete frames.
+ *
+ * Supported functions: read holding registers (0x03), read input registers
+ * (0x04), write single register (0x06) and write multiple registers (0x10).
+ * Requests to the broadcast address 0 are executed without response.
+ *
+ * Holding registers (read/write): the configuration variables in the order
+ * of VirtAddVarTab, e.g. register 0 is CFG_LONGPRESS_TIME. A write out of the
+ * range of a variable (cfg_isValid()) is refused with the exception 0x03.
+ */
+#ifndef MODBUS_H_
+#define MODBUS_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Maximum size of a RTU frame (address, PDU and crc)
+ */
+#define MB_FRAME_SIZE               (256)
+
+/**
+ * Broadcast address
+ */
+#define MB_ADDR_BROADCAST           (0)
+
+/**
+ * Input registers (read only)
+ */
+typedef enum mbInputReg_e {
+    MB_IREG_APP_STATE       = 0,    /* State of the application */
+    MB_IREG_FLOOR           = 1,    /* Current floor (0 - 2) */
+    MB_IREG_STP_STATE       = 2,    /* State of the stepper (stpState_t) */
+    MB_IREG_TRIPS           = 3,    /* Number of drives */
+    MB_IREG_UPTIME_HIGH     = 4,    /* Seconds since power on, high word */
+    MB_IREG_UPTIME_LOW      = 5,    /* Seconds since power on, low word */
+    MB_IREG_EE_DIRTY        = 6,    /* Variables which are not written to flash yet */
+
+    MB_IREG_COUNT
+} mbInputReg_t;
+
+/**
+ * Statistics of the Modbus slave
+ */
+typedef struct mbStats_s {
+    uint32_t frames;        /* Frames to this slave with a valid crc */
+    uint32_t crcErrors;     /* Frames with an invalid crc */
+    uint32_t overruns;      /* Frames longer than MB_FRAME_SIZE */
+    uint32_t exceptions;    /* Exception responses */
+} mbStats_t;
+
+void mb_init(void);
+void mb_handler(void);
+void mb_getStats(mbStats_t* stats);
+
+#endif /* MODBUS_H_ */
@@ -0,0 +1,109 @@
+/**
+ * @file mtr.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Registry of the operational metrics
+ *
+ * The counters and histograms are registered at compile time: a metric is an
+ * entry of mtrCounter_t or mtrHistogram_t and its name, labels and help text
+ * in the tables of mtr.c. The values are static, zero at the start and valid
+ * before any initialization, nothing is allocated.
+ *
+ * mtr_inc(), mtr_add() and mtr_observe() update a value with a single atomic
+ * read-modify-write (LDREX/STREX), no lock and no disabled interrupts. They
+ * may be called from every interrupt. They run from RAM, but mtr_observe()
+ * reads the bounds of the histogram from flash, only the counters may be
+ * updated from the step interrupt. An observation updates the bucket and the
+ * sum one after the other, a dump in between shows the bucket without the
+ * value at the sum.
+ *
+ * mtr_formatLine() dumps all metrics in the text exposition format of
+ * Prometheus, one line per call:
+ *
+ * <code>
+ * # HELP elevator_trips_total Drives by destination floor
+ * # TYPE elevator_trips_total counter
+ * elevator_trips_total{floor="0"} 42
+ * ...
+ * elevator_drive_ms_bucket{le="4096"} 17
+ * elevator_drive_ms_bucket{le="+Inf"} 42
+ * elevator_drive_ms_sum 180312
+ * elevator_drive_ms_count 42
+ * </code>
+ *
+ * The dump is requested by PROTO_CMD_METRICS (see proto.h), the host tool
+ * metrics-scrape.py turns periodic dumps into a time series.
+ */
+#ifndef MTR_H_
+#define MTR_H_
+
+#include "stm32f1xx_hal.h"
+#include "irq.h"
+
+/**
+ * Maximum length of a dump line (without termination)
+ */
+#define MTR_LINE_SIZE               (96)
+
+/**
+ * Number of buckets of a histogram without the +Inf bucket. The upper bound
+ * of bucket n is 2 ^ (shift + n), the shift is set per histogram.
+ */
+#define MTR_HIST_BUCKETS            (8)
+
+/**
+ * Counters
+ */
+typedef enum mtrCounter_e {
+    MTR_TRIPS_FLOOR0        = 0,
+    MTR_TRIPS_FLOOR1        = 1,
+    MTR_TRIPS_FLOOR2        = 2,
+    MTR_DRIVE_TIMEOUTS      = 3,
+    MTR_DRIVE_SW2_STOPS     = 4,
+    MTR_DRIVE_NOT_ARRIVED   = 5,
+    MTR_BUTTON_PRESSES      = 6,
+    MTR_STORE_ERRORS        = 7,
+    MTR_EE_PAGE_TRANSFERS   = 8,
+    MTR_EE_VAR_COPIES       = 9,
+    MTR_EE_PAGE_ERASES      = 10,
+
+    MTR_COUNTER_COUNT
+} mtrCounter_t;
+
+/**
+ * Histograms
+ */
+typedef enum mtrHistogram_e {
+    MTR_DRIVE_MS            = 0,
+
+    MTR_HIST_COUNT
+} mtrHistogram_t;
+
+/**
+ * Position of a dump
+ */
+typedef struct mtrCursor_s {
+    uint8_t metric;     /* Counters, then histograms */
+    uint8_t line;       /* Line of the metric */
+
+    /**
+     * Cumulative buckets and sum of the histogram in progress, copied at its
+     * first line so all lines of a histogram match
+     */
+    uint32_t buckets[MTR_HIST_BUCKETS + 1];
+    uint32_t sum;
+} mtrCursor_t;
+
+void mtr_inc(mtrCounter_t counter) IRQ_RAM_FUNC;
+void mtr_add(mtrCounter_t counter, uint32_t val) IRQ_RAM_FUNC;
+void mtr_observe(mtrHistogram_t histogram, uint32_t val) IRQ_RAM_FUNC;
+uint32_t mtr_get(mtrCounter_t counter);
+void mtr_formatStart(mtrCursor_t* cursor);
+uint8_t mtr_formatLine(mtrCursor_t* cursor, char* line);
+
+#endif /* MTR_H_ */
@@ -0,0 +1,94 @@
+/**
+ * @file proto.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Framed binary protocol at the USB CDC interface
+ *
+ * Every frame is COBS encoded and terminated by a zero byte. The decoded
+ * frame is:
+ *
+ * <code>
+ * [cmd] [seq] [payload ...] [crc16 low] [crc16 high]
+ * </code>
+ *
+ * The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over cmd, seq
+ * and payload. A response echoes the sequence number and sets the bit
+ * PROTO_RESPONSE at the command. The first payload byte of a response is the
+ * status (protoStatus_t). Multi byte values are little endian.
+ *
+ * The host client is proto-client.py.
+ */
+#ifndef PROTO_H_
+#define PROTO_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Maximum size of a decoded frame (cmd, seq, payload and crc)
+ */
+#define PROTO_FRAME_SIZE            (64)
+
+/**
+ * Maximum number of trace entries of a PROTO_CMD_TRACE response
+ */
+#define PROTO_TRACE_ENTRIES         (6)
+
+/**
+ * Marker of a response at the command byte
+ */
+#define PROTO_RESPONSE              (0x80)
+
+/**
+ * Protocol commands
+ */
+typedef enum protoCmd_e {
+    PROTO_CMD_PING      = 0x01, /* -> [version u32] */
+    PROTO_CMD_CFG_GET   = 0x02, /* [vaddr u16] -> [data u16] */
+    PROTO_CMD_CFG_SET   = 0x03, /* [vaddr u16] [data u16] -> [] (PROTO_STATUS_INVALID out of the range, see cfg_isValid()) */
+    PROTO_CMD_MOVE      = 0x04, /* [dir u8: 0 up, 1 down] [steps u32] -> [] Service move (see app_requServiceMove()) */
+    PROTO_CMD_STOP      = 0x05, /* -> [] Stop the motor, a drive returns to the idle position (see app_requStop()) */
+    PROTO_CMD_STATUS    = 0x06, /* -> [tick u32] [stepper state u8] [ee dirty u8] [ee writes u32] [ee erases u32] [log dropped u32] */
+    PROTO_CMD_LOG       = 0x07, /* [enable u8] -> [] */
+    PROTO_CMD_TELEMETRY = 0x08, /* [divider u8: sample every divider ms, 0 stop] -> [] (see tlm.h) */
+    PROTO_CMD_BRIDGE    = 0x09, /* -> [] Connect USB to USART1 until a break (see bridge.h) */
+    PROTO_CMD_TRACE     = 0x0A, /* [index u16] -> [count u16] [lost u32] [up to PROTO_TRACE_ENTRIES trcEntry_t] (TRC_RECORD only, see trc.h) */
+    PROTO_CMD_ISR       = 0x0B, /* [source u8] [clear u8] -> [count u32] [min u32] [max u32] [avg u32] [hist u32 x ISR_HIST_BINS] (ISR_PROFILE only, see isr.h) */
+    PROTO_CMD_LOOP      = 0x0C, /* [clear u8] -> [loopStats_t] (LOOP_PROFILE only, see loop.h) */
+    PROTO_CMD_METRICS   = 0x0D, /* -> [] Dump the metrics by PROTO_CMD_METRICS_DATA frames (see mtr.h) */
+
+    PROTO_CMD_LOG_DATA  = 0x40, /* Unsolicited: [mlog frame bytes] */
+    PROTO_CMD_METRICS_DATA = 0x41 /* Unsolicited: [text of the dump], empty at the end of the dump */
+} protoCmd_t;
+
+/**
+ * Status of a response
+ */
+typedef enum protoStatus_e {
+    PROTO_STATUS_OK         = 0,
+    PROTO_STATUS_UNKNOWN    = 1, /* Unknown command */
+    PROTO_STATUS_LENGTH     = 2, /* Invalid payload length */
+    PROTO_STATUS_INVALID    = 3, /* Invalid parameter */
+    PROTO_STATUS_BUSY       = 4, /* Elevator or flash is busy, retry */
+    PROTO_STATUS_ERROR      = 5  /* Execution failed */
+} protoStatus_t;
+
+/**
+ * Statistics of the protocol
+ */
+typedef struct protoStats_s {
+    uint32_t frames;        /* Valid frames received */
+    uint32_t crcErrors;     /* Frames with invalid CRC */
+    uint32_t framingErrors; /* Invalid COBS encoding or too long frames */
+    uint32_t txDropped;     /* Frames dropped because the transmit queue was full */
+} protoStats_t;
+
+void proto_init(void);
+void proto_handler(void);
+void proto_getStats(protoStats_t* stats);
+
+#endif /* PROTO_H_ */
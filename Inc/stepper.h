@@ -14,6 +14,7 @@
 #define STEPPER_H_
 
 #include "stm32f1xx_hal.h"
+#include "irq.h"
 
 typedef enum stpCmd_e {
 	STP_CMD_NONE		= 0,
@@ -42,8 +43,13 @@ void stp_handler(void);
 void stp_requ(stpCmd_t cmd, uint32_t steps);
 void stp_requStopFast(void);
 stpState_t stp_getState(void);
+uint32_t stp_getStepCount(void);
+uint32_t stp_getPeriod(void);
 
 void stp_setPeriodStartRamp(uint16_t val);
 void stp_setPeriodEndRamp(uint16_t val);
+void stp_setPeriodStep(uint16_t val);
+
+void stp_irqHandler(void) IRQ_RAM_FUNC;
 
 #endif /* STEPPER_H_ */
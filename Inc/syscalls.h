@@ -0,0 +1,44 @@
+/**
+ * @file syscalls.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief System call interface
+ *
+ * The output of _write() (printf, puts, ...) is buffered in a ring and sent
+ * to the ITM stimulus port 0 by sys_itmHandler() whenever the port FIFO has
+ * room. _write() never waits for the debugger and may be called from the
+ * main loop and from ISRs. The output written while no debugger is attached
+ * is discarded and counted.
+ */
+#ifndef SYSCALLS_H_
+#define SYSCALLS_H_
+
+#include <stdint.h>
+
+/**
+ * Size of the ITM output ring in bytes (power of two)
+ */
+#ifndef SYS_ITM_BUFFER_SIZE
+#define SYS_ITM_BUFFER_SIZE         (512)
+#endif
+
+/**
+ * Statistics of the ITM output
+ */
+typedef struct sysItmStats_s {
+    uint32_t written;       /* Bytes sent to the ITM port */
+    uint32_t dropped;       /* Bytes dropped because the ring was full */
+    uint32_t discarded;     /* Bytes discarded while no debugger was attached */
+    uint16_t highWatermark; /* Maximum fill level of the ring */
+} sysItmStats_t;
+
+int _write(int file, char *ptr, int len);
+void sys_itmHandler(void);
+void sys_getItmStats(sysItmStats_t* stats);
+
+#endif /* SYSCALLS_H_ */
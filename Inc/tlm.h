@@ -0,0 +1,85 @@
+/**
+ * @file tlm.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Motion telemetry at the USB CDC interface
+ *
+ * tlm_tick() samples the step count, the step period, the state of the
+ * stepper and the input levels from the SysTick interrupt. The SysTick has a
+ * lower priority than the step timer, so the sampling never delays a step.
+ * The samples are collected into two packets of TLM_PACKET_SIZE bytes: one is
+ * filled while the other is passed to the transmit queue of the CDC interface
+ * (see cdc.h) by tlm_handler() at the main loop. If the host does not read
+ * fast enough, the filled packet is dropped and the gap is visible at the
+ * sequence number.
+ *
+ * The stream is started and stopped by PROTO_CMD_TELEMETRY. The packets are
+ * sent raw (not as protocol frames). A zero byte follows the last packet, so
+ * the host finds the start of the next protocol frame. The host tool is
+ * tlm-capture.py.
+ */
+#ifndef TLM_H_
+#define TLM_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Number of samples of a packet
+ */
+#define TLM_SAMPLES                 (7)
+
+/**
+ * Marker at the beginning of a packet ("TM")
+ */
+#define TLM_MAGIC                   (0x4D54)
+
+/**
+ * Bits of tlmSample_t::inputs
+ */
+#define TLM_INPUT_SW1               (1 << 0)
+#define TLM_INPUT_SW2               (1 << 1)
+#define TLM_INPUT_DIR               (1 << 2)
+
+/**
+ * Sample of the motion (8 bytes)
+ */
+typedef struct __attribute__((packed)) tlmSample_s {
+    uint32_t steps;     /* Steps of the current drive */
+    uint16_t period;    /* Timer period of a step */
+    uint8_t state;      /* State of the stepper (stpState_t) */
+    uint8_t inputs;     /* TLM_INPUT_x */
+} tlmSample_t;
+
+/**
+ * Telemetry packet (64 bytes, one USB bulk packet)
+ */
+typedef struct __attribute__((packed)) tlmPacket_s {
+    uint16_t magic;     /* TLM_MAGIC */
+    uint16_t seq;       /* Sequence number of the packet */
+    uint32_t tick;      /* Tick of the first sample in ms */
+    tlmSample_t samples[TLM_SAMPLES];
+} tlmPacket_t;
+
+#define TLM_PACKET_SIZE             (sizeof(tlmPacket_t))
+
+/**
+ * Statistics of the telemetry
+ */
+typedef struct tlmStats_s {
+    uint32_t packets;   /* Sent packets */
+    uint32_t overruns;  /* Packets dropped because the other packet was not sent yet */
+} tlmStats_t;
+
+void tlm_init(void);
+void tlm_handler(void);
+void tlm_tick(void);
+void tlm_start(uint8_t divider);
+void tlm_stop(void);
+void tlm_getStats(tlmStats_t* stats);
+
+#endif /* TLM_H_ */
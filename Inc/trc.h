@@ -0,0 +1,113 @@
+/**
+ * @file trc.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Input trace of the application
+ *
+ * Build with TRC_RECORD to record everything the application consumes from
+ * the outside, so a field issue can be replayed by the host simulation
+ * (sim/build/elevator-replay):
+ *
+ * - the configuration read by app_init()
+ * - the levels of SW1 and SW2 where the application reads them, if they
+ *   differ from the last read
+ * - the drive and stop commands of the console and of the USB protocol
+ * - the states of the FSM, to check the replay
+ *
+ * The time of an entry is the SysTick: HAL_GetTick() * (LOAD + 1) plus the
+ * elapsed counter, i.e. CPU cycles since the reset. The stepper continues
+ * the phase of its timer after a stop, so the replay needs the inputs at the
+ * CPU cycle and not only at the millisecond. Every entry carries the cycles
+ * since the previous entry, longer gaps than 59 s are filled by
+ * TRC_TYPE_TICK entries.
+ *
+ * The entries are kept in RAM from the reset on until TRC_SIZE entries are
+ * recorded, further entries are counted as lost: a replay must start at the
+ * power on. The trace is read by PROTO_CMD_TRACE
+ * (proto-client.py <port> trace <file>) as a raw array of trcEntry_t.
+ *
+ * Without TRC_RECORD the TRC_x macros do nothing.
+ */
+#ifndef TRC_H_
+#define TRC_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Number of entries (8 bytes each)
+ */
+#ifndef TRC_SIZE
+#define TRC_SIZE                    (256)
+#endif
+
+/**
+ * Maximum number of steps of a drive command (24 bits)
+ */
+#define TRC_MAX_STEPS               (0xFFFFFF)
+
+/**
+ * Entry type
+ */
+typedef enum trcType_e {
+    TRC_TYPE_TICK       = 0, /* Gap of 0xFFFFFFFF cycles without an entry */
+    TRC_TYPE_INPUT      = 1, /* data: trcInput_t, value: level (1 active) */
+    TRC_TYPE_STATE      = 2, /* data: appState_t entered */
+    TRC_TYPE_CONFIG     = 3, /* data: CFG_x_IDX, value: data */
+    TRC_TYPE_DRIVE_UP   = 4, /* data: steps bits 16 - 23, value: steps bits 0 - 15 */
+    TRC_TYPE_DRIVE_DOWN = 5, /* Same as TRC_TYPE_DRIVE_UP */
+    TRC_TYPE_STOP       = 6, /* Fast stop command */
+} trcType_t;
+
+/**
+ * Traced inputs
+ */
+typedef enum trcInput_e {
+    TRC_INPUT_SW1       = 0,
+    TRC_INPUT_SW2       = 1,
+
+    TRC_INPUT_COUNT
+} trcInput_t;
+
+/**
+ * Entry of the trace (8 bytes, little endian)
+ */
+typedef struct trcEntry_s {
+    uint32_t delta;     /* CPU cycles since the previous entry */
+    uint8_t type;       /* trcType_t */
+    uint8_t data;
+    uint16_t value;
+} trcEntry_t;
+
+#ifdef TRC_RECORD
+
+#define TRC_INPUT(input_, level_)   trc_input((input_), (level_))
+#define TRC_STATE(state_)           trc_add(TRC_TYPE_STATE, (state_), 0)
+#define TRC_CONFIG(idx_, data_)     trc_add(TRC_TYPE_CONFIG, (idx_), (data_))
+#define TRC_DRIVE(cmd_, steps_)     trc_drive((cmd_), (steps_))
+#define TRC_STOP()                  trc_add(TRC_TYPE_STOP, 0, 0)
+
+#else
+
+#define TRC_INPUT(input_, level_)   (level_)
+#define TRC_STATE(state_)           ((void)0)
+#define TRC_CONFIG(idx_, data_)     ((void)0)
+#define TRC_DRIVE(cmd_, steps_)     ((void)0)
+#define TRC_STOP()                  ((void)0)
+
+#endif /* TRC_RECORD */
+
+void trc_init(void);
+uint8_t trc_input(trcInput_t input, uint8_t level);
+void trc_drive(uint8_t cmd, uint32_t steps);
+void trc_add(trcType_t type, uint8_t data, uint16_t value);
+uint64_t trc_getTime(void);
+uint16_t trc_getCount(void);
+uint32_t trc_getLost(void);
+const trcEntry_t* trc_getEntries(void);
+
+#endif /* TRC_H_ */
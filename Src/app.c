@@ -16,6 +16,8 @@
 #include "config.h"
 #include "stepper.h"
 #include "io.h"
+#include "trc.h"
+#include "mtr.h"
 
 /* MLOG settings for the module app */
 #define MLOG_DEBUG			(0x01)
@@ -24,28 +26,9 @@
 
 #include <mlog.h>
 
-/**
- * Application state enumeration type
- */
-typedef enum appState_e {
-	APP_STATE_INIT			    = 0,
-	APP_STATE_IDLE			    = 1,
-	APP_STATE_DRIVING_UP	    = 2,
-	APP_STATE_DRIVING_DOWN	    = 3,
-
-	APP_STATE_SETUP_INIT        = 20,
-    APP_STATE_SETUP_FLOOR2_1    = 21,
-    APP_STATE_SETUP_FLOOR1_0    = 22,
-} appState_t;
-
-/**
- * Floor enumeration type
- */
-typedef enum appFloor_e {
-	APP_FLOOR_0		= 0,
-	APP_FLOOR_1		= 1,
-	APP_FLOOR_2		= 2,
-} appFloor_t;
+/* Inputs of the FSM, recorded by the input trace (see trc.h) */
+#define app_isSw1()         TRC_INPUT(TRC_INPUT_SW1, io_isSw1())
+#define app_isSw2()         TRC_INPUT(TRC_INPUT_SW2, io_isSw2())
 
 typedef enum appDrive_e {
     APP_DRIVE_FLOOR0,
@@ -86,6 +69,11 @@ typedef struct appData_s {
 
 	uint32_t timeoutFloor2;
 
+	/**
+	 * Number of drives, written via the EEPROM write-behind cache
+	 */
+	uint16_t trips;
+
 	struct {
 		appFloor_t current;
 		appFloor_t last;
@@ -96,6 +84,23 @@ typedef struct appData_s {
 		appDrive_t drive;
 	} floor;
 
+	/**
+	 * Steps counted by the setup assistant for the current floor
+	 */
+	uint16_t setupCnt;
+
+	/**
+	 * Move and stop requested by the console or the protocol and the end of
+	 * the last move
+	 */
+	struct {
+		stpCmd_t cmd;
+		uint32_t steps;
+		uint8_t pending;
+		uint8_t stop;
+		uint32_t lastMove;
+	} service;
+
 	struct {
 		appState_t state;
 		appState_t nxState;
@@ -119,6 +124,10 @@ void app_stateDriveDown(void);
 void app_stateSetupInit(void);
 void app_stateSetupFloor21(void);
 void app_stateSetupFloor10(void);
+void app_stateService(void);
+static void app_countTrip(void);
+static void app_countDrive(appState_t state, appState_t nxState);
+static void app_stop(void);
 
 /**
  * Initialize the application variables
@@ -129,6 +138,16 @@ void app_init()
 {
 	uint16_t ret = 0;
 	uint16_t powerOff;
+	uint8_t i;
+	eeVar_t cfg[] = {
+			[CFG_LONGPRESS_TIME_IDX]        = { CFG_LONGPRESS_TIME_VADDR, CFG_LONGPRESS_TIME_DEFAULT },
+			[CFG_POWER_OFF_IDX]             = { CFG_POWER_OFF_VADDR, CFG_POWER_OFF_DEFAULT },
+			[CFG_FLOOR_0_1_TICKS_IDX]       = { CFG_FLOOR_0_1_TICKS_VADDR, CFG_FLOOR_0_1_TICKS_DEFAULT },
+			[CFG_FLOOR_1_2_TICKS_IDX]       = { CFG_FLOOR_1_2_TICKS_VADDR, CFG_FLOOR_1_2_TICKS_DEFAULT },
+			[CFG_TIMEOUT_FLOOR2_ARRIVE_IDX] = { CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR, CFG_TIMEOUT_FLOOR2_ARRIVE_DEFAULT },
+			[CFG_TRIP_COUNT_IDX]            = { CFG_TRIP_COUNT_VADDR, CFG_TRIP_COUNT_DEFAULT },
+			[CFG_MODBUS_ADDR_IDX]           = { CFG_MODBUS_ADDR_VADDR, CFG_MODBUS_ADDR_DEFAULT },
+	};
 
     /** @todo intialize IWDG */
 
@@ -151,6 +170,7 @@ void app_init()
 
 	appData.fsm.state =
 			appData.fsm.nxState = APP_STATE_INIT;
+	TRC_STATE(APP_STATE_INIT);
 
 	appData.floor.current =
 			appData.floor.last = APP_FLOOR_2;
@@ -162,53 +182,45 @@ void app_init()
 	appData.timestamps.powerOn =
 			appData.btnTimestamp = HAL_GetTick();
 
-	HAL_FLASH_Unlock();
+	/* Read the values from the persistent memory. Missing values are written
+	 * with their defaults in one transaction.
+	 */
+	ret = ee_readVariablesOrDefault(cfg, sizeof(cfg) / sizeof(cfg[0]));
 
-	/* Read the values from the persistent memory */
-	ret = ee_readVariableOrDefault(
-			VirtAddVarTab[CFG_LONGPRESS_TIME_IDX],
-			(uint16_t*)&appData.longpressTime,
-			CFG_LONGPRESS_TIME_DEFAULT);
+	for(i = 0; i < sizeof(cfg) / sizeof(cfg[0]); i++)
+	{
+		TRC_CONFIG(i, cfg[i].data);
+	}
 
-	ret = ee_readVariableOrDefault(
-			VirtAddVarTab[CFG_POWER_OFF_IDX],
-			(uint16_t*)&powerOff,
-			CFG_POWER_OFF_DEFAULT);
+	appData.longpressTime = cfg[CFG_LONGPRESS_TIME_IDX].data;
+	powerOff = cfg[CFG_POWER_OFF_IDX].data;
 
 	appData.powerOffTimeMs = 1000 * 60 * powerOff;
 
 	/* Load floor 01 position */
-	ret = ee_readVariableOrDefault(
-			VirtAddVarTab[CFG_FLOOR_0_1_TICKS_IDX],
-			(uint16_t*)&appData.floor.level0_1,
-			CFG_FLOOR_0_1_TICKS_DEFAULT);
+	appData.floor.level0_1 = cfg[CFG_FLOOR_0_1_TICKS_IDX].data;
 
 	mDebug("Load setup for floor 01: %ld\n", appData.floor.level0_1);
 
 	/* Load floor 12 position */
-	ret = ee_readVariableOrDefault(
-			VirtAddVarTab[CFG_FLOOR_1_2_TICKS_IDX],
-			(uint16_t*)&appData.floor.level1_2,
-			CFG_FLOOR_1_2_TICKS_DEFAULT);
+	appData.floor.level1_2 = cfg[CFG_FLOOR_1_2_TICKS_IDX].data;
 
 	mDebug("Load setup for floor 12: %ld\n", appData.floor.level1_2);
 
+	/* Load the timeout to arrive floor 2 */
+	appData.timeoutFloor2 = cfg[CFG_TIMEOUT_FLOOR2_ARRIVE_IDX].data;
 
-    /* Load floor 12 position */
-    ret = ee_readVariableOrDefault(
-            VirtAddVarTab[CFG_TIMEOUT_FLOOR2_ARRIVE_IDX],
-            (uint16_t*)&appData.timeoutFloor2,
-            CFG_TIMEOUT_FLOOR2_ARRIVE_DEFAULT);
+	mDebug("Load timeout for floor 2: %ld\n", appData.timeoutFloor2);
 
-    mDebug("Load setup for floor 12: %ld\n", appData.floor.level1_2);
+	appData.trips = cfg[CFG_TRIP_COUNT_IDX].data;
+
+	mDebug("Load trip count: %d\n", appData.trips);
 
 	stp_setPeriodStartRamp(65535);
 	stp_setPeriodEndRamp(45000);
 
-	HAL_FLASH_Lock();
-
     /* If switch 1 enabled while power on it will enter the setup mode */
-    if( io_isSw1() )
+    if( app_isSw1() )
     {
         mDebug("Setup mode enabled\n");
         appData.fsm.nxState = APP_STATE_SETUP_INIT;
@@ -257,14 +269,27 @@ void app_handler()
 	case APP_STATE_SETUP_FLOOR1_0:
         app_stateSetupFloor10();
 	    break;
+	case APP_STATE_SERVICE:
+	    app_stateService();
+	    break;
 	default:
 		break;
 	}
 
+	/* A requested stop overrides the transition of a drive */
+	if(appData.service.stop)
+	{
+		app_stop();
+	}
+
 	if(appData.fsm.state != appData.fsm.nxState)
 	{
+		app_countDrive(appData.fsm.state, appData.fsm.nxState);
+
 		appData.fsm.state = appData.fsm.nxState;
 		appData.fsm.entered = 0;
+
+		TRC_STATE(appData.fsm.state);
 	}
 
 	/** @todo Test the power off feature */
@@ -304,7 +329,7 @@ void app_stateInit(void)
 	/* If idle position arrived we want to stop the stepper and go to idle
 	 * state
 	 */
-	if( io_isSw2() )
+	if( app_isSw2() )
 	{
 		stp_requStopFast();
 
@@ -320,6 +345,13 @@ void app_stateIdle(void)
 {
 	btnRc_t ret;
 
+	/* A service move takes the car away from its floor */
+	if(appData.service.pending)
+	{
+		appData.fsm.nxState = APP_STATE_SERVICE;
+		return;
+	}
+
 	/* Perform button action */
 	if ( (ret = btn_isPressed() ) == BTN_PRESSED_SHORT)
 	{
@@ -330,6 +362,8 @@ void app_stateIdle(void)
 		/* Update the value for the security timeout */
 		appData.timestamps.driveStarted = HAL_GetTick();
 
+		app_countTrip();
+
 		if(appData.floor.current == APP_FLOOR_2) {
 			appData.fsm.nxState = APP_STATE_DRIVING_DOWN;
 
@@ -375,6 +409,8 @@ void app_stateIdle(void)
         /* Update the value for the security timeout */
         appData.timestamps.driveStarted = HAL_GetTick();
 
+        app_countTrip();
+
 		switch(appData.floor.current)
 		{
 		case APP_FLOOR_0:
@@ -438,6 +474,164 @@ void app_stateIdle(void)
             mWarning("Invalid floor state detected!\n");
 		    break;
 		}
+	}else if(ee_getDirtyCount() &&
+	        HAL_GetTick() - appData.timestamps.driveStarted >= APP_EE_FLUSH_IDLE_TIME)
+	{
+	    /* Write the cached variables while the elevator is not in use */
+	    ee_flush();
+	}
+}
+
+/**
+ * @brief Returns the state of the application
+ */
+uint8_t app_getState(void)
+{
+	return appData.fsm.state;
+}
+
+/**
+ * @brief Returns the current floor
+ */
+uint8_t app_getFloor(void)
+{
+	return appData.floor.current;
+}
+
+/**
+ * @brief Returns the number of drives
+ */
+uint16_t app_getTrips(void)
+{
+	return appData.trips;
+}
+
+/**
+ * @brief Request a service move of the car
+ *
+ * The move is accepted in the idle state and in the service state while the
+ * motor stands. The application enters the service state, the car returns
+ * to the idle position afterwards (see app_stateService()).
+ *
+ * @param cmd STP_CMD_DRIVE_UP or STP_CMD_DRIVE_DOWN
+ * @param steps Number of steps
+ *
+ * @return HAL_OK or HAL_BUSY if the move is refused
+ */
+uint16_t app_requServiceMove(stpCmd_t cmd, uint32_t steps)
+{
+	stpState_t state = stp_getState();
+
+	if((appData.fsm.state != APP_STATE_IDLE && appData.fsm.state != APP_STATE_SERVICE) ||
+			appData.fsm.nxState != appData.fsm.state || appData.service.pending ||
+			(state != STP_STATE_IDLE && state != STP_STATE_ARRIVED))
+	{
+		return HAL_BUSY;
+	}
+
+	TRC_DRIVE(cmd, steps);
+
+	appData.service.cmd = cmd;
+	appData.service.steps = steps;
+	appData.service.pending = 1;
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Request a stop of the motor
+ *
+ * The motor stops at once. A drive to a floor or to the idle position ends
+ * and the car returns to the idle position by the init state, its floor is
+ * unknown. A service move ends and the service state is kept. The stop is
+ * refused by the setup assistant.
+ *
+ * @return HAL_OK or HAL_BUSY if the stop is refused
+ */
+uint16_t app_requStop(void)
+{
+	if(appData.fsm.state == APP_STATE_SETUP_INIT || appData.fsm.state == APP_STATE_SETUP_FLOOR2_1 ||
+			appData.fsm.state == APP_STATE_SETUP_FLOOR1_0)
+	{
+		return HAL_BUSY;
+	}
+
+	TRC_STOP();
+
+	stp_requStopFast();
+
+	appData.service.pending = 0;
+	appData.service.stop = 1;
+
+	return HAL_OK;
+}
+
+/**
+ * @brief Apply a stop of app_requStop() to the state machine
+ */
+static void app_stop(void)
+{
+	appData.service.stop = 0;
+
+	switch(appData.fsm.state)
+	{
+	case APP_STATE_INIT:
+	case APP_STATE_DRIVING_UP:
+	case APP_STATE_DRIVING_DOWN:
+		io_clrLd1();
+
+		appData.floor.current =
+				appData.floor.last = APP_FLOOR_2;
+		appData.floor.drive = APP_DRIVE_FLOOR2;
+
+		/* Enter the init state again to restart the drive to the idle position */
+		appData.fsm.nxState = APP_STATE_INIT;
+		appData.fsm.entered = 0;
+
+		mInfo("drive stopped, return to the idle position\n");
+		break;
+	case APP_STATE_SERVICE:
+		appData.service.lastMove = HAL_GetTick();
+		break;
+	default:
+		/* The motor stands in the idle state */
+		break;
+	}
+}
+
+/**
+ * @brief Count a new drive. The counter is cached in RAM and written to flash
+ * when the elevator is idle for a while.
+ */
+static void app_countTrip(void)
+{
+    appData.trips++;
+
+    if(ee_cacheWrite(CFG_TRIP_COUNT_VADDR, appData.trips) != HAL_OK)
+    {
+        mtr_inc(MTR_STORE_ERRORS);
+        mWarning("failed to cache the trip count\n");
+    }
+}
+
+/**
+ * @brief Count a drive by its destination at the start and record its
+ * duration at the end
+ *
+ * @param state Current state
+ * @param nxState Next state
+ */
+static void app_countDrive(appState_t state, appState_t nxState)
+{
+	uint8_t driving = (state == APP_STATE_DRIVING_UP || state == APP_STATE_DRIVING_DOWN);
+	uint8_t nxDriving = (nxState == APP_STATE_DRIVING_UP || nxState == APP_STATE_DRIVING_DOWN);
+
+	if(state == APP_STATE_IDLE && nxDriving)
+	{
+		mtr_inc((mtrCounter_t)(MTR_TRIPS_FLOOR0 + appData.floor.drive));
+	}else if(driving && nxState == APP_STATE_IDLE)
+	{
+		mtr_observe(MTR_DRIVE_MS, HAL_GetTick() - appData.timestamps.driveStarted);
 	}
 }
 
@@ -447,13 +641,14 @@ void app_stateIdle(void)
 void app_stateDriveUp(void)
 {
 	stpState_t state;
-	uint32_t curTimeStamp;
+	uint8_t stop = 0;
 
 	/* Check if the motor stops */
 	if( (state = stp_getState() ) == STP_STATE_ARRIVED) {
-	    if(appData.floor.drive == APP_DRIVE_FLOOR2 && !io_isSw2())
+	    if(appData.floor.drive == APP_DRIVE_FLOOR2 && !app_isSw2())
 	    {
 	        stp_requ(STP_CMD_DRIVE_UP, 500);
+	        mtr_inc(MTR_DRIVE_NOT_ARRIVED);
 	        mWarning("elevator did not arrive the idle position\n");
 	    }else {
 	        appData.fsm.nxState = APP_STATE_IDLE;
@@ -463,10 +658,17 @@ void app_stateDriveUp(void)
 	}
 
 	/* Stop the drive if idle position has been arrived or timeout occurred */
-	if(
-	        ( io_isSw2() ) ||
-            ((curTimeStamp = HAL_GetTick()) - appData.timestamps.driveStarted >= appData.timeoutFloor2)
-            )
+	if( app_isSw2() )
+	{
+		mtr_inc(MTR_DRIVE_SW2_STOPS);
+		stop = 1;
+	}else if(HAL_GetTick() - appData.timestamps.driveStarted >= appData.timeoutFloor2)
+	{
+		mtr_inc(MTR_DRIVE_TIMEOUTS);
+		stop = 1;
+	}
+
+	if(stop)
 	{
 		stp_requStopFast();
 
@@ -493,7 +695,7 @@ void app_stateDriveDown(void)
     /* Stop the drive if idle position has been arrived. This should never be
      * arrived but for security reasons we check this at this state also.
      */
-    if(HAL_GPIO_ReadPin(SW2_IN_GPIO_Port, SW2_IN_Pin) == GPIO_PIN_RESET)
+    if( app_isSw2() )
     {
         stp_requStopFast();
 
@@ -512,7 +714,7 @@ void app_stateSetupInit()
 {
 
     /* If switch 1 enabled while power on it will enter the setup mode */
-    if( io_isSw2() )
+    if( app_isSw2() )
     {
         stp_requStopFast();
 
@@ -527,9 +729,14 @@ void app_stateSetupInit()
 void app_stateSetupFloor21(void)
 {
     btnRc_t ret;
-    static uint16_t cnt = 0;
     const uint16_t cntStep = 100;
 
+    if(!appData.fsm.entered)
+    {
+        appData.fsm.entered = 1;
+        appData.setupCnt = 0;
+    }
+
     /* Perform button action */
     if ( (ret = btn_isPressed() ) == BTN_PRESSED_SHORT)
     {
@@ -537,30 +744,19 @@ void app_stateSetupFloor21(void)
 
         io_setLd1();
 
-        cnt += cntStep;
+        appData.setupCnt += cntStep;
         stp_requ(STP_CMD_DRIVE_DOWN, cntStep);
 
     }else if(ret == BTN_PRESSED_LONG) {
         btn_clearLongPress();
 
-        HAL_FLASH_Unlock();
-
-        ee_writeVariableIfDifferent(VirtAddVarTab[CFG_FLOOR_1_2_TICKS_IDX], cnt);
-
-        mDebug("Setup floor 12: %d\n", cnt);
-
-        /* */
-        ret = ee_readVariableOrDefault(
-                VirtAddVarTab[CFG_FLOOR_1_2_TICKS_IDX],
-                (uint16_t*)&appData.floor.level1_2,
-                CFG_FLOOR_1_2_TICKS_DEFAULT);
-
-        HAL_FLASH_Lock();
+        /* The value is stored together with floor 01 at the end of the setup */
+        appData.floor.level1_2 = appData.setupCnt;
 
         mDebug("Setup floor 12: %lu\n", appData.floor.level1_2);
 
         /* wait until user release the button */
-        do{}while( io_isSw1() );
+        do{}while( app_isSw1() );
 
         appData.fsm.nxState = APP_STATE_SETUP_FLOOR1_0;
     }
@@ -572,9 +768,15 @@ void app_stateSetupFloor21(void)
 void app_stateSetupFloor10(void)
 {
     btnRc_t ret;
-    static uint16_t cnt = 0;
+    uint16_t status;
     const uint16_t cntStep = 100;
 
+    if(!appData.fsm.entered)
+    {
+        appData.fsm.entered = 1;
+        appData.setupCnt = 0;
+    }
+
     /* Perform button action */
     if ( (ret = btn_isPressed() ) == BTN_PRESSED_SHORT)
     {
@@ -582,31 +784,99 @@ void app_stateSetupFloor10(void)
 
         io_setLd1();
 
-        cnt += cntStep;
+        appData.setupCnt += cntStep;
         stp_requ(STP_CMD_DRIVE_DOWN, cntStep);
 
     }else if(ret == BTN_PRESSED_LONG) {
-        btn_clearLongPress();
-
-        HAL_FLASH_Unlock();
-
-        ee_writeVariable(VirtAddVarTab[CFG_FLOOR_0_1_TICKS_IDX], cnt);
+        eeVar_t floors[] = {
+                { CFG_FLOOR_1_2_TICKS_VADDR, (uint16_t)appData.floor.level1_2 },
+                { CFG_FLOOR_0_1_TICKS_VADDR, appData.setupCnt },
+        };
 
-        mDebug("Setup floor 01: %d\n", cnt);
-
-        ret = ee_readVariableOrDefault(
-                VirtAddVarTab[CFG_FLOOR_0_1_TICKS_IDX],
-                (uint16_t*)&appData.floor.level0_1,
-                CFG_FLOOR_0_1_TICKS_DEFAULT);
+        btn_clearLongPress();
 
-        HAL_FLASH_Lock();
+        appData.floor.level0_1 = appData.setupCnt;
+
+        /* Store both floor positions at once to keep the calibration
+         * consistent on a power loss. During a background erase of the flash
+         * they are cached and written in one transaction by the next flush.
+         */
+        if( (status = ee_writeVariables(floors, sizeof(floors) / sizeof(floors[0]))) == HAL_BUSY)
+        {
+            if( (status = ee_cacheWrite(floors[0].virtAddress, floors[0].data)) == HAL_OK)
+            {
+                status = ee_cacheWrite(floors[1].virtAddress, floors[1].data);
+            }
+            ee_requestFlush();
+        }
+
+        if( status != 0)
+        {
+            mtr_inc(MTR_STORE_ERRORS);
+            mWarning("Setup floors could not be stored\n");
+        }
 
         mDebug("Setup floor 01: %lu\n", appData.floor.level0_1);
 
         /* wait until user release the button */
-        do{}while( io_isSw1() );
+        do{}while( app_isSw1() );
 
         appData.fsm.nxState = APP_STATE_INIT;
     }
 }
 
+/* SERVICE -------------------------------------------------------------------*/
+
+/**
+ * @brief Service moves of the console or the protocol
+ *
+ * The floor of the car is unknown after a move. The car returns to the idle
+ * position by the init state after APP_SERVICE_TIMEOUT without a move or at
+ * a press of SW1.
+ */
+void app_stateService(void)
+{
+	stpState_t state = stp_getState();
+
+	if(!appData.fsm.entered)
+	{
+		appData.fsm.entered = 1;
+		btn_clearAll();
+		mInfo("service mode\n");
+	}
+
+	if(appData.service.pending)
+	{
+		appData.service.pending = 0;
+		appData.service.lastMove = HAL_GetTick();
+
+		stp_requ(appData.service.cmd, appData.service.steps);
+		return;
+	}
+
+	if(state != STP_STATE_IDLE && state != STP_STATE_ARRIVED)
+	{
+		appData.service.lastMove = HAL_GetTick();
+
+		/* The idle position is the upper end of the shaft */
+		if(appData.service.cmd == STP_CMD_DRIVE_UP && app_isSw2())
+		{
+			stp_requStopFast();
+			mDebug("idle position arrived\n");
+		}
+		return;
+	}
+
+	if(btn_isPressed() != BTN_OK ||
+			HAL_GetTick() - appData.service.lastMove >= APP_SERVICE_TIMEOUT)
+	{
+		btn_clearAll();
+
+		appData.floor.current =
+				appData.floor.last = APP_FLOOR_2;
+		appData.floor.drive = APP_DRIVE_FLOOR2;
+
+		mInfo("service mode left\n");
+		appData.fsm.nxState = APP_STATE_INIT;
+	}
+}
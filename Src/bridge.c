@@ -0,0 +1,363 @@
+/**
+ * @file bridge.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB to UART bridge implementation
+ */
+#include "bridge.h"
+#include "usart.h"
+#include "cli.h"
+#include "cdc.h"
+
+/**
+ * Range of the baud rate of USART1 (PCLK2 72 MHz, oversampling 16)
+ */
+#define BRG_BAUDRATE_MIN            (1200)
+#define BRG_BAUDRATE_MAX            (4500000)
+
+/**
+ * CDC line coding struct type
+ */
+typedef struct brgLineCoding_s {
+    uint32_t bitrate;
+    uint8_t format;         /* Stop bits: 0 1, 1 1.5, 2 2 */
+    uint8_t parityType;     /* 0 none, 1 odd, 2 even, 3 mark, 4 space */
+    uint8_t dataType;       /* Data bits */
+} brgLineCoding_t;
+
+/**
+ * Bridge data struct type
+ */
+typedef struct brgData_s {
+    /**
+     * Line coding of the host
+     */
+    brgLineCoding_t lineCoding;
+    volatile uint8_t lineCodingChanged;
+
+    /**
+     * Line coding of the UART
+     */
+    brgLineCoding_t applied;
+
+    /**
+     * Frame format of the service console
+     */
+    UART_InitTypeDef console;
+
+    /**
+     * Consumer of the UART input before the bridge (NULL: console)
+     */
+    cliRawInput_t input;
+
+    volatile uint8_t breakRequest;
+    uint8_t enabled;
+
+    brgStats_t stats;
+} brgData_t;
+
+/**
+ * Module data
+ */
+static brgData_t brgData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint16_t brg_uartInput(const uint8_t* data, uint16_t len);
+static void brg_applyLineCoding(void);
+static uint16_t brg_getFormat(const brgLineCoding_t* coding, uint32_t* wordLength, uint32_t* stopBits,
+        uint32_t* parity);
+
+/**
+ * Basic initialization for the bridge
+ *
+ * @warning Run MX_USART1_UART_Init() before you run this function.
+ */
+void brg_init(void)
+{
+    brgData.console = huart1.Init;
+
+    /* The host may have set the line coding already */
+    if(brgData.lineCoding.bitrate == 0)
+    {
+        brgData.lineCoding.bitrate = huart1.Init.BaudRate;
+        brgData.lineCoding.format = 0;
+        brgData.lineCoding.parityType = 0;
+        brgData.lineCoding.dataType = 8;
+    }
+
+    /* The format of the console until a line coding is applied */
+    brgData.applied.bitrate = huart1.Init.BaudRate;
+    brgData.applied.format = 0;
+    brgData.applied.parityType = 0;
+    brgData.applied.dataType = 8;
+}
+
+/**
+ * @brief Forward the received USB packets to the UART
+ *
+ * Run this handler at the main loop.
+ */
+void brg_handler(void)
+{
+    const uint8_t* packet;
+    uint16_t len;
+
+    if(!brgData.enabled)
+    {
+        return;
+    }
+
+    if(brgData.breakRequest || !cdc_isConfigured())
+    {
+        brg_disable();
+        return;
+    }
+
+    if(brgData.lineCodingChanged)
+    {
+        brg_applyLineCoding();
+    }
+
+    /* A packet which does not fit into the UART ring stays at its slot */
+    while((packet = cdc_rxPeek(&len)) != NULL && len <= cli_txFree())
+    {
+        cli_write(packet, len);
+        brgData.stats.toUart += len;
+        cdc_rxRelease();
+    }
+}
+
+/**
+ * @brief Connect the USB CDC interface to USART1
+ */
+void brg_enable(void)
+{
+    if(brgData.enabled)
+    {
+        return;
+    }
+
+    brgData.breakRequest = 0;
+    brgData.enabled = 1;
+
+    brgData.input = cli_getRawInput();
+    cli_setRawInput(brg_uartInput);
+    brg_applyLineCoding();
+}
+
+/**
+ * @brief Return USART1 to the service console or the previous consumer
+ */
+void brg_disable(void)
+{
+    if(!brgData.enabled)
+    {
+        return;
+    }
+
+    brgData.enabled = 0;
+
+    cli_setRawInput(brgData.input);
+    cli_setFormat(brgData.console.BaudRate, brgData.console.WordLength,
+            brgData.console.StopBits, brgData.console.Parity);
+}
+
+/**
+ * @brief Check if the bridge is running
+ */
+uint8_t brg_isEnabled(void)
+{
+    return brgData.enabled;
+}
+
+/**
+ * @brief Store the line coding of the host
+ *
+ * Called by CDC_Control_FS() from the USB interrupt.
+ *
+ * @param pbuf Line coding (BRG_LINE_CODING_SIZE bytes)
+ */
+void brg_setLineCoding(const uint8_t* pbuf)
+{
+    brgData.lineCoding.bitrate = pbuf[0] | ((uint32_t)pbuf[1] << 8) |
+            ((uint32_t)pbuf[2] << 16) | ((uint32_t)pbuf[3] << 24);
+    brgData.lineCoding.format = pbuf[4];
+    brgData.lineCoding.parityType = pbuf[5];
+    brgData.lineCoding.dataType = pbuf[6];
+
+    brgData.lineCodingChanged = 1;
+}
+
+/**
+ * @brief Get the line coding
+ *
+ * Called by CDC_Control_FS() from the USB interrupt.
+ *
+ * @param pbuf Line coding (BRG_LINE_CODING_SIZE bytes)
+ */
+void brg_getLineCoding(uint8_t* pbuf)
+{
+    pbuf[0] = brgData.lineCoding.bitrate;
+    pbuf[1] = brgData.lineCoding.bitrate >> 8;
+    pbuf[2] = brgData.lineCoding.bitrate >> 16;
+    pbuf[3] = brgData.lineCoding.bitrate >> 24;
+    pbuf[4] = brgData.lineCoding.format;
+    pbuf[5] = brgData.lineCoding.parityType;
+    pbuf[6] = brgData.lineCoding.dataType;
+}
+
+/**
+ * @brief Request to stop the bridge
+ *
+ * Called by CDC_Control_FS() from the USB interrupt.
+ */
+void brg_sendBreak(void)
+{
+    if(brgData.enabled)
+    {
+        brgData.breakRequest = 1;
+    }
+}
+
+/**
+ * @brief Copy the statistics of the bridge
+ *
+ * @param stats Destination of the statistics
+ */
+void brg_getStats(brgStats_t* stats)
+{
+    *stats = brgData.stats;
+}
+
+/**
+ * @brief Forward the UART input to USB
+ *
+ * @param data Received bytes
+ * @param len Number of bytes
+ *
+ * @return Number of consumed bytes
+ */
+static uint16_t brg_uartInput(const uint8_t* data, uint16_t len)
+{
+    if(cdc_write(data, len) == 0)
+    {
+        return 0;
+    }
+
+    brgData.stats.toUsb += len;
+    return len;
+}
+
+/**
+ * @brief Apply the line coding of the host to the UART
+ *
+ * A line coding the UART cannot frame is rejected: the UART keeps its format
+ * and the line coding is reset to the applied one, so the host reads the
+ * real format with CDC_GET_LINE_CODING.
+ */
+static void brg_applyLineCoding(void)
+{
+    brgLineCoding_t coding;
+    uint32_t primask;
+    uint32_t stopBits;
+    uint32_t parity;
+    uint32_t wordLength;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    coding = brgData.lineCoding;
+    brgData.lineCodingChanged = 0;
+    __set_PRIMASK(primask);
+
+    if(brg_getFormat(&coding, &wordLength, &stopBits, &parity) != HAL_OK)
+    {
+        brgData.stats.rejected++;
+
+        primask = __get_PRIMASK();
+        __disable_irq();
+        if(!brgData.lineCodingChanged)
+        {
+            brgData.lineCoding = brgData.applied;
+        }
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    brgData.applied = coding;
+    cli_setFormat(coding.bitrate, wordLength, stopBits, parity);
+}
+
+/**
+ * @brief Map a line coding to the frame format of the UART
+ *
+ * The word length of the UART includes the parity bit, so it frames 7 or 8
+ * data bits with parity and 8 data bits without parity only.
+ *
+ * @param coding Line coding
+ * @param wordLength Destination of the word length
+ * @param stopBits Destination of the stop bits
+ * @param parity Destination of the parity
+ *
+ * @return HAL_OK or HAL_ERROR if the UART does not support the line coding
+ */
+static uint16_t brg_getFormat(const brgLineCoding_t* coding, uint32_t* wordLength, uint32_t* stopBits,
+        uint32_t* parity)
+{
+    if(coding->bitrate < BRG_BAUDRATE_MIN || coding->bitrate > BRG_BAUDRATE_MAX)
+    {
+        return HAL_ERROR;
+    }
+
+    switch(coding->format)
+    {
+    case 0:
+        *stopBits = UART_STOPBITS_1;
+        break;
+
+    case 2:
+        *stopBits = UART_STOPBITS_2;
+        break;
+
+    default:
+        return HAL_ERROR;
+    }
+
+    switch(coding->parityType)
+    {
+    case 0:
+        *parity = UART_PARITY_NONE;
+        break;
+
+    case 1:
+        *parity = UART_PARITY_ODD;
+        break;
+
+    case 2:
+        *parity = UART_PARITY_EVEN;
+        break;
+
+    default:
+        return HAL_ERROR;
+    }
+
+    if(coding->dataType == 8)
+    {
+        *wordLength = (*parity == UART_PARITY_NONE) ? UART_WORDLENGTH_8B : UART_WORDLENGTH_9B;
+    }
+    else if(coding->dataType == 7 && *parity != UART_PARITY_NONE)
+    {
+        *wordLength = UART_WORDLENGTH_8B;
+    }
+    else
+    {
+        return HAL_ERROR;
+    }
+
+    return HAL_OK;
+}
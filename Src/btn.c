@@ -10,6 +10,9 @@
  * @brief Button implementation
  */
 #include "btn.h"
+#include "io.h"
+#include "trc.h"
+#include "mtr.h"
 
 /**
  * Button data struct type
@@ -25,6 +28,11 @@ typedef struct btnData_s {
 
     uint16_t buttonDebCnt;
 
+    /* Counter for number of equal states */
+    uint8_t count;
+    /* Keeps track of current (debounced) state */
+    uint8_t btnState;
+
     uint32_t timestamp;
 } btnData_t;
 
@@ -42,6 +50,8 @@ void btn_init()
     btnData.longPressActive = 0;
     btnData.longPressActiveRepeat = 0;
     btnData.buttonDebCnt = BTN_DEBOUNCE_CNT_DEFAULT;
+    btnData.count = 0;
+    btnData.btnState = GPIO_PIN_SET;
 }
 
 /**
@@ -120,21 +130,16 @@ void btn_handler(void)
 	uint32_t curTimeStamp;
     
     curTimeStamp = HAL_GetTick();
-    
-    /* Counter for number of equal states */
-    static uint8_t count = 0;
-    /* Keeps track of current (debounced) state */
-    static uint8_t btnState = GPIO_PIN_SET;
 
     //uint32_t stateChanged = ~SW1_IN_GPIO_Port->IDR ^ btnState;
 
     /* Check if button is high or low for the moment */
-    if ( (btnData.currentState = HAL_GPIO_ReadPin(SW1_IN_GPIO_Port, SW1_IN_Pin) ) != btnState) {
+    if ( (btnData.currentState = TRC_INPUT(TRC_INPUT_SW1, io_isSw1()) ? GPIO_PIN_RESET : GPIO_PIN_SET) != btnData.btnState) {
         /* Button state is about to be changed, increase counter */
-        count++;
-        if (count >= btnData.buttonDebCnt) {
+        btnData.count++;
+        if (btnData.count >= btnData.buttonDebCnt) {
             /* The button have not bounced for N checks, change state */
-            btnState = btnData.currentState;
+            btnData.btnState = btnData.currentState;
 
             /* Start the timestamp to detect the press time but do this only once */
             if(btnData.buttonDown == 0) {
@@ -144,12 +149,13 @@ void btn_handler(void)
             /* If the button was pressed (not released), tell main so */
             if (btnData.currentState != GPIO_PIN_SET) {
                 btnData.buttonDown = 1;
+                mtr_inc(MTR_BUTTON_PRESSES);
             }
-            count = 0;
+            btnData.count = 0;
         }
     } else {
         /* Button released or debouncing so we reset the counter counter */
-        count = 0;
+        btnData.count = 0;
 
         /* If the button was pressed (not released) */
         if(btnData.buttonDown == 1 && btnData.currentState == GPIO_PIN_RESET) {
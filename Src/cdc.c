@@ -0,0 +1,368 @@
+/**
+ * @file cdc.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Packet buffers of the USB CDC interface implementation
+ */
+#include <string.h>
+
+#include "cdc.h"
+#include "usb_device.h"
+#include "usbd_cdc.h"
+
+#define CDC_RX_SLOTS_MASK           (CDC_RX_SLOTS - 1)
+
+#define CDC_TX_BUFFER_MASK          (CDC_TX_BUFFER_SIZE - 1)
+
+#if (CDC_RX_SLOTS & CDC_RX_SLOTS_MASK) != 0 || (CDC_TX_BUFFER_SIZE & CDC_TX_BUFFER_MASK) != 0
+#error "CDC_RX_SLOTS and CDC_TX_BUFFER_SIZE must be a power of two"
+#endif
+
+/**
+ * CDC data struct type
+ */
+typedef struct cdcData_s {
+    struct {
+        uint8_t slots[CDC_RX_SLOTS][CDC_PACKET_SIZE];
+        uint8_t len[CDC_RX_SLOTS];
+
+        /**
+         * Free running slot indices. The slots from tail to head - 1 are
+         * received, the slot head is armed at the endpoint unless stalled.
+         */
+        volatile uint8_t head;
+        volatile uint8_t tail;
+
+        /**
+         * The endpoint is not armed because all slots are used
+         */
+        volatile uint8_t stalled;
+    } rx;
+
+    struct {
+        uint8_t buffer[CDC_TX_BUFFER_SIZE];
+        /**
+         * Free running write and read index. The bytes from tail to tail +
+         * inflight are sent by the running transfer.
+         */
+        volatile uint16_t head;
+        volatile uint16_t tail;
+        volatile uint16_t inflight;
+
+        /**
+         * Tick of the last transfer or of the first write to the empty queue
+         */
+        uint32_t pendingSince;
+
+        /**
+         * The last transfer ended with a full packet and needs a zero length
+         * packet if no data follows
+         */
+        volatile uint8_t zlp;
+    } tx;
+
+    cdcStats_t stats;
+} cdcData_t;
+
+/**
+ * Module data
+ */
+static cdcData_t cdcData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void cdc_txStart(void);
+
+/**
+ * @brief Send the pending short packet
+ *
+ * Run this handler at the main loop.
+ */
+void cdc_handler(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* Nobody listens: discard the output */
+    if(!cdc_isConfigured())
+    {
+        cdcData.tx.tail = cdcData.tx.head;
+        cdcData.tx.inflight = 0;
+        cdcData.tx.zlp = 0;
+    }else
+    {
+        cdc_txStart();
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Check if the USB device is configured by the host
+ */
+uint8_t cdc_isConfigured(void)
+{
+    return hUsbDeviceFS.dev_state == USBD_STATE_CONFIGURED;
+}
+
+/**
+ * @brief Reset the receive slots
+ *
+ * Called by CDC_Init_FS() when the host configures the device.
+ *
+ * @return Slot to arm at the endpoint
+ */
+uint8_t* cdc_rxInit(void)
+{
+    cdcData.rx.head = 0;
+    cdcData.rx.tail = 0;
+    cdcData.rx.stalled = 0;
+
+    return cdcData.rx.slots[0];
+}
+
+/**
+ * @brief Commit the received packet and get the next slot
+ *
+ * Called by CDC_Receive_FS() from the USB interrupt.
+ *
+ * @param len Number of bytes received into the armed slot
+ *
+ * @return Slot to arm at the endpoint or NULL if all slots are used
+ */
+uint8_t* cdc_rxReceived(uint32_t len)
+{
+    uint8_t head = cdcData.rx.head;
+
+    /* A zero length packet does not need a slot */
+    if(len != 0)
+    {
+        cdcData.rx.len[head & CDC_RX_SLOTS_MASK] = len;
+        cdcData.rx.head = ++head;
+        cdcData.stats.rxPackets++;
+    }
+
+    if((uint8_t)(head - cdcData.rx.tail) >= CDC_RX_SLOTS)
+    {
+        cdcData.rx.stalled = 1;
+        cdcData.stats.rxStalls++;
+        return NULL;
+    }
+
+    return cdcData.rx.slots[head & CDC_RX_SLOTS_MASK];
+}
+
+/**
+ * @brief Get the oldest received packet
+ *
+ * The packet stays valid until cdc_rxRelease() is called.
+ *
+ * @param len Number of bytes of the packet
+ *
+ * @return Packet or NULL if nothing was received
+ */
+const uint8_t* cdc_rxPeek(uint16_t* len)
+{
+    uint8_t tail = cdcData.rx.tail;
+
+    if(tail == cdcData.rx.head)
+    {
+        return NULL;
+    }
+
+    *len = cdcData.rx.len[tail & CDC_RX_SLOTS_MASK];
+
+    return cdcData.rx.slots[tail & CDC_RX_SLOTS_MASK];
+}
+
+/**
+ * @brief Free the oldest received packet
+ *
+ * Arms the endpoint again if it was NAKed.
+ */
+void cdc_rxRelease(void)
+{
+    uint32_t primask;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if(cdcData.rx.tail != cdcData.rx.head)
+    {
+        cdcData.rx.tail++;
+
+        if(cdcData.rx.stalled)
+        {
+            cdcData.rx.stalled = 0;
+            USBD_CDC_SetRxBuffer(&hUsbDeviceFS, cdcData.rx.slots[cdcData.rx.head & CDC_RX_SLOTS_MASK]);
+            USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Reset the transmit queue
+ *
+ * Called by CDC_Init_FS() when the host configures the device.
+ */
+void cdc_txInit(void)
+{
+    cdcData.tx.tail = cdcData.tx.head;
+    cdcData.tx.inflight = 0;
+    cdcData.tx.zlp = 0;
+}
+
+/**
+ * @brief Queue data for the IN endpoint
+ *
+ * The data is copied completely or not at all. The call never blocks.
+ *
+ * @param data Data
+ * @param len Number of bytes
+ *
+ * @return Number of queued bytes (len or 0)
+ */
+uint16_t cdc_write(const uint8_t* data, uint16_t len)
+{
+    uint16_t head = cdcData.tx.head;
+    uint16_t chunk;
+    uint32_t primask;
+
+    /* Nobody listens: discard the output */
+    if(!cdc_isConfigured())
+    {
+        return len;
+    }
+
+    if(len > cdc_txFree())
+    {
+        cdcData.stats.txDropped += len;
+        return 0;
+    }
+
+    /* Copy up to the end of the buffer and wrap around */
+    chunk = CDC_TX_BUFFER_SIZE - (head & CDC_TX_BUFFER_MASK);
+    if(chunk > len)
+    {
+        chunk = len;
+    }
+
+    memcpy(&cdcData.tx.buffer[head & CDC_TX_BUFFER_MASK], data, chunk);
+    memcpy(cdcData.tx.buffer, data + chunk, len - chunk);
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if(head == cdcData.tx.tail)
+    {
+        cdcData.tx.pendingSince = HAL_GetTick();
+    }
+    cdcData.tx.head = head + len;
+
+    cdc_txStart();
+
+    __set_PRIMASK(primask);
+
+    return len;
+}
+
+/**
+ * @brief Get the free space of the transmit queue
+ */
+uint16_t cdc_txFree(void)
+{
+    return CDC_TX_BUFFER_SIZE - (uint16_t)(cdcData.tx.head - cdcData.tx.tail);
+}
+
+/**
+ * @brief Chain the next transfer
+ *
+ * Called by CDC_TransmitCplt_FS() from the USB interrupt.
+ */
+void cdc_txComplete(void)
+{
+    cdcData.tx.tail += cdcData.tx.inflight;
+    cdcData.tx.inflight = 0;
+
+    cdc_txStart();
+}
+
+/**
+ * @brief Copy the statistics of the CDC buffers
+ *
+ * @param stats Destination of the statistics
+ */
+void cdc_getStats(cdcStats_t* stats)
+{
+    *stats = cdcData.stats;
+}
+
+/**
+ * @brief Start the next transfer of the transmit queue
+ *
+ * Sends all full packets which are contiguous at the queue. A short packet
+ * is sent if the oldest byte waits for CDC_TX_FLUSH_TIME. Call with the
+ * interrupts disabled or from the USB interrupt.
+ */
+static void cdc_txStart(void)
+{
+    USBD_CDC_HandleTypeDef* hcdc = (USBD_CDC_HandleTypeDef*)hUsbDeviceFS.pClassData;
+    uint16_t tail = cdcData.tx.tail;
+    uint16_t len;
+    uint8_t flush;
+
+    if(hcdc == NULL || hcdc->TxState != 0 || cdcData.tx.inflight != 0)
+    {
+        return;
+    }
+
+    flush = (HAL_GetTick() - cdcData.tx.pendingSince) >= CDC_TX_FLUSH_TIME;
+
+    if((len = cdcData.tx.head - tail) == 0)
+    {
+        /* Terminate the transfer for the host */
+        if(cdcData.tx.zlp && flush)
+        {
+            cdcData.tx.zlp = 0;
+            USBD_CDC_SetTxBuffer(&hUsbDeviceFS, cdcData.tx.buffer, 0);
+            USBD_CDC_TransmitPacket(&hUsbDeviceFS);
+        }
+        return;
+    }
+
+    if(len < CDC_PACKET_SIZE && !flush)
+    {
+        return;
+    }
+
+    /* A transfer ends at the end of the buffer */
+    if(len > CDC_TX_BUFFER_SIZE - (tail & CDC_TX_BUFFER_MASK))
+    {
+        len = CDC_TX_BUFFER_SIZE - (tail & CDC_TX_BUFFER_MASK);
+    }
+
+    /* Keep the rest of a short packet for the next writes */
+    if(len > CDC_PACKET_SIZE && !flush)
+    {
+        len -= len % CDC_PACKET_SIZE;
+    }
+
+    USBD_CDC_SetTxBuffer(&hUsbDeviceFS, &cdcData.tx.buffer[tail & CDC_TX_BUFFER_MASK], len);
+    if(USBD_CDC_TransmitPacket(&hUsbDeviceFS) == USBD_OK)
+    {
+        cdcData.tx.inflight = len;
+        cdcData.tx.zlp = (len % CDC_PACKET_SIZE) == 0;
+        cdcData.tx.pendingSince = HAL_GetTick();
+        cdcData.stats.txBytes += len;
+        cdcData.stats.txTransfers++;
+    }
+}
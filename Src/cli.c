@@ -0,0 +1,1101 @@
+/**
+ * @file cli.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Debug command line interface implementation
+ */
+#include <string.h>
+#include <stdlib.h>
+
+#include "cli.h"
+#include "usart.h"
+#include "irq.h"
+#include "mlog.h"
+#include "syscalls.h"
+#include "eeprom.h"
+#include "config.h"
+#include "app.h"
+#include "stepper.h"
+#include "loop.h"
+
+#define CLI_TX_BUFFER_MASK          (CLI_TX_BUFFER_SIZE - 1)
+
+#if (CLI_TX_BUFFER_SIZE & CLI_TX_BUFFER_MASK) != 0
+#error "CLI_TX_BUFFER_SIZE must be a power of two"
+#endif
+
+#define CLI_RX_EVENTS_MASK          (CLI_RX_EVENTS - 1)
+
+#if (CLI_RX_EVENTS & CLI_RX_EVENTS_MASK) != 0
+#error "CLI_RX_EVENTS must be a power of two"
+#endif
+
+/**
+ * Command line interface data struct type
+ */
+typedef struct cliData_s {
+    struct {
+        uint8_t buffer[CLI_TX_BUFFER_SIZE];
+        /**
+         * Free running write and read index. The bytes from tail to tail +
+         * inflight are sent by the running DMA transfer.
+         */
+        volatile uint16_t head;
+        volatile uint16_t tail;
+        volatile uint16_t inflight;
+    } tx;
+
+    struct {
+        uint8_t buffer[CLI_RX_BUFFER_SIZE];
+        /**
+         * DMA position of the last interrupt and the total number of bytes
+         * received until this position
+         */
+        volatile uint16_t dmaPos;
+        volatile uint32_t received;
+        /**
+         * Processed bytes and the read position of the main loop
+         */
+        uint32_t consumed;
+        uint16_t tail;
+        /**
+         * The reception has been aborted by an error
+         */
+        volatile uint8_t error;
+
+        /**
+         * Receive events of the interrupts and the event of the input which
+         * is passed to the raw consumer
+         */
+        cliRxEvent_t events[CLI_RX_EVENTS];
+        volatile uint8_t eventHead;
+        uint8_t eventTail;
+        cliRxEvent_t event;
+
+        char line[CLI_LINE_SIZE];
+        uint8_t lineLen;
+        uint8_t lineOverflow;
+
+        /**
+         * Consumer of the input instead of the console
+         */
+        cliRawInput_t rawInput;
+    } rx;
+
+    /**
+     * Frame format which is applied when the transmission is idle
+     */
+    struct {
+        UART_InitTypeDef init;
+        uint8_t pending;
+    } format;
+
+    cliStats_t stats;
+} cliData_t;
+
+/**
+ * Console command type
+ */
+typedef struct cliCmd_s {
+    const char* name;
+    const char* help;
+    void (*func)(uint8_t argc, char* argv[]);
+} cliCmd_t;
+
+/**
+ * Configuration variable of the console
+ */
+typedef struct cliVar_s {
+    const char* name;
+    uint16_t virtAddress;
+} cliVar_t;
+
+/**
+ * Module data
+ */
+static cliData_t cliData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void cli_txStart(void);
+static void cli_logOutput(const uint8_t* data, uint16_t len);
+static void cli_rxStart(void);
+static void cli_rxUpdate(uint8_t idle);
+static void cli_rxRaw(void);
+static uint8_t cli_rxNextEvent(void);
+static void cli_applyFormat(void);
+static void cli_rxChar(char c);
+static void cli_execute(char* line);
+static const cliVar_t* cli_findVar(const char* name);
+
+static void cli_cmdHelp(uint8_t argc, char* argv[]);
+static void cli_cmdGet(uint8_t argc, char* argv[]);
+static void cli_cmdSet(uint8_t argc, char* argv[]);
+static void cli_cmdMove(uint8_t argc, char* argv[]);
+static void cli_cmdStop(uint8_t argc, char* argv[]);
+static void cli_cmdStats(uint8_t argc, char* argv[]);
+static void cli_cmdLog(uint8_t argc, char* argv[]);
+
+/**
+ * Console commands
+ */
+static const cliCmd_t cliCmds[] = {
+        { "help",  "help                  list the commands", cli_cmdHelp },
+        { "get",   "get <var>             read a config variable", cli_cmdGet },
+        { "set",   "set <var> <value>     write a config variable (active after reset)", cli_cmdSet },
+        { "move",  "move <up|down> <steps> service move, the car returns to the idle position", cli_cmdMove },
+        { "stop",  "stop                  stop the motor, a drive returns to the idle position", cli_cmdStop },
+        { "stats", "stats                 dump the statistics", cli_cmdStats },
+        { "log",   "log <on|off>          enable the log frames", cli_cmdLog },
+};
+
+/**
+ * Configuration variables of the console
+ */
+static const cliVar_t cliVars[] = {
+        { "longpress", CFG_LONGPRESS_TIME_VADDR },
+        { "poweroff",  CFG_POWER_OFF_VADDR },
+        { "floor01",   CFG_FLOOR_0_1_TICKS_VADDR },
+        { "floor12",   CFG_FLOOR_1_2_TICKS_VADDR },
+        { "timeout2",  CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR },
+        { "trips",     CFG_TRIP_COUNT_VADDR },
+        { "modbus",    CFG_MODBUS_ADDR_VADDR },
+};
+
+#define CLI_ARRAY_SIZE(a)           (sizeof(a) / sizeof((a)[0]))
+
+/**
+ * Basic initialization for the command line interface
+ *
+ * @warning Run MX_USART1_UART_Init() before you run this function.
+ */
+void cli_init(void)
+{
+    cliData.tx.head =
+            cliData.tx.tail =
+            cliData.tx.inflight = 0;
+
+    memset(&cliData.stats, 0, sizeof(cliData.stats));
+
+#if CLI_LOG_OUTPUT
+    mlog_addSink(cli_logOutput);
+#endif
+
+    /* The end of a DMA transmission is signaled by the UART TC interrupt */
+    HAL_NVIC_SetPriority(USART1_IRQn, IRQ_PRIO_FLASH, 0);
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
+
+    cli_rxStart();
+}
+
+/**
+ * @brief Process the received input and run the console commands
+ *
+ * Run this handler at the main loop.
+ */
+void cli_handler(void)
+{
+    uint32_t primask;
+    uint32_t received;
+
+    /* Restart a transmission which was blocked by a busy UART handle */
+    cli_txStart();
+
+    if(cliData.format.pending && cliData.tx.inflight == 0)
+    {
+        cli_applyFormat();
+    }
+
+    if(cliData.rx.error)
+    {
+        cliData.stats.rxErrors++;
+        cli_rxStart();
+        return;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    received = cliData.rx.received;
+    __set_PRIMASK(primask);
+
+    /* The DMA has overwritten input which was not processed yet */
+    if(received - cliData.rx.consumed > CLI_RX_BUFFER_SIZE)
+    {
+        cliData.stats.rxLost += received - cliData.rx.consumed;
+        cliData.rx.consumed = received;
+        cliData.rx.tail = received % CLI_RX_BUFFER_SIZE;
+        cliData.rx.lineOverflow = 1;
+        return;
+    }
+
+    if(cliData.rx.rawInput != NULL)
+    {
+        cli_rxRaw();
+        return;
+    }
+
+    while(cliData.rx.consumed != received)
+    {
+        cli_rxChar(cliData.rx.buffer[cliData.rx.tail]);
+
+        if(++cliData.rx.tail >= CLI_RX_BUFFER_SIZE)
+        {
+            cliData.rx.tail = 0;
+        }
+        cliData.rx.consumed++;
+    }
+}
+
+/**
+ * @brief Interrupt handler extension of USART1
+ *
+ * Detects the IDLE line after a received frame. Run this function before
+ * HAL_UART_IRQHandler() at the USART1 interrupt.
+ */
+void cli_uartIrqHandler(void)
+{
+    if(__HAL_UART_GET_FLAG(&huart1, UART_FLAG_IDLE) &&
+            __HAL_UART_GET_IT_SOURCE(&huart1, UART_IT_IDLE))
+    {
+        __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+        cli_rxUpdate(1);
+    }
+}
+
+/**
+ * @brief Copy data into the transmit ring
+ *
+ * The data is dropped completely if it does not fit into the ring.
+ *
+ * @param data Data to send
+ * @param len Number of bytes
+ *
+ * @return Number of bytes queued
+ */
+uint16_t cli_write(const uint8_t* data, uint16_t len)
+{
+    uint16_t head = cliData.tx.head;
+    uint16_t chunk;
+
+    if(len > cli_txFree())
+    {
+        cliData.stats.dropped += len;
+        return 0;
+    }
+
+    /* Copy up to the end of the buffer and wrap around */
+    chunk = CLI_TX_BUFFER_SIZE - (head & CLI_TX_BUFFER_MASK);
+    if(chunk > len)
+    {
+        chunk = len;
+    }
+
+    memcpy(&cliData.tx.buffer[head & CLI_TX_BUFFER_MASK], data, chunk);
+    memcpy(cliData.tx.buffer, data + chunk, len - chunk);
+
+    cli_txCommit(len);
+
+    return len;
+}
+
+/**
+ * @brief Get the contiguous free space of the transmit ring
+ *
+ * Write the data directly into the returned buffer and pass the number of
+ * written bytes to cli_txCommit().
+ *
+ * @param len Returns the number of contiguous free bytes
+ *
+ * @return Start of the free space
+ */
+uint8_t* cli_txAcquire(uint16_t* len)
+{
+    uint16_t head = cliData.tx.head;
+    uint16_t chunk = CLI_TX_BUFFER_SIZE - (head & CLI_TX_BUFFER_MASK);
+    uint16_t free = cli_txFree();
+
+    *len = (chunk < free) ? chunk : free;
+
+    return &cliData.tx.buffer[head & CLI_TX_BUFFER_MASK];
+}
+
+/**
+ * @brief Queue bytes written into the transmit ring and start the DMA
+ *
+ * @param len Number of bytes written after cli_txAcquire() or cli_write()
+ */
+void cli_txCommit(uint16_t len)
+{
+    uint16_t used;
+
+    cliData.tx.head += len;
+
+    if((used = cliData.tx.head - cliData.tx.tail) > cliData.stats.highWatermark)
+    {
+        cliData.stats.highWatermark = used;
+    }
+
+    cli_txStart();
+}
+
+/**
+ * @brief Returns the number of free bytes of the transmit ring
+ */
+uint16_t cli_txFree(void)
+{
+    return CLI_TX_BUFFER_SIZE - (uint16_t)(cliData.tx.head - cliData.tx.tail);
+}
+
+/**
+ * @brief Write a string to the console
+ *
+ * @param str Zero terminated string
+ */
+void cli_print(const char* str)
+{
+    cli_write((const uint8_t*)str, strlen(str));
+}
+
+/**
+ * @brief Write a decimal number to the console
+ *
+ * @param val Number
+ */
+void cli_printNum(uint32_t val)
+{
+    char buf[11];
+    uint8_t pos = sizeof(buf) - 1;
+
+    buf[pos] = '\0';
+    do
+    {
+        buf[--pos] = '0' + (val % 10);
+        val /= 10;
+    } while(val);
+
+    cli_print(&buf[pos]);
+}
+
+/**
+ * @brief Copy the statistics of the command line interface
+ *
+ * @param stats Destination of the statistics
+ */
+void cli_getStats(cliStats_t* stats)
+{
+    *stats = cliData.stats;
+}
+
+/**
+ * @brief Pass the input to another consumer instead of the console
+ *
+ * @param input Consumer or NULL to return to the console
+ */
+void cli_setRawInput(cliRawInput_t input)
+{
+    cliData.rx.rawInput = input;
+    cliData.rx.lineLen = 0;
+}
+
+/**
+ * @brief Returns the consumer of the input or NULL for the console
+ */
+cliRawInput_t cli_getRawInput(void)
+{
+    return cliData.rx.rawInput;
+}
+
+/**
+ * @brief Returns the receive event of the input
+ *
+ * During the call of the raw consumer the event of the passed input,
+ * afterwards the newest processed event. The idle flag and the tick tell
+ * since when the line is idle.
+ */
+const cliRxEvent_t* cli_getRxEvent(void)
+{
+    return &cliData.rx.event;
+}
+
+/**
+ * @brief Change the frame format of the UART
+ *
+ * The format is applied by cli_handler() after the running transmission.
+ * The reception is restarted, received input which was not processed yet is
+ * lost.
+ *
+ * @param baudRate Baud rate
+ * @param wordLength UART_WORDLENGTH_x (including the parity bit)
+ * @param stopBits UART_STOPBITS_x
+ * @param parity UART_PARITY_x
+ */
+void cli_setFormat(uint32_t baudRate, uint32_t wordLength, uint32_t stopBits, uint32_t parity)
+{
+    cliData.format.init = huart1.Init;
+    cliData.format.init.BaudRate = baudRate;
+    cliData.format.init.WordLength = wordLength;
+    cliData.format.init.StopBits = stopBits;
+    cliData.format.init.Parity = parity;
+    cliData.format.pending = 1;
+}
+
+/**
+ * @brief Start the DMA transfer of the next contiguous chunk
+ *
+ * Called from the main loop and the transfer complete interrupt.
+ */
+static void cli_txStart(void)
+{
+    uint32_t primask;
+    uint16_t tail;
+    uint16_t len;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    tail = cliData.tx.tail;
+
+    /* Hold the output until the new frame format is applied */
+    if(cliData.tx.inflight == 0 && !cliData.format.pending && (len = cliData.tx.head - tail) != 0)
+    {
+        /* A transfer ends at the end of the buffer */
+        if(len > CLI_TX_BUFFER_SIZE - (tail & CLI_TX_BUFFER_MASK))
+        {
+            len = CLI_TX_BUFFER_SIZE - (tail & CLI_TX_BUFFER_MASK);
+        }
+
+        if(HAL_UART_Transmit_DMA(&huart1, &cliData.tx.buffer[tail & CLI_TX_BUFFER_MASK], len) == HAL_OK)
+        {
+            cliData.tx.inflight = len;
+            cliData.stats.bursts++;
+        }
+    }
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Start the circular DMA reception
+ *
+ * The reception must be stopped (initialization or receive error).
+ */
+static void cli_rxStart(void)
+{
+    cliData.rx.error = 0;
+
+    cliData.rx.dmaPos =
+            cliData.rx.tail = 0;
+    cliData.rx.received =
+            cliData.rx.consumed = 0;
+    cliData.rx.lineLen = 0;
+
+    cliData.rx.eventHead =
+            cliData.rx.eventTail = 0;
+    memset(&cliData.rx.event, 0, sizeof(cliData.rx.event));
+
+    if(HAL_UART_Receive_DMA(&huart1, cliData.rx.buffer, CLI_RX_BUFFER_SIZE) != HAL_OK)
+    {
+        cliData.rx.error = 1;
+        return;
+    }
+
+    __HAL_UART_CLEAR_IDLEFLAG(&huart1);
+    __HAL_UART_ENABLE_IT(&huart1, UART_IT_IDLE);
+}
+
+/**
+ * @brief Publish the DMA position of the reception and queue a receive event
+ *
+ * Called by the IDLE line, half transfer and transfer complete interrupts.
+ * The interrupts occur at least every half buffer so the position moved by
+ * less than the buffer size. A background erase of the flash delays them,
+ * see CLI_RX_BUFFER_SIZE.
+ *
+ * @param idle 1 at the IDLE line interrupt
+ */
+static void cli_rxUpdate(uint8_t idle)
+{
+    uint16_t pos = CLI_RX_BUFFER_SIZE - __HAL_DMA_GET_COUNTER(huart1.hdmarx);
+    uint8_t head = cliData.rx.eventHead;
+    uint8_t count = head - cliData.rx.eventTail;
+    cliRxEvent_t* event;
+
+    if(pos >= CLI_RX_BUFFER_SIZE)
+    {
+        pos = 0;
+    }
+
+    cliData.rx.received += (uint16_t)(pos + CLI_RX_BUFFER_SIZE - cliData.rx.dmaPos) % CLI_RX_BUFFER_SIZE;
+    cliData.rx.dmaPos = pos;
+
+    /* An IDLE line without new input only updates the newest event, a full
+     * queue merges the event into the newest one
+     */
+    event = &cliData.rx.events[(head - 1) & CLI_RX_EVENTS_MASK];
+    if(count == 0 || (count < CLI_RX_EVENTS && event->received != cliData.rx.received))
+    {
+        event = &cliData.rx.events[head & CLI_RX_EVENTS_MASK];
+        head++;
+    }
+
+    event->received = cliData.rx.received;
+    event->tick = HAL_GetTick();
+    event->idle = idle;
+
+    cliData.rx.eventHead = head;
+}
+
+/**
+ * @brief Pass the received input to the raw consumer
+ *
+ * The input is passed by receive events, so the consumer may use the timing
+ * of every event.
+ */
+static void cli_rxRaw(void)
+{
+    uint16_t len;
+    uint16_t used;
+
+    for(;;)
+    {
+        /* The input of the event is passed, continue with the next event */
+        if((int32_t)(cliData.rx.event.received - cliData.rx.consumed) <= 0)
+        {
+            if(!cli_rxNextEvent())
+            {
+                break;
+            }
+            continue;
+        }
+
+        len = cliData.rx.event.received - cliData.rx.consumed;
+        if(len > CLI_RX_BUFFER_SIZE - cliData.rx.tail)
+        {
+            len = CLI_RX_BUFFER_SIZE - cliData.rx.tail;
+        }
+
+        used = cliData.rx.rawInput(&cliData.rx.buffer[cliData.rx.tail], len);
+
+        cliData.stats.received += used;
+        cliData.rx.consumed += used;
+        if((cliData.rx.tail += used) >= CLI_RX_BUFFER_SIZE)
+        {
+            cliData.rx.tail = 0;
+        }
+
+        /* The rest of the input continues the passed input */
+        if(used != 0)
+        {
+            cliData.rx.event.silence = 0;
+        }
+
+        /* The consumer is busy */
+        if(used < len)
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Take the next receive event from the queue
+ *
+ * The silence before the input is the time from the event before until the
+ * tick of the event minus the time of the input at the line.
+ *
+ * @return 0 if the queue is empty
+ */
+static uint8_t cli_rxNextEvent(void)
+{
+    cliRxEvent_t* current = &cliData.rx.event;
+    cliRxEvent_t next;
+    uint32_t primask;
+    uint32_t bits;
+    uint32_t burst;
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    if(cliData.rx.eventTail == cliData.rx.eventHead)
+    {
+        __set_PRIMASK(primask);
+        return 0;
+    }
+
+    next = cliData.rx.events[cliData.rx.eventTail++ & CLI_RX_EVENTS_MASK];
+
+    __set_PRIMASK(primask);
+
+    /* Input which was processed by the console or lost */
+    if((int32_t)(next.received - cliData.rx.consumed) < 0)
+    {
+        next.received = cliData.rx.consumed;
+    }
+
+    next.silence = 0;
+    if(current->idle)
+    {
+        bits = 1 + ((huart1.Init.WordLength == UART_WORDLENGTH_9B) ? 9 : 8) +
+                ((huart1.Init.StopBits == UART_STOPBITS_2) ? 2 : 1);
+        burst = (next.received - current->received) * bits * 1000 / huart1.Init.BaudRate;
+
+        if(next.tick - current->tick > burst)
+        {
+            next.silence = next.tick - current->tick - burst;
+        }
+    }
+
+    *current = next;
+
+    return 1;
+}
+
+/**
+ * @brief Apply the new frame format and restart the reception
+ */
+static void cli_applyFormat(void)
+{
+    cliData.format.pending = 0;
+
+    HAL_UART_DMAStop(&huart1);
+
+    huart1.Init = cliData.format.init;
+    if(HAL_UART_Init(&huart1) != HAL_OK)
+    {
+        cliData.rx.error = 1;
+        return;
+    }
+
+    cli_rxStart();
+}
+
+/**
+ * @brief Add a received character to the command line
+ *
+ * @param c Character
+ */
+static void cli_rxChar(char c)
+{
+    cliData.stats.received++;
+
+    if(c == '\r' || c == '\n')
+    {
+        if(cliData.rx.lineOverflow)
+        {
+            cli_print("error: line too long\r\n");
+        }else if(cliData.rx.lineLen > 0)
+        {
+            cliData.rx.line[cliData.rx.lineLen] = '\0';
+            cliData.stats.lines++;
+            cli_execute(cliData.rx.line);
+        }
+
+        cliData.rx.lineLen = 0;
+        cliData.rx.lineOverflow = 0;
+    }else if(c == '\b' || c == 0x7F)
+    {
+        if(cliData.rx.lineLen > 0)
+        {
+            cliData.rx.lineLen--;
+        }
+    }else if(cliData.rx.lineLen < CLI_LINE_SIZE - 1)
+    {
+        cliData.rx.line[cliData.rx.lineLen++] = c;
+    }else
+    {
+        cliData.rx.lineOverflow = 1;
+    }
+}
+
+/**
+ * @brief Split a command line into arguments and run the command
+ *
+ * @param line Zero terminated command line
+ */
+static void cli_execute(char* line)
+{
+    char* argv[CLI_MAX_ARGS];
+    uint8_t argc = 0;
+    uint8_t i;
+
+    while(*line && argc < CLI_MAX_ARGS)
+    {
+        while(*line == ' ')
+        {
+            *line++ = '\0';
+        }
+
+        if(*line)
+        {
+            argv[argc++] = line;
+        }
+
+        while(*line && *line != ' ')
+        {
+            line++;
+        }
+    }
+
+    if(argc == 0)
+    {
+        return;
+    }
+
+    for(i = 0; i < CLI_ARRAY_SIZE(cliCmds); i++)
+    {
+        if(strcmp(argv[0], cliCmds[i].name) == 0)
+        {
+            cliCmds[i].func(argc, argv);
+            return;
+        }
+    }
+
+    cli_print("error: unknown command, type help\r\n");
+}
+
+/**
+ * @brief Search a configuration variable by its name
+ *
+ * @param name Variable name
+ *
+ * @return Variable or NULL if the name is unknown
+ */
+static const cliVar_t* cli_findVar(const char* name)
+{
+    uint8_t i;
+
+    for(i = 0; i < CLI_ARRAY_SIZE(cliVars); i++)
+    {
+        if(strcmp(name, cliVars[i].name) == 0)
+        {
+            return &cliVars[i];
+        }
+    }
+
+    cli_print("error: unknown variable:");
+    for(i = 0; i < CLI_ARRAY_SIZE(cliVars); i++)
+    {
+        cli_print(" ");
+        cli_print(cliVars[i].name);
+    }
+    cli_print("\r\n");
+
+    return NULL;
+}
+
+static void cli_cmdHelp(uint8_t argc, char* argv[])
+{
+    uint8_t i;
+
+    for(i = 0; i < CLI_ARRAY_SIZE(cliCmds); i++)
+    {
+        cli_print(cliCmds[i].help);
+        cli_print("\r\n");
+    }
+}
+
+static void cli_cmdGet(uint8_t argc, char* argv[])
+{
+    const cliVar_t* var;
+    uint16_t data;
+
+    if(argc != 2 || (var = cli_findVar(argv[1])) == NULL)
+    {
+        return;
+    }
+
+    if(ee_readVariable(var->virtAddress, &data) != 0)
+    {
+        cli_print("error: variable not found\r\n");
+        return;
+    }
+
+    cli_print(var->name);
+    cli_print(" = ");
+    cli_printNum(data);
+    cli_print("\r\n");
+}
+
+static void cli_cmdSet(uint8_t argc, char* argv[])
+{
+    const cliVar_t* var;
+    const cfgRange_t* range;
+    char* end;
+    uint32_t data;
+
+    if(argc != 3 || (var = cli_findVar(argv[1])) == NULL)
+    {
+        return;
+    }
+
+    data = strtoul(argv[2], &end, 0);
+    if(*end != '\0' || data > 0xFFFF || !cfg_isValid(var->virtAddress, data))
+    {
+        range = cfg_getRange(var->virtAddress);
+        cli_print("error: value out of range ");
+        cli_printNum(range->min);
+        cli_print("..");
+        cli_printNum(range->max);
+        cli_print("\r\n");
+        return;
+    }
+
+    switch(ee_writeVariable(var->virtAddress, data))
+    {
+    case HAL_OK:
+        break;
+    case HAL_BUSY:
+        cli_print("error: flash busy, retry\r\n");
+        return;
+    default:
+        cli_print("error: write failed\r\n");
+        return;
+    }
+
+    cli_print("ok\r\n");
+}
+
+static void cli_cmdMove(uint8_t argc, char* argv[])
+{
+    stpCmd_t cmd;
+    char* end;
+    uint32_t steps;
+
+    if(argc != 3)
+    {
+        cli_print("error: move <up|down> <steps>\r\n");
+        return;
+    }
+
+    if(strcmp(argv[1], "up") == 0)
+    {
+        cmd = STP_CMD_DRIVE_UP;
+    }else if(strcmp(argv[1], "down") == 0)
+    {
+        cmd = STP_CMD_DRIVE_DOWN;
+    }else
+    {
+        cli_print("error: direction must be up or down\r\n");
+        return;
+    }
+
+    steps = strtoul(argv[2], &end, 0);
+    if(*end != '\0' || steps == 0)
+    {
+        cli_print("error: invalid number of steps\r\n");
+        return;
+    }
+
+    if(app_requServiceMove(cmd, steps) != HAL_OK)
+    {
+        cli_print("error: elevator is busy\r\n");
+        return;
+    }
+
+    cli_print("ok\r\n");
+}
+
+static void cli_cmdStop(uint8_t argc, char* argv[])
+{
+    if(app_requStop() != HAL_OK)
+    {
+        cli_print("error: elevator is busy\r\n");
+        return;
+    }
+
+    cli_print("ok\r\n");
+}
+
+static void cli_cmdStats(uint8_t argc, char* argv[])
+{
+    eeStats_t ee;
+    sysItmStats_t itm;
+#ifdef LOOP_PROFILE
+    loopStats_t loop;
+#endif
+
+    ee_getStats(&ee);
+    sys_getItmStats(&itm);
+
+    cli_print("cli: sent ");
+    cli_printNum(cliData.stats.sent);
+    cli_print(" bursts ");
+    cli_printNum(cliData.stats.bursts);
+    cli_print(" dropped ");
+    cli_printNum(cliData.stats.dropped);
+    cli_print(" watermark ");
+    cli_printNum(cliData.stats.highWatermark);
+    cli_print(" received ");
+    cli_printNum(cliData.stats.received);
+    cli_print(" lost ");
+    cli_printNum(cliData.stats.rxLost);
+    cli_print(" errors ");
+    cli_printNum(cliData.stats.rxErrors);
+    cli_print(" lines ");
+    cli_printNum(cliData.stats.lines);
+    cli_print("\r\n");
+
+    cli_print("itm: written ");
+    cli_printNum(itm.written);
+    cli_print(" dropped ");
+    cli_printNum(itm.dropped);
+    cli_print(" discarded ");
+    cli_printNum(itm.discarded);
+    cli_print(" watermark ");
+    cli_printNum(itm.highWatermark);
+    cli_print("\r\n");
+
+    cli_print("mlog: dropped ");
+    cli_printNum(mlog_getDropped());
+    cli_print("\r\n");
+
+    cli_print("ee: writes ");
+    cli_printNum(ee.writes);
+    cli_print(" programs ");
+    cli_printNum(ee.programs);
+    cli_print(" erases ");
+    cli_printNum(ee.erases);
+    cli_print(" reclaims ");
+    cli_printNum(ee.reclaims);
+    cli_print(" transactions ");
+    cli_printNum(ee.transactions);
+    cli_print(" cached ");
+    cli_printNum(ee.cacheWrites);
+    cli_print(" coalesced ");
+    cli_printNum(ee.coalesced);
+    cli_print(" flushes ");
+    cli_printNum(ee.flushes);
+    cli_print(" dirty ");
+    cli_printNum(ee_getDirtyCount());
+    cli_print("\r\n");
+
+#ifdef LOOP_PROFILE
+    loop_getStats(&loop);
+
+    cli_print("loop: load ");
+    cli_printNum(loop.load);
+    cli_print(" iterations ");
+    cli_printNum(loop.iterations);
+    cli_print(" idle ");
+    cli_printNum(loop.idle);
+    cli_print(" max ");
+    cli_printNum(loop.max);
+    cli_print(" worst ");
+    cli_print(loop_getName(loop.worst));
+    cli_print(" ");
+    cli_printNum(loop.worstCycles);
+    cli_print(" peak ");
+    cli_print(loop_getName(loop.peak));
+    cli_print(" ");
+    cli_printNum(loop.peakCycles);
+    cli_print("\r\n");
+#endif
+}
+
+static void cli_cmdLog(uint8_t argc, char* argv[])
+{
+    if(argc != 2 || (strcmp(argv[1], "on") != 0 && strcmp(argv[1], "off") != 0))
+    {
+        cli_print("error: log <on|off>\r\n");
+        return;
+    }
+
+    if(strcmp(argv[1], "on") == 0)
+    {
+        mlog_addSink(cli_logOutput);
+    }else
+    {
+        mlog_removeSink(cli_logOutput);
+    }
+
+    cli_print("ok\r\n");
+}
+
+/**
+ * @brief Half transfer callback of the UART reception
+ */
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    if(huart->Instance == USART1)
+    {
+        cli_rxUpdate(0);
+    }
+}
+
+/**
+ * @brief Transfer complete callback of the UART reception
+ */
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if(huart->Instance == USART1)
+    {
+        cli_rxUpdate(0);
+    }
+}
+
+/**
+ * @brief Transfer complete callback of the UART
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if(huart->Instance != USART1)
+    {
+        return;
+    }
+
+    cliData.stats.sent += cliData.tx.inflight;
+    cliData.tx.tail += cliData.tx.inflight;
+    cliData.tx.inflight = 0;
+
+    cli_txStart();
+}
+
+/**
+ * @brief Error callback of the UART
+ *
+ * A receive error aborts the circular DMA, the reception is restarted by
+ * cli_handler(). A transmission aborted by a DMA error is dropped.
+ */
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+{
+    if(huart->Instance != USART1)
+    {
+        return;
+    }
+
+    if(huart->RxState == HAL_UART_STATE_READY)
+    {
+        cliData.rx.error = 1;
+    }
+
+    if(cliData.tx.inflight == 0 || huart->gState != HAL_UART_STATE_READY)
+    {
+        return;
+    }
+
+    cliData.stats.dropped += cliData.tx.inflight;
+    cliData.tx.tail += cliData.tx.inflight;
+    cliData.tx.inflight = 0;
+
+    cli_txStart();
+}
+
+/**
+ * @brief Output of the deferred log frames at the UART
+ *
+ * @param data Frame bytes
+ * @param len Number of bytes
+ */
+static void cli_logOutput(const uint8_t* data, uint16_t len)
+{
+    /* The UART does not belong to the console */
+    if(cliData.rx.rawInput == NULL)
+    {
+        cli_write(data, len);
+    }
+}
@@ -9,14 +9,71 @@
  *
  * @brief Configuration settings implementation
  */
+#include <stddef.h>
+
 #include "config.h"
 
-/* Virtual address defined by the user: 0xFFFF value is prohibited */
+/* Virtual address defined by the user: 0xFFFF, 0xFFFE, 0xFFFD, 0xFFFC and
+ * 0x0000 are reserved by the EEPROM emulation
+ */
 uint16_t VirtAddVarTab[] = {
 		CFG_LONGPRESS_TIME_VADDR,
 		CFG_POWER_OFF_VADDR,
 		CFG_FLOOR_0_1_TICKS_VADDR,
 		CFG_FLOOR_1_2_TICKS_VADDR,
 		CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR,
+		CFG_TRIP_COUNT_VADDR,
+		CFG_MODBUS_ADDR_VADDR,
 		0x0000	/* End of the list */
 };
+
+/* The ranges of the variables, every interface checks a written value here.
+ * The floor distances are limited by the 16 bit variables.
+ */
+static const cfgRange_t cfgRanges[] = {
+		{ CFG_LONGPRESS_TIME_VADDR, CFG_LONGPRESS_TIME_MIN, CFG_LONGPRESS_TIME_MAX },
+		{ CFG_POWER_OFF_VADDR, CFG_POWER_OFF_MIN, CFG_POWER_OFF_MAX },
+		{ CFG_FLOOR_0_1_TICKS_VADDR, CFG_FLOOR_0_1_TICKS_MIN, 0xFFFF },
+		{ CFG_FLOOR_1_2_TICKS_VADDR, CFG_FLOOR_1_2_TICKS_MIN, 0xFFFF },
+		{ CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR, CFG_TIMEOUT_FLOOR2_ARRIVE_MIN, CFG_TIMEOUT_FLOOR2_ARRIVE_MAX },
+		{ CFG_TRIP_COUNT_VADDR, 0, 0xFFFF },
+		{ CFG_MODBUS_ADDR_VADDR, CFG_MODBUS_ADDR_MIN, CFG_MODBUS_ADDR_MAX },
+};
+
+/**
+ * @brief Search the range of a configuration variable
+ *
+ * @param virtAddress Virtual address
+ *
+ * @return Range or NULL if the address is not a configuration variable
+ */
+const cfgRange_t* cfg_getRange(uint16_t virtAddress)
+{
+	uint8_t i;
+
+	for(i = 0; i < sizeof(cfgRanges) / sizeof(cfgRanges[0]); i++)
+	{
+		if(cfgRanges[i].virtAddress == virtAddress)
+		{
+			return &cfgRanges[i];
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Check a value before it is written to a configuration variable
+ *
+ * @param virtAddress Virtual address
+ * @param data Value
+ *
+ * @return 1 if the address is a configuration variable and the value is in
+ * its range otherwise 0
+ */
+uint8_t cfg_isValid(uint16_t virtAddress, uint16_t data)
+{
+	const cfgRange_t* range = cfg_getRange(virtAddress);
+
+	return (range != NULL && data >= range->min && data <= range->max);
+}
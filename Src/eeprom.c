@@ -24,236 +24,369 @@
 /* Includes ------------------------------------------------------------------*/
 #include "eeprom.h"
 #include "stm32f1xx_hal.h"
+#include "irq.h"
+#include "mtr.h"
+
+/* MLOG settings for the module eeprom */
+#define MLOG_WARNING            (0x04)
+
+#include "mlog.h"
+
+/* An alternative flash port, e.g. a simulated flash of a host build */
+#ifdef EE_FLASH_PORT
+#include EE_FLASH_PORT
+#endif
 
 /* Private typedef -----------------------------------------------------------*/
+
+/**
+ * State of the background erase
+ */
+typedef enum eeBgState_e {
+  EE_BG_IDLE = 0,     /* No background operation */
+  EE_BG_PENDING,      /* Page reclaimed, erase starts after the pending records */
+  EE_BG_ERASE,        /* Page erase running, waiting for end of operation */
+  EE_BG_ERASE_DONE,   /* Page erased, erase counter must be written */
+  EE_BG_ERROR         /* Page erase failed */
+} eeBgState_t;
+
+/**
+ * Entry of the write-behind cache
+ */
+typedef struct eeCacheEntry_s {
+  uint16_t virtAddress;
+  uint16_t data;
+  uint8_t dirty;
+} eeCacheEntry_t;
+
+/**
+ * Runtime state of the circular page log
+ */
+typedef struct eeData_s {
+  /* Set by ee_init() if the log is usable */
+  uint8_t valid;
+  /* Page index of the log head (page receiving new records) */
+  uint16_t head;
+  /* Sequence number of the head page */
+  uint16_t seq;
+  /* Next free record slot in the head page */
+  uint32_t freeAddress;
+
+  /* Background erase of a reclaimed page */
+  struct {
+    volatile eeBgState_t state;
+    uint16_t page;
+    uint16_t erases;
+  } bg;
+
+  /* Write-behind cache */
+  struct {
+    eeCacheEntry_t entries[EE_CACHE_SIZE];
+    uint8_t used;
+    uint8_t dirty;
+    /* Timestamp of the oldest dirty entry */
+    uint32_t dirtySince;
+    volatile uint8_t flushRequest;
+  } cache;
+
+  eeStats_t stats;
+} eeData_t;
+
 /* Private define ------------------------------------------------------------*/
 /* Private macro -------------------------------------------------------------*/
-/* Private variables ---------------------------------------------------------*/
 
-/* Global variable used to store variable value in read sequence */
-uint16_t DataVar = 0;
+/* Flash port: every flash access of the emulation passes these macros. The
+ * defaults access the internal flash. A port may translate the addresses into
+ * a flash image and return HAL_ERROR on EE_FLASH_ERASE_IT to use blocking
+ * erases only.
+ */
+#ifndef EE_FLASH_READ
+#define EE_FLASH_READ(Address)            (*(__IO uint16_t*)(Address))
+#endif
+#ifndef EE_FLASH_PROGRAM
+#define EE_FLASH_PROGRAM(Address, Data)   HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, (Address), (Data))
+#endif
+#ifndef EE_FLASH_ERASE
+#define EE_FLASH_ERASE(Init, PageError)   HAL_FLASHEx_Erase((Init), (PageError))
+#endif
+#ifndef EE_FLASH_ERASE_IT
+#define EE_FLASH_ERASE_IT(Init)           HAL_FLASHEx_Erase_IT(Init)
+#endif
+
+/* Base and end address of a page of the log */
+#define EE_PAGE_BASE(page)      ((uint32_t)(EEPROM_START_ADDRESS + ((uint32_t)(page) * FLASH_PAGE_SIZE)))
+#define EE_PAGE_END(page)       ((uint32_t)(EE_PAGE_BASE(page) + FLASH_PAGE_SIZE))
+
+/* Number of record slots of a page */
+#define EE_PAGE_RECORDS         ((uint32_t)((FLASH_PAGE_SIZE - EE_PAGE_HEADER_SIZE) / EE_RECORD_SIZE))
+
+/* Maximum number of variables of a transaction: the transaction and its
+ * markers must fit into a new head page after the garbage collection.
+ */
+#define EE_TXN_MAX_VARS         ((uint16_t)(EE_PAGE_RECORDS - NumbOfVar - 2))
+
+/* Next and previous page in the circular log */
+#define EE_PAGE_NEXT(page)      ((uint16_t)(((page) + 1) % EE_PAGE_COUNT))
+#define EE_PAGE_PREV(page)      ((uint16_t)(((page) + EE_PAGE_COUNT - 1) % EE_PAGE_COUNT))
+
+/* Private variables ---------------------------------------------------------*/
 
 /* Virtual address defined by the user: 0xFFFF value is prohibited */
-extern uint16_t VirtAddVarTab[NumbOfVar];
+extern uint16_t VirtAddVarTab[];
+
+/* Module data */
+static eeData_t eeData;
 
 /* Private function prototypes -----------------------------------------------*/
 /* Private functions ---------------------------------------------------------*/
-static HAL_StatusTypeDef EE_Format(void);
-static uint16_t EE_FindValidPage(uint8_t Operation);
-static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data);
-static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data);
+static uint16_t EE_ReadHalfWord(uint32_t Address);
+static uint8_t EE_IsRecordBlank(uint32_t Address);
+static HAL_StatusTypeDef EE_ProgramHalfWord(uint32_t Address, uint16_t Data);
+static HAL_StatusTypeDef EE_ErasePage(uint16_t Page);
+static HAL_StatusTypeDef EE_ErasePageIT(uint16_t Page);
+static uint16_t EE_CompleteBackground(void);
+static uint16_t EE_StartBackground(void);
+static void EE_FlashUnlock(void);
+static void EE_FlashLock(void);
+static uint16_t EE_Init(void);
+static uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data);
+static uint16_t EE_WriteVariables(const eeVar_t* Vars, uint16_t Count);
+static HAL_StatusTypeDef EE_OpenPage(uint16_t Page, uint16_t Seq);
+static uint8_t EE_IsPageInUse(uint16_t Page);
+static uint8_t EE_IsPageBlank(uint16_t Page);
+static uint8_t EE_IsLegacyPage(uint16_t Page);
+static uint8_t EE_IsSeqNewer(uint16_t Seq, uint16_t Ref);
+static uint32_t EE_FindVariable(uint16_t VirtAddress);
+static uint16_t EE_WriteRecord(uint16_t VirtAddress, uint16_t Data);
+static uint16_t EE_PageAdvance(void);
+static uint16_t EE_ReclaimPage(uint16_t Page);
+static uint16_t EE_MigrateLegacyPage(uint16_t Page);
+static uint16_t EE_RecoverTransaction(void);
+static uint16_t EE_VoidRecords(uint32_t Begin, uint32_t End);
+static eeCacheEntry_t* EE_CacheFind(uint16_t VirtAddress);
+static void EE_CacheUpdate(uint16_t VirtAddress, uint16_t Data);
 
 /**
-  * @brief  Restore the pages to a known good state in case of page's status
+  * @brief  Restore the page log to a known good state in case of page's status
   *   corruption after a power loss.
+  *
+  *   The log head is the in-use page with the newest sequence number. All
+  *   in-use pages which are not part of the chain ending at the head are
+  *   stale and will be erased. An interrupted garbage collection is completed
+  *   so that the page following the head is always free.
+  *   Records of a transaction without commit marker are voided. An
+  *   interrupted migration of a legacy page is restarted.
+  *
   * @param  None.
   * @retval - Flash error code: on write Flash error
   *         - FLASH_COMPLETE: on success
   */
 uint16_t ee_init(void)
 {
-  uint16_t PageStatus0 = 6, PageStatus1 = 6;
-  uint16_t VarIdx = 0;
-  uint16_t EepromStatus = 0, ReadStatus = 0;
-  int16_t x = -1;
-  HAL_StatusTypeDef  FlashStatus;
-  uint32_t pageError;
+  uint16_t FlashStatus;
 
-  /* Get Page0 status */
-  PageStatus0 = (*(__IO uint16_t*)PAGE0_BASE_ADDRESS);
-  /* Get Page1 status */
-  PageStatus1 = (*(__IO uint16_t*)PAGE1_BASE_ADDRESS);
+  eeData.bg.state = EE_BG_IDLE;
 
-  /* Check for invalid header states and repair if necessary */
-  switch (PageStatus0)
+  eeData.cache.used =
+  eeData.cache.dirty =
+  eeData.cache.flushRequest = 0;
+
+  /* The end of a background erase is signaled by the flash interrupt */
+  HAL_NVIC_SetPriority(FLASH_IRQn, IRQ_PRIO_FLASH, 0);
+  HAL_NVIC_EnableIRQ(FLASH_IRQn);
+
+  EE_FlashUnlock();
+  FlashStatus = EE_Init();
+
+  /* Erase a page reclaimed by the recovery before the first write */
+  if (eeData.bg.state == EE_BG_PENDING)
   {
-    case ERASED:
-      if (PageStatus1 == VALID_PAGE) /* Page0 erased, Page1 valid */
-      {
-        /* Erase Page0 */
-        FLASH_EraseInitTypeDef eraseInit;
-        eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-        eraseInit.NbPages = 1;
-        eraseInit.PageAddress = PAGE0_BASE_ADDRESS;
-        if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-        {
-        	return FlashStatus;
-        }
-      }
-      else if (PageStatus1 == RECEIVE_DATA) /* Page0 erased, Page1 receive */
+    eeData.bg.state = EE_BG_IDLE;
+    if (FlashStatus == HAL_OK)
+    {
+      FlashStatus = EE_ErasePage(eeData.bg.page);
+    }
+  }
+  EE_FlashLock();
+
+  return FlashStatus;
+}
+
+/**
+  * @brief  Runs the background operations of the EEPROM emulation.
+  *
+  *   Reclaimed pages are erased in the background by the flash interrupt.
+  *   This handler completes the erase by writing the erase counter. It also
+  *   flushes the write-behind cache if a flush was requested or the oldest
+  *   dirty entry is older than EE_CACHE_FLUSH_DELAY_MS. A flush is deferred
+  *   while an erase is running. Run this handler at your main loop.
+  *
+  * @param  None
+  * @retval None
+  */
+void ee_handler(void)
+{
+  if (eeData.bg.state == EE_BG_ERASE_DONE || eeData.bg.state == EE_BG_ERROR)
+  {
+    EE_FlashUnlock();
+    EE_CompleteBackground();
+    EE_FlashLock();
+  }
+
+  if (eeData.bg.state == EE_BG_ERASE)
+  {
+    return;
+  }
+
+  if (eeData.cache.flushRequest ||
+      (eeData.cache.dirty && HAL_GetTick() - eeData.cache.dirtySince >= EE_CACHE_FLUSH_DELAY_MS))
+  {
+    eeData.cache.flushRequest = 0;
+    ee_flush();
+  }
+}
+
+/**
+  * @brief  Check if a background erase is running
+  * @param  None
+  * @retval 1 if the EEPROM emulation is busy otherwise 0
+  */
+uint8_t ee_isBusy(void)
+{
+  return eeData.bg.state != EE_BG_IDLE;
+}
+
+/**
+  * @brief  Restore the page log, see ee_init()
+  * @param  None.
+  * @retval - Flash error code: on write Flash error
+  *         - FLASH_COMPLETE: on success
+  */
+static uint16_t EE_Init(void)
+{
+  uint16_t FlashStatus;
+  uint16_t Page = 0, Head = 0, Seq = 0;
+  uint8_t found = 0;
+  uint8_t chain[EE_PAGE_COUNT];
+
+  eeData.valid = 0;
+  eeData.stats.writes =
+  eeData.stats.programs =
+  eeData.stats.erases =
+  eeData.stats.reclaims =
+  eeData.stats.copies =
+  eeData.stats.transactions =
+  eeData.stats.discarded =
+  eeData.stats.cacheWrites =
+  eeData.stats.coalesced =
+  eeData.stats.flushes =
+  eeData.stats.flushedVars = 0;
+
+  /* Search the log head */
+  for (Page = 0; Page < EE_PAGE_COUNT; Page++)
+  {
+    chain[Page] = 0;
+
+    if (EE_IsPageInUse(Page))
+    {
+      Seq = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET);
+      if (!found || EE_IsSeqNewer(Seq, eeData.seq))
       {
-        /* Erase Page0 */
-    	  FLASH_EraseInitTypeDef eraseInit;
-    	  eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-    	  eraseInit.NbPages = 1;
-    	  eraseInit.PageAddress = PAGE0_BASE_ADDRESS;
-    	  if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-    	  {
-    		  return FlashStatus;
-    	  }
-
-          /* Mark Page1 as valid */
-    	  if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE1_BASE_ADDRESS, VALID_PAGE)) != HAL_OK) {
-    		  return FlashStatus;
-    	  }
+        Head = Page;
+        eeData.seq = Seq;
+        found = 1;
       }
-      else /* First EEPROM access (Page0&1 are erased) or invalid state -> format EEPROM */
+    }
+  }
+
+  if (!found)
+  {
+    /* First EEPROM access or the data has been written by the two page
+     * emulation of older firmware versions: start a new log.
+     */
+    for (Page = 0; Page < EE_PAGE_COUNT; Page++)
+    {
+      if (EE_IsLegacyPage(Page))
       {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        FlashStatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (FlashStatus != HAL_OK)
-        {
-          return FlashStatus;
-        }
+        return EE_MigrateLegacyPage(Page);
       }
-      break;
+    }
 
-    case RECEIVE_DATA:
-      if (PageStatus1 == VALID_PAGE) /* Page0 receive, Page1 valid */
-      {
-        /* Transfer data from Page1 to Page0 */
-        for (VarIdx = 0; VarIdx < NumbOfVar; VarIdx++)
-        {
-          if (( *(__IO uint16_t*)(PAGE0_BASE_ADDRESS + 6)) == VirtAddVarTab[VarIdx])
-          {
-            x = VarIdx;
-          }
-          if (VarIdx != x)
-          {
-            /* Read the last variables' updates */
-            ReadStatus = ee_readVariable(VirtAddVarTab[VarIdx], &DataVar);
-            /* In case variable corresponding to the virtual address was found */
-            if (ReadStatus != 0x1)
-            {
-              /* Transfer the variable to the Page0 */
-              EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[VarIdx], DataVar);
-              /* If program operation was failed, a Flash error code is returned */
-              if (EepromStatus != HAL_OK)
-              {
-                return EepromStatus;
-              }
-            }
-          }
-        }
-        /* Mark Page0 as valid */
-		if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS, VALID_PAGE)) != HAL_OK) {
-		  return FlashStatus;
-		}
+    if ((FlashStatus = EE_OpenPage(0, 0)) != HAL_OK)
+    {
+      return FlashStatus;
+    }
 
-        /* Erase Page1 */
-		FLASH_EraseInitTypeDef eraseInit;
-		eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-		eraseInit.NbPages = 1;
-		eraseInit.PageAddress = PAGE1_BASE_ADDRESS;
-		if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-		{
-			return FlashStatus;
-		}
-      }
-      else if (PageStatus1 == ERASED) /* Page0 receive, Page1 erased */
+    Head = 0;
+  }
+  else
+  {
+    eeData.head = Head;
+
+    /* Walk backwards from the head through all older pages of the log */
+    chain[Head] = 1;
+    Seq = eeData.seq;
+    for (Page = EE_PAGE_PREV(Head); Page != Head; Page = EE_PAGE_PREV(Page))
+    {
+      if (!EE_IsPageInUse(Page) ||
+          !EE_IsSeqNewer(Seq, EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET)))
       {
-        /* Erase Page1 */
-  		FLASH_EraseInitTypeDef eraseInit;
-  		eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-  		eraseInit.NbPages = 1;
-  		eraseInit.PageAddress = PAGE1_BASE_ADDRESS;
-  		if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-  		{
-  			return FlashStatus;
-  		}
-        /* Mark Page0 as valid */
-		if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS, VALID_PAGE)) != HAL_OK) {
-		  return FlashStatus;
-		}
+        break;
       }
-      else /* Invalid state -> format eeprom */
+      Seq = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET);
+      chain[Page] = 1;
+    }
+
+    /* Search the first free record slot of the head page */
+    eeData.freeAddress = EE_PAGE_BASE(Head) + EE_PAGE_HEADER_SIZE;
+    while (eeData.freeAddress < EE_PAGE_END(Head) &&
+           !EE_IsRecordBlank(eeData.freeAddress))
+    {
+      eeData.freeAddress += EE_RECORD_SIZE;
+    }
+
+    /* A legacy page is kept until its migration is complete */
+    if (EE_FindVariable(EE_VADDR_MIGRATED) == 0)
+    {
+      for (Page = 0; Page < EE_PAGE_COUNT; Page++)
       {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        FlashStatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (FlashStatus != HAL_OK)
+        if (!chain[Page] && EE_IsLegacyPage(Page))
         {
-          return FlashStatus;
+          return EE_MigrateLegacyPage(Page);
         }
       }
-      break;
+    }
 
-    case VALID_PAGE:
-      if (PageStatus1 == VALID_PAGE) /* Invalid state -> format eeprom */
+    /* Erase stale or corrupted pages which are not part of the log */
+    for (Page = 0; Page < EE_PAGE_COUNT; Page++)
+    {
+      if (!chain[Page] && !EE_IsPageBlank(Page))
       {
-        /* Erase both Page0 and Page1 and set Page0 as valid page */
-        FlashStatus = EE_Format();
-        /* If erase/program operation was failed, a Flash error code is returned */
-        if (FlashStatus != HAL_OK)
+        if ((FlashStatus = EE_ErasePage(Page)) != HAL_OK)
         {
           return FlashStatus;
         }
       }
-      else if (PageStatus1 == ERASED) /* Page0 valid, Page1 erased */
-      {
-		/* Erase Page1 */
-		FLASH_EraseInitTypeDef eraseInit;
-		eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-		eraseInit.NbPages = 1;
-		eraseInit.PageAddress = PAGE1_BASE_ADDRESS;
-		if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-		{
-		  return FlashStatus;
-		}
-      }
-      else /* Page0 valid, Page1 receive */
-      {
-        /* Transfer data from Page0 to Page1 */
-        for (VarIdx = 0; VarIdx < NumbOfVar; VarIdx++)
-        {
-          if ((*(__IO uint16_t*)(PAGE1_BASE_ADDRESS + 6)) == VirtAddVarTab[VarIdx])
-          {
-            x = VarIdx;
-          }
-          if (VarIdx != x)
-          {
-            /* Read the last variables' updates */
-            ReadStatus = ee_readVariable(VirtAddVarTab[VarIdx], &DataVar);
-            /* In case variable corresponding to the virtual address was found */
-            if (ReadStatus != 0x1)
-            {
-              /* Transfer the variable to the Page1 */
-              EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[VarIdx], DataVar);
-              /* If program operation was failed, a Flash error code is returned */
-              if (EepromStatus != HAL_OK)
-              {
-                return EepromStatus;
-              }
-            }
-          }
-        }
-        /* Mark Page1 as valid */
-		if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE1_BASE_ADDRESS, VALID_PAGE)) != HAL_OK) {
-		  return FlashStatus;
-		}
+    }
 
-        /* Erase Page0 */
-		FLASH_EraseInitTypeDef eraseInit;
-		eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-		eraseInit.NbPages = 1;
-		eraseInit.PageAddress = PAGE0_BASE_ADDRESS;
-		if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-		{
-		  return FlashStatus;
-		}
-      }
-      break;
+    /* Discard a transaction interrupted by a power loss */
+    if ((FlashStatus = EE_RecoverTransaction()) != HAL_OK)
+    {
+      return FlashStatus;
+    }
+  }
 
-    default:  /* Any other state -> format eeprom */
-      /* Erase both Page0 and Page1 and set Page0 as valid page */
-      FlashStatus = EE_Format();
-      /* If erase/program operation was failed, a Flash error code is returned */
-      if (FlashStatus != HAL_OK)
-      {
-        return FlashStatus;
-      }
-      break;
+  eeData.valid = 1;
+
+  /* Complete an interrupted garbage collection: the page after the head
+   * must be free to be able to advance the log.
+   */
+  if (EE_PAGE_NEXT(Head) != Head && EE_IsPageInUse(EE_PAGE_NEXT(Head)))
+  {
+    if ((FlashStatus = EE_ReclaimPage(EE_PAGE_NEXT(Head))) != HAL_OK)
+    {
+      return FlashStatus;
+    }
   }
 
   return HAL_OK;
@@ -271,51 +404,31 @@ uint16_t ee_init(void)
   */
 uint16_t ee_readVariable(uint16_t VirtAddress, uint16_t* Data)
 {
-  uint16_t ValidPage = PAGE0;
-  uint16_t AddressValue = 0x5555, ReadStatus = 1;
-  uint32_t Address = 0x08010000, PageStartAddress = 0x08010000;
-
-  /* Get active Page for read operation */
-  ValidPage = EE_FindValidPage(READ_FROM_VALID_PAGE);
+  uint32_t Address = 0;
+  eeCacheEntry_t* Entry = 0;
 
   /* Check if there is no valid page */
-  if (ValidPage == NO_VALID_PAGE)
+  if (!eeData.valid)
   {
     return  NO_VALID_PAGE;
   }
 
-  /* Get the valid Page start Address */
-  PageStartAddress = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(ValidPage * FLASH_PAGE_SIZE));
-
-  /* Get the valid Page end Address */
-  Address = (uint32_t)((EEPROM_START_ADDRESS - 2) + (uint32_t)((1 + ValidPage) * FLASH_PAGE_SIZE));
-
-  /* Check each active page address starting from end */
-  while (Address > (PageStartAddress + 2))
+  /* Values of the write-behind cache are newer than the flash */
+  if ((Entry = EE_CacheFind(VirtAddress)) != 0)
   {
-    /* Get the current location content to be compared with virtual address */
-    AddressValue = (*(__IO uint16_t*)Address);
-
-    /* Compare the read address with the virtual address */
-    if (AddressValue == VirtAddress)
-    {
-      /* Get content of Address-2 which is variable value */
-      *Data = (*(__IO uint16_t*)(Address - 2));
-
-      /* In case variable value is read, reset ReadStatus flag */
-      ReadStatus = 0;
+    *Data = Entry->data;
+    return 0;
+  }
 
-      break;
-    }
-    else
-    {
-      /* Next address location */
-      Address = Address - 4;
-    }
+  if ((Address = EE_FindVariable(VirtAddress)) == 0)
+  {
+    /* Variable doesn't exist */
+    return 1;
   }
 
-  /* Return ReadStatus value: (0: variable exist, 1: variable doesn't exist) */
-  return ReadStatus;
+  *Data = EE_ReadHalfWord(Address);
+
+  return 0;
 }
 
 /**
@@ -338,11 +451,11 @@ uint16_t ee_readVariableOrDefault(uint16_t VirtAddress, uint16_t* Data, const ui
 
 	if( (ret = ee_readVariable(VirtAddress, Data) ) == 1) {
 		if ( (ret = ee_writeVariable(VirtAddress, dataDefault)) != 0) {
-			printf("failed to write default value at 0x%04x\n", VirtAddress);
+			mWarning("failed to write default value at 0x%04x\n", VirtAddress);
 		}
 
 		if( (ret = ee_readVariable(VirtAddress, Data) ) != 0) {
-			printf("failed to read default value at 0x%04x\n", VirtAddress);
+			mWarning("failed to read default value at 0x%04x\n", VirtAddress);
 		}
 	}
 
@@ -357,290 +470,1100 @@ uint16_t ee_readVariableOrDefault(uint16_t VirtAddress, uint16_t* Data, const ui
   *           - FLASH_COMPLETE: on success
   *           - PAGE_FULL: if valid page is full
   *           - NO_VALID_PAGE: if no valid page was found
+  *           - HAL_BUSY: if a background erase is running, nothing is written
   *           - Flash error code: on write Flash error
   */
 uint16_t ee_writeVariable(uint16_t VirtAddress, uint16_t Data)
 {
   uint16_t Status = 0;
 
-  /* Write the variable virtual address and value in the EEPROM */
-  Status = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
+  EE_FlashUnlock();
+  if ((Status = EE_CompleteBackground()) == HAL_OK)
+  {
+    Status = EE_WriteVariable(VirtAddress, Data);
+
+    /* Erase a page reclaimed by the write */
+    if (EE_StartBackground() != HAL_OK && Status == HAL_OK)
+    {
+      Status = HAL_ERROR;
+    }
+  }
+  EE_FlashLock();
 
-  /* In case the EEPROM active page is full */
-  if (Status == PAGE_FULL)
+  if (Status == HAL_OK)
   {
-    /* Perform Page transfer */
-    Status = EE_PageTransfer(VirtAddress, Data);
+    EE_CacheUpdate(VirtAddress, Data);
   }
 
-  /* Return last operation status */
   return Status;
 }
 
 /**
-  * @brief  Erases PAGE0 and PAGE1 and writes VALID_PAGE header to PAGE0
-  * @param  None
-  * @retval Status of the last operation (Flash write or erase) done during
-  *         EEPROM formating
-  */
-static HAL_StatusTypeDef EE_Format(void)
-{
-	uint32_t pageError;
-	HAL_StatusTypeDef FlashStatus = HAL_OK;
-
-	/* Erase Page0 */
-	FLASH_EraseInitTypeDef eraseInit;
-	eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-	eraseInit.NbPages = 1;
-	eraseInit.PageAddress = PAGE0_BASE_ADDRESS;
-	if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-	{
-		return FlashStatus;
-	}
+  * @brief  Writes/updates a group of variables atomically.
+  *
+  *   The records are appended in one pass between a begin and a commit
+  *   marker. If the commit marker is missing after a power loss the whole
+  *   group is discarded by ee_init(). The group never spans two pages.
+  *
+  * @param  Vars: Virtual addresses and values of the variables
+  * @param  Count: Number of variables
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if the group does not fit into a page
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - HAL_BUSY: if a background erase is running, nothing is written
+  *           - Flash error code: on write Flash error
+  */
+uint16_t ee_writeVariables(const eeVar_t* Vars, uint16_t Count)
+{
+  uint16_t Status = 0;
+  uint16_t VarIdx = 0;
 
+  EE_FlashUnlock();
+  if ((Status = EE_CompleteBackground()) == HAL_OK)
+  {
+    Status = EE_WriteVariables(Vars, Count);
 
-	/* Set Page0 as valid page: Write VALID_PAGE at Page0 base address */
-	if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, PAGE0_BASE_ADDRESS, VALID_PAGE)) != HAL_OK) {
-		return FlashStatus;
-	}
+    /* Erase a page reclaimed by the write */
+    if (EE_StartBackground() != HAL_OK && Status == HAL_OK)
+    {
+      Status = HAL_ERROR;
+    }
+  }
+  EE_FlashLock();
 
-	/* Erase Page1 */
-	eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
-	eraseInit.NbPages = 1;
-	eraseInit.PageAddress = PAGE1_BASE_ADDRESS;
-	if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
-	{
-		return FlashStatus;
-	}
+  for (VarIdx = 0; Status == HAL_OK && VarIdx < Count; VarIdx++)
+  {
+    EE_CacheUpdate(Vars[VarIdx].virtAddress, Vars[VarIdx].data);
+  }
 
-	/* Return Page1 erase operation status */
-	return FlashStatus;
+  return Status;
 }
 
 /**
-  * @brief  Find valid Page for write or read operation
-  * @param  Operation: operation to achieve on the valid page.
-  *   This parameter can be one of the following values:
-  *     @arg READ_FROM_VALID_PAGE: read operation from valid page
-  *     @arg WRITE_IN_VALID_PAGE: write operation from valid page
-  * @retval Valid page number (PAGE0 or PAGE1) or NO_VALID_PAGE in case
-  *   of no valid page was found
+  * @brief  Writes/upadtes variable data in EEPROM, see ee_writeVariable()
+  * @param  VirtAddress: Variable virtual address
+  * @param  Data: 16 bit data to be written
+  * @retval Success or error status
   */
-static uint16_t EE_FindValidPage(uint8_t Operation)
+static uint16_t EE_WriteVariable(uint16_t VirtAddress, uint16_t Data)
 {
-  uint16_t PageStatus0 = 6, PageStatus1 = 6;
-
-  /* Get Page0 actual status */
-  PageStatus0 = (*(__IO uint16_t*)PAGE0_BASE_ADDRESS);
+  uint16_t Status = 0;
 
-  /* Get Page1 actual status */
-  PageStatus1 = (*(__IO uint16_t*)PAGE1_BASE_ADDRESS);
+  /* Check if there is no valid page */
+  if (!eeData.valid)
+  {
+    return  NO_VALID_PAGE;
+  }
 
-  /* Write or read operation */
-  switch (Operation)
+  /* In case the head page is full */
+  if (eeData.freeAddress >= EE_PAGE_END(eeData.head))
   {
-    case WRITE_IN_VALID_PAGE:   /* ---- Write operation ---- */
-      if (PageStatus1 == VALID_PAGE)
-      {
-        /* Page0 receiving data */
-        if (PageStatus0 == RECEIVE_DATA)
-        {
-          return PAGE0;         /* Page0 valid */
-        }
-        else
-        {
-          return PAGE1;         /* Page1 valid */
-        }
-      }
-      else if (PageStatus0 == VALID_PAGE)
-      {
-        /* Page1 receiving data */
-        if (PageStatus1 == RECEIVE_DATA)
-        {
-          return PAGE1;         /* Page1 valid */
-        }
-        else
-        {
-          return PAGE0;         /* Page0 valid */
-        }
-      }
-      else
-      {
-        return NO_VALID_PAGE;   /* No valid Page */
-      }
+    /* Advance the log to the next page */
+    if ((Status = EE_PageAdvance()) != HAL_OK)
+    {
+      return Status;
+    }
+  }
 
-    case READ_FROM_VALID_PAGE:  /* ---- Read operation ---- */
-      if (PageStatus0 == VALID_PAGE)
-      {
-        return PAGE0;           /* Page0 valid */
-      }
-      else if (PageStatus1 == VALID_PAGE)
-      {
-        return PAGE1;           /* Page1 valid */
-      }
-      else
-      {
-        return NO_VALID_PAGE ;  /* No valid Page */
-      }
+  /* Write the variable virtual address and value in the EEPROM */
+  Status = EE_WriteRecord(VirtAddress, Data);
 
-    default:
-      return PAGE0;             /* Page0 valid */
-  }
+  eeData.stats.writes++;
+
+  /* Return last operation status */
+  return Status;
 }
 
 /**
-  * @brief  Verify if active page is full and Writes variable in EEPROM.
-  * @param  VirtAddress: 16 bit virtual address of the variable
-  * @param  Data: 16 bit data to be written as variable value
-  * @retval Success or error status:
-  *           - FLASH_COMPLETE: on success
-  *           - PAGE_FULL: if valid page is full
-  *           - NO_VALID_PAGE: if no valid page was found
-  *           - Flash error code: on write Flash error
+  * @brief  Writes/updates a group of variables atomically, see
+  *   ee_writeVariables()
+  * @param  Vars: Virtual addresses and values of the variables
+  * @param  Count: Number of variables
+  * @retval Success or error status
   */
-static uint16_t EE_VerifyPageFullWriteVariable(uint16_t VirtAddress, uint16_t Data)
+static uint16_t EE_WriteVariables(const eeVar_t* Vars, uint16_t Count)
 {
-	HAL_StatusTypeDef FlashStatus = HAL_OK;
-  uint16_t ValidPage = PAGE0;
-  uint32_t Address = 0x08010000, PageEndAddress = 0x080107FF;
-
-  /* Get valid Page for write operation */
-  ValidPage = EE_FindValidPage(WRITE_IN_VALID_PAGE);
+  uint16_t Status = 0;
+  uint16_t VarIdx = 0;
+  uint32_t Begin = 0;
 
   /* Check if there is no valid page */
-  if (ValidPage == NO_VALID_PAGE)
+  if (!eeData.valid)
   {
     return  NO_VALID_PAGE;
   }
 
-  /* Get the valid Page start Address */
-  Address = (uint32_t)(EEPROM_START_ADDRESS + (uint32_t)(ValidPage * FLASH_PAGE_SIZE));
+  if (Count == 0)
+  {
+    return HAL_OK;
+  }
 
-  /* Get the valid Page end Address */
-  PageEndAddress = (uint32_t)((EEPROM_START_ADDRESS - 2) + (uint32_t)((1 + ValidPage) * FLASH_PAGE_SIZE));
+  if (Count > EE_TXN_MAX_VARS)
+  {
+    return PAGE_FULL;
+  }
 
-  /* Check each active page address starting from begining */
-  while (Address < PageEndAddress)
+  /* Advance the log if the group and its markers do not fit */
+  if (EE_PAGE_END(eeData.head) - eeData.freeAddress < (Count + 2) * EE_RECORD_SIZE)
   {
-    /* Verify if Address and Address+2 contents are 0xFFFFFFFF */
-    if ((*(__IO uint32_t*)Address) == 0xFFFFFFFF)
+    if ((Status = EE_PageAdvance()) != HAL_OK)
     {
-      /* Set variable data */
-  	  if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Address, Data)) != HAL_OK) {
-  		  return FlashStatus;
-  	  }
+      return Status;
+    }
+  }
 
-      /* Set variable virtual address */
-  	  FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, Address + 2, VirtAddress);
+  Begin = eeData.freeAddress;
+  Status = EE_WriteRecord(EE_VADDR_TXN_BEGIN, Count);
 
-      /* Return program operation status */
-      return FlashStatus;
-    }
-    else
-    {
-      /* Next address location */
-      Address = Address + 4;
-    }
+  for (VarIdx = 0; VarIdx < Count && Status == HAL_OK; VarIdx++)
+  {
+    Status = EE_WriteRecord(Vars[VarIdx].virtAddress, Vars[VarIdx].data);
+  }
+
+  if (Status == HAL_OK)
+  {
+    Status = EE_WriteRecord(EE_VADDR_TXN_COMMIT, Count);
   }
 
-  /* Return PAGE_FULL in case the valid page is full */
-  return PAGE_FULL;
+  /* A failed group must not be found by EE_FindVariable(), void the records
+   * written so far
+   */
+  if (Status != HAL_OK)
+  {
+    EE_VoidRecords(Begin, eeData.freeAddress);
+    return Status;
+  }
+
+  eeData.stats.writes += Count;
+  eeData.stats.transactions++;
+
+  return HAL_OK;
 }
 
 /**
-  * @brief  Transfers last updated variables data from the full Page to
-  *   an empty one.
-  * @param  VirtAddress: 16 bit virtual address of the variable
-  * @param  Data: 16 bit data to be written as variable value
+  * @brief  Returns the last stored data of a group of variables. Variables
+  *   which are not found get their default value and are written in one
+  *   transaction.
+  *
+  * @param  Vars: Virtual addresses and default values of the variables. The
+  *   values are replaced by the stored data.
+  * @param  Count: Number of variables
   * @retval Success or error status:
-  *           - FLASH_COMPLETE: on success
-  *           - PAGE_FULL: if valid page is full
+  *           - 0: if all variables were found or written
   *           - NO_VALID_PAGE: if no valid page was found
   *           - Flash error code: on write Flash error
   */
-static uint16_t EE_PageTransfer(uint16_t VirtAddress, uint16_t Data)
+uint16_t ee_readVariablesOrDefault(eeVar_t* Vars, uint16_t Count)
 {
-	HAL_StatusTypeDef FlashStatus = HAL_OK;
-  uint32_t NewPageAddress = 0x080103FF, OldPageAddress = 0x08010000;
-  uint16_t ValidPage = PAGE0, VarIdx = 0;
-  uint16_t EepromStatus = 0, ReadStatus = 0;
-  uint32_t pageError;
-
-  /* Get active Page for read operation */
-  ValidPage = EE_FindValidPage(READ_FROM_VALID_PAGE);
+  eeVar_t Missing[NumbOfVar];
+  uint16_t MissingCnt = 0;
+  uint16_t VarIdx = 0;
+  uint16_t Status = 0;
 
-  if (ValidPage == PAGE1)       /* Page1 valid */
+  for (VarIdx = 0; VarIdx < Count; VarIdx++)
   {
-    /* New page address where variable will be moved to */
-    NewPageAddress = PAGE0_BASE_ADDRESS;
+    if ((Status = ee_readVariable(Vars[VarIdx].virtAddress, &Vars[VarIdx].data)) == NO_VALID_PAGE)
+    {
+      return Status;
+    }
 
-    /* Old page address where variable will be taken from */
-    OldPageAddress = PAGE1_BASE_ADDRESS;
+    if (Status == 1 && MissingCnt < NumbOfVar)
+    {
+      Missing[MissingCnt++] = Vars[VarIdx];
+    }
   }
-  else if (ValidPage == PAGE0)  /* Page0 valid */
-  {
-    /* New page address where variable will be moved to */
-    NewPageAddress = PAGE1_BASE_ADDRESS;
 
-    /* Old page address where variable will be taken from */
-    OldPageAddress = PAGE0_BASE_ADDRESS;
-  }
-  else
+  if ((Status = ee_writeVariables(Missing, MissingCnt)) != HAL_OK)
   {
-    return NO_VALID_PAGE;       /* No valid Page */
-  }
-
-  /* Set the new Page status to RECEIVE_DATA status */
-  if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, NewPageAddress, RECEIVE_DATA)) != HAL_OK) {
-	  return FlashStatus;
+    mWarning("failed to write %d default values\n", MissingCnt);
   }
 
-  /* Write the variable passed as parameter in the new active page */
-  EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddress, Data);
-  /* If program operation was failed, a Flash error code is returned */
-  if (EepromStatus != HAL_OK)
-  {
-    return EepromStatus;
-  }
+  return Status;
+}
 
-  /* Transfer process: transfer variables from old to the new active page */
-  for (VarIdx = 0; VarIdx < NumbOfVar; VarIdx++)
-  {
-    if (VirtAddVarTab[VarIdx] != VirtAddress)  /* Check each variable except the one passed as parameter */
-    {
-      /* Read the other last variable updates */
-      ReadStatus = ee_readVariable(VirtAddVarTab[VarIdx], &DataVar);
-      /* In case variable corresponding to the virtual address was found */
-      if (ReadStatus != 0x1)
-      {
-        /* Transfer the variable to the new active page */
-        EepromStatus = EE_VerifyPageFullWriteVariable(VirtAddVarTab[VarIdx], DataVar);
-        /* If program operation was failed, a Flash error code is returned */
-        if (EepromStatus != HAL_OK)
-        {
-          return EepromStatus;
-        }
-      }
+/**
+  * @brief  Writes/updates variable data in the write-behind cache.
+  *
+  *   The value is kept in RAM and written to flash by the next flush.
+  *   Repeated writes to the same variable are coalesced into one flash write.
+  *   If the cache is full the value is written to flash immediately.
+  *
+  * @param  VirtAddress: Variable virtual address
+  * @param  Data: 16 bit data to be written
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - Flash error code: on write Flash error
+  */
+uint16_t ee_cacheWrite(uint16_t VirtAddress, uint16_t Data)
+{
+  eeCacheEntry_t* Entry = 0;
+  uint16_t Stored = 0;
+  uint16_t Status = 0;
+  uint8_t Missing = 0;
+
+  if ((Entry = EE_CacheFind(VirtAddress)) == 0)
+  {
+    if (eeData.cache.used >= EE_CACHE_SIZE)
+    {
+      return ee_writeVariable(VirtAddress, Data);
+    }
+
+    if ((Status = ee_readVariable(VirtAddress, &Stored)) == NO_VALID_PAGE)
+    {
+      return Status;
     }
+
+    Entry = &eeData.cache.entries[eeData.cache.used++];
+    Entry->virtAddress = VirtAddress;
+    Entry->data = Stored;
+    Entry->dirty = 0;
+
+    /* A variable which does not exist in flash is always written */
+    Missing = (Status != 0);
+  }
+
+  eeData.stats.cacheWrites++;
+
+  if (Entry->data == Data && !Missing)
+  {
+    return HAL_OK;
+  }
+
+  Entry->data = Data;
+
+  if (Entry->dirty)
+  {
+    eeData.stats.coalesced++;
+    return HAL_OK;
   }
 
-  /* Erase the old Page: Set old Page status to ERASED status */
+  Entry->dirty = 1;
+
+  if (eeData.cache.dirty++ == 0)
+  {
+    eeData.cache.dirtySince = HAL_GetTick();
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Write all dirty variables of the write-behind cache to flash in
+  *   one transaction.
+  * @param  None
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - NO_VALID_PAGE: if no valid page was found
+  *           - HAL_BUSY: if a background erase is running, the variables
+  *             stay dirty
+  *           - Flash error code: on write Flash error
+  */
+uint16_t ee_flush(void)
+{
+  eeVar_t Vars[EE_CACHE_SIZE];
+  uint16_t Count = 0;
+  uint16_t Status = 0;
+  uint8_t Idx = 0;
+
+  if (eeData.cache.dirty == 0)
+  {
+    return HAL_OK;
+  }
+
+  for (Idx = 0; Idx < eeData.cache.used; Idx++)
+  {
+    if (eeData.cache.entries[Idx].dirty)
+    {
+      Vars[Count].virtAddress = eeData.cache.entries[Idx].virtAddress;
+      Vars[Count].data = eeData.cache.entries[Idx].data;
+      Count++;
+    }
+  }
+
+  /* Written variables are marked clean by ee_writeVariables() */
+  if ((Status = ee_writeVariables(Vars, Count)) != HAL_OK)
+  {
+    return Status;
+  }
+
+  eeData.stats.flushes++;
+  eeData.stats.flushedVars += Count;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Request a flush of the write-behind cache by ee_handler(), e.g.
+  *   on a power fail warning. This function can be called from an interrupt.
+  * @param  None
+  * @retval None
+  */
+void ee_requestFlush(void)
+{
+  eeData.cache.flushRequest = 1;
+}
+
+/**
+  * @brief  Returns the number of dirty variables in the write-behind cache
+  * @param  None
+  * @retval Number of variables waiting for the next flush
+  */
+uint8_t ee_getDirtyCount(void)
+{
+  return eeData.cache.dirty;
+}
+
+/**
+  * @brief  Copy the EEPROM emulation statistics
+  * @param  Stats: Destination of the statistics
+  * @retval None
+  */
+void ee_getStats(eeStats_t* Stats)
+{
+  *Stats = eeData.stats;
+}
+
+/**
+  * @brief  Returns the number of erase cycles of a page of the log
+  * @param  Page: Page index (0 .. EE_PAGE_COUNT - 1)
+  * @retval Number of erase cycles or 0 if the counter is unknown
+  */
+uint16_t ee_getPageEraseCount(uint16_t Page)
+{
+  uint16_t Erases;
+
+  if (Page >= EE_PAGE_COUNT)
+  {
+    return 0;
+  }
+
+  Erases = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_ERASES_OFFSET);
+
+  return (Erases == ERASED) ? 0 : Erases;
+}
+
+/**
+  * @brief  Read a half word from the flash
+  * @param  Address: Flash address
+  * @retval Half word at the address
+  */
+static uint16_t EE_ReadHalfWord(uint32_t Address)
+{
+  return EE_FLASH_READ(Address);
+}
+
+/**
+  * @brief  Check if a record slot is erased
+  * @param  Address: Address of the record slot
+  * @retval 1 if both half words of the slot are erased otherwise 0
+  */
+static uint8_t EE_IsRecordBlank(uint32_t Address)
+{
+  return EE_ReadHalfWord(Address) == ERASED && EE_ReadHalfWord(Address + 2) == ERASED;
+}
+
+/**
+  * @brief  Program a half word into the flash
+  * @param  Address: Flash address
+  * @param  Data: Half word to program
+  * @retval Flash status
+  */
+static HAL_StatusTypeDef EE_ProgramHalfWord(uint32_t Address, uint16_t Data)
+{
+  eeData.stats.programs++;
+
+  return EE_FLASH_PROGRAM(Address, Data);
+}
+
+/**
+  * @brief  Erase a page of the log and carry over its erase counter
+  * @param  Page: Page index
+  * @retval Flash status
+  */
+static HAL_StatusTypeDef EE_ErasePage(uint16_t Page)
+{
+  HAL_StatusTypeDef FlashStatus = HAL_OK;
   FLASH_EraseInitTypeDef eraseInit;
+  uint32_t pageError;
+  uint16_t Erases;
+
+  /* Unknown erase counters (erased or interrupted) restart at zero */
+  if ((Erases = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_ERASES_OFFSET)) == ERASED)
+  {
+    Erases = 0;
+  }
+
   eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
   eraseInit.NbPages = 1;
-  eraseInit.PageAddress = OldPageAddress;
-  if( ( FlashStatus = HAL_FLASHEx_Erase(&eraseInit, &pageError))  != HAL_OK)
+  eraseInit.PageAddress = EE_PAGE_BASE(Page);
+  if( ( FlashStatus = EE_FLASH_ERASE(&eraseInit, &pageError))  != HAL_OK)
   {
-	  return FlashStatus;
+    return FlashStatus;
   }
 
-  /* Set new Page status to VALID_PAGE status */
-  if( (FlashStatus = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, NewPageAddress, VALID_PAGE)) != HAL_OK) {
-	  return FlashStatus;
+  eeData.stats.erases++;
+  mtr_inc(MTR_EE_PAGE_ERASES);
+
+  /* Saturate the counter: 0xFFFF is reserved for erased flash */
+  if (Erases < (ERASED - 1))
+  {
+    Erases++;
   }
 
-  /* Return last operation flash status */
-  return FlashStatus;
+  return EE_ProgramHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_ERASES_OFFSET, Erases);
+}
+
+/**
+  * @brief  Start the erase of a page in the background
+  *
+  *   The flash interrupt signals the end of the erase. The erase counter is
+  *   written afterwards by ee_handler() or before the next write. The flash
+  *   can not be programmed until then (the HAL returns HAL_BUSY).
+  *
+  * @param  Page: Page index
+  * @retval Flash status
+  */
+static HAL_StatusTypeDef EE_ErasePageIT(uint16_t Page)
+{
+  FLASH_EraseInitTypeDef eraseInit;
+
+  /* Unknown erase counters (erased or interrupted) restart at zero */
+  if ((eeData.bg.erases = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_ERASES_OFFSET)) == ERASED)
+  {
+    eeData.bg.erases = 0;
+  }
+
+  eeData.bg.page = Page;
+  eeData.bg.state = EE_BG_ERASE;
+
+  eraseInit.TypeErase = FLASH_TYPEERASE_PAGES;
+  eraseInit.NbPages = 1;
+  eraseInit.PageAddress = EE_PAGE_BASE(Page);
+  if (EE_FLASH_ERASE_IT(&eraseInit) != HAL_OK)
+  {
+    /* Fall back to a blocking erase */
+    eeData.bg.state = EE_BG_IDLE;
+    return EE_ErasePage(Page);
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Complete a finished background erase
+  *
+  *   Never waits for a running erase: the erase of a page takes about 20 ms
+  *   and stalls the main loop. A failed erase is repeated as blocking erase.
+  *
+  * @param  None
+  * @retval Flash status, HAL_BUSY if the erase is still running
+  */
+static uint16_t EE_CompleteBackground(void)
+{
+  uint16_t Erases;
+
+  if (eeData.bg.state == EE_BG_ERASE)
+  {
+    return HAL_BUSY;
+  }
+
+  if (eeData.bg.state == EE_BG_ERROR)
+  {
+    eeData.bg.state = EE_BG_IDLE;
+    return EE_ErasePage(eeData.bg.page);
+  }
+
+  if (eeData.bg.state == EE_BG_ERASE_DONE)
+  {
+    eeData.bg.state = EE_BG_IDLE;
+    eeData.stats.erases++;
+    mtr_inc(MTR_EE_PAGE_ERASES);
+
+    Erases = eeData.bg.erases;
+    if (Erases < (ERASED - 1))
+    {
+      Erases++;
+    }
+
+    return EE_ProgramHalfWord(EE_PAGE_BASE(eeData.bg.page) + EE_PAGE_ERASES_OFFSET, Erases);
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Start the erase of a page reclaimed by the last write
+  *
+  *   The erase is queued by EE_ReclaimPage() and started after the records
+  *   of the write are programmed: the flash can not be programmed while the
+  *   erase is running.
+  *
+  * @param  None
+  * @retval Flash status
+  */
+static uint16_t EE_StartBackground(void)
+{
+  if (eeData.bg.state != EE_BG_PENDING)
+  {
+    return HAL_OK;
+  }
+
+  return EE_ErasePageIT(eeData.bg.page);
+}
+
+/**
+  * @brief  Unlock the flash for the EEPROM emulation
+  * @param  None
+  * @retval None
+  */
+static void EE_FlashUnlock(void)
+{
+  HAL_FLASH_Unlock();
+}
+
+/**
+  * @brief  Lock the flash if no background erase is running. Otherwise the
+  *   flash is locked by ee_handler() after the erase.
+  * @param  None
+  * @retval None
+  */
+static void EE_FlashLock(void)
+{
+  if (eeData.bg.state == EE_BG_IDLE)
+  {
+    HAL_FLASH_Lock();
+  }
+}
+
+/**
+  * @brief  End of flash operation callback
+  * @param  ReturnValue: 0xFFFFFFFF if all pages of an erase are erased
+  * @retval None
+  */
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue)
+{
+  if (eeData.bg.state == EE_BG_ERASE && ReturnValue == 0xFFFFFFFF)
+  {
+    eeData.bg.state = EE_BG_ERASE_DONE;
+  }
+}
+
+/**
+  * @brief  Flash operation error callback
+  * @param  ReturnValue: Address of the failed operation
+  * @retval None
+  */
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue)
+{
+  if (eeData.bg.state == EE_BG_ERASE)
+  {
+    eeData.bg.state = EE_BG_ERROR;
+  }
+}
+
+/**
+  * @brief  Prepare a page as new head of the log
+  *
+  *   The sequence number is written before the RECEIVE_DATA status so that an
+  *   interrupted open leaves a page which is not in use.
+  *
+  * @param  Page: Page index
+  * @param  Seq: Sequence number of the page
+  * @retval Flash status
+  */
+static HAL_StatusTypeDef EE_OpenPage(uint16_t Page, uint16_t Seq)
+{
+  HAL_StatusTypeDef FlashStatus = HAL_OK;
+
+  if (!EE_IsPageBlank(Page))
+  {
+    if ((FlashStatus = EE_ErasePage(Page)) != HAL_OK)
+    {
+      return FlashStatus;
+    }
+  }
+
+  if ((FlashStatus = EE_ProgramHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET, Seq)) != HAL_OK)
+  {
+    return FlashStatus;
+  }
+
+  if ((FlashStatus = EE_ProgramHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_STATUS_OFFSET, RECEIVE_DATA)) != HAL_OK)
+  {
+    return FlashStatus;
+  }
+
+  eeData.head = Page;
+  eeData.seq = Seq;
+  eeData.freeAddress = EE_PAGE_BASE(Page) + EE_PAGE_HEADER_SIZE;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Check if a page is part of the log
+  * @param  Page: Page index
+  * @retval 1 if the page has a valid header otherwise 0
+  */
+static uint8_t EE_IsPageInUse(uint16_t Page)
+{
+  uint16_t PageStatus = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_STATUS_OFFSET);
+
+  return (PageStatus == RECEIVE_DATA || PageStatus == VALID_PAGE) &&
+      EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET) != ERASED;
+}
+
+/**
+  * @brief  Check if a page can be opened without an erase
+  * @param  Page: Page index
+  * @retval 1 if everything except the erase counter is erased otherwise 0
+  */
+static uint8_t EE_IsPageBlank(uint16_t Page)
+{
+  uint32_t Address;
+
+  if (EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_STATUS_OFFSET) != ERASED ||
+      EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET) != ERASED ||
+      EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_ERASES_OFFSET + 2) != ERASED)
+  {
+    return 0;
+  }
+
+  for (Address = EE_PAGE_BASE(Page) + EE_PAGE_HEADER_SIZE; Address < EE_PAGE_END(Page); Address += 4)
+  {
+    if (!EE_IsRecordBlank(Address))
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/**
+  * @brief  Check if a page has been written by the two page emulation of
+  *   older firmware versions
+  * @param  Page: Page index
+  * @retval 1 if the page is a valid legacy page otherwise 0
+  */
+static uint8_t EE_IsLegacyPage(uint16_t Page)
+{
+  /* The legacy header has no sequence number */
+  return EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_STATUS_OFFSET) == VALID_PAGE &&
+      EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET) == ERASED;
+}
+
+/**
+  * @brief  Compare two page sequence numbers with wrap around
+  * @param  Seq: Sequence number to check
+  * @param  Ref: Reference sequence number
+  * @retval 1 if Seq is newer than Ref otherwise 0
+  */
+static uint8_t EE_IsSeqNewer(uint16_t Seq, uint16_t Ref)
+{
+  return ((int16_t)(Seq - Ref)) > 0;
+}
+
+/**
+  * @brief  Search the last record of a variable in the log
+  *
+  *   The log is searched from the newest record of the head page backwards
+  *   through all older pages.
+  *
+  * @param  VirtAddress: Variable virtual address
+  * @retval Address of the record data or 0 if the variable was not found
+  */
+static uint32_t EE_FindVariable(uint16_t VirtAddress)
+{
+  uint16_t Page = eeData.head, Seq = eeData.seq, Cnt = 0;
+  uint32_t Address = eeData.freeAddress;
+
+  for (Cnt = 0; Cnt < EE_PAGE_COUNT; Cnt++)
+  {
+    if (Cnt > 0)
+    {
+      Page = EE_PAGE_PREV(Page);
+
+      /* Stop at the tail of the log */
+      if (!EE_IsPageInUse(Page) ||
+          !EE_IsSeqNewer(Seq, EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET)))
+      {
+        break;
+      }
+      Seq = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET);
+      Address = EE_PAGE_END(Page);
+    }
+
+    /* Check each record of the page starting from end */
+    while (Address > EE_PAGE_BASE(Page) + EE_PAGE_HEADER_SIZE)
+    {
+      Address -= EE_RECORD_SIZE;
+
+      if (EE_ReadHalfWord(Address + 2) == VirtAddress)
+      {
+        return Address;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Append a record at the head of the log
+  *
+  *   The data is written before the virtual address. A record interrupted by
+  *   a power loss has the prohibited virtual address 0xFFFF and is ignored.
+  *
+  * @param  VirtAddress: 16 bit virtual address of the variable
+  * @param  Data: 16 bit data to be written as variable value
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if the head page is full
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_WriteRecord(uint16_t VirtAddress, uint16_t Data)
+{
+  HAL_StatusTypeDef FlashStatus = HAL_OK;
+  uint32_t Address = eeData.freeAddress;
+
+  if (Address >= EE_PAGE_END(eeData.head))
+  {
+    return PAGE_FULL;
+  }
+
+  /* The slot is consumed even if the programming fails */
+  eeData.freeAddress += EE_RECORD_SIZE;
+
+  /* Set variable data */
+  if( (FlashStatus = EE_ProgramHalfWord(Address, Data)) != HAL_OK) {
+    return FlashStatus;
+  }
+
+  /* Set variable virtual address */
+  return EE_ProgramHalfWord(Address + 2, VirtAddress);
+}
+
+/**
+  * @brief  Close the full head page and open the next page of the circular
+  *   log. If the log wraps around the oldest page is reclaimed afterwards so
+  *   that there is always one free page in front of the head.
+  * @param  None
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - NO_VALID_PAGE: if the next page is still in use
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_PageAdvance(void)
+{
+  HAL_StatusTypeDef FlashStatus = HAL_OK;
+  uint16_t OldPage = eeData.head;
+  uint16_t NewPage = EE_PAGE_NEXT(eeData.head);
+  uint16_t Seq = eeData.seq + 1;
+
+  /* The sequence number 0xFFFF is reserved for erased pages */
+  if (Seq == ERASED)
+  {
+    Seq = 0;
+  }
+
+  if (EE_IsPageInUse(NewPage))
+  {
+    return NO_VALID_PAGE;
+  }
+
+  /* Mark the full page as valid */
+  if (EE_ReadHalfWord(EE_PAGE_BASE(OldPage) + EE_PAGE_STATUS_OFFSET) == RECEIVE_DATA)
+  {
+    if ((FlashStatus = EE_ProgramHalfWord(EE_PAGE_BASE(OldPage) + EE_PAGE_STATUS_OFFSET, VALID_PAGE)) != HAL_OK)
+    {
+      return FlashStatus;
+    }
+  }
+
+  if ((FlashStatus = EE_OpenPage(NewPage, Seq)) != HAL_OK)
+  {
+    return FlashStatus;
+  }
+
+  /* Reclaim the oldest page if the log has no free page left */
+  if (EE_IsPageInUse(EE_PAGE_NEXT(NewPage)))
+  {
+    return EE_ReclaimPage(EE_PAGE_NEXT(NewPage));
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Garbage collection: copy the live records of the oldest page of
+  *   the log to the head and erase the page afterwards.
+  *
+  *   A record is live if it is the last record of its variable. Superseded
+  *   records are dropped without any flash access. The erase of the page is
+  *   queued and started in the background after the pending records of the
+  *   caller, see EE_StartBackground().
+  *
+  * @param  Page: Page index of the oldest page
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - PAGE_FULL: if the head page is full
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_ReclaimPage(uint16_t Page)
+{
+  HAL_StatusTypeDef FlashStatus = HAL_OK;
+  uint16_t VarIdx = 0;
+  uint32_t Address = 0;
+
+  for (VarIdx = 0; VarIdx < NumbOfVar; VarIdx++)
+  {
+    Address = EE_FindVariable(VirtAddVarTab[VarIdx]);
+
+    if (Address >= EE_PAGE_BASE(Page) && Address < EE_PAGE_END(Page))
+    {
+      /* Transfer the variable to the head of the log */
+      if ((FlashStatus = EE_WriteRecord(VirtAddVarTab[VarIdx], EE_ReadHalfWord(Address))) != HAL_OK)
+      {
+        return FlashStatus;
+      }
+
+      eeData.stats.copies++;
+      mtr_inc(MTR_EE_VAR_COPIES);
+    }
+  }
+
+  eeData.stats.reclaims++;
+  mtr_inc(MTR_EE_PAGE_TRANSFERS);
+
+  /* The spare page is not needed before the head page is full */
+  eeData.bg.page = Page;
+  eeData.bg.state = EE_BG_PENDING;
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Void the records of transactions without commit marker
+  *
+  *   The commit marker of a transaction follows the number of records stored
+  *   in its begin marker. Only these records are voided, the records written
+  *   after an open transaction are kept. All pages of the log are searched.
+  *
+  * @param  None
+  * @retval Flash status
+  */
+static uint16_t EE_RecoverTransaction(void)
+{
+  uint16_t FlashStatus = HAL_OK;
+  uint16_t Page = eeData.head, Seq = eeData.seq, Cnt = 0;
+  uint32_t End = eeData.freeAddress;
+  uint32_t Address = 0;
+  uint32_t Commit = 0;
+
+  for (Cnt = 0; Cnt < EE_PAGE_COUNT; Cnt++)
+  {
+    if (Cnt > 0)
+    {
+      Page = EE_PAGE_PREV(Page);
+
+      /* Stop at the tail of the log */
+      if (!EE_IsPageInUse(Page) ||
+          !EE_IsSeqNewer(Seq, EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET)))
+      {
+        break;
+      }
+      Seq = EE_ReadHalfWord(EE_PAGE_BASE(Page) + EE_PAGE_SEQ_OFFSET);
+      End = EE_PAGE_END(Page);
+    }
+
+    for (Address = EE_PAGE_BASE(Page) + EE_PAGE_HEADER_SIZE; Address < End; Address += EE_RECORD_SIZE)
+    {
+      if (EE_ReadHalfWord(Address + 2) != EE_VADDR_TXN_BEGIN)
+      {
+        continue;
+      }
+
+      Commit = Address + ((uint32_t)EE_ReadHalfWord(Address) + 1) * EE_RECORD_SIZE;
+      if (Commit < End && EE_ReadHalfWord(Commit + 2) == EE_VADDR_TXN_COMMIT)
+      {
+        Address = Commit;
+        continue;
+      }
+
+      /* The slot of the missing commit marker belongs to the transaction */
+      Commit = (Commit < End) ? Commit + EE_RECORD_SIZE : End;
+      if ((FlashStatus = EE_VoidRecords(Address, Commit)) != HAL_OK)
+      {
+        return FlashStatus;
+      }
+
+      eeData.stats.discarded++;
+      Address = Commit - EE_RECORD_SIZE;
+    }
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Void the records of a transaction
+  *
+  *   Voided records get the virtual address EE_VADDR_VOID. Programming 0x0000
+  *   is allowed on already programmed flash half words. The begin marker is
+  *   voided last, a voiding interrupted by a power loss is repeated by the
+  *   next ee_init().
+  *
+  * @param  Begin: Address of the begin marker
+  * @param  End: Address behind the last record
+  * @retval Flash status
+  */
+static uint16_t EE_VoidRecords(uint32_t Begin, uint32_t End)
+{
+  uint16_t FlashStatus = HAL_OK;
+  uint32_t Address = End;
+
+  while (Address > Begin)
+  {
+    Address -= EE_RECORD_SIZE;
+
+    if (EE_ReadHalfWord(Address + 2) != EE_VADDR_VOID)
+    {
+      if ((FlashStatus = EE_ProgramHalfWord(Address + 2, EE_VADDR_VOID)) != HAL_OK)
+      {
+        return FlashStatus;
+      }
+    }
+  }
+
+  return HAL_OK;
+}
+
+/**
+  * @brief  Search a variable in the write-behind cache
+  * @param  VirtAddress: Variable virtual address
+  * @retval Cache entry or 0 if the variable is not cached
+  */
+static eeCacheEntry_t* EE_CacheFind(uint16_t VirtAddress)
+{
+  uint8_t Idx = 0;
+
+  for (Idx = 0; Idx < eeData.cache.used; Idx++)
+  {
+    if (eeData.cache.entries[Idx].virtAddress == VirtAddress)
+    {
+      return &eeData.cache.entries[Idx];
+    }
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Update a cached variable after it was written to flash. A pending
+  *   value of the variable is superseded.
+  * @param  VirtAddress: Variable virtual address
+  * @param  Data: 16 bit data written to flash
+  * @retval None
+  */
+static void EE_CacheUpdate(uint16_t VirtAddress, uint16_t Data)
+{
+  eeCacheEntry_t* Entry = 0;
+
+  if ((Entry = EE_CacheFind(VirtAddress)) == 0)
+  {
+    return;
+  }
+
+  if (Entry->dirty)
+  {
+    Entry->dirty = 0;
+    eeData.cache.dirty--;
+  }
+
+  Entry->data = Data;
+}
+
+/**
+  * @brief  Move the variables of a page written by the two page emulation of
+  *   older firmware versions into a new log.
+  *
+  *   The legacy page header has a size of 4 bytes and the last record of a
+  *   variable is the one with the highest address. The legacy page is erased
+  *   after the completion marker EE_VADDR_MIGRATED is written to the new log.
+  *   A migration interrupted by a power loss is restarted from the legacy
+  *   page by ee_init().
+  *
+  * @param  Page: Page index of the legacy valid page
+  * @retval Success or error status:
+  *           - FLASH_COMPLETE: on success
+  *           - Flash error code: on write Flash error
+  */
+static uint16_t EE_MigrateLegacyPage(uint16_t Page)
+{
+  HAL_StatusTypeDef FlashStatus = HAL_OK;
+  uint16_t VarIdx = 0;
+  uint16_t Data[NumbOfVar];
+  uint8_t Found[NumbOfVar];
+  uint32_t Address = 0;
+
+  /* Read the last variables' updates */
+  for (VarIdx = 0; VarIdx < NumbOfVar; VarIdx++)
+  {
+    Found[VarIdx] = 0;
+
+    for (Address = EE_PAGE_END(Page) - EE_RECORD_SIZE; Address >= EE_PAGE_BASE(Page) + 4; Address -= EE_RECORD_SIZE)
+    {
+      if (EE_ReadHalfWord(Address + 2) == VirtAddVarTab[VarIdx])
+      {
+        Data[VarIdx] = EE_ReadHalfWord(Address);
+        Found[VarIdx] = 1;
+        break;
+      }
+    }
+  }
+
+  /* Start the new log at the page after the legacy page, an incomplete
+   * copy of an interrupted migration is erased
+   */
+  if ((FlashStatus = EE_OpenPage(EE_PAGE_NEXT(Page), 0)) != HAL_OK)
+  {
+    return FlashStatus;
+  }
+
+  eeData.valid = 1;
+
+  for (VarIdx = 0; VarIdx < NumbOfVar; VarIdx++)
+  {
+    if (Found[VarIdx])
+    {
+      if ((FlashStatus = EE_WriteRecord(VirtAddVarTab[VarIdx], Data[VarIdx])) != HAL_OK)
+      {
+        return FlashStatus;
+      }
+    }
+  }
+
+  if ((FlashStatus = EE_WriteRecord(EE_VADDR_MIGRATED, Page)) != HAL_OK)
+  {
+    return FlashStatus;
+  }
+
+  /* Erase all remaining pages of the legacy emulation */
+  for (VarIdx = 0; VarIdx < EE_PAGE_COUNT; VarIdx++)
+  {
+    if (VarIdx != eeData.head && !EE_IsPageBlank(VarIdx))
+    {
+      if ((FlashStatus = EE_ErasePage(VarIdx)) != HAL_OK)
+      {
+        return FlashStatus;
+      }
+    }
+  }
+
+  return HAL_OK;
 }
 
 /**
@@ -0,0 +1,225 @@
+/**
+ * @file iorec.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Recording backend of io.h implementation
+ */
+#include "iorec.h"
+#include "io.h"
+
+#define IO_REC_MASK                 (IO_REC_SIZE - 1)
+
+#if (IO_REC_SIZE & IO_REC_MASK) != 0
+#error "IO_REC_SIZE must be a power of two"
+#endif
+
+#ifndef IO_REC_TIMESTAMP
+#define IO_REC_TIMESTAMP()          (DWT->CYCCNT)
+#define IO_REC_DWT
+#endif
+
+/**
+ * Recorder data struct type
+ */
+typedef struct ioRecData_s {
+    ioEdge_t edges[IO_REC_SIZE];
+
+    /**
+     * Free running write and read index
+     */
+    uint16_t head;
+    uint16_t tail;
+
+    /**
+     * Input levels of the last reads
+     */
+    uint16_t inputs[IO_REC_PORTS];
+
+    /**
+     * Overwritten edges
+     */
+    uint32_t lost;
+} ioRecData_t;
+
+/**
+ * Module data
+ */
+static ioRecData_t ioRecData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void io_recPush(GPIO_TypeDef* port, uint16_t pin, uint8_t level) IRQ_RAM_FUNC;
+
+/**
+ * Basic initialization for the recorder
+ *
+ * @warning Run MX_GPIO_Init() before you run this function.
+ */
+void io_recInit(void)
+{
+    GPIO_TypeDef* const ports[IO_REC_PORTS] = { GPIOA, GPIOB, GPIOC };
+    uint8_t i;
+
+#ifdef IO_REC_DWT
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    ioRecData.head =
+    ioRecData.tail = 0;
+    ioRecData.lost = 0;
+
+    for(i = 0; i < IO_REC_PORTS; i++)
+    {
+        ioRecData.inputs[i] = ports[i]->IDR;
+    }
+}
+
+/**
+ * @brief Set an output
+ */
+void io_recSet(GPIO_TypeDef* port, uint16_t pin)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if(!io_pinOut(port, pin))
+    {
+        io_recPush(port, pin, 1);
+    }
+    IO_SET(port, pin);
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Clear an output
+ */
+void io_recClr(GPIO_TypeDef* port, uint16_t pin)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    if(io_pinOut(port, pin))
+    {
+        io_recPush(port, pin, 0);
+    }
+    IO_CLR(port, pin);
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Toggle an output
+ */
+void io_recTgl(GPIO_TypeDef* port, uint16_t pin)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+
+    io_recPush(port, pin, !io_pinOut(port, pin));
+    IO_TGL(port, pin);
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Read an input
+ *
+ * @return Level of the input
+ */
+uint8_t io_recGet(GPIO_TypeDef* port, uint16_t pin)
+{
+    uint32_t primask;
+    uint8_t level = IO_GET(port, pin);
+    uint8_t index = IO_PORT_INDEX(port);
+
+    if(index >= IO_REC_PORTS || ((ioRecData.inputs[index] & pin) != 0) == level)
+    {
+        return level;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    /* An interrupt may have recorded the edge meanwhile */
+    if(((ioRecData.inputs[index] & pin) != 0) != level)
+    {
+        ioRecData.inputs[index] ^= pin;
+        io_recPush(port, pin, level);
+    }
+
+    __set_PRIMASK(primask);
+
+    return level;
+}
+
+/**
+ * @brief Read and remove the oldest edges
+ *
+ * @param edges Destination
+ * @param max Maximum number of edges
+ *
+ * @return Number of edges
+ */
+uint16_t io_recRead(ioEdge_t* edges, uint16_t max)
+{
+    uint32_t primask;
+    uint16_t n;
+
+    for(n = 0; n < max; n++)
+    {
+        primask = __get_PRIMASK();
+        __disable_irq();
+
+        if(ioRecData.tail == ioRecData.head)
+        {
+            __set_PRIMASK(primask);
+            break;
+        }
+
+        edges[n] = ioRecData.edges[ioRecData.tail++ & IO_REC_MASK];
+
+        __set_PRIMASK(primask);
+    }
+
+    return n;
+}
+
+/**
+ * @brief Returns the number of overwritten edges
+ */
+uint32_t io_recGetLost(void)
+{
+    return ioRecData.lost;
+}
+
+/**
+ * @brief Record an edge, the oldest edge is overwritten if the ring is full
+ *
+ * Call this function with disabled interrupts.
+ */
+static void io_recPush(GPIO_TypeDef* port, uint16_t pin, uint8_t level)
+{
+    ioEdge_t* edge;
+
+    if((uint16_t)(ioRecData.head - ioRecData.tail) == IO_REC_SIZE)
+    {
+        ioRecData.tail++;
+        ioRecData.lost++;
+    }
+
+    edge = &ioRecData.edges[ioRecData.head++ & IO_REC_MASK];
+    edge->time = IO_REC_TIMESTAMP();
+    edge->pin = pin;
+    edge->port = IO_PORT_INDEX(port);
+    edge->level = level;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file irq.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Interrupt vector table implementation
+ */
+#include "irq.h"
+
+#include <string.h>
+
+/**
+ * Vector table in RAM. The table offset register requires an alignment to
+ * the next power of two of the table size.
+ */
+static irqHandler_t irqVectors[IRQ_VECTOR_COUNT] __attribute__((aligned(256)));
+
+/**
+ * @brief Copy the vector table from flash into RAM and activate it
+ *
+ * Call this function before any interrupt handler will be changed by
+ * irq_setHandler().
+ */
+void irq_init(void)
+{
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+
+	memcpy(irqVectors, (void*)SCB->VTOR, sizeof(irqVectors));
+
+	SCB->VTOR = (uint32_t)irqVectors;
+	__DSB();
+
+	__set_PRIMASK(primask);
+}
+
+/**
+ * @brief Replace the handler of an interrupt
+ *
+ * @param irqn Interrupt number
+ * @param handler New interrupt handler
+ */
+void irq_setHandler(IRQn_Type irqn, irqHandler_t handler)
+{
+	irqVectors[16 + irqn] = handler;
+	__DSB();
+}
@@ -0,0 +1,139 @@
+/**
+ * @file isr.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Cycle cost of the interrupt handlers implementation
+ */
+#include "isr.h"
+
+#ifdef ISR_PROFILE
+
+/**
+ * ISR profile data struct type
+ */
+typedef struct isrData_s {
+    isrStats_t stats[ISR_SRC_COUNT];
+
+    /**
+     * Cycles of all finished measurements, including the preempting ones.
+     * A handler subtracts the increase during its run.
+     */
+    uint32_t nested;
+} isrData_t;
+
+/**
+ * Module data
+ */
+static isrData_t isrData;
+
+/**
+ * Basic initialization for the ISR profile
+ *
+ * Starts the cycle counter and clears the statistics of all sources.
+ */
+void isr_init(void)
+{
+    uint8_t i;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for(i = 0; i < ISR_SRC_COUNT; i++)
+    {
+        isr_clear(i);
+    }
+}
+
+/**
+ * @brief Start a measurement at the entry of a handler (see ISR_ENTER())
+ */
+void isr_enter(isrFrame_t* frame)
+{
+    frame->nested = isrData.nested;
+    frame->start = DWT->CYCCNT;
+}
+
+/**
+ * @brief Record a measurement at the exit of a handler (see ISR_EXIT())
+ *
+ * @param frame Start of the measurement
+ * @param source Interrupt source
+ */
+void isr_exit(const isrFrame_t* frame, isrSource_t source)
+{
+    isrStats_t* stats = &isrData.stats[source];
+    uint32_t primask = __get_PRIMASK();
+    uint32_t total;
+    uint32_t cycles;
+    uint32_t bin;
+
+    __disable_irq();
+
+    total = DWT->CYCCNT - frame->start;
+
+    /* Only the own cycles, the preempting handlers count theirs */
+    cycles = total - (isrData.nested - frame->nested);
+    isrData.nested = frame->nested + total;
+
+    stats->count++;
+    stats->sum += cycles;
+    if(cycles < stats->min)
+    {
+        stats->min = cycles;
+    }
+    if(cycles > stats->max)
+    {
+        stats->max = cycles;
+    }
+
+    /* Index of the highest set bit, no library call */
+    bin = 31 - __CLZ(cycles | 1);
+    bin = (bin > ISR_HIST_SHIFT) ? bin - ISR_HIST_SHIFT : 0;
+    stats->hist[(bin < ISR_HIST_BINS) ? bin : ISR_HIST_BINS - 1]++;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Copy the statistics of a source
+ */
+void isr_getStats(isrSource_t source, isrStats_t* stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    *stats = isrData.stats[source];
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Clear the statistics of a source
+ */
+void isr_clear(isrSource_t source)
+{
+    isrStats_t* stats = &isrData.stats[source];
+    uint32_t primask = __get_PRIMASK();
+    uint8_t i;
+
+    __disable_irq();
+
+    stats->count = 0;
+    stats->min = UINT32_MAX;
+    stats->max = 0;
+    stats->sum = 0;
+
+    for(i = 0; i < ISR_HIST_BINS; i++)
+    {
+        stats->hist[i] = 0;
+    }
+
+    __set_PRIMASK(primask);
+}
+
+#endif /* ISR_PROFILE */
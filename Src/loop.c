@@ -0,0 +1,229 @@
+/**
+ * @file loop.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Latency and CPU load of the main loop implementation
+ */
+#include <string.h>
+
+#include "loop.h"
+
+#ifdef LOOP_PROFILE
+
+/**
+ * Loop profile data struct type
+ */
+typedef struct loopData_s {
+    /**
+     * Cycle counter at the start of the iteration, the last mark and the
+     * start of the window
+     */
+    uint32_t start;
+    uint32_t last;
+    uint32_t windowStart;
+    uint32_t windowCycles;
+    uint8_t started;
+
+    /**
+     * Results of the current window
+     */
+    struct {
+        uint32_t iterations;
+        uint32_t idle;
+        uint32_t min;
+        uint32_t max;
+        uint32_t worstCycles;
+        uint8_t worst;
+    } window;
+
+    /**
+     * Record of the last completed window
+     */
+    loopStats_t stats;
+} loopData_t;
+
+/**
+ * Module data
+ */
+static loopData_t loopData;
+
+/**
+ * Names of the handlers (loopHandler_t)
+ */
+static const char* const loopNames[LOOP_H_COUNT] = {
+        "app", "stp", "ee", "mlog", "itm", "cli", "mb", "brg", "proto", "tlm", "cdc"
+};
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void loop_resetWindow(uint32_t now);
+static void loop_closeWindow(uint32_t now, uint32_t cycles);
+
+/**
+ * Basic initialization for the loop profile
+ *
+ * Run after the system clock configuration.
+ */
+void loop_init(void)
+{
+    memset(&loopData, 0, sizeof(loopData));
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    loopData.windowCycles = SystemCoreClock / 1000 * LOOP_WINDOW_MS;
+    loopData.stats.idleCycles = UINT32_MAX;
+}
+
+/**
+ * @brief Finish the previous iteration and start the next (see LOOP_BEGIN())
+ */
+void loop_begin(void)
+{
+    uint32_t now = DWT->CYCCNT;
+    uint32_t cycles = now - loopData.start;
+
+    loopData.start = now;
+    loopData.last = now;
+
+    /* The time up to the first iteration is the initialization */
+    if(!loopData.started)
+    {
+        loopData.started = 1;
+        loop_resetWindow(now);
+        return;
+    }
+
+    if(cycles < loopData.stats.idleCycles)
+    {
+        loopData.stats.idleCycles = cycles;
+    }
+
+    loopData.window.iterations++;
+    if(cycles - loopData.stats.idleCycles < loopData.stats.idleCycles)
+    {
+        loopData.window.idle++;
+    }
+    if(cycles < loopData.window.min)
+    {
+        loopData.window.min = cycles;
+    }
+    if(cycles > loopData.window.max)
+    {
+        loopData.window.max = cycles;
+    }
+
+    cycles = now - loopData.windowStart;
+    if(cycles >= loopData.windowCycles)
+    {
+        loop_closeWindow(now, cycles);
+    }
+}
+
+/**
+ * @brief Measure the call of a handler (see LOOP_MARK())
+ *
+ * @param handler Handler which returned right before
+ */
+void loop_mark(loopHandler_t handler)
+{
+    uint32_t now = DWT->CYCCNT;
+    uint32_t cycles = now - loopData.last;
+
+    loopData.last = now;
+
+    if(cycles > loopData.window.worstCycles)
+    {
+        loopData.window.worstCycles = cycles;
+        loopData.window.worst = handler;
+    }
+}
+
+/**
+ * @brief Copy the record of the last completed window
+ *
+ * The record is written at the main loop, so the copy is consistent when
+ * called from the main loop.
+ */
+void loop_getStats(loopStats_t* stats)
+{
+    *stats = loopData.stats;
+}
+
+/**
+ * @brief Clear the longest call since the last clear
+ *
+ * The idle reference is kept.
+ */
+void loop_clear(void)
+{
+    loopData.stats.peak = 0;
+    loopData.stats.peakCycles = 0;
+}
+
+/**
+ * @brief Name of a handler
+ */
+const char* loop_getName(loopHandler_t handler)
+{
+    return (handler < LOOP_H_COUNT) ? loopNames[handler] : "?";
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Start a new window
+ *
+ * @param now Cycle counter
+ */
+static void loop_resetWindow(uint32_t now)
+{
+    loopData.windowStart = now;
+    loopData.window.iterations = 0;
+    loopData.window.idle = 0;
+    loopData.window.min = UINT32_MAX;
+    loopData.window.max = 0;
+    loopData.window.worstCycles = 0;
+    loopData.window.worst = 0;
+}
+
+/**
+ * @brief Publish the record of the window and start a new window
+ *
+ * @param now Cycle counter
+ * @param cycles Length of the window
+ */
+static void loop_closeWindow(uint32_t now, uint32_t cycles)
+{
+    loopStats_t* stats = &loopData.stats;
+    uint32_t idle;
+
+    stats->windows++;
+    stats->iterations = loopData.window.iterations;
+    stats->idle = loopData.window.idle;
+    stats->min = loopData.window.min;
+    stats->avg = cycles / loopData.window.iterations;
+    stats->max = loopData.window.max;
+    stats->worst = loopData.window.worst;
+    stats->worstCycles = loopData.window.worstCycles;
+
+    if(loopData.window.worstCycles > stats->peakCycles)
+    {
+        stats->peak = loopData.window.worst;
+        stats->peakCycles = loopData.window.worstCycles;
+    }
+
+    /* Every idle iteration lasts at least the reference, the product fits */
+    idle = loopData.window.idle * stats->idleCycles;
+    idle /= cycles / 1000;
+    stats->load = (idle < 1000) ? 1000 - idle : 0;
+
+    loop_resetWindow(now);
+}
+
+#endif /* LOOP_PROFILE */
@@ -60,6 +60,18 @@
 #include "btn.h"
 #include "eeprom.h"
 #include "mlog.h"
+#include "irq.h"
+#include "syscalls.h"
+#include "cli.h"
+#include "proto.h"
+#include "cdc.h"
+#include "bridge.h"
+#include "modbus.h"
+#include "tlm.h"
+#include "io.h"
+#include "trc.h"
+#include "isr.h"
+#include "loop.h"
 /* USER CODE END Includes */
 
 /* Private variables ---------------------------------------------------------*/
@@ -74,6 +86,7 @@ void SystemClock_Config(void);
 
 /* USER CODE BEGIN PFP */
 /* Private function prototypes -----------------------------------------------*/
+static void PVD_Config(void);
 
 /* USER CODE END PFP */
 
@@ -106,6 +119,16 @@ int main(void)
 
   /* USER CODE BEGIN SysInit */
   mInfo("elevator init...\n");
+
+  /* Vector table in RAM to run interrupt handlers from RAM */
+  irq_init();
+
+#ifdef ISR_PROFILE
+  isr_init();
+#endif
+#ifdef LOOP_PROFILE
+  loop_init();
+#endif
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -115,21 +138,84 @@ int main(void)
   MX_USART1_UART_Init();
   MX_USB_DEVICE_Init();
   /* USER CODE BEGIN 2 */
+  /* Only the step interrupt runs from RAM. All other interrupts must not
+   * block it while an instruction fetch from flash is stalled.
+   */
+  HAL_NVIC_SetPriority(TIM3_IRQn, IRQ_PRIO_RAM, 0);
+  HAL_NVIC_SetPriority(SysTick_IRQn, IRQ_PRIO_FLASH, 0);
+  HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, IRQ_PRIO_FLASH, 0);
+  HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, IRQ_PRIO_FLASH, 0);
+  HAL_NVIC_SetPriority(USB_LP_CAN1_RX0_IRQn, IRQ_PRIO_FLASH, 0);
+
+#ifdef IO_RECORD
+  io_recInit();
+#endif
+#ifdef TRC_RECORD
+  trc_init();
+#endif
+
+  cli_init();
+  brg_init();
+  proto_init();
+  tlm_init();
   btn_init();
   ee_init();
   stp_init();
+  mb_init();
   app_init(); /* This must be the last init function call */
+
+  PVD_Config();
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
   while (1)
   {
+	  LOOP_BEGIN();
+
 	  /* Run the application handler */
 	  app_handler();
+	  LOOP_MARK(LOOP_H_APP);
 
 	  /* Stepper motor handler */
 	  stp_handler();
+	  LOOP_MARK(LOOP_H_STP);
+
+	  /* EEPROM emulation background erase and cache flush */
+	  ee_handler();
+	  LOOP_MARK(LOOP_H_EE);
+
+	  /* Write the recorded log messages */
+	  mlog_handler();
+	  LOOP_MARK(LOOP_H_MLOG);
+
+	  /* Send the buffered output to the debugger */
+	  sys_itmHandler();
+	  LOOP_MARK(LOOP_H_ITM);
+
+	  /* Service console */
+	  cli_handler();
+	  LOOP_MARK(LOOP_H_CLI);
+
+	  /* Modbus RTU slave */
+	  mb_handler();
+	  LOOP_MARK(LOOP_H_MB);
+
+	  /* USB to UART bridge */
+	  brg_handler();
+	  LOOP_MARK(LOOP_H_BRG);
+
+	  /* USB CDC protocol */
+	  proto_handler();
+	  LOOP_MARK(LOOP_H_PROTO);
+
+	  /* Motion telemetry */
+	  tlm_handler();
+	  LOOP_MARK(LOOP_H_TLM);
+
+	  /* USB CDC transmit queue */
+	  cdc_handler();
+	  LOOP_MARK(LOOP_H_CDC);
   /* USER CODE END WHILE */
 
   /* USER CODE BEGIN 3 */
@@ -217,6 +303,36 @@ void USB_DEVICE_MasterHardReset(void)
     HAL_GPIO_WritePin(USB_DP_GPIO_Port,USB_DP_Pin,0);
     HAL_Delay(USB_DEVICE_MASTER_HARD_RESET_DELAY);
 }
+
+/**
+ * @brief Configure the programmable voltage detector as power fail warning
+ *
+ * The supply is monitored at 2.9V. A falling supply voltage raises the PVD
+ * output and the write-behind cache of the EEPROM emulation is flushed while
+ * the flash can still be programmed.
+ */
+static void PVD_Config(void)
+{
+    PWR_PVDTypeDef sConfigPVD;
+
+    __HAL_RCC_PWR_CLK_ENABLE();
+
+    sConfigPVD.PVDLevel = PWR_PVDLEVEL_7;
+    sConfigPVD.Mode = PWR_PVD_MODE_IT_RISING;
+    HAL_PWR_ConfigPVD(&sConfigPVD);
+    HAL_PWR_EnablePVD();
+
+    HAL_NVIC_SetPriority(PVD_IRQn, IRQ_PRIO_FLASH, 0);
+    HAL_NVIC_EnableIRQ(PVD_IRQn);
+}
+
+/**
+ * @brief Power fail warning of the programmable voltage detector
+ */
+void HAL_PWR_PVDCallback(void)
+{
+    ee_requestFlush();
+}
 /* USER CODE END 4 */
 
 /**
@@ -0,0 +1,272 @@
+/**
+ * @file mlog.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Deferred logging implementation
+ */
+#include <stdarg.h>
+#include <unistd.h>
+
+#include "stm32f1xx_hal.h"
+#include "mlog.h"
+#include "syscalls.h"
+
+#define MLOG_BUFFER_MASK			(MLOG_BUFFER_WORDS - 1)
+
+#if (MLOG_BUFFER_WORDS & MLOG_BUFFER_MASK) != 0
+#error "MLOG_BUFFER_WORDS must be a power of two"
+#endif
+
+/**
+ * Log data struct type
+ */
+typedef struct mlogData_s {
+    /**
+     * Ring buffer of the log frames
+     */
+    uint32_t buffer[MLOG_BUFFER_WORDS];
+    /**
+     * Free running write and read index
+     */
+    volatile uint16_t head;
+    uint16_t tail;
+    /**
+     * Number of messages dropped since the last output
+     */
+    volatile uint32_t dropped;
+    /**
+     * Total number of dropped messages
+     */
+    uint32_t droppedTotal;
+    /**
+     * Registered outputs of the log frames
+     */
+    mlogSink_t sinks[MLOG_MAX_SINKS];
+} mlogData_t;
+
+/**
+ * Module data
+ */
+static mlogData_t mlogData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void mlog_emit(const uint8_t* data, uint16_t len);
+
+/**
+ * @brief Record a log message into the ring buffer
+ *
+ * This function can be called from interrupts. The message is dropped if the
+ * ring buffer is full.
+ *
+ * @param token Token of the format string
+ * @param nargs Number of the 32 bit arguments
+ */
+void mlog_write(uint16_t token, uint8_t nargs, ...)
+{
+    va_list ap;
+    uint32_t primask;
+    uint16_t head;
+    uint8_t i;
+
+    if(nargs > MLOG_MAX_ARGS)
+    {
+        nargs = MLOG_MAX_ARGS;
+    }
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+
+    head = mlogData.head;
+
+    if((uint16_t)(MLOG_BUFFER_WORDS - (uint16_t)(head - mlogData.tail)) < 2 + nargs)
+    {
+        mlogData.dropped++;
+        __set_PRIMASK(primask);
+        return;
+    }
+
+    mlogData.buffer[head++ & MLOG_BUFFER_MASK] = token | ((uint32_t)nargs << 16) | ((uint32_t)MLOG_FRAME_SYNC << 24);
+    mlogData.buffer[head++ & MLOG_BUFFER_MASK] = HAL_GetTick();
+
+    va_start(ap, nargs);
+    for(i = 0; i < nargs; i++)
+    {
+        mlogData.buffer[head++ & MLOG_BUFFER_MASK] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    mlogData.head = head;
+
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Write the recorded log frames to the output
+ *
+ * Run this handler at the main loop.
+ */
+void mlog_handler(void)
+{
+    uint32_t frame[2 + MLOG_MAX_ARGS];
+    uint32_t primask;
+    uint16_t head;
+    uint16_t end;
+    uint16_t words;
+    uint8_t i;
+
+    /* Report the dropped messages before the next recorded message */
+    if(mlogData.dropped)
+    {
+        primask = __get_PRIMASK();
+        __disable_irq();
+        frame[2] = mlogData.dropped;
+        mlogData.dropped = 0;
+        __set_PRIMASK(primask);
+
+        mlogData.droppedTotal += frame[2];
+
+        frame[0] = MLOG_TOKEN_DROPPED | (1UL << 16) | ((uint32_t)MLOG_FRAME_SYNC << 24);
+        frame[1] = HAL_GetTick();
+        mlog_emit((const uint8_t*)frame, 3 * 4);
+    }
+
+    head = mlogData.head;
+
+    /* The frames are written without copy up to the end of the buffer. A sink
+     * may drop a write, so a write holds whole frames only: the frame which
+     * wraps around is copied.
+     */
+    while(mlogData.tail != head)
+    {
+        end = mlogData.tail;
+        do
+        {
+            words = 2 + ((mlogData.buffer[end & MLOG_BUFFER_MASK] >> 16) & 0xFF);
+            if((end & MLOG_BUFFER_MASK) + words > MLOG_BUFFER_WORDS)
+            {
+                break;
+            }
+            end += words;
+        } while(end != head && (end & MLOG_BUFFER_MASK) != 0);
+
+        if(end != mlogData.tail)
+        {
+            mlog_emit((const uint8_t*)&mlogData.buffer[mlogData.tail & MLOG_BUFFER_MASK],
+                    (uint16_t)(end - mlogData.tail) * 4);
+            mlogData.tail = end;
+            continue;
+        }
+
+        for(i = 0; i < words; i++)
+        {
+            frame[i] = mlogData.buffer[(end + i) & MLOG_BUFFER_MASK];
+        }
+
+        mlog_emit((const uint8_t*)frame, words * 4);
+        mlogData.tail += words;
+    }
+}
+
+/**
+ * @brief Returns the total number of dropped messages
+ */
+uint32_t mlog_getDropped(void)
+{
+    return mlogData.droppedTotal + mlogData.dropped;
+}
+
+/**
+ * @brief Register an output of the log frames
+ *
+ * @param sink Output function
+ *
+ * @return 1 if the sink is registered otherwise 0
+ */
+uint8_t mlog_addSink(mlogSink_t sink)
+{
+    uint8_t i;
+
+    for(i = 0; i < MLOG_MAX_SINKS; i++)
+    {
+        if(mlogData.sinks[i] == sink)
+        {
+            return 1;
+        }
+    }
+
+    for(i = 0; i < MLOG_MAX_SINKS; i++)
+    {
+        if(mlogData.sinks[i] == NULL)
+        {
+            mlogData.sinks[i] = sink;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Remove a registered output of the log frames
+ *
+ * @param sink Output function
+ */
+void mlog_removeSink(mlogSink_t sink)
+{
+    uint8_t i;
+
+    for(i = 0; i < MLOG_MAX_SINKS; i++)
+    {
+        if(mlogData.sinks[i] == sink)
+        {
+            mlogData.sinks[i] = NULL;
+        }
+    }
+}
+
+/**
+ * @brief Write frames to all registered sinks or to mlog_output()
+ *
+ * @param data Frame bytes
+ * @param len Number of bytes
+ */
+static void mlog_emit(const uint8_t* data, uint16_t len)
+{
+    uint8_t i;
+    uint8_t written = 0;
+
+    for(i = 0; i < MLOG_MAX_SINKS; i++)
+    {
+        if(mlogData.sinks[i] != NULL)
+        {
+            mlogData.sinks[i](data, len);
+            written = 1;
+        }
+    }
+
+    if(!written)
+    {
+        mlog_output(data, len);
+    }
+}
+
+/**
+ * @brief Output of the log frames without registered sink
+ *
+ * The default output writes the frames to the buffered ITM output of
+ * syscalls.c. Implement this function outside the module to use another
+ * output.
+ *
+ * @param data Frame bytes
+ * @param len Number of bytes
+ */
+__weak void mlog_output(const uint8_t* data, uint16_t len)
+{
+    _write(STDOUT_FILENO, (char*)data, len);
+}
@@ -0,0 +1,433 @@
+/**
+ * @file modbus.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Modbus RTU slave implementation
+ */
+#include "modbus.h"
+#include "usart.h"
+#include "cli.h"
+#include "app.h"
+#include "stepper.h"
+#include "eeprom.h"
+#include "config.h"
+
+/**
+ * Function codes
+ */
+#define MB_FC_READ_HOLDING          (0x03)
+#define MB_FC_READ_INPUT            (0x04)
+#define MB_FC_WRITE_SINGLE          (0x06)
+#define MB_FC_WRITE_MULTIPLE        (0x10)
+
+/**
+ * Exception codes
+ */
+#define MB_EX_ILLEGAL_FUNCTION      (0x01)
+#define MB_EX_ILLEGAL_ADDRESS       (0x02)
+#define MB_EX_ILLEGAL_VALUE         (0x03)
+#define MB_EX_DEVICE_FAILURE        (0x04)
+#define MB_EX_DEVICE_BUSY           (0x06)
+
+/**
+ * Marker of an exception response at the function code
+ */
+#define MB_EXCEPTION                (0x80)
+
+/**
+ * Maximum number of registers of a read and of a write request
+ */
+#define MB_MAX_READ                 (125)
+#define MB_MAX_WRITE                (123)
+
+/**
+ * Minimum size of a frame (address, function code and crc)
+ */
+#define MB_MIN_FRAME                (4)
+
+/**
+ * Modbus data struct type
+ */
+typedef struct mbData_s {
+    uint8_t address;
+
+    /**
+     * Silent interval in ms which ends a frame
+     */
+    uint32_t t35;
+
+    struct {
+        uint8_t frame[MB_FRAME_SIZE];
+        uint16_t len;
+        uint8_t overrun;
+    } rx;
+
+    uint8_t tx[MB_FRAME_SIZE];
+
+    mbStats_t stats;
+} mbData_t;
+
+/**
+ * Module data
+ */
+static mbData_t mbData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint16_t mb_input(const uint8_t* data, uint16_t len);
+static void mb_frame(void);
+static uint8_t mb_execute(const uint8_t* req, uint16_t len, uint8_t* rsp, uint16_t* rspLen);
+static uint8_t mb_readInput(uint16_t reg, uint16_t* val);
+static uint16_t mb_crc16(const uint8_t* data, uint16_t len);
+
+/**
+ * Basic initialization for the Modbus slave
+ *
+ * A missing address variable keeps the service console, app_init() writes
+ * its default.
+ *
+ * @warning Run ee_init() and cli_init() before you run this function.
+ */
+void mb_init(void)
+{
+    uint16_t address;
+
+    if(ee_readVariable(CFG_MODBUS_ADDR_VADDR, &address) != 0 ||
+            address == MB_ADDR_BROADCAST || address > CFG_MODBUS_ADDR_MAX)
+    {
+        return;
+    }
+
+    mbData.address = address;
+
+    /* 3.5 characters of 11 bits, fixed to 1.75 ms above 19200 baud */
+    if(huart1.Init.BaudRate > 19200)
+    {
+        mbData.t35 = 2;
+    }else
+    {
+        mbData.t35 = (35 * 11 * 1000 / 10 + huart1.Init.BaudRate - 1) / huart1.Init.BaudRate;
+    }
+
+    cli_setRawInput(mb_input);
+}
+
+/**
+ * @brief Process a complete frame
+ *
+ * Run this handler at the main loop.
+ */
+void mb_handler(void)
+{
+    const cliRxEvent_t* event = cli_getRxEvent();
+
+    /* The line is idle since the tick of the interrupt */
+    if(mbData.rx.len != 0 && event->idle && HAL_GetTick() - event->tick > mbData.t35)
+    {
+        mb_frame();
+    }
+}
+
+/**
+ * @brief Copy the statistics of the Modbus slave
+ *
+ * @param stats Destination of the statistics
+ */
+void mb_getStats(mbStats_t* stats)
+{
+    *stats = mbData.stats;
+}
+
+/**
+ * @brief Collect the UART input into a frame
+ *
+ * The silent interval is measured by the ticks of the receive interrupts, so
+ * a late main loop does not join or split the frames.
+ *
+ * @param data Received bytes
+ * @param len Number of bytes
+ *
+ * @return Number of consumed bytes
+ */
+static uint16_t mb_input(const uint8_t* data, uint16_t len)
+{
+    uint16_t i;
+
+    /* The silent interval has passed before the input */
+    if(mbData.rx.len != 0 && cli_getRxEvent()->silence > mbData.t35)
+    {
+        mb_frame();
+    }
+
+    for(i = 0; i < len; i++)
+    {
+        if(mbData.rx.len < MB_FRAME_SIZE)
+        {
+            mbData.rx.frame[mbData.rx.len++] = data[i];
+        }else
+        {
+            mbData.rx.overrun = 1;
+        }
+    }
+
+    return len;
+}
+
+/**
+ * @brief Check the received frame and send the response
+ */
+static void mb_frame(void)
+{
+    const uint8_t* frame = mbData.rx.frame;
+    uint16_t len = mbData.rx.len;
+    uint16_t rspLen;
+    uint16_t crc;
+    uint8_t ex;
+
+    mbData.rx.len = 0;
+
+    if(mbData.rx.overrun)
+    {
+        mbData.rx.overrun = 0;
+        mbData.stats.overruns++;
+        return;
+    }
+
+    if(len < MB_MIN_FRAME)
+    {
+        return;
+    }
+
+    /* The crc is sent low byte first */
+    if(mb_crc16(frame, len - 2) != (frame[len - 2] | ((uint16_t)frame[len - 1] << 8)))
+    {
+        mbData.stats.crcErrors++;
+        return;
+    }
+
+    if(frame[0] != mbData.address && frame[0] != MB_ADDR_BROADCAST)
+    {
+        return;
+    }
+
+    mbData.stats.frames++;
+
+    mbData.tx[0] = mbData.address;
+    mbData.tx[1] = frame[1];
+    rspLen = 2;
+
+    if((ex = mb_execute(&frame[1], len - 3, mbData.tx, &rspLen)) != 0)
+    {
+        mbData.tx[1] = frame[1] | MB_EXCEPTION;
+        mbData.tx[2] = ex;
+        rspLen = 3;
+        mbData.stats.exceptions++;
+    }
+
+    if(frame[0] == MB_ADDR_BROADCAST)
+    {
+        return;
+    }
+
+    crc = mb_crc16(mbData.tx, rspLen);
+    mbData.tx[rspLen++] = crc & 0xFF;
+    mbData.tx[rspLen++] = crc >> 8;
+
+    cli_write(mbData.tx, rspLen);
+}
+
+/**
+ * @brief Run a request
+ *
+ * @param req PDU of the request (function code and data)
+ * @param len PDU length
+ * @param rsp Response, address and function code are set
+ * @param rspLen Length of the response
+ *
+ * @return 0 or the exception code
+ */
+static uint8_t mb_execute(const uint8_t* req, uint16_t len, uint8_t* rsp, uint16_t* rspLen)
+{
+    uint16_t reg;
+    uint16_t cnt;
+    uint16_t val;
+    uint16_t i;
+    uint16_t status;
+    eeVar_t vars[NumbOfVar];
+
+    if(req[0] != MB_FC_READ_HOLDING && req[0] != MB_FC_READ_INPUT &&
+            req[0] != MB_FC_WRITE_SINGLE && req[0] != MB_FC_WRITE_MULTIPLE)
+    {
+        return MB_EX_ILLEGAL_FUNCTION;
+    }
+
+    if(len < 5)
+    {
+        return MB_EX_ILLEGAL_VALUE;
+    }
+
+    /* Register numbers and values are big endian */
+    reg = ((uint16_t)req[1] << 8) | req[2];
+    cnt = ((uint16_t)req[3] << 8) | req[4];
+
+    switch(req[0])
+    {
+    case MB_FC_READ_HOLDING:
+    case MB_FC_READ_INPUT:
+        if(cnt == 0 || cnt > MB_MAX_READ)
+        {
+            return MB_EX_ILLEGAL_VALUE;
+        }
+        if(reg + cnt > (req[0] == MB_FC_READ_HOLDING ? NumbOfVar : MB_IREG_COUNT))
+        {
+            return MB_EX_ILLEGAL_ADDRESS;
+        }
+
+        rsp[(*rspLen)++] = cnt * 2;
+        for(i = reg; i < reg + cnt; i++)
+        {
+            if(req[0] == MB_FC_READ_HOLDING ?
+                    ee_readVariable(VirtAddVarTab[i], &val) != 0 :
+                    mb_readInput(i, &val) != 0)
+            {
+                return MB_EX_DEVICE_FAILURE;
+            }
+            rsp[(*rspLen)++] = val >> 8;
+            rsp[(*rspLen)++] = val & 0xFF;
+        }
+        break;
+
+    case MB_FC_WRITE_SINGLE:
+        if(reg >= NumbOfVar)
+        {
+            return MB_EX_ILLEGAL_ADDRESS;
+        }
+        if(!cfg_isValid(VirtAddVarTab[reg], cnt))
+        {
+            return MB_EX_ILLEGAL_VALUE;
+        }
+        if((status = ee_writeVariable(VirtAddVarTab[reg], cnt)) != HAL_OK)
+        {
+            return (status == HAL_BUSY) ? MB_EX_DEVICE_BUSY : MB_EX_DEVICE_FAILURE;
+        }
+
+        /* Echo of the request */
+        for(i = 1; i < 5; i++)
+        {
+            rsp[(*rspLen)++] = req[i];
+        }
+        break;
+
+    case MB_FC_WRITE_MULTIPLE:
+        if(cnt == 0 || cnt > MB_MAX_WRITE || len != 6 + cnt * 2 || req[5] != cnt * 2)
+        {
+            return MB_EX_ILLEGAL_VALUE;
+        }
+        if(reg + cnt > NumbOfVar)
+        {
+            return MB_EX_ILLEGAL_ADDRESS;
+        }
+
+        /* All registers are written in one transaction */
+        for(i = 0; i < cnt; i++)
+        {
+            vars[i].virtAddress = VirtAddVarTab[reg + i];
+            vars[i].data = ((uint16_t)req[6 + i * 2] << 8) | req[7 + i * 2];
+            if(!cfg_isValid(vars[i].virtAddress, vars[i].data))
+            {
+                return MB_EX_ILLEGAL_VALUE;
+            }
+        }
+        if((status = ee_writeVariables(vars, cnt)) != HAL_OK)
+        {
+            return (status == HAL_BUSY) ? MB_EX_DEVICE_BUSY : MB_EX_DEVICE_FAILURE;
+        }
+
+        for(i = 1; i < 5; i++)
+        {
+            rsp[(*rspLen)++] = req[i];
+        }
+        break;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Read an input register
+ *
+ * @param reg Register number
+ * @param val Value
+ *
+ * @return 0 on success
+ */
+static uint8_t mb_readInput(uint16_t reg, uint16_t* val)
+{
+    uint32_t uptime = HAL_GetTick() / 1000;
+
+    switch(reg)
+    {
+    case MB_IREG_APP_STATE:
+        *val = app_getState();
+        break;
+
+    case MB_IREG_FLOOR:
+        *val = app_getFloor();
+        break;
+
+    case MB_IREG_STP_STATE:
+        *val = stp_getState();
+        break;
+
+    case MB_IREG_TRIPS:
+        *val = app_getTrips();
+        break;
+
+    case MB_IREG_UPTIME_HIGH:
+        *val = uptime >> 16;
+        break;
+
+    case MB_IREG_UPTIME_LOW:
+        *val = uptime & 0xFFFF;
+        break;
+
+    case MB_IREG_EE_DIRTY:
+        *val = ee_getDirtyCount();
+        break;
+
+    default:
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Calculate the CRC-16/MODBUS
+ *
+ * @param data Data
+ * @param len Number of bytes
+ *
+ * @return CRC
+ */
+static uint16_t mb_crc16(const uint8_t* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    while(len--)
+    {
+        crc ^= *data++;
+        for(i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+    }
+
+    return crc;
+}
@@ -0,0 +1,324 @@
+/**
+ * @file mtr.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Registry of the operational metrics implementation
+ */
+#include <string.h>
+
+#include "mtr.h"
+
+/**
+ * Description of a counter. Counters of the same name must follow each other,
+ * they are one metric with different labels.
+ */
+typedef struct mtrCounterInfo_s {
+    const char* name;
+    const char* labels;     /* Without braces, NULL without labels */
+    const char* help;
+} mtrCounterInfo_t;
+
+/**
+ * Description of a histogram
+ */
+typedef struct mtrHistInfo_s {
+    const char* name;
+    const char* help;
+    uint8_t shift;          /* Upper bound of the first bucket 2 ^ shift */
+} mtrHistInfo_t;
+
+/**
+ * Metrics data struct type
+ */
+typedef struct mtrData_s {
+    volatile uint32_t counters[MTR_COUNTER_COUNT];
+
+    struct {
+        volatile uint32_t buckets[MTR_HIST_BUCKETS + 1];
+        volatile uint32_t sum;
+    } hist[MTR_HIST_COUNT];
+} mtrData_t;
+
+/**
+ * Module data
+ */
+static mtrData_t mtrData;
+
+/**
+ * Registered counters
+ */
+static const mtrCounterInfo_t mtrCounters[MTR_COUNTER_COUNT] = {
+        [MTR_TRIPS_FLOOR0]      = { "elevator_trips_total", "floor=\"0\"", "Drives by destination floor" },
+        [MTR_TRIPS_FLOOR1]      = { "elevator_trips_total", "floor=\"1\"", "Drives by destination floor" },
+        [MTR_TRIPS_FLOOR2]      = { "elevator_trips_total", "floor=\"2\"", "Drives by destination floor" },
+        [MTR_DRIVE_TIMEOUTS]    = { "elevator_drive_timeouts_total", NULL, "Drives up stopped by the timeout" },
+        [MTR_DRIVE_SW2_STOPS]   = { "elevator_drive_sw2_stops_total", NULL, "Drives up stopped by the idle position switch" },
+        [MTR_DRIVE_NOT_ARRIVED] = { "elevator_drive_not_arrived_total", NULL, "Drives up which did not arrive the idle position" },
+        [MTR_BUTTON_PRESSES]    = { "elevator_button_presses_total", NULL, "Debounced presses of the button" },
+        [MTR_STORE_ERRORS]      = { "elevator_store_errors_total", NULL, "Failed writes of the trip count or the floors" },
+        [MTR_EE_PAGE_TRANSFERS] = { "ee_page_transfers_total", NULL, "Flash pages transferred to the head page" },
+        [MTR_EE_VAR_COPIES]     = { "ee_variable_copies_total", NULL, "Variables copied by the page transfers" },
+        [MTR_EE_PAGE_ERASES]    = { "ee_page_erases_total", NULL, "Erased flash pages" },
+};
+
+/**
+ * Registered histograms
+ */
+static const mtrHistInfo_t mtrHists[MTR_HIST_COUNT] = {
+        [MTR_DRIVE_MS]          = { "elevator_drive_ms", "Duration of the drives in ms", 9 },
+};
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t mtr_formatCounter(mtrCursor_t* cursor, char* line);
+static uint8_t mtr_formatHist(mtrCursor_t* cursor, char* line);
+static uint8_t mtr_append(char* line, uint8_t len, const char* str);
+static uint8_t mtr_appendNum(char* line, uint8_t len, uint32_t val);
+static uint8_t mtr_formatHeader(char* line, const char* name, const char* help, uint8_t type);
+
+/**
+ * @brief Increment a counter
+ */
+void mtr_inc(mtrCounter_t counter)
+{
+    __atomic_fetch_add(&mtrData.counters[counter], 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Add a value to a counter
+ */
+void mtr_add(mtrCounter_t counter, uint32_t val)
+{
+    __atomic_fetch_add(&mtrData.counters[counter], val, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Record a value at a histogram
+ */
+void mtr_observe(mtrHistogram_t histogram, uint32_t val)
+{
+    uint8_t shift = mtrHists[histogram].shift;
+    uint32_t bucket = 0;
+
+    /* Smallest bucket with val <= 2 ^ (shift + bucket), no library call */
+    if(val > (1UL << shift))
+    {
+        bucket = 32 - __builtin_clz(val - 1) - shift;
+        if(bucket > MTR_HIST_BUCKETS)
+        {
+            bucket = MTR_HIST_BUCKETS;
+        }
+    }
+
+    __atomic_fetch_add(&mtrData.hist[histogram].buckets[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&mtrData.hist[histogram].sum, val, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Returns the value of a counter
+ */
+uint32_t mtr_get(mtrCounter_t counter)
+{
+    return mtrData.counters[counter];
+}
+
+/**
+ * @brief Start a dump at the first line
+ *
+ * @param cursor Position of the dump
+ */
+void mtr_formatStart(mtrCursor_t* cursor)
+{
+    memset(cursor, 0, sizeof(*cursor));
+}
+
+/**
+ * @brief Format the next line of a dump
+ *
+ * @param cursor Position of the dump
+ * @param line Destination of MTR_LINE_SIZE bytes, the line ends with '\n'
+ * and is not terminated
+ *
+ * @return Length of the line or 0 at the end of the dump
+ */
+uint8_t mtr_formatLine(mtrCursor_t* cursor, char* line)
+{
+    if(cursor->metric < MTR_COUNTER_COUNT)
+    {
+        return mtr_formatCounter(cursor, line);
+    }
+
+    if(cursor->metric < MTR_COUNTER_COUNT + MTR_HIST_COUNT)
+    {
+        return mtr_formatHist(cursor, line);
+    }
+
+    return 0;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Format the next line of a counter
+ *
+ * @return Length of the line
+ */
+static uint8_t mtr_formatCounter(mtrCursor_t* cursor, char* line)
+{
+    const mtrCounterInfo_t* info = &mtrCounters[cursor->metric];
+    uint8_t first;
+    uint8_t len;
+
+    /* The header only at the first counter of a name */
+    first = (cursor->metric == 0 || strcmp(info->name, mtrCounters[cursor->metric - 1].name) != 0);
+
+    if(cursor->line == 0)
+    {
+        cursor->line = first ? 1 : 2;
+        if(first)
+        {
+            return mtr_formatHeader(line, info->name, info->help, 0);
+        }
+    }else if(cursor->line == 1)
+    {
+        cursor->line = 2;
+        return mtr_formatHeader(line, info->name, "counter", 1);
+    }
+
+    cursor->metric++;
+    cursor->line = 0;
+
+    len = mtr_append(line, 0, info->name);
+    if(info->labels)
+    {
+        len = mtr_append(line, len, "{");
+        len = mtr_append(line, len, info->labels);
+        len = mtr_append(line, len, "}");
+    }
+    len = mtr_append(line, len, " ");
+    len = mtr_appendNum(line, len, mtrData.counters[cursor->metric - 1]);
+
+    return mtr_append(line, len, "\n");
+}
+
+/**
+ * @brief Format the next line of a histogram
+ *
+ * @return Length of the line
+ */
+static uint8_t mtr_formatHist(mtrCursor_t* cursor, char* line)
+{
+    uint8_t histogram = cursor->metric - MTR_COUNTER_COUNT;
+    const mtrHistInfo_t* info = &mtrHists[histogram];
+    uint32_t cum = 0;
+    uint8_t bucket;
+    uint8_t len;
+    uint8_t i;
+
+    switch(cursor->line++)
+    {
+    case 0:
+        for(i = 0; i <= MTR_HIST_BUCKETS; i++)
+        {
+            cum += mtrData.hist[histogram].buckets[i];
+            cursor->buckets[i] = cum;
+        }
+        cursor->sum = mtrData.hist[histogram].sum;
+
+        return mtr_formatHeader(line, info->name, info->help, 0);
+
+    case 1:
+        return mtr_formatHeader(line, info->name, "histogram", 1);
+
+    default:
+        break;
+    }
+
+    bucket = cursor->line - 3;
+    len = mtr_append(line, 0, info->name);
+
+    if(bucket <= MTR_HIST_BUCKETS)
+    {
+        len = mtr_append(line, len, "_bucket{le=\"");
+        if(bucket < MTR_HIST_BUCKETS)
+        {
+            len = mtr_appendNum(line, len, 1UL << (info->shift + bucket));
+        }else
+        {
+            len = mtr_append(line, len, "+Inf");
+        }
+        len = mtr_append(line, len, "\"} ");
+        len = mtr_appendNum(line, len, cursor->buckets[bucket]);
+    }else if(bucket == MTR_HIST_BUCKETS + 1)
+    {
+        len = mtr_append(line, len, "_sum ");
+        len = mtr_appendNum(line, len, cursor->sum);
+    }else
+    {
+        len = mtr_append(line, len, "_count ");
+        len = mtr_appendNum(line, len, cursor->buckets[MTR_HIST_BUCKETS]);
+
+        cursor->metric++;
+        cursor->line = 0;
+    }
+
+    return mtr_append(line, len, "\n");
+}
+
+/**
+ * @brief Format the HELP or TYPE line of a metric
+ *
+ * @param text Help text or type
+ * @param type 0 HELP, 1 TYPE
+ */
+static uint8_t mtr_formatHeader(char* line, const char* name, const char* text, uint8_t type)
+{
+    uint8_t len;
+
+    len = mtr_append(line, 0, type ? "# TYPE " : "# HELP ");
+    len = mtr_append(line, len, name);
+    len = mtr_append(line, len, " ");
+    len = mtr_append(line, len, text);
+
+    return mtr_append(line, len, "\n");
+}
+
+/**
+ * @brief Append a string to a line, cut at MTR_LINE_SIZE
+ *
+ * @return New length of the line
+ */
+static uint8_t mtr_append(char* line, uint8_t len, const char* str)
+{
+    while(*str && len < MTR_LINE_SIZE)
+    {
+        line[len++] = *str++;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Append a decimal number to a line
+ *
+ * @return New length of the line
+ */
+static uint8_t mtr_appendNum(char* line, uint8_t len, uint32_t val)
+{
+    char buf[11];
+    uint8_t i = sizeof(buf) - 1;
+
+    buf[i] = '\0';
+    do
+    {
+        buf[--i] = '0' + val % 10;
+        val /= 10;
+    }while(val);
+
+    return mtr_append(line, len, &buf[i]);
+}
@@ -0,0 +1,697 @@
+/**
+ * @file proto.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Framed binary protocol implementation
+ */
+#include <string.h>
+
+#include "proto.h"
+#include "cdc.h"
+#include "eeprom.h"
+#include "config.h"
+#include "stepper.h"
+#include "app.h"
+#include "mlog.h"
+#include "tlm.h"
+#include "bridge.h"
+#include "version.h"
+#include "trc.h"
+#include "isr.h"
+#include "loop.h"
+#include "mtr.h"
+
+/**
+ * Maximum size of a COBS encoded frame (without the delimiter)
+ */
+#define PROTO_ENCODED_SIZE          (PROTO_FRAME_SIZE + PROTO_FRAME_SIZE / 254 + 1)
+
+/**
+ * Size of the frame header (cmd, seq) and the crc
+ */
+#define PROTO_HEADER_SIZE           (2)
+#define PROTO_CRC_SIZE              (2)
+
+/**
+ * Maximum payload of a frame
+ */
+#define PROTO_PAYLOAD_SIZE          (PROTO_FRAME_SIZE - PROTO_HEADER_SIZE - PROTO_CRC_SIZE)
+
+/* Status, count, lost and the entries of 8 bytes */
+#if 1 + 2 + 4 + PROTO_TRACE_ENTRIES * 8 > PROTO_PAYLOAD_SIZE
+#error "PROTO_TRACE_ENTRIES do not fit into a frame"
+#endif
+
+/* Status, count, min, max, avg and the histogram */
+#if 1 + 4 * 4 + ISR_HIST_BINS * 4 > PROTO_PAYLOAD_SIZE
+#error "ISR_HIST_BINS do not fit into a frame"
+#endif
+
+/* Status and the record */
+#if 1 + 40 > PROTO_PAYLOAD_SIZE
+#error "loopStats_t does not fit into a frame"
+#endif
+
+/**
+ * Protocol data struct type
+ */
+typedef struct protoData_s {
+    struct {
+        /**
+         * Encoded frame until the next delimiter
+         */
+        uint8_t frame[PROTO_ENCODED_SIZE];
+        uint8_t frameLen;
+        uint8_t frameOverflow;
+    } rx;
+
+    /**
+     * Sequence number of the unsolicited log frames
+     */
+    uint8_t logSeq;
+
+    /**
+     * Dump of the metrics in progress, the line is sent in chunks
+     */
+    struct {
+        uint8_t active;
+        uint8_t seq;
+        uint8_t lineLen;
+        uint8_t linePos;
+        char line[MTR_LINE_SIZE];
+        mtrCursor_t cursor;
+    } metrics;
+
+    protoStats_t stats;
+} protoData_t;
+
+/**
+ * Module data
+ */
+static protoData_t protoData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void proto_rxByte(uint8_t c);
+static void proto_dispatch(const uint8_t* frame, uint8_t len);
+static void proto_send(uint8_t cmd, uint8_t seq, const uint8_t* payload, uint8_t len);
+static void proto_logOutput(const uint8_t* data, uint16_t len);
+static void proto_sendMetrics(void);
+static uint16_t proto_crc16(const uint8_t* data, uint16_t len);
+static uint8_t proto_cobsEncode(const uint8_t* in, uint8_t len, uint8_t* out);
+static uint8_t proto_cobsDecode(const uint8_t* in, uint8_t len, uint8_t* out);
+static uint8_t proto_isVariable(uint16_t virtAddress);
+
+/**
+ * Basic initialization for the protocol
+ */
+void proto_init(void)
+{
+    memset(&protoData, 0, sizeof(protoData));
+}
+
+/**
+ * @brief Process the received frames and send the responses
+ *
+ * Run this handler at the main loop.
+ */
+void proto_handler(void)
+{
+    const uint8_t* packet;
+    uint16_t len;
+    uint16_t i;
+
+    /* The packets are read in place from the receive slots. The data belongs
+     * to the UART while the bridge is running.
+     */
+    while(!brg_isEnabled() && (packet = cdc_rxPeek(&len)) != NULL)
+    {
+        for(i = 0; i < len; i++)
+        {
+            proto_rxByte(packet[i]);
+        }
+        cdc_rxRelease();
+    }
+
+    proto_sendMetrics();
+}
+
+/**
+ * @brief Copy the statistics of the protocol
+ *
+ * @param stats Destination of the statistics
+ */
+void proto_getStats(protoStats_t* stats)
+{
+    *stats = protoData.stats;
+}
+
+/**
+ * @brief Add a received byte to the encoded frame
+ *
+ * @param c Received byte
+ */
+static void proto_rxByte(uint8_t c)
+{
+    uint8_t frame[PROTO_FRAME_SIZE];
+    uint8_t len;
+
+    if(c != 0)
+    {
+        if(protoData.rx.frameLen < sizeof(protoData.rx.frame))
+        {
+            protoData.rx.frame[protoData.rx.frameLen++] = c;
+        }else
+        {
+            protoData.rx.frameOverflow = 1;
+        }
+        return;
+    }
+
+    /* Frame delimiter */
+    if(protoData.rx.frameOverflow)
+    {
+        protoData.stats.framingErrors++;
+    }else if(protoData.rx.frameLen > 0)
+    {
+        len = proto_cobsDecode(protoData.rx.frame, protoData.rx.frameLen, frame);
+
+        if(len < PROTO_HEADER_SIZE + PROTO_CRC_SIZE)
+        {
+            protoData.stats.framingErrors++;
+        }else if(proto_crc16(frame, len - PROTO_CRC_SIZE) !=
+                (frame[len - 2] | ((uint16_t)frame[len - 1] << 8)))
+        {
+            protoData.stats.crcErrors++;
+        }else
+        {
+            protoData.stats.frames++;
+            proto_dispatch(frame, len - PROTO_CRC_SIZE);
+        }
+    }
+
+    protoData.rx.frameLen = 0;
+    protoData.rx.frameOverflow = 0;
+}
+
+/**
+ * @brief Run a command and send the response
+ *
+ * @param frame Decoded frame without crc
+ * @param len Frame length
+ */
+static void proto_dispatch(const uint8_t* frame, uint8_t len)
+{
+    uint8_t rsp[PROTO_PAYLOAD_SIZE];
+    uint8_t rspLen = 1;
+    const uint8_t* p = &frame[PROTO_HEADER_SIZE];
+    uint8_t pLen = len - PROTO_HEADER_SIZE;
+    uint16_t virtAddress;
+    uint16_t data;
+    uint16_t status;
+    uint32_t val;
+    eeStats_t ee;
+#ifdef TRC_RECORD
+    uint16_t index;
+    uint16_t count;
+#endif
+#ifdef ISR_PROFILE
+    isrStats_t isr;
+#endif
+#ifdef LOOP_PROFILE
+    loopStats_t loop;
+#endif
+
+    rsp[0] = PROTO_STATUS_OK;
+
+    switch(frame[0])
+    {
+    case PROTO_CMD_PING:
+        val = APP_VERSION;
+        memcpy(&rsp[rspLen], &val, 4);
+        rspLen += 4;
+        break;
+
+    case PROTO_CMD_CFG_GET:
+        if(pLen != 2)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        virtAddress = p[0] | ((uint16_t)p[1] << 8);
+        if(!proto_isVariable(virtAddress))
+        {
+            rsp[0] = PROTO_STATUS_INVALID;
+        }else if(ee_readVariable(virtAddress, &data) != 0)
+        {
+            rsp[0] = PROTO_STATUS_ERROR;
+        }else
+        {
+            rsp[rspLen++] = data & 0xFF;
+            rsp[rspLen++] = data >> 8;
+        }
+        break;
+
+    case PROTO_CMD_CFG_SET:
+        if(pLen != 4)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        virtAddress = p[0] | ((uint16_t)p[1] << 8);
+        data = p[2] | ((uint16_t)p[3] << 8);
+        if(!cfg_isValid(virtAddress, data))
+        {
+            rsp[0] = PROTO_STATUS_INVALID;
+        }else if((status = ee_writeVariable(virtAddress, data)) != HAL_OK)
+        {
+            rsp[0] = (status == HAL_BUSY) ? PROTO_STATUS_BUSY : PROTO_STATUS_ERROR;
+        }
+        break;
+
+    case PROTO_CMD_MOVE:
+        if(pLen != 5)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        memcpy(&val, &p[1], 4);
+        if(p[0] > 1 || val == 0)
+        {
+            rsp[0] = PROTO_STATUS_INVALID;
+        }else if(app_requServiceMove(p[0] == 0 ? STP_CMD_DRIVE_UP : STP_CMD_DRIVE_DOWN, val) != HAL_OK)
+        {
+            rsp[0] = PROTO_STATUS_BUSY;
+        }
+        break;
+
+    case PROTO_CMD_STOP:
+        if(app_requStop() != HAL_OK)
+        {
+            rsp[0] = PROTO_STATUS_BUSY;
+        }
+        break;
+
+    case PROTO_CMD_STATUS:
+        ee_getStats(&ee);
+
+        val = HAL_GetTick();
+        memcpy(&rsp[rspLen], &val, 4);
+        rspLen += 4;
+        rsp[rspLen++] = stp_getState();
+        rsp[rspLen++] = ee_getDirtyCount();
+        memcpy(&rsp[rspLen], &ee.writes, 4);
+        rspLen += 4;
+        memcpy(&rsp[rspLen], &ee.erases, 4);
+        rspLen += 4;
+        val = mlog_getDropped();
+        memcpy(&rsp[rspLen], &val, 4);
+        rspLen += 4;
+        break;
+
+    case PROTO_CMD_LOG:
+        if(pLen != 1)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+        }else if(p[0])
+        {
+            if(!mlog_addSink(proto_logOutput))
+            {
+                rsp[0] = PROTO_STATUS_ERROR;
+            }
+        }else
+        {
+            mlog_removeSink(proto_logOutput);
+        }
+        break;
+
+    case PROTO_CMD_TELEMETRY:
+        if(pLen != 1)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+        }else if(p[0])
+        {
+            tlm_start(p[0]);
+        }else
+        {
+            tlm_stop();
+        }
+        break;
+
+    case PROTO_CMD_BRIDGE:
+        if(pLen != 0)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        /* No other output may follow the response */
+        protoData.metrics.active = 0;
+        tlm_stop();
+        mlog_removeSink(proto_logOutput);
+        brg_enable();
+        break;
+
+    case PROTO_CMD_METRICS:
+        if(pLen != 0)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        /* A dump in progress starts again */
+        mtr_formatStart(&protoData.metrics.cursor);
+        protoData.metrics.lineLen = 0;
+        protoData.metrics.linePos = 0;
+        protoData.metrics.active = 1;
+        break;
+
+#ifdef TRC_RECORD
+    case PROTO_CMD_TRACE:
+        if(pLen != 2)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        index = p[0] | ((uint16_t)p[1] << 8);
+        count = trc_getCount();
+        memcpy(&rsp[rspLen], &count, 2);
+        rspLen += 2;
+        val = trc_getLost();
+        memcpy(&rsp[rspLen], &val, 4);
+        rspLen += 4;
+
+        /* The trace only grows, the entries up to count are final */
+        if(index < count)
+        {
+            count = (count - index < PROTO_TRACE_ENTRIES) ? count - index : PROTO_TRACE_ENTRIES;
+            memcpy(&rsp[rspLen], &trc_getEntries()[index], count * sizeof(trcEntry_t));
+            rspLen += count * sizeof(trcEntry_t);
+        }
+        break;
+#endif /* TRC_RECORD */
+
+#ifdef ISR_PROFILE
+    case PROTO_CMD_ISR:
+        if(pLen != 2)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+        if(p[0] >= ISR_SRC_COUNT)
+        {
+            rsp[0] = PROTO_STATUS_INVALID;
+            break;
+        }
+
+        isr_getStats(p[0], &isr);
+        if(p[1])
+        {
+            isr_clear(p[0]);
+        }
+
+        memcpy(&rsp[rspLen], &isr.count, 4);
+        rspLen += 4;
+        memcpy(&rsp[rspLen], &isr.min, 4);
+        rspLen += 4;
+        memcpy(&rsp[rspLen], &isr.max, 4);
+        rspLen += 4;
+        val = isr.count ? (uint32_t)(isr.sum / isr.count) : 0;
+        memcpy(&rsp[rspLen], &val, 4);
+        rspLen += 4;
+        memcpy(&rsp[rspLen], isr.hist, sizeof(isr.hist));
+        rspLen += sizeof(isr.hist);
+        break;
+#endif /* ISR_PROFILE */
+
+#ifdef LOOP_PROFILE
+    case PROTO_CMD_LOOP:
+        if(pLen != 1)
+        {
+            rsp[0] = PROTO_STATUS_LENGTH;
+            break;
+        }
+
+        loop_getStats(&loop);
+        if(p[0])
+        {
+            loop_clear();
+        }
+
+        memcpy(&rsp[rspLen], &loop, sizeof(loop));
+        rspLen += sizeof(loop);
+        break;
+#endif /* LOOP_PROFILE */
+
+    default:
+        rsp[0] = PROTO_STATUS_UNKNOWN;
+        break;
+    }
+
+    proto_send(frame[0] | PROTO_RESPONSE, frame[1], rsp, rspLen);
+}
+
+/**
+ * @brief Encode a frame into the transmit queue of the CDC interface
+ *
+ * The frame is dropped if it does not fit into the queue.
+ *
+ * @param cmd Command
+ * @param seq Sequence number
+ * @param payload Payload
+ * @param len Payload length (max. PROTO_PAYLOAD_SIZE)
+ */
+static void proto_send(uint8_t cmd, uint8_t seq, const uint8_t* payload, uint8_t len)
+{
+    uint8_t frame[PROTO_FRAME_SIZE];
+    uint8_t encoded[PROTO_ENCODED_SIZE + 1];
+    uint16_t crc;
+    uint8_t encLen;
+
+    frame[0] = cmd;
+    frame[1] = seq;
+    memcpy(&frame[PROTO_HEADER_SIZE], payload, len);
+    len += PROTO_HEADER_SIZE;
+
+    crc = proto_crc16(frame, len);
+    frame[len++] = crc & 0xFF;
+    frame[len++] = crc >> 8;
+
+    encLen = proto_cobsEncode(frame, len, encoded);
+    encoded[encLen++] = 0;
+
+    if(cdc_write(encoded, encLen) == 0)
+    {
+        protoData.stats.txDropped++;
+    }
+}
+
+/**
+ * @brief Output of the deferred log frames as unsolicited protocol frames
+ *
+ * @param data Frame bytes
+ * @param len Number of bytes
+ */
+static void proto_logOutput(const uint8_t* data, uint16_t len)
+{
+    uint8_t chunk;
+
+    while(len)
+    {
+        chunk = (len > PROTO_PAYLOAD_SIZE) ? PROTO_PAYLOAD_SIZE : len;
+
+        proto_send(PROTO_CMD_LOG_DATA, protoData.logSeq++, data, chunk);
+
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+/**
+ * @brief Send the next chunks of the metrics dump
+ *
+ * A chunk is only formatted if its frame fits into the transmit queue, so no
+ * part of the dump is dropped. The host finds a lost frame by the sequence
+ * number anyway.
+ */
+static void proto_sendMetrics(void)
+{
+    uint8_t chunk[PROTO_PAYLOAD_SIZE];
+    uint8_t len;
+    uint8_t n;
+
+    if(protoData.metrics.active && (!cdc_isConfigured() || brg_isEnabled()))
+    {
+        protoData.metrics.active = 0;
+    }
+
+    while(protoData.metrics.active && cdc_txFree() >= PROTO_ENCODED_SIZE + 1)
+    {
+        len = 0;
+        while(len < sizeof(chunk))
+        {
+            if(protoData.metrics.linePos == protoData.metrics.lineLen)
+            {
+                protoData.metrics.lineLen = mtr_formatLine(&protoData.metrics.cursor,
+                        protoData.metrics.line);
+                protoData.metrics.linePos = 0;
+
+                if(protoData.metrics.lineLen == 0)
+                {
+                    break;
+                }
+            }
+
+            n = protoData.metrics.lineLen - protoData.metrics.linePos;
+            n = (n < sizeof(chunk) - len) ? n : sizeof(chunk) - len;
+            memcpy(&chunk[len], &protoData.metrics.line[protoData.metrics.linePos], n);
+            protoData.metrics.linePos += n;
+            len += n;
+        }
+
+        proto_send(PROTO_CMD_METRICS_DATA, protoData.metrics.seq++, chunk, len);
+
+        /* The empty frame ends the dump */
+        if(len == 0)
+        {
+            protoData.metrics.active = 0;
+        }
+    }
+}
+
+/**
+ * @brief Calculate the CRC-16/CCITT-FALSE
+ *
+ * @param data Data
+ * @param len Number of bytes
+ *
+ * @return CRC
+ */
+static uint16_t proto_crc16(const uint8_t* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    while(len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for(i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief COBS encode a frame (without delimiter)
+ *
+ * @param in Frame
+ * @param len Frame length
+ * @param out Encoded frame, at least len + len / 254 + 1 bytes
+ *
+ * @return Length of the encoded frame
+ */
+static uint8_t proto_cobsEncode(const uint8_t* in, uint8_t len, uint8_t* out)
+{
+    uint8_t code = 1;
+    uint8_t codePos = 0;
+    uint8_t outLen = 1;
+
+    while(len--)
+    {
+        if(*in != 0)
+        {
+            out[outLen++] = *in;
+            code++;
+        }
+
+        if(*in++ == 0 || code == 0xFF)
+        {
+            out[codePos] = code;
+            code = 1;
+            codePos = outLen++;
+        }
+    }
+
+    out[codePos] = code;
+
+    return outLen;
+}
+
+/**
+ * @brief COBS decode a frame (without delimiter)
+ *
+ * @param in Encoded frame
+ * @param len Encoded frame length
+ * @param out Decoded frame, at least PROTO_FRAME_SIZE bytes
+ *
+ * @return Length of the decoded frame or 0 on error
+ */
+static uint8_t proto_cobsDecode(const uint8_t* in, uint8_t len, uint8_t* out)
+{
+    uint8_t inPos = 0;
+    uint8_t outLen = 0;
+    uint8_t code;
+    uint8_t i;
+
+    while(inPos < len)
+    {
+        code = in[inPos++];
+
+        if(code == 0 || inPos + code - 1 > len)
+        {
+            return 0;
+        }
+
+        for(i = 1; i < code; i++)
+        {
+            if(outLen >= PROTO_FRAME_SIZE)
+            {
+                return 0;
+            }
+            out[outLen++] = in[inPos++];
+        }
+
+        if(code != 0xFF && inPos < len)
+        {
+            if(outLen >= PROTO_FRAME_SIZE)
+            {
+                return 0;
+            }
+            out[outLen++] = 0;
+        }
+    }
+
+    return outLen;
+}
+
+/**
+ * @brief Check if a virtual address is a configuration variable
+ *
+ * @param virtAddress Virtual address
+ */
+static uint8_t proto_isVariable(uint16_t virtAddress)
+{
+    uint16_t i;
+
+    for(i = 0; VirtAddVarTab[i] != 0; i++)
+    {
+        if(VirtAddVarTab[i] == virtAddress)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
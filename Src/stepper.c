@@ -14,6 +14,8 @@
 #include "tim.h"
 #include "time.h"
 #include "io.h"
+#include "irq.h"
+#include "isr.h"
 
 //#define MLOG_DEBUG			(0x01)
 #define MLOG_INFO			(0x02)
@@ -60,6 +62,7 @@ static stpData_t stpData;
 
 void stp_setDecayMode(stpDecayMode_t mode);
 stpState_t stp_getState(void);
+static void stp_step(void) IRQ_RAM_FUNC;
 
 /**
  * @brief Initialize the motor driver and all module variables with default values
@@ -90,6 +93,9 @@ void stp_init(void)
 
 	HAL_TIM_OC_Init(&htim3);
 	__HAL_TIM_DISABLE_IT(&htim3, TIM_IT_UPDATE);
+
+	/* Run the step interrupt from RAM to keep stepping while the flash is busy */
+	irq_setHandler(TIM3_IRQn, stp_irqHandler);
 }
 
 /**
@@ -138,13 +144,22 @@ void stp_handler(void)
 
 	case STP_STATE_RAMP_START:
 
+		/* Stopped before the drive started, e.g. the idle position is
+		 * already closed or the timeout elapsed. The timer must not run
+		 * without a drive.
+		 */
+		if(stpData.cmd.active == STP_CMD_STOP || stpData.cmd.nxt == STP_CMD_STOP) {
+			stpData.fsm.nxState = STP_STATE_IDLE;
+			break;
+		}
+
 		if(stpData.cmd.active == STP_CMD_DRIVE_UP) {
 			/* set direction to UP */
-			HAL_GPIO_WritePin(MTR_DIR_GPIO_Port, MTR_DIR_Pin, GPIO_PIN_SET);
+			io_setStpDir();
 
 		} else if(stpData.cmd.active == STP_CMD_DRIVE_DOWN) {
 			/* set direction to DOWN */
-			HAL_GPIO_WritePin(MTR_DIR_GPIO_Port, MTR_DIR_Pin, GPIO_PIN_RESET);
+			io_clrStpDir();
 		}else {
 			/* Error */
 			stpData.fsm.nxState = STP_STATE_FAULT_INVALID_DIR;
@@ -172,24 +187,18 @@ void stp_handler(void)
 		break;
 	case STP_STATE_RAMP_UP:
 
-		/* Transitions */
+		/* Transitions, the target is checked by stp_step() */
 		if(stpData.cmd.active == STP_CMD_STOP)
 		{
 			stpData.fsm.nxState = STP_STATE_IDLE;
-		}else if(stpData.steps.cnt >= stpData.steps.target)
-		{
-			stpData.fsm.nxState = STP_STATE_ARRIVED;
 		}
 		break;
 	case STP_STATE_RAMP_STABLE:
 
-		/* Transitions */
+		/* Transitions, the target is checked by stp_step() */
 		if(stpData.cmd.active == STP_CMD_STOP)
 		{
 			stpData.fsm.nxState = STP_STATE_IDLE;
-		}else if(stpData.steps.cnt >= stpData.steps.target)
-		{
-			stpData.fsm.nxState = STP_STATE_ARRIVED;
 		}
 		break;
 
@@ -312,40 +321,101 @@ void stp_setPeriodEndRamp(uint16_t val)
 	stpData.period.max = val;
 }
 
+/**
+ * @brief Set the decrement of the timer period per step of the ramp
+ */
+void stp_setPeriodStep(uint16_t val)
+{
+	stpData.period.step = val;
+}
+
 stpState_t stp_getState(void)
 {
 	return stpData.fsm.state;
 }
 
+/**
+ * @brief Returns the number of steps of the current drive
+ */
+uint32_t stp_getStepCount(void)
+{
+	return stpData.steps.cnt;
+}
+
+/**
+ * @brief Returns the current timer period of a step
+ */
+uint32_t stp_getPeriod(void)
+{
+	return stpData.period.val;
+}
+
 /*------------------------------------------------------------------------------
  * ISR
  *--------------------------------------------------------------------------- */
 
 /**
- * Interrupt for the stepper motor PIN
+ * Step of the stepper motor
  *
- * It will ramp up the frequency and toggle the GPIO pin
+ * It will ramp up the frequency and toggle the GPIO pin. At the target the
+ * timer is stopped here and not by stp_handler(), because the main loop
+ * stalls while the flash is erased. This function runs from RAM and must not
+ * call any function placed in flash.
  */
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+static void stp_step(void)
 {
-	if(htim->Instance == TIM3) {
-
-		if(stpData.fsm.state == STP_STATE_RAMP_UP) {
-			if(stpData.period.val > stpData.period.max) {
+	if(stpData.fsm.state == STP_STATE_RAMP_UP) {
+		if(stpData.period.val > stpData.period.max) {
 
-				stpData.period.val -= stpData.period.step;
-				__HAL_TIM_SET_AUTORELOAD(&htim3, stpData.period.val);
-			}else {
-				stpData.fsm.nxState = STP_STATE_RAMP_STABLE;
-			}
+			stpData.period.val -= stpData.period.step;
+			__HAL_TIM_SET_AUTORELOAD(&htim3, stpData.period.val);
+		}else {
+			stpData.fsm.nxState = STP_STATE_RAMP_STABLE;
 		}
+	}
+
+	stpData.steps.cnt++;
+
+	/* Toggle the gpio pin */
+	io_tglStpStep();
 
-		stpData.steps.cnt++;
+	if(stpData.steps.cnt >= stpData.steps.target) {
+		/* Stop the timer and its interrupt by register access */
+		htim3.Instance->CR1 &= ~TIM_CR1_CEN;
+		htim3.Instance->DIER &= ~TIM_IT_UPDATE;
 
-		/* Toggle the gpio pin */
-		io_tglStpStep();
+		stpData.fsm.state =
+		stpData.fsm.nxState = STP_STATE_ARRIVED;
 	}
 }
 
+/**
+ * TIM3 interrupt handler for the stepper motor PIN
+ *
+ * Replaces TIM3_IRQHandler() and the HAL timer interrupt handling which are
+ * placed in flash. Only the update interrupt of TIM3 is used.
+ */
+void stp_irqHandler(void)
+{
+	ISR_ENTER();
+
+	if(__HAL_TIM_GET_FLAG(&htim3, TIM_FLAG_UPDATE) != RESET) {
+		__HAL_TIM_CLEAR_IT(&htim3, TIM_IT_UPDATE);
 
+		stp_step();
+	}
 
+	ISR_EXIT(ISR_SRC_TIM3);
+}
+
+/**
+ * Interrupt for the stepper motor PIN
+ *
+ * Only used if the TIM3 interrupt is handled by the HAL
+ */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+	if(htim->Instance == TIM3) {
+		stp_step();
+	}
+}
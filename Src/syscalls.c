@@ -16,9 +16,41 @@
 #include <stm32f103xb.h>
 #endif
 
+#include "syscalls.h"
+
+#define SYS_ITM_BUFFER_MASK         (SYS_ITM_BUFFER_SIZE - 1)
+
+#if (SYS_ITM_BUFFER_SIZE & SYS_ITM_BUFFER_MASK) != 0
+#error "SYS_ITM_BUFFER_SIZE must be a power of two"
+#endif
+
+/**
+ * ITM output data struct type
+ */
+typedef struct sysItmData_s {
+    uint8_t buffer[SYS_ITM_BUFFER_SIZE];
+    /**
+     * Free running write and read index
+     */
+    volatile uint16_t head;
+    volatile uint16_t tail;
+
+    sysItmStats_t stats;
+} sysItmData_t;
+
+/**
+ * Module data
+ */
+static sysItmData_t sysItmData;
+
 /**
  * @brief Overwritten function to use printf
  *
+ * The message is copied into the ITM output ring. A message which does not
+ * fit into the ring is dropped completely. The copy runs with the interrupts
+ * disabled, so a message written by an ISR is never interleaved with a
+ * message of the main loop. Keep the messages of ISRs short (or use mlog).
+ *
  * @param file File handle
  * @param data String message to write
  * @param len String length
@@ -27,9 +59,72 @@
  */
 int _write(int file, char *ptr, int len)
 {
-  /* Implement your write code here, this is used by puts and printf for example */
+  uint32_t primask = __get_PRIMASK();
+  uint16_t head;
+  uint16_t used;
   int i=0;
+
+  __disable_irq();
+
+  head = sysItmData.head;
+  used = head - sysItmData.tail;
+
+  if(len > SYS_ITM_BUFFER_SIZE - used)
+  {
+    sysItmData.stats.dropped += len;
+    __set_PRIMASK(primask);
+    return len;
+  }
+
   for(i=0 ; i<len ; i++)
-    ITM_SendChar((*ptr++));
+    sysItmData.buffer[head++ & SYS_ITM_BUFFER_MASK] = *ptr++;
+
+  sysItmData.head = head;
+
+  if((used += len) > sysItmData.stats.highWatermark)
+  {
+    sysItmData.stats.highWatermark = used;
+  }
+
+  __set_PRIMASK(primask);
+
   return len;
 }
+
+/**
+ * @brief Send the buffered output to the ITM stimulus port 0
+ *
+ * Only the bytes which fit into the port FIFO are sent. The output is
+ * discarded and counted while the ITM port is disabled (no debugger
+ * attached). Run this handler at the main loop.
+ */
+void sys_itmHandler(void)
+{
+  uint16_t tail = sysItmData.tail;
+  uint16_t head = sysItmData.head;
+
+  if((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0 || (ITM->TER & 1UL) == 0)
+  {
+    sysItmData.stats.discarded += (uint16_t)(head - tail);
+    sysItmData.tail = head;
+    return;
+  }
+
+  while(tail != sysItmData.head && ITM->PORT[0U].u32 != 0)
+  {
+    ITM->PORT[0U].u8 = sysItmData.buffer[tail++ & SYS_ITM_BUFFER_MASK];
+    sysItmData.stats.written++;
+  }
+
+  sysItmData.tail = tail;
+}
+
+/**
+ * @brief Copy the statistics of the ITM output
+ *
+ * @param stats Destination of the statistics
+ */
+void sys_getItmStats(sysItmStats_t* stats)
+{
+  *stats = sysItmData.stats;
+}
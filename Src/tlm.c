@@ -0,0 +1,222 @@
+/**
+ * @file tlm.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Motion telemetry implementation
+ */
+#include <string.h>
+
+#include "tlm.h"
+#include "main.h"
+#include "io.h"
+#include "stepper.h"
+#include "cdc.h"
+
+/**
+ * Number of packet buffers
+ */
+#define TLM_BUFFERS                 (2)
+
+/**
+ * State of a packet buffer
+ */
+typedef enum tlmBufState_e {
+    TLM_BUF_FREE = 0,   /* Free or filled by tlm_tick() */
+    TLM_BUF_READY       /* Complete, waiting for the transmit queue */
+} tlmBufState_t;
+
+/**
+ * Telemetry data struct type
+ */
+typedef struct tlmData_s {
+    tlmPacket_t packets[TLM_BUFFERS];
+    volatile uint8_t state[TLM_BUFFERS];
+
+    /**
+     * Buffer and sample index filled by tlm_tick()
+     */
+    uint8_t fill;
+    uint8_t sample;
+
+    /**
+     * Sampling is enabled and the sample rate divider of the SysTick
+     */
+    volatile uint8_t enabled;
+    uint8_t divider;
+    uint8_t cnt;
+
+    uint16_t seq;
+
+    tlmStats_t stats;
+} tlmData_t;
+
+/**
+ * Module data
+ */
+static tlmData_t tlmData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void tlm_send(void);
+
+/**
+ * Basic initialization for the telemetry
+ */
+void tlm_init(void)
+{
+    memset(&tlmData, 0, sizeof(tlmData));
+}
+
+/**
+ * @brief Send the complete packets
+ *
+ * Run this handler at the main loop. A packet which does not fit into the
+ * transmit queue is retried at the next call, so the handler never blocks.
+ */
+void tlm_handler(void)
+{
+    uint8_t i;
+
+    /* Nobody listens */
+    if(!cdc_isConfigured())
+    {
+        tlmData.enabled = 0;
+        for(i = 0; i < TLM_BUFFERS; i++)
+        {
+            tlmData.state[i] = TLM_BUF_FREE;
+        }
+        return;
+    }
+
+    tlm_send();
+}
+
+/**
+ * @brief Sample the motion
+ *
+ * Called from the SysTick interrupt (1 kHz).
+ */
+void tlm_tick(void)
+{
+    tlmPacket_t* packet;
+    tlmSample_t* sample;
+    uint8_t next;
+
+    if(!tlmData.enabled || ++tlmData.cnt < tlmData.divider)
+    {
+        return;
+    }
+    tlmData.cnt = 0;
+
+    packet = &tlmData.packets[tlmData.fill];
+    if(tlmData.sample == 0)
+    {
+        packet->magic = TLM_MAGIC;
+        packet->seq = tlmData.seq++;
+        packet->tick = HAL_GetTick();
+    }
+
+    sample = &packet->samples[tlmData.sample];
+    sample->steps = stp_getStepCount();
+    sample->period = stp_getPeriod();
+    sample->state = stp_getState();
+    sample->inputs = (io_isSw1() ? TLM_INPUT_SW1 : 0) |
+            (io_isSw2() ? TLM_INPUT_SW2 : 0) |
+            (io_isStpDir() ? TLM_INPUT_DIR : 0);
+
+    if(++tlmData.sample < TLM_SAMPLES)
+    {
+        return;
+    }
+    tlmData.sample = 0;
+
+    next = (tlmData.fill + 1) % TLM_BUFFERS;
+    if(tlmData.state[next] == TLM_BUF_FREE)
+    {
+        tlmData.state[tlmData.fill] = TLM_BUF_READY;
+        tlmData.fill = next;
+    }else
+    {
+        /* Overwrite the packet */
+        tlmData.stats.overruns++;
+    }
+}
+
+/**
+ * @brief Start the stream
+ *
+ * @param divider Sample every divider ms (0 is 1)
+ */
+void tlm_start(uint8_t divider)
+{
+    tlmData.enabled = 0;
+
+    tlmData.divider = divider ? divider : 1;
+    tlmData.cnt = tlmData.divider - 1;
+    tlmData.sample = 0;
+
+    tlmData.enabled = 1;
+}
+
+/**
+ * @brief Stop the stream
+ *
+ * The complete packets are queued before the final zero byte. The incomplete
+ * packet and the packets which do not fit into the queue are dropped.
+ */
+void tlm_stop(void)
+{
+    const uint8_t end = 0;
+    uint8_t i;
+
+    if(!tlmData.enabled)
+    {
+        return;
+    }
+
+    tlmData.enabled = 0;
+    tlmData.sample = 0;
+
+    tlm_send();
+    for(i = 0; i < TLM_BUFFERS; i++)
+    {
+        tlmData.state[i] = TLM_BUF_FREE;
+    }
+
+    cdc_write(&end, 1);
+}
+
+/**
+ * @brief Copy the statistics of the telemetry
+ *
+ * @param stats Destination of the statistics
+ */
+void tlm_getStats(tlmStats_t* stats)
+{
+    *stats = tlmData.stats;
+}
+
+/**
+ * @brief Pass the complete packets to the transmit queue
+ *
+ * Only called from the main loop.
+ */
+static void tlm_send(void)
+{
+    uint8_t i;
+
+    for(i = 0; i < TLM_BUFFERS; i++)
+    {
+        if(tlmData.state[i] == TLM_BUF_READY &&
+                cdc_write((const uint8_t*)&tlmData.packets[i], TLM_PACKET_SIZE) != 0)
+        {
+            tlmData.state[i] = TLM_BUF_FREE;
+            tlmData.stats.packets++;
+        }
+    }
+}
@@ -0,0 +1,201 @@
+/**
+ * @file trc.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Input trace of the application implementation
+ */
+#include "trc.h"
+#include "stepper.h"
+
+/**
+ * Trace data struct type
+ */
+typedef struct trcData_s {
+    trcEntry_t entries[TRC_SIZE];
+    uint16_t count;
+
+    /**
+     * Time of the last entry
+     */
+    uint64_t time;
+
+    /**
+     * Levels of the last reads of the inputs
+     */
+    uint8_t inputs[TRC_INPUT_COUNT];
+
+    /**
+     * Entries which did not fit
+     */
+    uint32_t lost;
+} trcData_t;
+
+/**
+ * Module data
+ */
+static trcData_t trcData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t trc_push(uint32_t delta, trcType_t type, uint8_t data, uint16_t value);
+
+/**
+ * Basic initialization for the trace
+ *
+ * The time base of the trace is the reset, the inputs are assumed to be
+ * inactive.
+ */
+void trc_init(void)
+{
+    uint8_t i;
+
+    trcData.count = 0;
+    trcData.time = 0;
+    trcData.lost = 0;
+
+    for(i = 0; i < TRC_INPUT_COUNT; i++)
+    {
+        trcData.inputs[i] = 0;
+    }
+}
+
+/**
+ * @brief Record the level of an input if it differs from the last read
+ *
+ * Call this function at the main loop only.
+ *
+ * @param input Input
+ * @param level Read level, not zero if active
+ *
+ * @return The level
+ */
+uint8_t trc_input(trcInput_t input, uint8_t level)
+{
+    uint8_t active = (level != 0);
+
+    if(trcData.inputs[input] != active)
+    {
+        trcData.inputs[input] = active;
+        trc_add(TRC_TYPE_INPUT, input, active);
+    }
+
+    return level;
+}
+
+/**
+ * @brief Record a drive command
+ *
+ * @param cmd STP_CMD_DRIVE_UP or STP_CMD_DRIVE_DOWN
+ * @param steps Number of steps, saturated to TRC_MAX_STEPS
+ */
+void trc_drive(uint8_t cmd, uint32_t steps)
+{
+    if(steps > TRC_MAX_STEPS)
+    {
+        steps = TRC_MAX_STEPS;
+    }
+
+    trc_add(cmd == STP_CMD_DRIVE_UP ? TRC_TYPE_DRIVE_UP : TRC_TYPE_DRIVE_DOWN,
+            steps >> 16, steps & 0xFFFF);
+}
+
+/**
+ * @brief Record an entry
+ *
+ * Call this function at the main loop only.
+ *
+ * @param type Entry type
+ * @param data Data of the type
+ * @param value Value of the type
+ */
+void trc_add(trcType_t type, uint8_t data, uint16_t value)
+{
+    uint64_t time = trc_getTime();
+
+    while(time - trcData.time > 0xFFFFFFFF)
+    {
+        if(!trc_push(0xFFFFFFFF, TRC_TYPE_TICK, 0, 0))
+        {
+            return;
+        }
+    }
+
+    trc_push(time - trcData.time, type, data, value);
+}
+
+/**
+ * @brief Returns the time base of the trace in CPU cycles since the reset
+ *
+ * Call this function with enabled interrupts.
+ */
+uint64_t trc_getTime(void)
+{
+    uint32_t tick;
+    uint32_t val;
+
+    /* A reload between the reads is seen at the changed tick */
+    do
+    {
+        tick = HAL_GetTick();
+        val = SysTick->VAL;
+    }while(tick != HAL_GetTick());
+
+    return (uint64_t)tick * (SysTick->LOAD + 1) + (SysTick->LOAD - val);
+}
+
+/**
+ * @brief Returns the number of recorded entries
+ */
+uint16_t trc_getCount(void)
+{
+    return trcData.count;
+}
+
+/**
+ * @brief Returns the number of entries which did not fit into the trace
+ */
+uint32_t trc_getLost(void)
+{
+    return trcData.lost;
+}
+
+/**
+ * @brief Returns the recorded entries, trc_getCount() are valid
+ */
+const trcEntry_t* trc_getEntries(void)
+{
+    return trcData.entries;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Append an entry
+ *
+ * @return 1 on success, 0 if the trace is full
+ */
+static uint8_t trc_push(uint32_t delta, trcType_t type, uint8_t data, uint16_t value)
+{
+    trcEntry_t* entry;
+
+    if(trcData.count >= TRC_SIZE)
+    {
+        trcData.lost++;
+        return 0;
+    }
+
+    entry = &trcData.entries[trcData.count++];
+    entry->delta = delta;
+    entry->type = type;
+    entry->data = data;
+    entry->value = value;
+
+    trcData.time += delta;
+
+    return 1;
+}
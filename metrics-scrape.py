@@ -0,0 +1,102 @@
+#!/usr/bin/env python3
+#
+# Scrape the metrics of the USB CDC interface (see Inc/mtr.h) periodically
+# into a CSV file, one row per dump and one column per series. Counters and
+# histogram buckets are cumulative, the rate is the difference of two rows.
+# Requires pyserial. Stop the scrape with Ctrl+C.
+#
+#   python3 metrics-scrape.py /dev/ttyACM0 metrics.csv
+#   python3 metrics-scrape.py /dev/ttyACM0 metrics.csv 10   (every 10 s)
+
+import importlib.util
+import os
+import sys
+import time
+
+CMD_METRICS = 0x0D
+CMD_METRICS_DATA = 0x41
+
+
+def load_client():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "proto-client.py")
+    spec = importlib.util.spec_from_file_location("proto_client", path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def parse(text):
+    """Series and values of a dump in the text exposition format"""
+    series = []
+    for line in text.splitlines():
+        if not line or line.startswith("#"):
+            continue
+        name, value = line.rsplit(" ", 1)
+        series.append((name, int(value)))
+    return series
+
+
+def scrape(client):
+    """Text of a dump or None if a frame was lost"""
+    client.request(CMD_METRICS)
+
+    text = b""
+    seq = None
+    lost = False
+    while True:
+        frame = client.read_frame()
+        if frame is None:
+            raise TimeoutError("no metrics data")
+        cmd, rseq, data = frame
+        if cmd != CMD_METRICS_DATA:
+            continue
+        if seq is not None and rseq != (seq + 1) & 0xFF:
+            lost = True
+        seq = rseq
+        if not data:
+            break
+        text += data
+
+    return None if lost else text.decode("ascii")
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write("usage: %s <port> <csv> [interval s]\n" % sys.argv[0])
+        return 1
+
+    interval = float(sys.argv[3]) if len(sys.argv) > 3 else 1.0
+    client = load_client().Client(sys.argv[1])
+
+    with open(sys.argv[2], "w") as out:
+        names = None
+        start = time.monotonic()
+        try:
+            while True:
+                now = time.monotonic()
+                text = scrape(client)
+                if text is None:
+                    sys.stderr.write("frame lost, dump dropped\n")
+                else:
+                    series = parse(text)
+
+                    # The metrics are fixed at compile time, the first dump sets the columns
+                    if names is None:
+                        names = [name for name, _ in series]
+                        out.write("time_s," + ",".join('"%s"' % name.replace('"', '""') for name in names) + "\n")
+                    elif [name for name, _ in series] != names:
+                        sys.stderr.write("the metrics changed, restart the scrape\n")
+                        return 1
+
+                    out.write("%.3f,%s\n" % (now - start, ",".join(str(value) for _, value in series)))
+                    out.flush()
+
+                time.sleep(max(0.0, interval - (time.monotonic() - now)))
+        except KeyboardInterrupt:
+            pass
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+#
+# Decode the deferred log frames of mlog.h into text.
+#
+# The string table is the section .mlog which is dumped by post-build.sh.
+# The frames are read from a file or stdin, e.g. a capture of the USART1 output
+# (see CLI_LOG_OUTPUT) or of the ITM port 0.
+#
+#   python3 mlog-decode.py Debug/elevator.mlog uart.bin
+#   cat /dev/ttyUSB0 | python3 mlog-decode.py Debug/elevator.mlog
+
+import re
+import struct
+import sys
+
+FRAME_SYNC = 0xA5
+MAX_ARGS = 4
+TOKEN_DROPPED = 0xFFFF
+
+SPEC = re.compile(r"%([-+ #0]*)(\d*)(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+def load_table(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def lookup(table, token):
+    end = table.find(b"\0", token)
+    if token >= len(table) or end < 0:
+        return None
+    return table[token:end].decode("ascii", "replace")
+
+
+def format_message(fmt, args):
+    args = list(args)
+
+    def conv(m):
+        flags, width, prec, _, kind = m.groups()
+        if kind == "%":
+            return "%"
+        value = args.pop(0) if args else 0
+        if kind in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            kind = "d"
+        elif kind in "sp":
+            # Pointers can not be resolved on the host
+            return "0x%08x" % value
+        elif kind == "c":
+            value = chr(value & 0xFF)
+        spec = "%" + flags + width + ("." + prec if prec else "") + kind
+        return spec % value
+
+    return SPEC.sub(conv, fmt)
+
+
+def decode(table, data, out):
+    pos = 0
+    while pos + 8 <= len(data):
+        header, tick = struct.unpack_from("<II", data, pos)
+        token = header & 0xFFFF
+        nargs = (header >> 16) & 0xFF
+
+        # Resync on a byte basis
+        if (header >> 24) != FRAME_SYNC or nargs > MAX_ARGS:
+            pos += 1
+            continue
+
+        if pos + 8 + 4 * nargs > len(data):
+            break
+
+        args = struct.unpack_from("<%dI" % nargs, data, pos + 8)
+        pos += 8 + 4 * nargs
+
+        if token == TOKEN_DROPPED:
+            text = "[mlog] %d messages dropped\n" % args[0]
+        else:
+            fmt = lookup(table, token)
+            text = format_message(fmt, args) if fmt is not None else \
+                "[mlog] unknown token 0x%04x\n" % token
+
+        out.write("[%6d.%03d] %s" % (tick // 1000, tick % 1000, text))
+
+    return pos
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("usage: %s <table> [frames]\n" % sys.argv[0])
+        return 1
+
+    table = load_table(sys.argv[1])
+    stream = open(sys.argv[2], "rb") if len(sys.argv) > 2 else sys.stdin.buffer
+
+    data = b""
+    while True:
+        chunk = stream.read1(4096) if hasattr(stream, "read1") else stream.read(4096)
+        if not chunk:
+            break
+        data += chunk
+        data = data[decode(table, data, sys.stdout):]
+        sys.stdout.flush()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -10,3 +10,13 @@ PWD=$(pwd)
 if [ -f $PWD/$BUILD_TARGET/$BINARY_BASE ]; then
    mv $PWD/$BUILD_TARGET/$BINARY_BASE $PWD/$BUILD_TARGET/$BINARY_NEW
 fi
+
+# Dump the format strings of the deferred logging for mlog-decode.py
+ELF="elevator.elf"
+MLOG_TABLE="elevator.mlog"
+
+if [ -f $PWD/$BUILD_TARGET/$ELF ]; then
+   arm-none-eabi-objcopy --dump-section .mlog=$PWD/$BUILD_TARGET/$MLOG_TABLE \
+      $PWD/$BUILD_TARGET/$ELF $PWD/$BUILD_TARGET/$ELF.tmp
+   rm -f $PWD/$BUILD_TARGET/$ELF.tmp
+fi
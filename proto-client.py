@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+#
+# Host client of the framed binary protocol at the USB CDC interface (see
+# Inc/proto.h). Requires pyserial.
+#
+#   python3 proto-client.py /dev/ttyACM0 ping
+#   python3 proto-client.py /dev/ttyACM0 get 0x1111
+#   python3 proto-client.py /dev/ttyACM0 set 0x1111 1500
+#   python3 proto-client.py /dev/ttyACM0 move up 2000
+#   python3 proto-client.py /dev/ttyACM0 stop
+#   python3 proto-client.py /dev/ttyACM0 status
+#   python3 proto-client.py /dev/ttyACM0 log Debug/elevator.mlog
+#   python3 proto-client.py /dev/ttyACM0 bridge     (USB to USART1)
+#   python3 proto-client.py /dev/ttyACM0 unbridge   (break: back to the console)
+#   python3 proto-client.py /dev/ttyACM0 trace trace.bin  (TRC_RECORD, see Inc/trc.h)
+#   python3 proto-client.py /dev/ttyACM0 isr [clear]      (ISR_PROFILE, see Inc/isr.h)
+#   python3 proto-client.py /dev/ttyACM0 loop [clear|watch] (LOOP_PROFILE, see Inc/loop.h)
+#   python3 proto-client.py /dev/ttyACM0 metrics     (see Inc/mtr.h, metrics-scrape.py)
+
+import importlib.util
+import os
+import struct
+import sys
+import time
+
+import serial
+
+CMD_PING = 0x01
+CMD_CFG_GET = 0x02
+CMD_CFG_SET = 0x03
+CMD_MOVE = 0x04
+CMD_STOP = 0x05
+CMD_STATUS = 0x06
+CMD_LOG = 0x07
+CMD_BRIDGE = 0x09
+CMD_TRACE = 0x0A
+CMD_ISR = 0x0B
+CMD_LOOP = 0x0C
+CMD_METRICS = 0x0D
+CMD_LOG_DATA = 0x40
+CMD_METRICS_DATA = 0x41
+
+# Interrupt sources of PROTO_CMD_ISR (isrSource_t) and the CPU clock
+ISR_SOURCES = ("TIM3", "USB_LP", "DMA1_CH4", "DMA1_CH5", "SysTick")
+ISR_CPU_MHZ = 72.0
+
+# Handlers of the main loop of PROTO_CMD_LOOP (loopHandler_t)
+LOOP_HANDLERS = ("app", "stp", "ee", "mlog", "itm", "cli", "mb", "brg", "proto", "tlm", "cdc")
+
+RESPONSE = 0x80
+
+STATUS = ["ok", "unknown command", "invalid length", "invalid parameter",
+          "busy", "error"]
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+            crc &= 0xFFFF
+    return crc
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos = 0
+    code = 1
+    for b in data:
+        if b != 0:
+            out.append(b)
+            code += 1
+        if b == 0 or code == 0xFF:
+            out[code_pos] = code
+            code = 1
+            code_pos = len(out)
+            out.append(0)
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        pos += 1
+        if code == 0 or pos + code - 1 > len(data):
+            raise ValueError("invalid COBS encoding")
+        out += data[pos:pos + code - 1]
+        pos += code - 1
+        if code != 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Client:
+    def __init__(self, port, timeout=1.0):
+        self.ser = serial.Serial(port, timeout=timeout)
+        self.seq = 0
+        self.rx = b""
+        self.on_log = None
+
+    def send(self, cmd, payload=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        frame = bytes([cmd, self.seq]) + payload
+        frame += struct.pack("<H", crc16(frame))
+        self.ser.write(cobs_encode(frame) + b"\0")
+        return self.seq
+
+    def read_frame(self):
+        while b"\0" not in self.rx:
+            chunk = self.ser.read(max(1, self.ser.in_waiting))
+            if not chunk:
+                return None
+            self.rx += chunk
+        encoded, self.rx = self.rx.split(b"\0", 1)
+        if not encoded:
+            return self.read_frame()
+        try:
+            frame = cobs_decode(encoded)
+        except ValueError:
+            return self.read_frame()
+        if len(frame) < 4 or crc16(frame[:-2]) != struct.unpack("<H", frame[-2:])[0]:
+            sys.stderr.write("crc error\n")
+            return self.read_frame()
+        return frame[0], frame[1], frame[2:-2]
+
+    def request(self, cmd, payload=b""):
+        seq = self.send(cmd, payload)
+        while True:
+            frame = self.read_frame()
+            if frame is None:
+                raise TimeoutError("no response")
+            rcmd, rseq, data = frame
+            if rcmd == CMD_LOG_DATA:
+                if self.on_log:
+                    self.on_log(data)
+                continue
+            if rcmd == (cmd | RESPONSE) and rseq == seq:
+                if data[0] != 0:
+                    raise RuntimeError(STATUS[data[0]] if data[0] < len(STATUS) else "status %d" % data[0])
+                return data[1:]
+
+
+def load_decoder():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "mlog-decode.py")
+    spec = importlib.util.spec_from_file_location("mlog_decode", path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write("usage: %s <port> <ping|get|set|move|stop|status|log|bridge|unbridge|trace|isr|loop|metrics> [args]\n" % sys.argv[0])
+        return 1
+
+    client = Client(sys.argv[1])
+    cmd, args = sys.argv[2], sys.argv[3:]
+
+    if cmd == "ping":
+        version, = struct.unpack("<I", client.request(CMD_PING))
+        print("version %d.%d.%d" % (version >> 16, (version >> 8) & 0xFF, version & 0xFF))
+    elif cmd == "get":
+        data, = struct.unpack("<H", client.request(CMD_CFG_GET, struct.pack("<H", int(args[0], 0))))
+        print(data)
+    elif cmd == "set":
+        client.request(CMD_CFG_SET, struct.pack("<HH", int(args[0], 0), int(args[1], 0)))
+        print("ok")
+    elif cmd == "move":
+        client.request(CMD_MOVE, struct.pack("<BI", 0 if args[0] == "up" else 1, int(args[1], 0)))
+        print("ok")
+    elif cmd == "stop":
+        client.request(CMD_STOP)
+        print("ok")
+    elif cmd == "status":
+        tick, state, dirty, writes, erases, dropped = struct.unpack("<IBBIII", client.request(CMD_STATUS))
+        print("tick %d stepper %d ee dirty %d writes %d erases %d log dropped %d" %
+              (tick, state, dirty, writes, erases, dropped))
+    elif cmd == "log":
+        decoder = load_decoder()
+        table = decoder.load_table(args[0])
+        stream = [b""]
+
+        def on_log(data):
+            stream[0] += data
+            stream[0] = stream[0][decoder.decode(table, stream[0], sys.stdout):]
+            sys.stdout.flush()
+
+        client.on_log = on_log
+        client.request(CMD_LOG, b"\1")
+        try:
+            while True:
+                frame = client.read_frame()
+                if frame and frame[0] == CMD_LOG_DATA:
+                    on_log(frame[2])
+        except KeyboardInterrupt:
+            client.on_log = None
+            client.request(CMD_LOG, b"\0")
+    elif cmd == "bridge":
+        client.request(CMD_BRIDGE)
+        print("ok")
+    elif cmd == "unbridge":
+        client.ser.send_break()
+        print("ok")
+    elif cmd == "trace":
+        entries = b""
+        while True:
+            data = client.request(CMD_TRACE, struct.pack("<H", len(entries) // 8))
+            count, lost = struct.unpack("<HI", data[:6])
+            entries += data[6:]
+            if len(data) == 6 or len(entries) // 8 >= count:
+                break
+        with open(args[0], "wb") as f:
+            f.write(entries)
+        print("%d entries (lost %d)" % (len(entries) // 8, lost))
+    elif cmd == "isr":
+        print("%-9s %9s %7s %7s %7s %9s  %s" % ("source", "count", "min", "avg", "max", "max us",
+                                             "log2 histogram (< 64, 64 - 127, ... >= 16384 cycles)"))
+        for source, name in enumerate(ISR_SOURCES):
+            data = client.request(CMD_ISR, struct.pack("<BB", source, 1 if args[:1] == ["clear"] else 0))
+            count, lo, hi, avg = struct.unpack("<IIII", data[:16])
+            hist = struct.unpack("<%dI" % ((len(data) - 16) // 4), data[16:])
+            if count == 0:
+                print("%-9s %9d" % (name, 0))
+                continue
+            print("%-9s %9d %7d %7d %7d %9.2f  %s" % (name, count, lo, avg, hi, hi / ISR_CPU_MHZ,
+                                                    " ".join(str(n) for n in hist)))
+    elif cmd == "loop":
+        windows = None
+        while True:
+            data = client.request(CMD_LOOP, b"\1" if args[:1] == ["clear"] else b"\0")
+            (count, iterations, idle, lo, avg, hi, ref, load, worst, peak,
+             worst_cycles, peak_cycles) = struct.unpack("<IIIIIIIHBBII", data)
+            if count != windows:
+                windows = count
+                name = lambda h: LOOP_HANDLERS[h] if h < len(LOOP_HANDLERS) else str(h)
+                print("load %5.1f%% iterations %d idle %d (%.1f%%) loop min/avg/max %.2f/%.2f/%.2f us "
+                      "idle %.2f us worst %s %.2f us peak %s %.2f us" %
+                      (load / 10.0, iterations, idle, 100.0 * idle / max(iterations, 1),
+                       lo / ISR_CPU_MHZ, avg / ISR_CPU_MHZ, hi / ISR_CPU_MHZ, ref / ISR_CPU_MHZ,
+                       name(worst), worst_cycles / ISR_CPU_MHZ, name(peak), peak_cycles / ISR_CPU_MHZ))
+                sys.stdout.flush()
+            if args[:1] != ["watch"]:
+                break
+            time.sleep(0.25)
+    elif cmd == "metrics":
+        client.request(CMD_METRICS)
+        while True:
+            frame = client.read_frame()
+            if frame is None:
+                raise TimeoutError("no metrics data")
+            if frame[0] != CMD_METRICS_DATA:
+                continue
+            if not frame[2]:
+                break
+            sys.stdout.write(frame[2].decode("ascii"))
+    else:
+        sys.stderr.write("unknown command %s\n" % cmd)
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
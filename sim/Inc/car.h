@@ -0,0 +1,54 @@
+/**
+ * @file car.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Elevator car model of the host simulation
+ *
+ * The car follows the pins of the stepper driver: every rising edge of
+ * MTR_STEP moves it by one microstep (MS1 - MS3) in the direction of MTR_DIR
+ * while the driver is enabled (nENABLE low, nSLEEP and nRESET high). The
+ * position is counted in sixteenth steps, i.e. one toggle of MTR_STEP in the
+ * eighth step mode of stepper.c.
+ *
+ * The idle position switch SW2 closes from CAR_SWITCH_TOP upwards. Steps
+ * beyond the end stops of the shaft are lost.
+ */
+#ifndef CAR_H_
+#define CAR_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Position of the car at floor 0 (sixteenth steps)
+ */
+#define CAR_FLOOR0                  (0)
+
+/**
+ * Position where SW2 closes, the default floor distances above floor 0
+ */
+#define CAR_SWITCH_TOP              (6000)
+
+/**
+ * End stops of the shaft
+ */
+#define CAR_END_BOTTOM              (CAR_FLOOR0 - 500)
+#define CAR_END_TOP                 (CAR_SWITCH_TOP + 500)
+
+/**
+ * Statistics of the car
+ */
+typedef struct carStats_s {
+    uint32_t steps;         /* Steps of the motor */
+    uint32_t lostSteps;     /* Steps against an end stop */
+} carStats_t;
+
+void car_init(int32_t position);
+int32_t car_getPosition(void);
+void car_getStats(carStats_t* stats);
+
+#endif /* CAR_H_ */
@@ -0,0 +1,30 @@
+/**
+ * @file io_sim.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Simulation backend of io.h (IO_BACKEND)
+ *
+ * The writes to BSRR and BRR would not change the simulated output data
+ * registers, so the outputs pass the simulated HAL. A read of an input takes
+ * SIM_GPIO_READ_CYCLES like HAL_GPIO_ReadPin().
+ */
+#ifndef IO_SIM_H_
+#define IO_SIM_H_
+
+#include "sim.h"
+
+#define IO_SET(port_, pin_)         HAL_GPIO_WritePin((port_), (pin_), GPIO_PIN_SET)
+#define IO_CLR(port_, pin_)         HAL_GPIO_WritePin((port_), (pin_), GPIO_PIN_RESET)
+#define IO_TGL(port_, pin_)         HAL_GPIO_TogglePin((port_), (pin_))
+#define IO_GET(port_, pin_)         (HAL_GPIO_ReadPin((port_), (pin_)) == GPIO_PIN_SET)
+
+#define IO_PORT_INDEX(port_)        ((uint8_t)((port_) - simGpio))
+
+#define IO_REC_TIMESTAMP()          ((uint32_t)sim_getCycles())
+
+#endif /* IO_SIM_H_ */
@@ -0,0 +1,198 @@
+/**
+ * @file sim.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Simulated microcontroller of the host build
+ *
+ * The host build links the application core (app.c, stepper.c, btn.c,
+ * eeprom.c and config.c) unchanged against a simulated HAL (see
+ * stm32f1xx_hal.h):
+ *
+ * - The virtual time is counted in CPU cycles (SIM_CPU_CLOCK). The SysTick
+ *   interrupt increments the HAL tick every SIM_TICK_CYCLES.
+ * - TIM3 generates update events from its prescaler and auto reload register
+ *   (with preload) and raises the interrupt of the vector set by
+ *   irq_setHandler() or HAL_TIM_PeriodElapsedCallback().
+ * - The GPIO ports keep their registers. Changes of the output data registers
+ *   are passed to the output hooks (e.g. the car model of car.h), the input
+ *   levels are set by sim_setInput() and passed to the input hooks.
+ * - The EEPROM emulation uses a flash image through EE_FLASH_PORT. Blocking
+ *   erases and programs stall the CPU like the flash does: only the
+ *   interrupt running from RAM (TIM3) is served, the SysTick is pended.
+ *   A background erase (HAL_FLASHEx_Erase_IT()) runs for
+ *   SIM_FLASH_ERASE_CYCLES and raises the flash interrupt at its end. The
+ *   main loop and the interrupts running from flash stall like on a fetch
+ *   of their instructions, only TIM3 is served until then. Meanwhile
+ *   programs and erases return HAL_BUSY like the locked HAL and reads of the
+ *   flash image by the interrupt stall until the end of the erase.
+ * - The flash is a NOR flash: a program clears bits only. Like the flash
+ *   controller a half word which is not erased can only be programmed to
+ *   0x0000. sim_setPowerCut() injects a power loss before any half word
+ *   program or page erase, the operations itself are atomic.
+ * - USART1 sends and receives by DMA (DMA1 channel 4 and 5) like the MSP of
+ *   usart.c configures it. A character takes its frame time at the baud
+ *   rate. The sent bytes are passed to the UART hook at the end of their
+ *   stop bit, sim_uartInput() queues bytes at the receive line which follow
+ *   back to back. The half transfer and transfer complete interrupts of the
+ *   reception, the IDLE line and the transmission complete interrupt of
+ *   USART1 are raised, errors are not injected.
+ *
+ * The main loop takes no virtual time. After each iteration sim_loop() jumps
+ * to the next interrupt, so a ride of several seconds is simulated in a few
+ * milliseconds. Every read of an input pin takes SIM_GPIO_READ_CYCLES, so
+ * busy waits on an input terminate.
+ *
+ * The log messages of the modules are formatted by sim_log() (MLOG_PRINTF).
+ *
+ * <code>
+ * make -C sim && sim/build/elevator-sim -n 1000
+ * </code>
+ */
+#ifndef SIM_H_
+#define SIM_H_
+
+#include "stm32f1xx_hal.h"
+#include "eeprom.h"
+
+/**
+ * Clock of the CPU and of TIM3 (APB1 timer clock) in Hz
+ */
+#define SIM_CPU_CLOCK               (72000000UL)
+
+/**
+ * CPU cycles of a SysTick period (1 ms)
+ */
+#define SIM_TICK_CYCLES             (SIM_CPU_CLOCK / 1000)
+
+/**
+ * CPU cycles of a read of an input pin
+ */
+#define SIM_GPIO_READ_CYCLES        (20)
+
+/**
+ * CPU stall of a half word program and of a page erase
+ */
+#define SIM_FLASH_PROGRAM_CYCLES    (SIM_CPU_CLOCK / 1000000 * 52)
+#define SIM_FLASH_ERASE_CYCLES      (SIM_CPU_CLOCK / 1000 * 20)
+
+/**
+ * Size of the flash image of the EEPROM emulation
+ */
+#define SIM_FLASH_SIZE              (EE_PAGE_COUNT * FLASH_PAGE_SIZE)
+
+/**
+ * Number of bytes which can be queued at the receive line of USART1
+ */
+#define SIM_UART_INPUT_SIZE         (4096)
+
+/**
+ * Maximum number of output and of input hooks
+ */
+#define SIM_MAX_OUTPUT_HOOKS        (4)
+#define SIM_MAX_INPUT_HOOKS         (4)
+
+/**
+ * Observer of the output pins
+ *
+ * @param port GPIO port
+ * @param changed Pins which changed their level
+ */
+typedef void (*simOutputHook_t)(GPIO_TypeDef* port, uint16_t changed);
+
+/**
+ * Observer of the input pins, same parameters as simOutputHook_t
+ */
+typedef void (*simInputHook_t)(GPIO_TypeDef* port, uint16_t changed);
+
+/**
+ * Function which runs at the end of every SysTick interrupt
+ */
+typedef void (*simTickHook_t)(void);
+
+/**
+ * Function which runs before an input pin is sampled by a read
+ */
+typedef void (*simReadHook_t)(void);
+
+/**
+ * Function which runs at every iteration of the main loop after the handlers
+ * of the application core, e.g. the handlers of further modules
+ */
+typedef void (*simLoopHook_t)(void);
+
+/**
+ * Receiver of the bytes sent at USART1
+ *
+ * @param data Sent byte
+ */
+typedef void (*simUartHook_t)(uint8_t data);
+
+/**
+ * Function which runs at a power cut instead of the flash operation. It must
+ * not return, e.g. longjmp() to a restart of the simulation.
+ */
+typedef void (*simPowerCutHook_t)(void);
+
+/**
+ * Statistics of the simulation since sim_init()
+ */
+typedef struct simStats_s {
+    uint64_t loops;         /* Iterations of the main loop */
+    uint64_t tim3Events;    /* Served TIM3 interrupts */
+    uint32_t lostTicks;     /* SysTick interrupts lost while pending */
+    uint32_t warnings;      /* Log messages with the level warning */
+    uint32_t flashPrograms; /* Programmed half words */
+    uint32_t flashErases;   /* Erased pages */
+    uint32_t flashBgErases; /* Pages erased in the background */
+    uint32_t uartTxBytes;   /* Bytes sent at USART1 */
+    uint32_t uartTxBursts;  /* DMA transfers of the transmission */
+    uint32_t uartRxBytes;   /* Bytes received by DMA */
+    uint32_t uartRxLost;    /* Bytes received while the DMA was stopped */
+} simStats_t;
+
+void sim_init(void);
+void sim_boot(void);
+void sim_loop(void);
+void sim_advance(uint64_t cycles);
+uint64_t sim_getCycles(void);
+
+void sim_setInput(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state);
+GPIO_PinState sim_getOutput(GPIO_TypeDef* port, uint16_t pin);
+uint8_t sim_addOutputHook(simOutputHook_t hook);
+uint8_t sim_addInputHook(simInputHook_t hook);
+void sim_setTickHook(simTickHook_t hook);
+void sim_setReadHook(simReadHook_t hook);
+void sim_setLoopHook(simLoopHook_t hook);
+
+void sim_setUartHook(simUartHook_t hook);
+uint16_t sim_uartInput(const uint8_t* data, uint16_t len);
+
+void sim_setPowerCut(uint32_t operations, simPowerCutHook_t hook);
+
+void sim_eraseFlash(void);
+void sim_saveFlash(uint8_t* image);
+void sim_loadFlash(const uint8_t* image);
+
+void sim_setVerbose(uint8_t verbose);
+int sim_log(const char* fmt, ...);
+void sim_getStats(simStats_t* stats);
+
+/*
+ * Flash port of the EEPROM emulation (EE_FLASH_PORT)
+ */
+uint16_t sim_flashRead(uint32_t address);
+HAL_StatusTypeDef sim_flashProgram(uint32_t address, uint16_t data);
+HAL_StatusTypeDef sim_flashErase(FLASH_EraseInitTypeDef* init, uint32_t* pageError);
+HAL_StatusTypeDef sim_flashEraseIT(FLASH_EraseInitTypeDef* init);
+
+#define EE_FLASH_READ(Address)              sim_flashRead(Address)
+#define EE_FLASH_PROGRAM(Address, Data)     sim_flashProgram((Address), (Data))
+#define EE_FLASH_ERASE(Init, PageError)     sim_flashErase((Init), (PageError))
+#define EE_FLASH_ERASE_IT(Init)             sim_flashEraseIT(Init)
+
+#endif /* SIM_H_ */
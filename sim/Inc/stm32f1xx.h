@@ -0,0 +1,17 @@
+/**
+ * @file stm32f1xx.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Device header of the host build (see stm32f1xx_hal.h)
+ */
+#ifndef STM32F1XX_H_
+#define STM32F1XX_H_
+
+#include "stm32f1xx_hal.h"
+
+#endif /* STM32F1XX_H_ */
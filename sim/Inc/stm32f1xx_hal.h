@@ -0,0 +1,363 @@
+/**
+ * @file stm32f1xx_hal.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Simulated HAL of the host build
+ *
+ * Replaces the STM32 HAL for the modules of the application core. Only the
+ * types, registers and functions which are used by these modules exist. The
+ * peripherals are implemented by sim.c.
+ */
+#ifndef STM32F1XX_HAL_H_
+#define STM32F1XX_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO                        volatile
+#define __weak                      __attribute__((weak))
+
+#define UNUSED(x)                   ((void)(x))
+
+typedef enum {
+    HAL_OK      = 0x00,
+    HAL_ERROR   = 0x01,
+    HAL_BUSY    = 0x02,
+    HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+typedef enum {
+    RESET = 0,
+    SET = !RESET
+} FlagStatus, ITStatus;
+
+/*
+ * Interrupts
+ */
+typedef enum {
+    SysTick_IRQn                = -1,
+    FLASH_IRQn                  = 4,
+    DMA1_Channel4_IRQn          = 14,
+    DMA1_Channel5_IRQn          = 15,
+    USB_LP_CAN1_RX0_IRQn        = 20,
+    TIM3_IRQn                   = 29,
+    USART1_IRQn                 = 37,
+    USBWakeUp_IRQn              = 42
+} IRQn_Type;
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+#define __DSB()                     __sync_synchronize()
+#define __ISB()                     __sync_synchronize()
+
+/*
+ * System tick
+ */
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t LOAD;
+    __IO uint32_t VAL;
+    __IO uint32_t CALIB;
+} SysTick_Type;
+
+/* The counter is updated from the virtual time at every access */
+SysTick_Type* sim_getSysTick(void);
+#define SysTick                     (sim_getSysTick())
+
+uint32_t HAL_GetTick(void);
+void HAL_IncTick(void);
+void HAL_Delay(uint32_t Delay);
+
+/*
+ * Reset and clock control
+ */
+#define RCC_FLAG_IWDGRST            (0x7DU)
+
+#define __HAL_RCC_GET_FLAG(__FLAG__)        (RESET)
+#define __HAL_RCC_CLEAR_RESET_FLAGS()       ((void)0)
+
+/*
+ * GPIO
+ */
+typedef struct {
+    __IO uint32_t CRL;
+    __IO uint32_t CRH;
+    __IO uint32_t IDR;
+    __IO uint32_t ODR;
+    __IO uint32_t BSRR;
+    __IO uint32_t BRR;
+    __IO uint32_t LCKR;
+} GPIO_TypeDef;
+
+typedef enum {
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+#define GPIO_PIN_0                  ((uint16_t)0x0001)
+#define GPIO_PIN_1                  ((uint16_t)0x0002)
+#define GPIO_PIN_2                  ((uint16_t)0x0004)
+#define GPIO_PIN_3                  ((uint16_t)0x0008)
+#define GPIO_PIN_4                  ((uint16_t)0x0010)
+#define GPIO_PIN_5                  ((uint16_t)0x0020)
+#define GPIO_PIN_6                  ((uint16_t)0x0040)
+#define GPIO_PIN_7                  ((uint16_t)0x0080)
+#define GPIO_PIN_8                  ((uint16_t)0x0100)
+#define GPIO_PIN_9                  ((uint16_t)0x0200)
+#define GPIO_PIN_10                 ((uint16_t)0x0400)
+#define GPIO_PIN_11                 ((uint16_t)0x0800)
+#define GPIO_PIN_12                 ((uint16_t)0x1000)
+#define GPIO_PIN_13                 ((uint16_t)0x2000)
+#define GPIO_PIN_14                 ((uint16_t)0x4000)
+#define GPIO_PIN_15                 ((uint16_t)0x8000)
+
+/**
+ * Number of the simulated GPIO ports (GPIOA to GPIOC)
+ */
+#define SIM_GPIO_PORTS              (3)
+
+extern GPIO_TypeDef simGpio[SIM_GPIO_PORTS];
+
+#define GPIOA                       (&simGpio[0])
+#define GPIOB                       (&simGpio[1])
+#define GPIOC                       (&simGpio[2])
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState);
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin);
+
+/*
+ * Timer
+ */
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+} TIM_TypeDef;
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+    uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    TIM_TypeDef* Instance;
+    TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+#define TIM_CR1_CEN                 (0x0001U)
+#define TIM_CR1_ARPE                (0x0080U)
+#define TIM_DIER_UIE                (0x0001U)
+#define TIM_SR_UIF                  (0x0001U)
+
+#define TIM_IT_UPDATE               TIM_DIER_UIE
+#define TIM_FLAG_UPDATE             TIM_SR_UIF
+
+#define TIM_COUNTERMODE_UP          (0x0000U)
+#define TIM_CLOCKDIVISION_DIV1      (0x0000U)
+#define TIM_AUTORELOAD_PRELOAD_DISABLE  (0x0000U)
+#define TIM_AUTORELOAD_PRELOAD_ENABLE   TIM_CR1_ARPE
+
+extern TIM_TypeDef simTim3;
+
+#define TIM3                        (&simTim3)
+
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)    ((__HANDLE__)->Instance->DIER |= (__INTERRUPT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__)   ((__HANDLE__)->Instance->DIER &= ~(__INTERRUPT__))
+#define __HAL_TIM_GET_FLAG(__HANDLE__, __FLAG__)          (((__HANDLE__)->Instance->SR &(__FLAG__)) == (__FLAG__))
+#define __HAL_TIM_CLEAR_IT(__HANDLE__, __INTERRUPT__)     ((__HANDLE__)->Instance->SR = ~(__INTERRUPT__))
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __AUTORELOAD__) \
+                        do{                                                    \
+                              (__HANDLE__)->Instance->ARR = (__AUTORELOAD__);  \
+                              (__HANDLE__)->Init.Period = (__AUTORELOAD__);    \
+                          } while(0U)
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_OC_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef* htim);
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef* htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef* htim);
+
+/*
+ * Flash
+ */
+#define FLASH_PAGE_SIZE             (0x400U)
+
+#define FLASH_TYPEERASE_PAGES       (0x00U)
+#define FLASH_TYPEPROGRAM_HALFWORD  (0x01U)
+
+typedef struct {
+    uint32_t TypeErase;
+    uint32_t Banks;
+    uint32_t PageAddress;
+    uint32_t NbPages;
+} FLASH_EraseInitTypeDef;
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address, uint64_t Data);
+HAL_StatusTypeDef HAL_FLASHEx_Erase(FLASH_EraseInitTypeDef* pEraseInit, uint32_t* PageError);
+HAL_StatusTypeDef HAL_FLASHEx_Erase_IT(FLASH_EraseInitTypeDef* pEraseInit);
+void HAL_FLASH_EndOfOperationCallback(uint32_t ReturnValue);
+void HAL_FLASH_OperationErrorCallback(uint32_t ReturnValue);
+
+/*
+ * DMA
+ */
+typedef struct {
+    __IO uint32_t CCR;
+    __IO uint32_t CNDTR;
+    __IO uint32_t CPAR;
+    __IO uint32_t CMAR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+} DMA_InitTypeDef;
+
+typedef struct {
+    DMA_Channel_TypeDef* Instance;
+    DMA_InitTypeDef Init;
+} DMA_HandleTypeDef;
+
+#define DMA_CCR_EN                  (0x0001U)
+#define DMA_CCR_TCIE                (0x0002U)
+#define DMA_CCR_HTIE                (0x0004U)
+
+#define DMA_NORMAL                  (0x0000U)
+#define DMA_CIRCULAR                (0x0020U)
+
+extern DMA_Channel_TypeDef simDma1Channel4;
+extern DMA_Channel_TypeDef simDma1Channel5;
+
+#define DMA1_Channel4               (&simDma1Channel4)
+#define DMA1_Channel5               (&simDma1Channel5)
+
+#define __HAL_DMA_GET_COUNTER(__HANDLE__)   ((__HANDLE__)->Instance->CNDTR)
+
+/*
+ * UART
+ */
+typedef struct {
+    __IO uint32_t SR;
+    __IO uint32_t DR;
+    __IO uint32_t BRR;
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t CR3;
+    __IO uint32_t GTPR;
+} USART_TypeDef;
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef enum {
+    HAL_UART_STATE_RESET        = 0x00U,
+    HAL_UART_STATE_READY        = 0x20U,
+    HAL_UART_STATE_BUSY         = 0x24U,
+    HAL_UART_STATE_BUSY_TX      = 0x21U,
+    HAL_UART_STATE_BUSY_RX      = 0x22U
+} HAL_UART_StateTypeDef;
+
+typedef struct {
+    USART_TypeDef* Instance;
+    UART_InitTypeDef Init;
+    DMA_HandleTypeDef* hdmatx;
+    DMA_HandleTypeDef* hdmarx;
+    __IO HAL_UART_StateTypeDef gState;
+    __IO HAL_UART_StateTypeDef RxState;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define USART_SR_PE                 (0x0001U)
+#define USART_SR_FE                 (0x0002U)
+#define USART_SR_ORE                (0x0008U)
+#define USART_SR_IDLE               (0x0010U)
+#define USART_SR_RXNE               (0x0020U)
+#define USART_SR_TC                 (0x0040U)
+
+#define USART_CR1_IDLEIE            (0x0010U)
+#define USART_CR1_RXNEIE            (0x0020U)
+#define USART_CR1_TCIE              (0x0040U)
+#define USART_CR1_PCE               (0x0400U)
+#define USART_CR1_M                 (0x1000U)
+
+#define UART_WORDLENGTH_8B          (0x0000U)
+#define UART_WORDLENGTH_9B          USART_CR1_M
+#define UART_STOPBITS_1             (0x0000U)
+#define UART_STOPBITS_2             (0x2000U)
+#define UART_PARITY_NONE            (0x0000U)
+#define UART_PARITY_EVEN            USART_CR1_PCE
+#define UART_PARITY_ODD             (0x0600U)
+#define UART_MODE_TX_RX             (0x000CU)
+#define UART_HWCONTROL_NONE         (0x0000U)
+#define UART_OVERSAMPLING_16        (0x0000U)
+
+#define HAL_UART_ERROR_NONE         (0x00U)
+#define HAL_UART_ERROR_FE           (0x04U)
+#define HAL_UART_ERROR_ORE          (0x08U)
+
+/* The interrupt sources are the enable bits of CR1 */
+#define UART_FLAG_IDLE              USART_SR_IDLE
+#define UART_IT_IDLE                USART_CR1_IDLEIE
+
+#define __HAL_UART_GET_FLAG(__HANDLE__, __FLAG__)         (((__HANDLE__)->Instance->SR & (__FLAG__)) == (__FLAG__))
+#define __HAL_UART_GET_IT_SOURCE(__HANDLE__, __IT__)      ((__HANDLE__)->Instance->CR1 & (__IT__))
+#define __HAL_UART_ENABLE_IT(__HANDLE__, __INTERRUPT__)   ((__HANDLE__)->Instance->CR1 |= (__INTERRUPT__))
+#define __HAL_UART_DISABLE_IT(__HANDLE__, __INTERRUPT__)  ((__HANDLE__)->Instance->CR1 &= ~(__INTERRUPT__))
+#define __HAL_UART_CLEAR_IDLEFLAG(__HANDLE__)             ((__HANDLE__)->Instance->SR &= ~USART_SR_IDLE)
+
+extern USART_TypeDef simUsart1;
+
+#define USART1                      (&simUsart1)
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef* huart);
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart);
+
+#endif /* STM32F1XX_HAL_H_ */
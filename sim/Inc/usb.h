@@ -0,0 +1,71 @@
+/**
+ * @file usb.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB host and bulk endpoint model of the host simulation
+ *
+ * Serves the bulk endpoints of the CDC interface (usbd_cdc_if.c and cdc.h)
+ * like a full speed host. Run usb_frame() once per ms from the SysTick hook
+ * (see sim_setTickHook()), the frame is the USB interrupt of the device:
+ *
+ * - OUT: usb_hostWrite() splits the data into packets of
+ *   CDC_DATA_FS_MAX_PACKET_SIZE bytes and terminates a transfer of a
+ *   multiple of the packet size with a zero length packet. Up to
+ *   USB_FRAME_PACKETS packets are received per frame into the armed buffer
+ *   and passed to CDC_Receive_FS(). A packet is NAKed while the endpoint is
+ *   not armed (USBD_CDC_ReceivePacket()).
+ * - IN: a transfer started by USBD_CDC_TransmitPacket() is sent in packets,
+ *   up to USB_FRAME_PACKETS per frame. A transfer of 0 bytes is a zero
+ *   length packet. At its end the TxState is cleared and
+ *   CDC_TransmitCplt_FS() is called. The packets are passed to the IN hook.
+ */
+#ifndef USB_H_
+#define USB_H_
+
+#include "usbd_cdc.h"
+
+/**
+ * Maximum number of packets per direction and frame
+ */
+#define USB_FRAME_PACKETS           (16)
+
+/**
+ * Number of packets which can be queued by the host
+ */
+#define USB_OUT_PACKETS             (256)
+
+/**
+ * Receiver of the IN packets of the host
+ *
+ * @param data Packet
+ * @param len Packet length, 0 for a zero length packet
+ */
+typedef void (*usbInHook_t)(const uint8_t* data, uint16_t len);
+
+/**
+ * Statistics of the USB model since usb_init()
+ */
+typedef struct usbStats_s {
+    uint32_t outPackets;    /* Packets received by the device (with zero length packets) */
+    uint32_t outNaks;       /* Frames with a packet NAKed by the OUT endpoint */
+    uint32_t inPackets;     /* Packets sent by the device */
+    uint32_t inZlps;        /* Zero length packets sent by the device */
+    uint32_t inTransfers;   /* Started IN transfers */
+    uint32_t errors;        /* Buffers armed twice or transfers started while busy */
+} usbStats_t;
+
+void usb_init(void);
+void usb_connect(void);
+void usb_disconnect(void);
+void usb_frame(void);
+uint16_t usb_hostWrite(const uint8_t* data, uint16_t len);
+uint16_t usb_getOutPending(void);
+void usb_setInHook(usbInHook_t hook);
+void usb_getStats(usbStats_t* stats);
+
+#endif /* USB_H_ */
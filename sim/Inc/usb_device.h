@@ -0,0 +1,19 @@
+/**
+ * @file usb_device.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB device of the host build (see usbd_cdc.h and usb.h)
+ */
+#ifndef USB_DEVICE_H_
+#define USB_DEVICE_H_
+
+#include "usbd_cdc.h"
+
+extern USBD_HandleTypeDef hUsbDeviceFS;
+
+#endif /* USB_DEVICE_H_ */
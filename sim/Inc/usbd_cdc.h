@@ -0,0 +1,84 @@
+/**
+ * @file usbd_cdc.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB device library of the host build (CDC class)
+ *
+ * Replaces the core and the CDC class of the STM32 USB device library with
+ * the handles, the interface of usbd_cdc_if.c and the endpoint functions
+ * which cdc.c uses. The endpoints are served by the USB model of usb.h.
+ */
+#ifndef USBD_CDC_H_
+#define USBD_CDC_H_
+
+#include "stm32f1xx_hal.h"
+
+/**
+ * Endpoints and packet size of the full speed device
+ */
+#define CDC_IN_EP                                   0x81
+#define CDC_OUT_EP                                  0x01
+#define CDC_DATA_FS_MAX_PACKET_SIZE                 64
+
+/**
+ * Class requests
+ */
+#define CDC_SEND_ENCAPSULATED_COMMAND               0x00
+#define CDC_GET_ENCAPSULATED_RESPONSE               0x01
+#define CDC_SET_COMM_FEATURE                        0x02
+#define CDC_GET_COMM_FEATURE                        0x03
+#define CDC_CLEAR_COMM_FEATURE                      0x04
+#define CDC_SET_LINE_CODING                         0x20
+#define CDC_GET_LINE_CODING                         0x21
+#define CDC_SET_CONTROL_LINE_STATE                  0x22
+#define CDC_SEND_BREAK                              0x23
+
+/**
+ * Device states
+ */
+#define USBD_STATE_DEFAULT                          1
+#define USBD_STATE_ADDRESSED                        2
+#define USBD_STATE_CONFIGURED                       3
+#define USBD_STATE_SUSPENDED                        4
+
+typedef enum {
+    USBD_OK   = 0,
+    USBD_BUSY,
+    USBD_FAIL
+} USBD_StatusTypeDef;
+
+typedef struct _USBD_HandleTypeDef {
+    uint8_t dev_state;
+    void* pClassData;
+    void* pUserData;
+} USBD_HandleTypeDef;
+
+typedef struct _USBD_CDC_Itf {
+    int8_t (*Init)(void);
+    int8_t (*DeInit)(void);
+    int8_t (*Control)(uint8_t, uint8_t*, uint16_t);
+    int8_t (*Receive)(uint8_t*, uint32_t*);
+    int8_t (*TransmitCplt)(uint8_t*, uint32_t*, uint8_t);
+} USBD_CDC_ItfTypeDef;
+
+typedef struct {
+    uint8_t* RxBuffer;
+    uint8_t* TxBuffer;
+    uint32_t RxLength;
+    uint32_t TxLength;
+
+    volatile uint32_t TxState;
+    volatile uint32_t RxState;
+} USBD_CDC_HandleTypeDef;
+
+uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef* pdev, uint8_t* pbuff, uint16_t length);
+uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef* pdev, uint8_t* pbuff);
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef* pdev);
+uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef* pdev);
+
+#endif /* USBD_CDC_H_ */
@@ -0,0 +1,42 @@
+/**
+ * @file vcd.h
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Value change dump of the pins of the host simulation
+ *
+ * Writes every change of the pins of io.h (MTR_STEP, MTR_DIR, nENABLE,
+ * nSLEEP, nRESET, MS1 - MS3, SW1, SW2 and LD1) with the virtual time to a
+ * value change dump (IEEE 1364), e.g. for GTKWave. The time unit is 1 ns.
+ *
+ * The changes are formatted into a buffer of VCD_BUFFER_SIZE bytes and
+ * written if it is full, so a dump of several minutes of ride costs about
+ * the time of the simulation itself.
+ *
+ * <code>
+ * sim_init();
+ * car_init(CAR_FLOOR0);
+ * vcd_open("ride.vcd");
+ * ...
+ * vcd_close();
+ * </code>
+ */
+#ifndef VCD_H_
+#define VCD_H_
+
+#include <stdint.h>
+
+/**
+ * Size of the output buffer in bytes
+ */
+#define VCD_BUFFER_SIZE             (64 * 1024)
+
+uint8_t vcd_open(const char* path);
+void vcd_close(void);
+uint64_t vcd_getChanges(void);
+
+#endif /* VCD_H_ */
@@ -0,0 +1,143 @@
+/**
+ * @file car.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Elevator car model implementation
+ */
+#include "car.h"
+#include "sim.h"
+#include "main.h"
+
+/**
+ * Car data struct type
+ */
+typedef struct carData_s {
+    int32_t position;
+    carStats_t stats;
+} carData_t;
+
+/**
+ * Module data
+ */
+static carData_t carData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void car_output(GPIO_TypeDef* port, uint16_t changed);
+static int32_t car_microstep(void);
+static void car_updateSwitch(void);
+
+/**
+ * @brief Place the car and connect it to the driver pins
+ *
+ * @warning Run sim_init() before you run this function.
+ *
+ * @param position Position in sixteenth steps
+ */
+void car_init(int32_t position)
+{
+    carData.position = position;
+    carData.stats.steps =
+    carData.stats.lostSteps = 0;
+
+    car_updateSwitch();
+
+    sim_addOutputHook(car_output);
+}
+
+/**
+ * @brief Returns the position in sixteenth steps
+ */
+int32_t car_getPosition(void)
+{
+    return carData.position;
+}
+
+/**
+ * @brief Copy the statistics of the car
+ *
+ * @param stats Destination of the statistics
+ */
+void car_getStats(carStats_t* stats)
+{
+    *stats = carData.stats;
+}
+
+/**
+ * @brief Move the car on a rising edge of MTR_STEP
+ */
+static void car_output(GPIO_TypeDef* port, uint16_t changed)
+{
+    int32_t position;
+
+    if(port != MTR_STEP_GPIO_Port || !(changed & MTR_STEP_Pin) || !(port->ODR & MTR_STEP_Pin))
+    {
+        return;
+    }
+
+    if((MTR_nENABLE_GPIO_Port->ODR & MTR_nENABLE_Pin) ||
+            !(MTR_nSLEEP_GPIO_Port->ODR & MTR_nSLEEP_Pin) ||
+            !(MTR_nRESET_GPIO_Port->ODR & MTR_nRESET_Pin))
+    {
+        return;
+    }
+
+    carData.stats.steps++;
+
+    position = carData.position;
+    if(MTR_DIR_GPIO_Port->ODR & MTR_DIR_Pin)
+    {
+        position += car_microstep();
+    }else
+    {
+        position -= car_microstep();
+    }
+
+    if(position < CAR_END_BOTTOM || position > CAR_END_TOP)
+    {
+        carData.stats.lostSteps++;
+        return;
+    }
+
+    carData.position = position;
+
+    car_updateSwitch();
+}
+
+/**
+ * @brief Returns the sixteenth steps of a step in the mode of MS1 - MS3
+ */
+static int32_t car_microstep(void)
+{
+    uint8_t ms = ((MTR_MS1_GPIO_Port->ODR & MTR_MS1_Pin) ? 1 : 0) |
+            ((MTR_MS2_GPIO_Port->ODR & MTR_MS2_Pin) ? 2 : 0) |
+            ((MTR_MS3_GPIO_Port->ODR & MTR_MS3_Pin) ? 4 : 0);
+
+    switch(ms)
+    {
+    case 0:
+        return 16;
+    case 1:
+        return 8;
+    case 2:
+        return 4;
+    case 3:
+        return 2;
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Set the level of SW2 (low active)
+ */
+static void car_updateSwitch(void)
+{
+    sim_setInput(SW2_IN_GPIO_Port, SW2_IN_Pin,
+            carData.position >= CAR_SWITCH_TOP ? GPIO_PIN_RESET : GPIO_PIN_SET);
+}
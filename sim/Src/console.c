@@ -0,0 +1,815 @@
+/**
+ * @file console.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Service console regression of the host simulation
+ *
+ * Runs cli.c at the simulated USART1 (see sim.h) of a configured board:
+ *
+ * - The commands of a script are typed character by character or pasted at
+ *   once, e.g. a paste of more than the receive buffer. The output must
+ *   match the expected response of every command. After a service move the
+ *   car must return to the idle position.
+ * - A stop in the middle of a ride down and of a ride up must return the
+ *   car to the idle position, the next ride must arrive at floor 1.
+ * - A stream of writes of the configuration at the full line rate wraps the
+ *   log of the EEPROM emulation. The background erases stall the main loop
+ *   and the UART interrupts (see sim.h), no received byte must be lost.
+ * - The SysTick interrupt writes deferred log frames (see mlog.h), first
+ *   of 1 to 4 arguments, first steadily below the bandwidth of the line
+ *   without any drop, then in random bursts above it. A second sink of
+ *   mlog.c records the output of mlog_handler(): every frame must be sent
+ *   complete and in order, the ring must drop exactly the bytes which are
+ *   not sent. While the ring has data the DMA bursts follow back to back.
+ *
+ * The exit code is 1 if a check fails or a warning is logged.
+ *
+ * <code>
+ * elevator-console [-n ms] [-s seed] [-v]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "car.h"
+#include "main.h"
+#include "irq.h"
+#include "app.h"
+#include "usart.h"
+#include "cli.h"
+#include "mlog.h"
+#include "syscalls.h"
+#include "eeprom.h"
+#include "config.h"
+
+/**
+ * Maximum time until the board is idle in ms
+ */
+#define CONSOLE_TIMEOUT             (30 * 1000)
+
+/**
+ * Time between two typed characters and until a response is complete in ms
+ */
+#define CONSOLE_TYPE_TIME           (5)
+#define CONSOLE_RESPONSE_TIME       (50)
+
+/**
+ * Time of a short press of SW1 and from the start of a ride to its stop in ms
+ */
+#define CONSOLE_PRESS_TIME          (100)
+#define CONSOLE_STOP_TIME           (500)
+
+/**
+ * Maximum deviation of the car from its floor (sixteenth steps)
+ */
+#define CONSOLE_TOLERANCE           (8)
+
+/**
+ * Number of writes of the stream, about three pages of the log
+ */
+#define CONSOLE_STREAM_WRITES       (3 * FLASH_PAGE_SIZE / EE_RECORD_SIZE)
+
+/**
+ * Size of the captured output
+ */
+#define CONSOLE_OUTPUT_SIZE         (1024 * 1024)
+
+/**
+ * Token and mean size of the log frames of the test
+ */
+#define CONSOLE_TOKEN               (0x0100)
+#define CONSOLE_FRAME_SIZE          (4 * 2 + 2 * (MLOG_MAX_ARGS + 1))
+
+/**
+ * Console test data struct type
+ */
+typedef struct consoleData_s {
+    /**
+     * Captured output and the time of the last byte
+     */
+    uint8_t output[CONSOLE_OUTPUT_SIZE];
+    uint32_t outputLen;
+    uint64_t lastByte;
+    uint32_t backToBack;
+
+    /**
+     * Output of mlog_handler() passed to the sinks
+     */
+    uint8_t log[CONSOLE_OUTPUT_SIZE];
+    uint32_t logLen;
+
+    /**
+     * Log frames written by the SysTick interrupt: the sequence number of
+     * the next frame, the mean load in bytes per s, random bursts or the
+     * bytes due of the steady load
+     */
+    uint32_t seq;
+    uint32_t load;
+    uint8_t bursts;
+    uint32_t due;
+
+    struct {
+        uint32_t commands;
+        uint32_t frames;    /* Log frames sent at the UART */
+        uint32_t logged;    /* Log frames passed to the sinks */
+        uint32_t reported;  /* Dropped messages reported to the sinks */
+    } stats;
+} consoleData_t;
+
+/**
+ * Result of a parsed log stream
+ */
+typedef struct consoleFrames_s {
+    uint32_t frames;
+    uint32_t missing;
+    uint32_t reported;
+} consoleFrames_t;
+
+/**
+ * Command of the script and its expected response
+ */
+typedef struct consoleCmd_s {
+    const char* input;
+    const char* response;
+    uint8_t paste;          /* 1 to send the input at once */
+} consoleCmd_t;
+
+/**
+ * Module data
+ */
+static consoleData_t consoleData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void console_loop(void);
+static void console_usartIrq(void);
+static void console_output(uint8_t data);
+static void console_tick(void);
+static void console_logSink(const uint8_t* data, uint16_t len);
+static void console_run(uint32_t time);
+static uint8_t console_command(const consoleCmd_t* cmd);
+static uint8_t console_script(void);
+static uint8_t console_waitIdle(void);
+static uint8_t console_ride(uint8_t stop);
+static uint8_t console_stops(void);
+static uint8_t console_stream(void);
+static uint8_t console_log(uint32_t time);
+static uint8_t console_parseFrames(const uint8_t* data, uint32_t len, consoleFrames_t* result);
+
+int main(int argc, char** argv)
+{
+    simStats_t simStats;
+    cliStats_t cliStats;
+    uint32_t time = 10000;
+    uint32_t seed = 1;
+    uint8_t ok;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            time = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n ms] [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    srand(seed);
+
+    /* Configured board at floor 0, see ride.c */
+    sim_init();
+    sim_boot();
+
+    sim_init();
+    car_init(CAR_FLOOR0);
+    sim_boot();
+
+    /* Like main() and USART1_IRQHandler() */
+    irq_setHandler(USART1_IRQn, console_usartIrq);
+    cli_init();
+    sim_setLoopHook(console_loop);
+    sim_setUartHook(console_output);
+
+    while(app_getState() != APP_STATE_IDLE)
+    {
+        if(HAL_GetTick() >= CONSOLE_TIMEOUT)
+        {
+            fprintf(stderr, "idle position not arrived\n");
+            return 1;
+        }
+        sim_loop();
+    }
+
+    ok = console_script() && console_stops() && console_stream() && console_log(time);
+
+    sim_getStats(&simStats);
+    cli_getStats(&cliStats);
+
+    printf("commands        %lu\n", (unsigned long)consoleData.stats.commands);
+    printf("log frames      %lu sent of %lu (%lu dropped by mlog)\n",
+            (unsigned long)consoleData.stats.frames, (unsigned long)consoleData.stats.logged,
+            (unsigned long)consoleData.stats.reported);
+    printf("sent            %lu bytes in %lu bursts (dropped %lu, watermark %u)\n",
+            (unsigned long)cliStats.sent, (unsigned long)cliStats.bursts,
+            (unsigned long)cliStats.dropped, cliStats.highWatermark);
+    printf("back to back    %.1f %%\n", simStats.uartTxBytes ?
+            100.0 * consoleData.backToBack / simStats.uartTxBytes : 0.0);
+    printf("received        %lu bytes (lost %lu, errors %lu, lines %lu)\n",
+            (unsigned long)cliStats.received, (unsigned long)cliStats.rxLost,
+            (unsigned long)cliStats.rxErrors, (unsigned long)cliStats.lines);
+    printf("warnings        %lu\n", (unsigned long)simStats.warnings);
+
+    if(ok && (cliStats.sent != simStats.uartTxBytes || cliStats.bursts != simStats.uartTxBursts))
+    {
+        fprintf(stderr, "statistics of the ring and of the UART differ\n");
+        ok = 0;
+    }
+
+    return (!ok || simStats.warnings || cliStats.rxLost || cliStats.rxErrors) ? 1 : 0;
+}
+
+/**
+ * @brief Handlers of the main loop which are not part of the core
+ */
+static void console_loop(void)
+{
+    cli_handler();
+    mlog_handler();
+}
+
+/**
+ * @brief Interrupt handler of USART1
+ */
+static void console_usartIrq(void)
+{
+    cli_uartIrqHandler();
+    HAL_UART_IRQHandler(&huart1);
+}
+
+/**
+ * @brief Capture a byte sent at USART1
+ */
+static void console_output(uint8_t data)
+{
+    uint64_t now = sim_getCycles();
+    uint64_t charCycles = SIM_CPU_CLOCK * 10 / huart1.Init.BaudRate;
+
+    /* The previous stop bit ended when this start bit began */
+    if(now - consoleData.lastByte <= charCycles + 1)
+    {
+        consoleData.backToBack++;
+    }
+    consoleData.lastByte = now;
+
+    if(consoleData.outputLen < CONSOLE_OUTPUT_SIZE)
+    {
+        consoleData.output[consoleData.outputLen++] = data;
+    }
+}
+
+/**
+ * @brief Write log frames like the interrupts of the firmware
+ *
+ * The steady load writes a frame as soon as its bytes are due. A random
+ * burst of up to 16 frames is written with a probability which gives the
+ * mean load.
+ */
+static void console_tick(void)
+{
+    uint32_t frames = 0;
+
+    if(!consoleData.bursts)
+    {
+        for(consoleData.due += consoleData.load; consoleData.due >= CONSOLE_FRAME_SIZE * 1000;
+                consoleData.due -= CONSOLE_FRAME_SIZE * 1000)
+        {
+            frames++;
+        }
+    }else if((uint32_t)rand() % (16 * CONSOLE_FRAME_SIZE * 1000 / 2) < consoleData.load)
+    {
+        frames = rand() % 17;
+    }
+
+    for(; frames > 0; frames--)
+    {
+        mlog_write(CONSOLE_TOKEN, 1 + consoleData.seq % MLOG_MAX_ARGS, consoleData.seq,
+                ~consoleData.seq, ~consoleData.seq, ~consoleData.seq);
+        consoleData.seq++;
+    }
+}
+
+/**
+ * @brief Record the output of mlog_handler() next to the UART
+ */
+static void console_logSink(const uint8_t* data, uint16_t len)
+{
+    if(consoleData.logLen + len <= CONSOLE_OUTPUT_SIZE)
+    {
+        memcpy(&consoleData.log[consoleData.logLen], data, len);
+        consoleData.logLen += len;
+    }
+}
+
+/**
+ * @brief Run the main loop for a time
+ *
+ * @param time Time in ms
+ */
+static void console_run(uint32_t time)
+{
+    uint32_t start = HAL_GetTick();
+
+    while(HAL_GetTick() - start < time)
+    {
+        sim_loop();
+    }
+}
+
+/**
+ * @brief Send a command and compare the output with the response
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t console_command(const consoleCmd_t* cmd)
+{
+    uint16_t len = strlen(cmd->input);
+    uint16_t i;
+
+    consoleData.outputLen = 0;
+
+    if(cmd->paste)
+    {
+        sim_uartInput((const uint8_t*)cmd->input, len);
+        console_run(len * 10 * 1000 / huart1.Init.BaudRate + 1);
+    }else
+    {
+        for(i = 0; i < len; i++)
+        {
+            sim_uartInput((const uint8_t*)&cmd->input[i], 1);
+            console_run(CONSOLE_TYPE_TIME);
+        }
+    }
+
+    console_run(CONSOLE_RESPONSE_TIME);
+
+    consoleData.stats.commands++;
+
+    if(consoleData.outputLen != strlen(cmd->response) ||
+            memcmp(consoleData.output, cmd->response, consoleData.outputLen) != 0)
+    {
+        fprintf(stderr, "command %lu: response \"%.*s\", expected \"%s\"\n",
+                (unsigned long)consoleData.stats.commands, (int)consoleData.outputLen,
+                (const char*)consoleData.output, cmd->response);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Run the command script
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t console_script(void)
+{
+    static char rangeError[64];
+    static char pasteTrips[32];
+    static char longLine[CLI_LINE_SIZE + 16];
+    static char paste[CLI_RX_BUFFER_SIZE * 2];
+    static char pasteResponse[CLI_RX_BUFFER_SIZE * 2];
+    static char help[1024];
+    const consoleCmd_t cmds[] = {
+            { "log off\r", "ok\r\n", 0 },
+            { "set trips 42\r", "ok\r\n", 0 },
+            { "get trips\r\n", "trips = 42\r\n", 1 },
+            { "set longpress 100\r", rangeError, 1 },
+            { "set longpress 12x\r", rangeError, 0 },
+            { "get speed\r", "error: unknown variable: longpress poweroff floor01 floor12 timeout2 trips modbus\r\n", 1 },
+            { "reboot\r", "error: unknown command, type help\r\n", 1 },
+            { "  get   trips  \r", "trips = 42\r\n", 0 },
+            { "hepl\b\blp\r", help, 0 },
+            { longLine, "error: line too long\r\n", 1 },
+            { "get longpress\r", "longpress = 1000\r\n", 1 },
+            { paste, pasteResponse, 1 },
+            { "get trips\r", pasteTrips, 0 },
+            { "move sideways 100\r", "error: direction must be up or down\r\n", 1 },
+            { "move down 2000\r", "ok\r\n", 1 },
+            { "move down 2000\r", "error: elevator is busy\r\n", 1 },
+    };
+    uint32_t start;
+    uint8_t i;
+
+    snprintf(rangeError, sizeof(rangeError), "error: value out of range %u..%u\r\n",
+            CFG_LONGPRESS_TIME_MIN, CFG_LONGPRESS_TIME_MAX);
+
+    memset(longLine, 'x', sizeof(longLine) - 2);
+    longLine[sizeof(longLine) - 2] = '\r';
+
+    /* More than the receive buffer at once, the DMA wraps around */
+    for(i = 1; i <= CLI_RX_BUFFER_SIZE / 10; i++)
+    {
+        snprintf(paste + strlen(paste), sizeof(paste) - strlen(paste), "set trips %u\r", i);
+        strcat(pasteResponse, "ok\r\n");
+    }
+    snprintf(pasteTrips, sizeof(pasteTrips), "trips = %u\r\n", CLI_RX_BUFFER_SIZE / 10);
+
+    strcat(help, "help                  list the commands\r\n");
+    strcat(help, "get <var>             read a config variable\r\n");
+    strcat(help, "set <var> <value>     write a config variable (active after reset)\r\n");
+    strcat(help, "move <up|down> <steps> service move, the car returns to the idle position\r\n");
+    strcat(help, "stop                  stop the motor, a drive returns to the idle position\r\n");
+    strcat(help, "stats                 dump the statistics\r\n");
+    strcat(help, "log <on|off>          enable the log frames\r\n");
+
+    for(i = 0; i < sizeof(cmds) / sizeof(cmds[0]); i++)
+    {
+        if(!console_command(&cmds[i]))
+        {
+            return 0;
+        }
+    }
+
+    /* The car returns to the idle position after the service move */
+    if(app_getState() != APP_STATE_SERVICE)
+    {
+        fprintf(stderr, "service state not entered\n");
+        return 0;
+    }
+
+    start = HAL_GetTick();
+    while(app_getState() != APP_STATE_IDLE)
+    {
+        if(HAL_GetTick() - start >= APP_SERVICE_TIMEOUT + CONSOLE_TIMEOUT)
+        {
+            fprintf(stderr, "idle position not arrived after the service move\n");
+            return 0;
+        }
+        sim_loop();
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Run the main loop until the application is idle
+ *
+ * @return 1 on success, 0 on timeout
+ */
+static uint8_t console_waitIdle(void)
+{
+    uint32_t start = HAL_GetTick();
+
+    while(app_getState() != APP_STATE_IDLE)
+    {
+        if(HAL_GetTick() - start >= CONSOLE_TIMEOUT)
+        {
+            return 0;
+        }
+        sim_loop();
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Ride to the next floor by a short press of SW1
+ *
+ * @param stop 1 to stop the ride by the console after CONSOLE_STOP_TIME
+ *
+ * @return 1 if the application is idle afterwards otherwise 0
+ */
+static uint8_t console_ride(uint8_t stop)
+{
+    const consoleCmd_t stopCmd = { "stop\r", "ok\r\n", 1 };
+    uint32_t start;
+    uint8_t state;
+
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_RESET);
+    console_run(CONSOLE_PRESS_TIME);
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_SET);
+
+    /* The press is detected at the release */
+    start = HAL_GetTick();
+    while((state = app_getState()) == APP_STATE_IDLE && HAL_GetTick() - start < CONSOLE_PRESS_TIME)
+    {
+        sim_loop();
+    }
+
+    if(state != APP_STATE_DRIVING_UP && state != APP_STATE_DRIVING_DOWN)
+    {
+        fprintf(stderr, "no ride started\n");
+        return 0;
+    }
+
+    if(stop)
+    {
+        console_run(CONSOLE_STOP_TIME);
+        if(app_getState() != state || !console_command(&stopCmd))
+        {
+            fprintf(stderr, "ride %s not stopped\n", state == APP_STATE_DRIVING_UP ? "up" : "down");
+            return 0;
+        }
+    }
+
+    if(!console_waitIdle())
+    {
+        fprintf(stderr, "ride %s not ended\n", state == APP_STATE_DRIVING_UP ? "up" : "down");
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Stop a ride down and a ride up by the console
+ *
+ * The car starts at the idle position. It must return to it after each stop,
+ * the floor of the application must follow.
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t console_stops(void)
+{
+    int32_t idle = car_getPosition();
+    int32_t deviation;
+    uint16_t level1_2;
+    uint8_t i;
+
+    ee_readVariable(CFG_FLOOR_1_2_TICKS_VADDR, &level1_2);
+
+    /* Floor 2 to 1 stopped, floor 2 to 1 to 0 to 1 with the last ride stopped */
+    for(i = 0; i < 5; i++)
+    {
+        if(!console_ride(i == 0 || i == 3))
+        {
+            return 0;
+        }
+
+        deviation = car_getPosition() - idle;
+        if((i == 0 || i == 3) && (app_getFloor() != APP_FLOOR_2 ||
+                deviation < -CONSOLE_TOLERANCE || deviation > CONSOLE_TOLERANCE))
+        {
+            fprintf(stderr, "car at %ld, floor %u after the stop\n", (long)car_getPosition(), app_getFloor());
+            return 0;
+        }
+    }
+
+    deviation = car_getPosition() - (idle - level1_2);
+    if(app_getFloor() != APP_FLOOR_1 || deviation < -CONSOLE_TOLERANCE || deviation > CONSOLE_TOLERANCE)
+    {
+        fprintf(stderr, "car at %ld, floor %u after the ride\n", (long)car_getPosition(), app_getFloor());
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Stream writes of the configuration across background erases
+ *
+ * The commands follow back to back at the line rate, the input is queued at
+ * the receive line as it has room.
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t console_stream(void)
+{
+    static char input[CONSOLE_STREAM_WRITES * 16];
+    const consoleCmd_t getTrips = { "get trips\r", "trips = 1000\r\n", 1 };
+    simStats_t simStats;
+    uint32_t erases;
+    uint32_t inputLen = 0;
+    uint32_t pos = 0;
+    uint32_t start;
+    uint32_t i;
+
+    for(i = 0; i < CONSOLE_STREAM_WRITES; i++)
+    {
+        inputLen += snprintf(&input[inputLen], sizeof(input) - inputLen, "set trips %lu\r",
+                (unsigned long)(CONSOLE_STREAM_WRITES - i + 999));
+    }
+
+    sim_getStats(&simStats);
+    erases = simStats.flashBgErases;
+    consoleData.outputLen = 0;
+
+    start = HAL_GetTick();
+    while(pos < inputLen || consoleData.outputLen < CONSOLE_STREAM_WRITES * 4)
+    {
+        if(HAL_GetTick() - start >= CONSOLE_TIMEOUT)
+        {
+            fprintf(stderr, "stream: %lu of %lu responses\n", (unsigned long)consoleData.outputLen / 4,
+                    (unsigned long)CONSOLE_STREAM_WRITES);
+            return 0;
+        }
+
+        pos += sim_uartInput((const uint8_t*)&input[pos], inputLen - pos);
+        sim_loop();
+    }
+    console_run(CONSOLE_RESPONSE_TIME);
+
+    consoleData.stats.commands += CONSOLE_STREAM_WRITES;
+
+    for(i = 0; i < consoleData.outputLen; i += 4)
+    {
+        if(memcmp(&consoleData.output[i], "ok\r\n", 4) != 0)
+        {
+            fprintf(stderr, "stream: response %lu \"%.*s\"\n", (unsigned long)i / 4,
+                    (int)(consoleData.outputLen - i), (const char*)&consoleData.output[i]);
+            return 0;
+        }
+    }
+
+    sim_getStats(&simStats);
+    if(consoleData.outputLen != CONSOLE_STREAM_WRITES * 4 || simStats.flashBgErases - erases < 2)
+    {
+        fprintf(stderr, "stream: %lu responses, %lu erases\n", (unsigned long)consoleData.outputLen / 4,
+                (unsigned long)(simStats.flashBgErases - erases));
+        return 0;
+    }
+
+    return console_command(&getTrips);
+}
+
+/**
+ * @brief Write log frames below and above the bandwidth of the line
+ *
+ * @param time Time of each load in ms
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t console_log(uint32_t time)
+{
+    const consoleCmd_t logOn = { "log on\r", "ok\r\n", 1 };
+    uint32_t lineRate = huart1.Init.BaudRate / 10;
+    cliStats_t cliStats;
+    consoleFrames_t sent;
+    consoleFrames_t logged;
+
+    if(!console_command(&logOn))
+    {
+        return 0;
+    }
+
+    consoleData.outputLen = 0;
+    mlog_addSink(console_logSink);
+    sim_setTickHook(console_tick);
+
+    /* Steady 90 % of the bandwidth, nothing is dropped */
+    consoleData.load = lineRate * 9 / 10;
+    console_run(time);
+
+    cli_getStats(&cliStats);
+    if(cliStats.dropped || mlog_getDropped())
+    {
+        fprintf(stderr, "output dropped below the bandwidth of the line\n");
+        return 0;
+    }
+
+    /* Bursts of twice the bandwidth */
+    consoleData.bursts = 1;
+    consoleData.load = lineRate * 2;
+    console_run(time);
+
+    consoleData.load = 0;
+    console_run(CONSOLE_RESPONSE_TIME + CLI_TX_BUFFER_SIZE * 10 * 1000 / huart1.Init.BaudRate);
+
+    if(!console_parseFrames(consoleData.log, consoleData.logLen, &logged) ||
+            !console_parseFrames(consoleData.output, consoleData.outputLen, &sent))
+    {
+        return 0;
+    }
+
+    consoleData.stats.frames = sent.frames;
+    consoleData.stats.logged = logged.frames;
+    consoleData.stats.reported = logged.reported;
+
+    /* mlog.c reports every dropped message, the ring drops whole writes */
+    cli_getStats(&cliStats);
+    if(logged.missing != mlog_getDropped() || logged.reported != logged.missing ||
+            consoleData.outputLen + cliStats.dropped != consoleData.logLen)
+    {
+        fprintf(stderr, "%lu frames dropped by mlog (reported %lu, counted %lu), "
+                "%lu of %lu bytes sent, %lu dropped by the ring\n",
+                (unsigned long)logged.missing, (unsigned long)logged.reported,
+                (unsigned long)mlog_getDropped(), (unsigned long)consoleData.outputLen,
+                (unsigned long)consoleData.logLen, (unsigned long)cliStats.dropped);
+        return 0;
+    }
+
+    if(sent.frames == 0 || sent.frames == logged.frames)
+    {
+        fprintf(stderr, "no log frames or no overload\n");
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Check a stream of log frames
+ *
+ * Every frame must be complete and the frames of the test must be in order.
+ *
+ * @param data Stream
+ * @param len Length of the stream
+ * @param result Frames of the test, missing frames and reported drops
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t console_parseFrames(const uint8_t* data, uint32_t len, consoleFrames_t* result)
+{
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    uint32_t words[2 + MLOG_MAX_ARGS];
+    uint32_t expected = 0;
+    uint8_t nargs;
+    uint8_t i;
+
+    memset(result, 0, sizeof(*result));
+
+    while(p < end)
+    {
+        if(end - p < 8)
+        {
+            fprintf(stderr, "log frame incomplete at byte %lu\n", (unsigned long)(p - data));
+            return 0;
+        }
+
+        memcpy(words, p, 8);
+        nargs = (words[0] >> 16) & 0xFF;
+        if((words[0] >> 24) != MLOG_FRAME_SYNC || nargs > MLOG_MAX_ARGS || end - p < 8 + 4 * nargs)
+        {
+            fprintf(stderr, "log frame corrupt at byte %lu\n", (unsigned long)(p - data));
+            return 0;
+        }
+
+        memcpy(&words[2], p + 8, 4 * nargs);
+        p += 8 + 4 * nargs;
+
+        if((words[0] & 0xFFFF) == MLOG_TOKEN_DROPPED && nargs == 1)
+        {
+            result->reported += words[2];
+            continue;
+        }
+
+        if((words[0] & 0xFFFF) != CONSOLE_TOKEN || words[2] < expected ||
+                nargs != 1 + words[2] % MLOG_MAX_ARGS)
+        {
+            fprintf(stderr, "log frame %lu wrong or out of order\n", (unsigned long)words[2]);
+            return 0;
+        }
+
+        for(i = 1; i < nargs; i++)
+        {
+            if(words[2 + i] != ~words[2])
+            {
+                fprintf(stderr, "log frame %lu corrupt\n", (unsigned long)words[2]);
+                return 0;
+            }
+        }
+
+        result->missing += words[2] - expected;
+        result->frames++;
+        expected = words[2] + 1;
+    }
+
+    result->missing += consoleData.seq - expected;
+
+    return 1;
+}
+
+/**
+ * @brief ITM output of syscalls.c, there is no debugger at the host
+ */
+int _write(int file, char* ptr, int len)
+{
+    return len;
+}
+
+/**
+ * @brief Statistics of the ITM output, see _write()
+ */
+void sys_getItmStats(sysItmStats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
@@ -0,0 +1,416 @@
+/**
+ * @file erase.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Background erase regression of the host simulation
+ *
+ * Runs rides like elevator-sim and writes the trip count during every drive
+ * until the log of the EEPROM emulation wraps and a reclaimed page is erased
+ * in the background. The erase stalls the main loop (see sim.h), only the
+ * step interrupt runs from RAM:
+ *
+ * - the motor must keep stepping during the erase,
+ * - every second ride starts the erase shortly before the car arrives, the
+ *   step interrupt must stop the motor at its floor,
+ * - after the flash interrupt the erase counter of the page must be
+ *   incremented and the written value must be readable.
+ *
+ * Every ride must end at its floor. The SysTick runs from flash, its ticks
+ * during an erase are lost. The exit code is 1 if a check fails, a warning
+ * is logged or more ticks are lost than the erases take.
+ *
+ * <code>
+ * elevator-erase [-n rides] [-v]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "car.h"
+#include "main.h"
+#include "app.h"
+#include "stepper.h"
+#include "eeprom.h"
+#include "config.h"
+
+/**
+ * Time of a short press of SW1 in ms
+ */
+#define ERASE_PRESS_TIME            (100)
+
+/**
+ * Maximum time of a ride and of the drive to the idle position in ms
+ */
+#define ERASE_TIMEOUT               (30 * 1000)
+
+/**
+ * Maximum deviation of the car from its floor (sixteenth steps)
+ */
+#define ERASE_TOLERANCE             (8)
+
+/**
+ * Maximum number of writes until the log wraps
+ */
+#define ERASE_MAX_WRITES            (EE_PAGE_COUNT * FLASH_PAGE_SIZE / EE_RECORD_SIZE)
+
+/**
+ * Distance of the car from its floor (sixteenth steps) at which the erase
+ * overlapping the end of a ride is started
+ */
+#define ERASE_END_DISTANCE          (4)
+
+/**
+ * Writes left until the log wraps when the car approaches its floor, the
+ * writes before are done at the start of the drive
+ */
+#define ERASE_END_WRITES            (8)
+
+/**
+ * Erase test data struct type
+ */
+typedef struct eraseData_s {
+    /**
+     * Expected position of the floors
+     */
+    int32_t floors[3];
+
+    /**
+     * Writes until the log wrapped by the last two rides, the number depends
+     * on the direction
+     */
+    uint32_t wrapWrites[2];
+
+    struct {
+        uint32_t rides;
+        uint32_t erases;
+        uint32_t endErases;     /* Erases overlapping the end of a ride */
+        uint32_t writes;
+        uint32_t minSteps;      /* Fewest steps of the motor during an erase */
+        uint32_t maxEraseUs;    /* Longest erase up to its completion */
+    } stats;
+} eraseData_t;
+
+/**
+ * Module data
+ */
+static eraseData_t eraseData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t erase_waitState(uint8_t idle, uint32_t timeout);
+static void erase_press(uint32_t time);
+static uint32_t erase_getEraseCount(void);
+static uint8_t erase_approach(int32_t floor, uint32_t timeout);
+static uint8_t erase_ride(void);
+
+int main(int argc, char** argv)
+{
+    simStats_t simStats;
+    carStats_t carStats;
+    uint32_t rides = 20;
+    uint16_t level0_1, level1_2;
+    uint32_t i;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            rides = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n rides] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* Configured board at floor 0, see ride.c */
+    sim_init();
+    sim_boot();
+
+    sim_init();
+    car_init(CAR_FLOOR0);
+    sim_boot();
+
+    if(!erase_waitState(1, ERASE_TIMEOUT))
+    {
+        fprintf(stderr, "idle position not arrived\n");
+        return 1;
+    }
+
+    ee_readVariable(CFG_FLOOR_0_1_TICKS_VADDR, &level0_1);
+    ee_readVariable(CFG_FLOOR_1_2_TICKS_VADDR, &level1_2);
+
+    eraseData.floors[APP_FLOOR_2] = car_getPosition();
+    eraseData.floors[APP_FLOOR_1] = eraseData.floors[APP_FLOOR_2] - level1_2;
+    eraseData.floors[APP_FLOOR_0] = eraseData.floors[APP_FLOOR_1] - level0_1;
+    eraseData.stats.minSteps = UINT32_MAX;
+
+    for(i = 0; i < rides; i++)
+    {
+        if(!erase_ride())
+        {
+            break;
+        }
+    }
+
+    sim_getStats(&simStats);
+    car_getStats(&carStats);
+
+    printf("rides           %lu\n", (unsigned long)eraseData.stats.rides);
+    printf("erases          %lu (background %lu, ride end %lu)\n",
+            (unsigned long)eraseData.stats.erases, (unsigned long)simStats.flashBgErases,
+            (unsigned long)eraseData.stats.endErases);
+    printf("writes          %lu\n", (unsigned long)eraseData.stats.writes);
+    if(eraseData.stats.erases)
+    {
+        printf("steps/erase     %lu (min)\n", (unsigned long)eraseData.stats.minSteps);
+        printf("erase us        %lu (max)\n", (unsigned long)eraseData.stats.maxEraseUs);
+    }
+    printf("warnings        %lu\n", (unsigned long)simStats.warnings);
+    printf("steps           %lu (lost %lu)\n", (unsigned long)carStats.steps, (unsigned long)carStats.lostSteps);
+    printf("lost ticks      %lu\n", (unsigned long)simStats.lostTicks);
+
+    return (eraseData.stats.rides != rides || simStats.warnings ||
+            simStats.lostTicks > eraseData.stats.erases * (SIM_FLASH_ERASE_CYCLES / SIM_TICK_CYCLES) ||
+            eraseData.stats.endErases < rides / 2 - 1 ||
+            simStats.flashBgErases != eraseData.stats.erases) ? 1 : 0;
+}
+
+/**
+ * @brief Run the main loop until the application enters or leaves the idle
+ * state with a stopped motor
+ *
+ * @param idle 1 to wait for the idle state, 0 to wait for a drive
+ * @param timeout Timeout in ms
+ *
+ * @return 1 on success, 0 on timeout
+ */
+static uint8_t erase_waitState(uint8_t idle, uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+    uint8_t state;
+
+    while(HAL_GetTick() - start < timeout)
+    {
+        sim_loop();
+
+        state = (app_getState() == APP_STATE_IDLE &&
+                (stp_getState() == STP_STATE_IDLE || stp_getState() == STP_STATE_ARRIVED));
+        if(state == idle)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Press and release SW1
+ *
+ * @param time Press time in ms
+ */
+static void erase_press(uint32_t time)
+{
+    uint32_t start = HAL_GetTick();
+
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_RESET);
+    while(HAL_GetTick() - start < time)
+    {
+        sim_loop();
+    }
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_SET);
+}
+
+/**
+ * @brief Returns the sum of the erase counters of all pages
+ */
+static uint32_t erase_getEraseCount(void)
+{
+    uint32_t sum = 0;
+    uint16_t page;
+
+    for(page = 0; page < EE_PAGE_COUNT; page++)
+    {
+        sum += ee_getPageEraseCount(page);
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Run the main loop until the car is close to a floor
+ *
+ * @param floor Position of the floor
+ * @param timeout Timeout in ms
+ *
+ * @return 1 on success, 0 on timeout
+ */
+static uint8_t erase_approach(int32_t floor, uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+
+    while(HAL_GetTick() - start < timeout)
+    {
+        if(car_getPosition() - floor <= ERASE_END_DISTANCE &&
+                floor - car_getPosition() <= ERASE_END_DISTANCE)
+        {
+            return 1;
+        }
+        sim_loop();
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Ride to the next floor, wrap the log during the drive and check the
+ * background erase and the position of the car
+ *
+ * A ride with an odd number starts the erase shortly before the car arrives
+ * if the writes of the ride before in the same direction are known. Most of
+ * its writes are done at the start of the drive.
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t erase_ride(void)
+{
+    carStats_t carStats;
+    uint32_t erases = erase_getEraseCount();
+    uint8_t rideEnd = (eraseData.stats.rides & 1) && eraseData.wrapWrites[1] > ERASE_END_WRITES;
+    uint32_t writes = 0;
+    uint32_t steps = 0;
+    uint64_t start = 0;
+    int32_t position;
+    int32_t floor;
+    uint16_t trips;
+    uint16_t data;
+    int32_t deviation;
+
+    position = car_getPosition();
+    erase_press(ERASE_PRESS_TIME);
+
+    if(!erase_waitState(0, ERASE_TIMEOUT))
+    {
+        fprintf(stderr, "ride %lu: no drive started\n", (unsigned long)eraseData.stats.rides);
+        return 0;
+    }
+    floor = eraseData.floors[app_getFloor()];
+
+    /* The step interrupt is started by the main loop, wait for the first step */
+    while(car_getPosition() == position)
+    {
+        sim_loop();
+    }
+
+    /* The value of the cached trip count, the write keeps the cache clean */
+    trips = app_getTrips();
+    while(!ee_isBusy())
+    {
+        if(rideEnd && writes == eraseData.wrapWrites[1] - ERASE_END_WRITES &&
+                !erase_approach(floor, ERASE_TIMEOUT))
+        {
+            fprintf(stderr, "ride %lu: floor not approached\n", (unsigned long)eraseData.stats.rides);
+            return 0;
+        }
+
+        /* The erase is started by a write and stalls it until its end */
+        car_getStats(&carStats);
+        steps = carStats.steps;
+        start = sim_getCycles();
+
+        if(writes++ >= ERASE_MAX_WRITES || ee_writeVariable(CFG_TRIP_COUNT_VADDR, trips) != HAL_OK)
+        {
+            fprintf(stderr, "ride %lu: write %lu failed\n", (unsigned long)eraseData.stats.rides,
+                    (unsigned long)writes);
+            return 0;
+        }
+    }
+    eraseData.stats.writes += writes;
+    if(rideEnd && writes <= eraseData.wrapWrites[1] - ERASE_END_WRITES)
+    {
+        /* The log wrapped before the car approached its floor */
+        rideEnd = 0;
+    }
+    eraseData.wrapWrites[eraseData.stats.rides & 1] = writes;
+
+    /* Like the main loop the completion follows the erase */
+    while(ee_isBusy())
+    {
+        if(sim_getCycles() - start >= (uint64_t)ERASE_TIMEOUT * SIM_TICK_CYCLES)
+        {
+            fprintf(stderr, "ride %lu: erase not completed\n", (unsigned long)eraseData.stats.rides);
+            return 0;
+        }
+        sim_loop();
+    }
+
+    car_getStats(&carStats);
+    steps = carStats.steps - steps;
+    if(steps < eraseData.stats.minSteps)
+    {
+        eraseData.stats.minSteps = steps;
+    }
+    if((sim_getCycles() - start) / (SIM_CPU_CLOCK / 1000000) > eraseData.stats.maxEraseUs)
+    {
+        eraseData.stats.maxEraseUs = (sim_getCycles() - start) / (SIM_CPU_CLOCK / 1000000);
+    }
+
+    if(steps == 0 || stp_getState() == STP_STATE_IDLE)
+    {
+        fprintf(stderr, "ride %lu: motor stopped during the erase\n", (unsigned long)eraseData.stats.rides);
+        return 0;
+    }
+
+    if(erase_getEraseCount() != erases + 1 ||
+            ee_readVariable(CFG_TRIP_COUNT_VADDR, &data) != 0 || data != trips)
+    {
+        fprintf(stderr, "ride %lu: erase counter or value wrong\n", (unsigned long)eraseData.stats.rides);
+        return 0;
+    }
+    eraseData.stats.erases++;
+
+    /* The motor is stopped at the floor by the step interrupt during the erase */
+    if(rideEnd)
+    {
+        deviation = car_getPosition() - floor;
+        if(stp_getState() != STP_STATE_ARRIVED || deviation < -ERASE_TOLERANCE || deviation > ERASE_TOLERANCE)
+        {
+            fprintf(stderr, "ride %lu: car at %ld after the erase, floor %u at %ld\n",
+                    (unsigned long)eraseData.stats.rides, (long)car_getPosition(), app_getFloor(),
+                    (long)floor);
+            return 0;
+        }
+        eraseData.stats.endErases++;
+    }
+
+    if(!erase_waitState(1, ERASE_TIMEOUT))
+    {
+        fprintf(stderr, "ride %lu: floor not arrived\n", (unsigned long)eraseData.stats.rides);
+        return 0;
+    }
+
+    deviation = car_getPosition() - eraseData.floors[app_getFloor()];
+    if(deviation < -ERASE_TOLERANCE || deviation > ERASE_TOLERANCE)
+    {
+        fprintf(stderr, "ride %lu: car at %ld, floor %u at %ld\n", (unsigned long)eraseData.stats.rides,
+                (long)car_getPosition(), app_getFloor(), (long)eraseData.floors[app_getFloor()]);
+        return 0;
+    }
+
+    eraseData.stats.rides++;
+
+    return 1;
+}
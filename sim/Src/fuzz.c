@@ -0,0 +1,612 @@
+/**
+ * @file fuzz.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief libFuzzer target of the application core
+ *
+ * Every input is one power on of the simulated elevator: the input bytes
+ * select the configuration, the start of the car and a sequence of presses
+ * and waits of SW1. The levels of SW1 are set by the read which samples them
+ * (see sim_setReadHook()), so the bouncing of a fuzzed sequence also reaches
+ * the busy waits of the setup assistant. SW1 pressed at power on is released
+ * when the operations start. The run stops after the last operation plus
+ * FUZZ_SETTLE_TIME, at most after FUZZ_MAX_TIME. The main loops of the quiet
+ * application are skipped (see fuzz_skip()), so the time of a run depends on
+ * its rides only.
+ *
+ * Input layout:
+ * <code>
+ * [flags] [floor 0-1] [floor 1-2] [timeout] [op] [op] ...
+ *
+ * flags       bit 0: SW1 pressed at power on (setup assistant)
+ *             bit 1-5: start of the car (4 * n + 1) below SW2
+ * floor x-y   distance of the floors, 2 * n sixteenth steps
+ * timeout     timeout of the drive to floor 2, 100 + 20 * n ms
+ * op          0b00nnnnnn press SW1 for n ms (bounce)
+ *             0b01nnnnnn press SW1 for 16 * (n + 1) ms (short press)
+ *             0b10nnnnnn press SW1 for 1000 + n ms (long press)
+ *             0b11nnnnnn wait (n + 1)^2 ms
+ * </code>
+ *
+ * A violation of these invariants aborts the run:
+ * - the motor steps while the application is idle
+ * - a drive up lasts longer than its timeout (in SysTick periods, the flash
+ *   stalls delay the SysTick like on the target)
+ * - the car does not stand at the floor of the application when it enters
+ *   the idle state. The check is suspended after a drive up which was
+ *   stopped by its timeout, the application loses its floor by design then.
+ *
+ * Build the libFuzzer target with clang (make fuzz). Built with
+ * FUZZ_STANDALONE, the target runs the given inputs or random inputs and
+ * reports the executions per second:
+ * <code>
+ * elevator-fuzz-run [-n runs] [-s seed] [-l size] [-v] [input ...]
+ * </code>
+ *
+ * The throughput is bound by the simulated rides: every step of the motor is
+ * a TIM3 interrupt of the simulation. The standalone build runs about 55k
+ * exec/s with 4 byte inputs, 7k exec/s with 16 byte inputs and 1.7k exec/s
+ * with 64 byte inputs on one desktop core (elevator-fuzz-run -n 20000 -l n).
+ * The libFuzzer build adds the coverage instrumentation on top. Keep
+ * -max_len small to fuzz the setup assistant and the first rides quickly.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "car.h"
+#include "main.h"
+#include "irq.h"
+#include "app.h"
+#include "stepper.h"
+#include "btn.h"
+#include "tim.h"
+#include "eeprom.h"
+#include "config.h"
+
+/**
+ * Maximum virtual time of a run in ms
+ */
+#define FUZZ_MAX_TIME               (30 * 1000)
+
+/**
+ * Time after the last operation in ms
+ */
+#define FUZZ_SETTLE_TIME            (2000)
+
+/**
+ * Maximum number of operations
+ */
+#define FUZZ_MAX_OPS                (256)
+
+/**
+ * Maximum deviation of the car from its floor (sixteenth steps)
+ */
+#define FUZZ_TOLERANCE              (8)
+
+/**
+ * Maximum delay of the stop at the timeout of a drive up in ms
+ */
+#define FUZZ_TIMEOUT_SLACK          (2)
+
+/**
+ * Time after which the waiting application is quiet with released and with
+ * pressed SW1 in ms (see fuzz_skip())
+ */
+#define FUZZ_QUIET_TIME             (100)
+#define FUZZ_QUIET_PRESSED_TIME     (1100)
+
+/**
+ * Reads within one iteration of the main loop which are a busy wait
+ */
+#define FUZZ_BUSY_READS             (100)
+
+/**
+ * Change of SW1 at a virtual time
+ */
+typedef struct fuzzEvent_s {
+    uint64_t time;
+    GPIO_PinState level;
+} fuzzEvent_t;
+
+/**
+ * Fuzz data struct type
+ */
+typedef struct fuzzData_s {
+    /**
+     * Formatted flash image of the EEPROM emulation
+     */
+    uint8_t flash[SIM_FLASH_SIZE];
+    uint8_t formatted;
+
+    const uint8_t* input;
+    size_t size;
+
+    fuzzEvent_t events[2 * FUZZ_MAX_OPS + 1];
+    uint16_t count;
+    uint16_t next;
+
+    uint16_t timeout;
+
+    /**
+     * Expected position of the floors, valid while floorsValid is set
+     */
+    int32_t floors[3];
+    uint8_t floorsValid;
+
+    uint8_t state;
+    uint32_t driveUpStarted;
+
+    /**
+     * Start of the quiet application and its next change of SW1, valid
+     * while quiet is set, and the tick of the last read of an input
+     */
+    uint32_t quietSince;
+    uint16_t quietNext;
+    uint8_t quiet;
+    uint32_t lastRead;
+
+    /**
+     * Reads in the current iteration of the main loop
+     */
+    uint32_t reads;
+} fuzzData_t;
+
+/**
+ * Module data
+ */
+static fuzzData_t fuzzData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+static void fuzz_boot(const uint8_t* data);
+static uint64_t fuzz_schedule(const uint8_t* ops, size_t count);
+static void fuzz_inputs(void);
+static void fuzz_output(GPIO_TypeDef* port, uint16_t changed);
+static void fuzz_check(void);
+static void fuzz_skip(uint64_t end);
+static void fuzz_fail(const char* reason);
+
+/**
+ * @brief Run one input (libFuzzer entry point)
+ *
+ * @return Always 0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    uint64_t end;
+
+    if(size < 4)
+    {
+        return 0;
+    }
+
+    fuzzData.input = data;
+    fuzzData.size = size;
+
+    fuzz_boot(data);
+
+    end = fuzz_schedule(&data[4], size - 4);
+    while(sim_getCycles() < end)
+    {
+        fuzzData.reads = 0;
+        sim_loop();
+        fuzz_check();
+        fuzz_skip(end);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Configure the flash, place the car and power the elevator on
+ *
+ * @param data Header of the input
+ */
+static void fuzz_boot(const uint8_t* data)
+{
+    /* Format the blank flash once, every run starts with a copy of it */
+    if(!fuzzData.formatted)
+    {
+        sim_init();
+        sim_eraseFlash();
+        irq_init();
+        ee_init();
+        sim_saveFlash(fuzzData.flash);
+        fuzzData.formatted = 1;
+    }
+
+    sim_loadFlash(fuzzData.flash);
+    sim_init();
+    irq_init();
+    ee_init();
+
+    fuzzData.timeout = 100 + 20 * data[3];
+
+    ee_writeVariable(CFG_FLOOR_0_1_TICKS_VADDR, 2 * data[1]);
+    ee_writeVariable(CFG_FLOOR_1_2_TICKS_VADDR, 2 * data[2]);
+    ee_writeVariable(CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR, fuzzData.timeout);
+
+    /* Reset with the configured flash */
+    sim_init();
+
+    car_init(CAR_SWITCH_TOP - 4 * ((data[0] >> 1) & 0x1F) - 1);
+    if(data[0] & 0x01)
+    {
+        sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_RESET);
+    }
+
+    sim_addOutputHook(fuzz_output);
+    sim_setReadHook(fuzz_inputs);
+
+    fuzzData.count = 0;
+    fuzzData.next = 0;
+    fuzzData.floorsValid = 0;
+    fuzzData.state = APP_STATE_INIT;
+    fuzzData.quiet = 0;
+
+    sim_boot();
+}
+
+/**
+ * @brief Convert the operations into the changes of SW1
+ *
+ * @param ops Operations of the input
+ * @param count Number of operations
+ *
+ * @return End of the run in CPU cycles
+ */
+static uint64_t fuzz_schedule(const uint8_t* ops, size_t count)
+{
+    uint64_t time = sim_getCycles();
+    uint64_t max = time + (uint64_t)FUZZ_MAX_TIME * SIM_TICK_CYCLES;
+    uint32_t press, wait;
+    size_t i;
+
+    /* Release SW1 pressed at power on */
+    fuzzData.events[0].time = time;
+    fuzzData.events[0].level = GPIO_PIN_SET;
+    fuzzData.count = 1;
+    fuzzData.next = 0;
+
+    for(i = 0; i < count && i < FUZZ_MAX_OPS && time < max; i++)
+    {
+        press = 0;
+        wait = 0;
+
+        switch(ops[i] >> 6)
+        {
+        case 0:
+            press = ops[i] & 0x3F;
+            break;
+        case 1:
+            press = 16 * ((ops[i] & 0x3F) + 1);
+            break;
+        case 2:
+            /* The setup assistant busy waits for the release after a long
+             * press, the time beyond the detection is kept short
+             */
+            press = 1000 + (ops[i] & 0x3F);
+            break;
+        default:
+            wait = ((ops[i] & 0x3F) + 1) * ((ops[i] & 0x3F) + 1);
+            break;
+        }
+
+        if(press)
+        {
+            fuzzData.events[fuzzData.count].time = time;
+            fuzzData.events[fuzzData.count].level = GPIO_PIN_RESET;
+            fuzzData.count++;
+
+            time += (uint64_t)press * SIM_TICK_CYCLES;
+
+            fuzzData.events[fuzzData.count].time = time;
+            fuzzData.events[fuzzData.count].level = GPIO_PIN_SET;
+            fuzzData.count++;
+        }
+
+        time += (uint64_t)wait * SIM_TICK_CYCLES;
+    }
+
+    time += (uint64_t)FUZZ_SETTLE_TIME * SIM_TICK_CYCLES;
+
+    return time < max ? time : max;
+}
+
+/**
+ * @brief Set SW1 to the level of the operations up to the current time
+ *
+ * Runs before every read of an input pin. A busy wait for SW1 (the setup
+ * assistant waits for the release) passes the virtual time up to its last
+ * read before the next change of SW1 at once. Its reads take
+ * SIM_GPIO_READ_CYCLES each, the interrupts are served meanwhile.
+ */
+static void fuzz_inputs(void)
+{
+    uint64_t time = sim_getCycles();
+    uint16_t next = fuzzData.next;
+    uint64_t reads;
+
+    fuzzData.lastRead = HAL_GetTick();
+
+    for(; fuzzData.next < fuzzData.count && fuzzData.events[fuzzData.next].time <= time; fuzzData.next++)
+    {
+        sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, fuzzData.events[fuzzData.next].level);
+    }
+
+    if(fuzzData.next != next)
+    {
+        return;
+    }
+
+    if(++fuzzData.reads > FUZZ_BUSY_READS && fuzzData.next < fuzzData.count)
+    {
+        reads = (fuzzData.events[fuzzData.next].time - time - 1) / SIM_GPIO_READ_CYCLES;
+        sim_advance(reads * SIM_GPIO_READ_CYCLES);
+        fuzzData.lastRead = HAL_GetTick();
+    }
+}
+
+/**
+ * @brief Check the steps of the motor
+ */
+static void fuzz_output(GPIO_TypeDef* port, uint16_t changed)
+{
+    if(port == MTR_STEP_GPIO_Port && (changed & MTR_STEP_Pin) && app_getState() == APP_STATE_IDLE)
+    {
+        fuzz_fail("motor running in idle state");
+    }
+}
+
+/**
+ * @brief Check the state of the application after an iteration of the main
+ * loop
+ */
+static void fuzz_check(void)
+{
+    uint8_t state = app_getState();
+    uint16_t level0_1, level1_2;
+    int32_t deviation;
+
+    if(state == APP_STATE_DRIVING_UP && fuzzData.state == APP_STATE_DRIVING_UP &&
+            HAL_GetTick() - fuzzData.driveUpStarted > (uint32_t)fuzzData.timeout + FUZZ_TIMEOUT_SLACK)
+    {
+        fuzz_fail("drive up timeout exceeded");
+    }
+
+    if(state == fuzzData.state)
+    {
+        return;
+    }
+
+    if(state == APP_STATE_DRIVING_UP)
+    {
+        fuzzData.driveUpStarted = HAL_GetTick();
+    }
+
+    if(state == APP_STATE_IDLE)
+    {
+        if(fuzzData.state == APP_STATE_INIT)
+        {
+            /* The idle position is floor 2 */
+            ee_readVariable(CFG_FLOOR_0_1_TICKS_VADDR, &level0_1);
+            ee_readVariable(CFG_FLOOR_1_2_TICKS_VADDR, &level1_2);
+
+            fuzzData.floors[APP_FLOOR_2] = car_getPosition();
+            fuzzData.floors[APP_FLOOR_1] = fuzzData.floors[APP_FLOOR_2] - level1_2;
+            fuzzData.floors[APP_FLOOR_0] = fuzzData.floors[APP_FLOOR_1] - level0_1;
+            fuzzData.floorsValid = 1;
+        }else if(fuzzData.state == APP_STATE_DRIVING_UP &&
+                HAL_GetTick() - fuzzData.driveUpStarted >= fuzzData.timeout)
+        {
+            fuzzData.floorsValid = 0;
+        }
+
+        if(fuzzData.floorsValid)
+        {
+            deviation = car_getPosition() - fuzzData.floors[app_getFloor()];
+            if(deviation < -FUZZ_TOLERANCE || deviation > FUZZ_TOLERANCE)
+            {
+                fuzz_fail("car is not at the floor of the application");
+            }
+        }
+    }
+
+    fuzzData.state = state;
+}
+
+/**
+ * @brief Skip the main loops of the quiet application
+ *
+ * The idle application and the setup assistant waiting for a press with a
+ * stopped motor and idle flash only run the button handler every
+ * APP_BUTTON_TRIGGER_INTERVAL. Once SW1 is stable for FUZZ_QUIET_TIME
+ * (released) or FUZZ_QUIET_PRESSED_TIME (pressed, the long press is handled)
+ * without a pending press, the handler reads the same level without an
+ * effect. The flush of the cached trip count is due after
+ * EE_CACHE_FLUSH_DELAY_MS only. The virtual time passes up to the last run
+ * of the button handler before the next change of SW1, so the run continues
+ * like without the skip.
+ *
+ * @param end End of the run in CPU cycles
+ */
+static void fuzz_skip(uint64_t end)
+{
+    uint8_t state = app_getState();
+    uint32_t tick = HAL_GetTick();
+    uint32_t target;
+
+    /* The cached trip count must not be flushed within a run */
+    if(FUZZ_MAX_TIME >= EE_CACHE_FLUSH_DELAY_MS ||
+            (state != APP_STATE_IDLE && state != APP_STATE_SETUP_FLOOR2_1 && state != APP_STATE_SETUP_FLOOR1_0) ||
+            (stp_getState() != STP_STATE_IDLE && stp_getState() != STP_STATE_ARRIVED) ||
+            (htim3.Instance->CR1 & TIM_CR1_CEN) || ee_isBusy() || btn_isPressed() != BTN_OK)
+    {
+        fuzzData.quiet = 0;
+        return;
+    }
+
+    if(!fuzzData.quiet || fuzzData.quietNext != fuzzData.next)
+    {
+        fuzzData.quiet = 1;
+        fuzzData.quietSince = tick;
+        fuzzData.quietNext = fuzzData.next;
+        return;
+    }
+
+    /* The last read must be one of the button handler */
+    if(tick - fuzzData.quietSince < ((SW1_IN_GPIO_Port->IDR & SW1_IN_Pin) ? FUZZ_QUIET_TIME : FUZZ_QUIET_PRESSED_TIME) ||
+            fuzzData.lastRead <= fuzzData.quietSince)
+    {
+        return;
+    }
+
+    if(fuzzData.next < fuzzData.count && fuzzData.events[fuzzData.next].time < end)
+    {
+        end = fuzzData.events[fuzzData.next].time;
+    }
+
+    /* Stop one tick before the next change of SW1 at a run of the handler */
+    target = (uint32_t)(end / SIM_TICK_CYCLES) - 1;
+    target -= (target - fuzzData.lastRead) % APP_BUTTON_TRIGGER_INTERVAL;
+
+    if((int32_t)(target - tick) > 0)
+    {
+        sim_advance((uint64_t)(target - tick) * SIM_TICK_CYCLES);
+    }
+}
+
+/**
+ * @brief Report a violated invariant and abort the run
+ */
+static void fuzz_fail(const char* reason)
+{
+    fprintf(stderr, "fuzz: %s at %lu ms (state %u, floor %u, car at %ld)\n", reason,
+            (unsigned long)HAL_GetTick(), app_getState(), app_getFloor(), (long)car_getPosition());
+
+#ifdef FUZZ_STANDALONE
+    {
+        FILE* file;
+
+        if((file = fopen("fuzz-crash.bin", "wb")) != NULL)
+        {
+            fwrite(fuzzData.input, 1, fuzzData.size, file);
+            fclose(file);
+            fprintf(stderr, "fuzz: input written to fuzz-crash.bin\n");
+        }
+    }
+#endif
+
+    abort();
+}
+
+#ifdef FUZZ_STANDALONE
+
+#include <unistd.h>
+#include <time.h>
+
+/**
+ * Maximum size of a random input
+ */
+#define FUZZ_RANDOM_SIZE            (64)
+
+int main(int argc, char** argv)
+{
+    struct timespec start, end;
+    uint8_t data[FUZZ_RANDOM_SIZE];
+    uint8_t* buffer;
+    uint32_t runs = 10000;
+    uint32_t seed = 1;
+    size_t max = FUZZ_RANDOM_SIZE;
+    uint32_t i, j;
+    size_t size;
+    double host;
+    FILE* file;
+    long length;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:s:l:v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            runs = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            length = strtol(optarg, NULL, 0);
+            if(length < 4 || length > FUZZ_RANDOM_SIZE)
+            {
+                fprintf(stderr, "size must be 4 to %u\n", FUZZ_RANDOM_SIZE);
+                return 2;
+            }
+            max = length;
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n runs] [-s seed] [-l size] [-v] [input ...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* Reproduce the given inputs */
+    for(i = optind; i < (uint32_t)argc; i++)
+    {
+        if((file = fopen(argv[i], "rb")) == NULL || fseek(file, 0, SEEK_END) != 0 ||
+                (length = ftell(file)) < 0 || fseek(file, 0, SEEK_SET) != 0 ||
+                (buffer = malloc(length + 1)) == NULL ||
+                fread(buffer, 1, length, file) != (size_t)length)
+        {
+            perror(argv[i]);
+            return 2;
+        }
+        fclose(file);
+
+        LLVMFuzzerTestOneInput(buffer, length);
+        printf("%s: passed\n", argv[i]);
+        free(buffer);
+    }
+
+    if(optind < argc)
+    {
+        return 0;
+    }
+
+    srand(seed);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for(i = 0; i < runs; i++)
+    {
+        size = 4 + rand() % (max - 4 + 1);
+        for(j = 0; j < size; j++)
+        {
+            data[j] = (uint8_t)rand();
+        }
+
+        LLVMFuzzerTestOneInput(data, size);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    host = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("runs            %lu\n", (unsigned long)runs);
+    printf("host time s     %.3f (%.0f exec/s)\n", host, host > 0 ? runs / host : 0.0);
+
+    return 0;
+}
+
+#endif /* FUZZ_STANDALONE */
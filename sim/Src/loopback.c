@@ -0,0 +1,717 @@
+/**
+ * @file loopback.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB CDC regression of the host simulation
+ *
+ * Runs cdc.c, usbd_cdc_if.c and proto.c at the simulated USB host of usb.h
+ * on a configured board. A recorded stream of request frames (see proto.h)
+ * is sent twice: once as one transfer, so the frames straddle the packets,
+ * and once as one transfer per frame:
+ *
+ * - pings, reads and writes of the configuration, writes out of the range
+ *   of a variable, an unknown variable, a wrong payload length, a stop of
+ *   the idle car and an unknown command with the longest payload,
+ * - a frame which is too long, a frame with a wrong crc and a frame with an
+ *   invalid COBS encoding, which must not be answered.
+ *
+ * The host decodes the COBS frames of the IN endpoint and checks their crc.
+ * The responses must match the recorded responses in order.
+ *
+ * Then the main loop echoes the received packets instead of proto.c.
+ * Transfers of 1 to 1000 bytes are sent at a fast main loop and at a main
+ * loop which stalls for LOOPBACK_STALL ms, so all receive slots are used
+ * and the host is NAKed. The echo must be complete and in order, every
+ * received packet must have used and released one slot and every IN
+ * transfer must end with a short or a zero length packet. The echo of one
+ * full packet must be followed by one zero length packet.
+ *
+ * The exit code is 1 if a check fails or a warning is logged.
+ *
+ * <code>
+ * elevator-usb [-v]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "car.h"
+#include "usb.h"
+#include "app.h"
+#include "cdc.h"
+#include "proto.h"
+#include "bridge.h"
+#include "tlm.h"
+#include "syscalls.h"
+#include "version.h"
+
+/**
+ * Maximum time until the board is idle and until a stream is sent in ms
+ */
+#define LOOPBACK_TIMEOUT            (30 * 1000)
+
+/**
+ * Time until the responses of the last request are sent in ms
+ */
+#define LOOPBACK_RESPONSE_TIME      (20)
+
+/**
+ * Maximum size of a decoded frame of the stream (cmd, seq, payload and crc)
+ */
+#define LOOPBACK_FRAME_SIZE         (PROTO_FRAME_SIZE + 1)
+
+/**
+ * Maximum size of a COBS encoded frame with its delimiter
+ */
+#define LOOPBACK_ENCODED_SIZE       (LOOPBACK_FRAME_SIZE + 2)
+
+/**
+ * Size of the captured IN data
+ */
+#define LOOPBACK_INPUT_SIZE         (16384)
+
+/**
+ * Stall of the main loop while the echo is running in ms
+ */
+#define LOOPBACK_STALL              (5)
+
+/**
+ * Corruption of a request frame
+ */
+typedef enum loopbackFault_e {
+    LOOPBACK_FAULT_NONE = 0,
+    LOOPBACK_FAULT_CRC,     /* A bit of the crc is inverted */
+    LOOPBACK_FAULT_COBS,    /* The first code points behind the frame */
+    LOOPBACK_FAULT_LENGTH   /* The frame is longer than PROTO_FRAME_SIZE */
+} loopbackFault_t;
+
+/**
+ * Recorded request and its response
+ */
+typedef struct loopbackRecord_s {
+    const char* name;
+    uint8_t request[LOOPBACK_FRAME_SIZE];   /* cmd and payload */
+    uint8_t requestLen;
+    uint8_t response[PROTO_FRAME_SIZE];     /* status and payload */
+    uint8_t responseLen;                    /* 0 if no response is sent */
+    loopbackFault_t fault;
+} loopbackRecord_t;
+
+/**
+ * Loopback test data struct type
+ */
+typedef struct loopbackData_s {
+    /**
+     * Captured data of the IN endpoint
+     */
+    uint8_t input[LOOPBACK_INPUT_SIZE];
+    uint32_t inputLen;
+
+    /**
+     * The last IN packet was full, the transfer is not terminated
+     */
+    uint8_t inputFull;
+
+    /**
+     * The main loop echoes the received packets instead of proto.c
+     */
+    uint8_t echo;
+
+    /**
+     * Stall of the main loop in ms (0 for a fast main loop)
+     */
+    uint32_t stall;
+} loopbackData_t;
+
+/**
+ * Module data
+ */
+static loopbackData_t loopbackData;
+
+/**
+ * Recorded stream, the responses follow the state of the writes before
+ */
+static const loopbackRecord_t loopbackStream[] = {
+        { "ping", { PROTO_CMD_PING }, 1,
+                { PROTO_STATUS_OK, APP_VERSION & 0xFF, (APP_VERSION >> 8) & 0xFF,
+                        (APP_VERSION >> 16) & 0xFF, (APP_VERSION >> 24) & 0xFF }, 5, LOOPBACK_FAULT_NONE },
+        { "get", { PROTO_CMD_CFG_GET, 0x11, 0x11 }, 3,
+                { PROTO_STATUS_OK, 0xE8, 0x03 }, 3, LOOPBACK_FAULT_NONE },
+        { "set out of range", { PROTO_CMD_CFG_SET, 0x11, 0x11, 0x00, 0x00 }, 5,
+                { PROTO_STATUS_INVALID }, 1, LOOPBACK_FAULT_NONE },
+        { "set", { PROTO_CMD_CFG_SET, 0x11, 0x11, 0xD0, 0x07 }, 5,
+                { PROTO_STATUS_OK }, 1, LOOPBACK_FAULT_NONE },
+        { "get back", { PROTO_CMD_CFG_GET, 0x11, 0x11 }, 3,
+                { PROTO_STATUS_OK, 0xD0, 0x07 }, 3, LOOPBACK_FAULT_NONE },
+        { "unknown variable", { PROTO_CMD_CFG_GET, 0x00, 0x00 }, 3,
+                { PROTO_STATUS_INVALID }, 1, LOOPBACK_FAULT_NONE },
+        { "payload length", { PROTO_CMD_CFG_GET, 0x11 }, 2,
+                { PROTO_STATUS_LENGTH }, 1, LOOPBACK_FAULT_NONE },
+        { "stop", { PROTO_CMD_STOP }, 1,
+                { PROTO_STATUS_OK }, 1, LOOPBACK_FAULT_NONE },
+        { "longest frame", { 0x3F }, PROTO_FRAME_SIZE - 3,
+                { PROTO_STATUS_UNKNOWN }, 1, LOOPBACK_FAULT_NONE },
+        { "too long", { 0x3F }, PROTO_FRAME_SIZE - 2,
+                { 0 }, 0, LOOPBACK_FAULT_LENGTH },
+        { "wrong crc", { PROTO_CMD_PING }, 1,
+                { 0 }, 0, LOOPBACK_FAULT_CRC },
+        { "invalid cobs", { PROTO_CMD_PING }, 1,
+                { 0 }, 0, LOOPBACK_FAULT_COBS },
+        { "restore", { PROTO_CMD_CFG_SET, 0x11, 0x11, 0xE8, 0x03 }, 5,
+                { PROTO_STATUS_OK }, 1, LOOPBACK_FAULT_NONE },
+};
+
+#define LOOPBACK_RECORDS            (sizeof(loopbackStream) / sizeof(loopbackStream[0]))
+
+/**
+ * Sizes of the echoed transfers, around and at multiples of the packet size
+ */
+static const uint16_t loopbackSizes[] = { 1, 63, 64, 65, 128, 200, 512, 1000 };
+
+#define LOOPBACK_TRANSFERS          (sizeof(loopbackSizes) / sizeof(loopbackSizes[0]))
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void loopback_loop(void);
+static void loopback_input(const uint8_t* data, uint16_t len);
+static uint8_t loopback_stream(uint8_t split);
+static uint8_t loopback_check(uint8_t split);
+static void loopback_echo(void);
+static uint8_t loopback_echoStream(const uint16_t* sizes, uint8_t count, uint32_t stall);
+static uint16_t loopback_frame(const loopbackRecord_t* record, uint8_t seq, uint8_t* encoded);
+static uint16_t loopback_crc16(const uint8_t* data, uint16_t len);
+static uint16_t loopback_cobsEncode(const uint8_t* in, uint16_t len, uint8_t* out);
+static uint16_t loopback_cobsDecode(const uint8_t* in, uint16_t len, uint8_t* out);
+
+int main(int argc, char** argv)
+{
+    simStats_t simStats;
+    protoStats_t protoStats;
+    cdcStats_t cdcStats;
+    usbStats_t usbStats;
+    uint16_t full = CDC_PACKET_SIZE;
+    uint32_t zlps;
+    uint32_t valid = 0;
+    uint32_t i;
+    uint8_t ok;
+    int opt;
+
+    while((opt = getopt(argc, argv, "v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* Configured board at floor 0, see ride.c */
+    sim_init();
+    sim_boot();
+
+    sim_init();
+    car_init(CAR_FLOOR0);
+    sim_boot();
+
+    /* Like main() */
+    usb_init();
+    tlm_init();
+    brg_init();
+    proto_init();
+    sim_setLoopHook(loopback_loop);
+    usb_setInHook(loopback_input);
+
+    while(app_getState() != APP_STATE_IDLE)
+    {
+        if(HAL_GetTick() >= LOOPBACK_TIMEOUT)
+        {
+            fprintf(stderr, "idle position not arrived\n");
+            return 1;
+        }
+        sim_loop();
+    }
+
+    /* The host configures the device, the SysTick serves the frames */
+    usb_connect();
+    sim_setTickHook(usb_frame);
+
+    ok = loopback_stream(0) && loopback_stream(1);
+
+    loopbackData.echo = 1;
+    ok = ok && loopback_echoStream(loopbackSizes, LOOPBACK_TRANSFERS, 0) &&
+            loopback_echoStream(loopbackSizes, LOOPBACK_TRANSFERS, LOOPBACK_STALL);
+
+    /* The echo of one full packet is a transfer which needs a zero length packet */
+    usb_getStats(&usbStats);
+    zlps = usbStats.inZlps;
+    ok = ok && loopback_echoStream(&full, 1, 0);
+
+    sim_getStats(&simStats);
+    proto_getStats(&protoStats);
+    cdc_getStats(&cdcStats);
+    usb_getStats(&usbStats);
+
+    for(i = 0; i < LOOPBACK_RECORDS; i++)
+    {
+        valid += (loopbackStream[i].fault == LOOPBACK_FAULT_NONE);
+    }
+
+    printf("requests        %lu\n", (unsigned long)(2 * LOOPBACK_RECORDS));
+    printf("frames          %lu (crc errors %lu, framing errors %lu, dropped %lu)\n",
+            (unsigned long)protoStats.frames, (unsigned long)protoStats.crcErrors,
+            (unsigned long)protoStats.framingErrors, (unsigned long)protoStats.txDropped);
+    printf("out packets     %lu (naks %lu)\n", (unsigned long)usbStats.outPackets,
+            (unsigned long)usbStats.outNaks);
+    printf("in packets      %lu (transfers %lu, zlps %lu)\n", (unsigned long)usbStats.inPackets,
+            (unsigned long)usbStats.inTransfers, (unsigned long)usbStats.inZlps);
+    printf("received        %lu packets (stalls %lu)\n", (unsigned long)cdcStats.rxPackets,
+            (unsigned long)cdcStats.rxStalls);
+    printf("sent            %lu bytes (dropped %lu)\n", (unsigned long)cdcStats.txBytes,
+            (unsigned long)cdcStats.txDropped);
+    printf("echo            %u transfers (stall %u ms)\n", (unsigned)(2 * LOOPBACK_TRANSFERS + 1),
+            LOOPBACK_STALL);
+    printf("warnings        %lu\n", (unsigned long)simStats.warnings);
+
+    /* Every stream has one frame with a wrong crc, one too long and one invalid */
+    if(ok && (protoStats.frames != 2 * valid || protoStats.crcErrors != 2 ||
+            protoStats.framingErrors != 4 || protoStats.txDropped != 0))
+    {
+        fprintf(stderr, "statistics of the protocol wrong\n");
+        ok = 0;
+    }
+
+    if(ok && usbStats.inZlps != zlps + 1)
+    {
+        fprintf(stderr, "no zero length packet after a full packet\n");
+        ok = 0;
+    }
+
+    if(ok && usbStats.errors != 0)
+    {
+        fprintf(stderr, "endpoint armed twice or transfer started while busy\n");
+        ok = 0;
+    }
+
+    return (!ok || simStats.warnings) ? 1 : 0;
+}
+
+/**
+ * @brief Handlers of the main loop which are not part of the core
+ */
+static void loopback_loop(void)
+{
+    cdc_handler();
+    if(loopbackData.echo)
+    {
+        loopback_echo();
+    }else
+    {
+        proto_handler();
+    }
+    brg_handler();
+
+    if(loopbackData.stall)
+    {
+        sim_advance((uint64_t)SIM_CPU_CLOCK * loopbackData.stall / 1000);
+    }
+}
+
+/**
+ * @brief Echo the received packets, a packet which does not fit into the
+ * transmit queue stays at its slot
+ */
+static void loopback_echo(void)
+{
+    const uint8_t* packet;
+    uint16_t len;
+
+    while((packet = cdc_rxPeek(&len)) != NULL && len <= cdc_txFree())
+    {
+        cdc_write(packet, len);
+        cdc_rxRelease();
+    }
+}
+
+/**
+ * @brief Capture an IN packet of the host
+ */
+static void loopback_input(const uint8_t* data, uint16_t len)
+{
+    if(loopbackData.inputLen + len <= LOOPBACK_INPUT_SIZE)
+    {
+        memcpy(&loopbackData.input[loopbackData.inputLen], data, len);
+        loopbackData.inputLen += len;
+    }
+
+    loopbackData.inputFull = (len == CDC_PACKET_SIZE);
+}
+
+/**
+ * @brief Send the recorded stream and compare the responses
+ *
+ * @param split 1 to send every frame as its own transfer, 0 to send the
+ * stream as one transfer
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t loopback_stream(uint8_t split)
+{
+    uint8_t stream[LOOPBACK_RECORDS * LOOPBACK_ENCODED_SIZE];
+    uint16_t len = 0;
+    uint16_t frameLen;
+    uint32_t start;
+    uint32_t i;
+
+    loopbackData.inputLen = 0;
+
+    for(i = 0; i < LOOPBACK_RECORDS; i++)
+    {
+        frameLen = loopback_frame(&loopbackStream[i], i, &stream[len]);
+        if(split && usb_hostWrite(&stream[len], frameLen) != frameLen)
+        {
+            fprintf(stderr, "split %u: %s: not queued\n", split, loopbackStream[i].name);
+            return 0;
+        }
+        len += frameLen;
+    }
+
+    if(!split && usb_hostWrite(stream, len) != len)
+    {
+        fprintf(stderr, "split %u: stream not queued\n", split);
+        return 0;
+    }
+
+    start = HAL_GetTick();
+    while(usb_getOutPending() != 0)
+    {
+        if(HAL_GetTick() - start >= LOOPBACK_TIMEOUT)
+        {
+            fprintf(stderr, "split %u: stream not sent\n", split);
+            return 0;
+        }
+        sim_loop();
+    }
+
+    /* The last response is sent */
+    start = HAL_GetTick();
+    while(HAL_GetTick() - start < LOOPBACK_RESPONSE_TIME)
+    {
+        sim_loop();
+    }
+
+    return loopback_check(split);
+}
+
+/**
+ * @brief Send transfers to the echo of the main loop and compare the echo
+ *
+ * @param sizes Sizes of the transfers
+ * @param count Number of transfers
+ * @param stall Stall of the main loop in ms
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t loopback_echoStream(const uint16_t* sizes, uint8_t count, uint32_t stall)
+{
+    uint8_t data[LOOPBACK_INPUT_SIZE];
+    cdcStats_t before;
+    cdcStats_t after;
+    uint32_t packets = 0;
+    uint32_t len = 0;
+    uint32_t start;
+    uint16_t slot;
+    uint32_t i;
+
+    cdc_getStats(&before);
+    loopbackData.inputLen = 0;
+
+    for(i = 0; i < count; i++)
+    {
+        for(slot = 0; slot < sizes[i]; slot++)
+        {
+            data[len + slot] = rand();
+        }
+
+        if(usb_hostWrite(&data[len], sizes[i]) != sizes[i])
+        {
+            fprintf(stderr, "stall %lu ms: transfer of %u bytes not queued\n", (unsigned long)stall, sizes[i]);
+            return 0;
+        }
+
+        len += sizes[i];
+        packets += (sizes[i] + CDC_PACKET_SIZE - 1) / CDC_PACKET_SIZE;
+    }
+
+    loopbackData.stall = stall;
+
+    start = HAL_GetTick();
+    while(usb_getOutPending() != 0)
+    {
+        if(HAL_GetTick() - start >= LOOPBACK_TIMEOUT)
+        {
+            fprintf(stderr, "stall %lu ms: transfers not sent\n", (unsigned long)stall);
+            return 0;
+        }
+        sim_loop();
+    }
+
+    /* The last echo is sent */
+    start = HAL_GetTick();
+    while(HAL_GetTick() - start < LOOPBACK_RESPONSE_TIME + stall)
+    {
+        sim_loop();
+    }
+
+    loopbackData.stall = 0;
+    cdc_getStats(&after);
+
+    if(loopbackData.inputLen != len || memcmp(loopbackData.input, data, len) != 0)
+    {
+        fprintf(stderr, "stall %lu ms: echo of %lu bytes wrong or incomplete (%lu bytes)\n",
+                (unsigned long)stall, (unsigned long)len, (unsigned long)loopbackData.inputLen);
+        return 0;
+    }
+
+    /* Zero length packets do not use a slot */
+    if(after.rxPackets - before.rxPackets != packets || cdc_rxPeek(&slot) != NULL)
+    {
+        fprintf(stderr, "stall %lu ms: %lu packets received into the slots, %lu sent\n",
+                (unsigned long)stall, (unsigned long)(after.rxPackets - before.rxPackets),
+                (unsigned long)packets);
+        return 0;
+    }
+
+    if(stall && after.rxStalls == before.rxStalls)
+    {
+        fprintf(stderr, "stall %lu ms: host not NAKed\n", (unsigned long)stall);
+        return 0;
+    }
+
+    if(loopbackData.inputFull || after.txDropped != before.txDropped)
+    {
+        fprintf(stderr, "stall %lu ms: echo not terminated by a short packet or dropped\n",
+                (unsigned long)stall);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Decode the captured responses and compare them with the stream
+ *
+ * @param split Mode of the stream (see loopback_stream())
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t loopback_check(uint8_t split)
+{
+    const loopbackRecord_t* record;
+    uint8_t frame[LOOPBACK_ENCODED_SIZE];
+    uint32_t pos = 0;
+    uint32_t end;
+    uint16_t len;
+    uint32_t i;
+
+    for(i = 0; i < LOOPBACK_RECORDS; i++)
+    {
+        record = &loopbackStream[i];
+        if(record->responseLen == 0)
+        {
+            continue;
+        }
+
+        for(end = pos; end < loopbackData.inputLen && loopbackData.input[end] != 0; end++);
+
+        if(end == loopbackData.inputLen || end - pos > LOOPBACK_ENCODED_SIZE)
+        {
+            fprintf(stderr, "split %u: %s: response missing\n", split, record->name);
+            return 0;
+        }
+
+        len = loopback_cobsDecode(&loopbackData.input[pos], end - pos, frame);
+        pos = end + 1;
+
+        if(len < 4 || loopback_crc16(frame, len - 2) != (frame[len - 2] | ((uint16_t)frame[len - 1] << 8)))
+        {
+            fprintf(stderr, "split %u: %s: response not decoded or wrong crc\n", split, record->name);
+            return 0;
+        }
+
+        if(frame[0] != (record->request[0] | PROTO_RESPONSE) || frame[1] != i ||
+                len - 4 != record->responseLen || memcmp(&frame[2], record->response, len - 4) != 0)
+        {
+            fprintf(stderr, "split %u: %s: response wrong\n", split, record->name);
+            return 0;
+        }
+    }
+
+    if(pos != loopbackData.inputLen)
+    {
+        fprintf(stderr, "split %u: %lu bytes more than the responses\n", split,
+                (unsigned long)(loopbackData.inputLen - pos));
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Build the encoded frame of a request
+ *
+ * @param record Request
+ * @param seq Sequence number
+ * @param encoded Encoded frame with delimiter, at least LOOPBACK_ENCODED_SIZE
+ * bytes
+ *
+ * @return Length of the encoded frame
+ */
+static uint16_t loopback_frame(const loopbackRecord_t* record, uint8_t seq, uint8_t* encoded)
+{
+    uint8_t frame[LOOPBACK_FRAME_SIZE + 2];
+    uint16_t len = 0;
+    uint16_t crc;
+
+    frame[len++] = record->request[0];
+    frame[len++] = seq;
+    memcpy(&frame[len], &record->request[1], record->requestLen - 1);
+    len += record->requestLen - 1;
+
+    crc = loopback_crc16(frame, len);
+    if(record->fault == LOOPBACK_FAULT_CRC)
+    {
+        crc ^= 0x0001;
+    }
+    frame[len++] = crc & 0xFF;
+    frame[len++] = crc >> 8;
+
+    len = loopback_cobsEncode(frame, len, encoded);
+    if(record->fault == LOOPBACK_FAULT_COBS)
+    {
+        encoded[0] = len + 1;
+    }
+    encoded[len++] = 0;
+
+    return len;
+}
+
+/**
+ * @brief Calculate the CRC-16/CCITT-FALSE like the host client
+ *
+ * @param data Data
+ * @param len Number of bytes
+ *
+ * @return CRC
+ */
+static uint16_t loopback_crc16(const uint8_t* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    while(len--)
+    {
+        crc ^= (uint16_t)(*data++) << 8;
+        for(i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief COBS encode a frame (without delimiter) like the host client
+ *
+ * @param in Frame
+ * @param len Frame length (less than 254 bytes)
+ * @param out Encoded frame, at least len + 1 bytes
+ *
+ * @return Length of the encoded frame
+ */
+static uint16_t loopback_cobsEncode(const uint8_t* in, uint16_t len, uint8_t* out)
+{
+    uint16_t codePos = 0;
+    uint16_t outLen = 1;
+    uint16_t i;
+
+    for(i = 0; i < len; i++)
+    {
+        if(in[i] == 0)
+        {
+            out[codePos] = outLen - codePos;
+            codePos = outLen++;
+        }else
+        {
+            out[outLen++] = in[i];
+        }
+    }
+
+    out[codePos] = outLen - codePos;
+
+    return outLen;
+}
+
+/**
+ * @brief COBS decode a frame (without delimiter) like the host client
+ *
+ * @param in Encoded frame
+ * @param len Encoded frame length (less than 254 bytes)
+ * @param out Decoded frame, at least len bytes
+ *
+ * @return Length of the decoded frame or 0 on error
+ */
+static uint16_t loopback_cobsDecode(const uint8_t* in, uint16_t len, uint8_t* out)
+{
+    uint16_t pos = 0;
+    uint16_t outLen = 0;
+    uint8_t code;
+
+    while(pos < len)
+    {
+        code = in[pos++];
+        if(code == 0 || pos + code - 1 > len)
+        {
+            return 0;
+        }
+
+        memcpy(&out[outLen], &in[pos], code - 1);
+        outLen += code - 1;
+        pos += code - 1;
+
+        if(pos < len)
+        {
+            out[outLen++] = 0;
+        }
+    }
+
+    return outLen;
+}
+
+/**
+ * @brief Output of printf, the ITM port is not simulated
+ */
+int _write(int file, char* ptr, int len)
+{
+    return len;
+}
+
+/**
+ * @brief Statistics of the ITM output, see _write()
+ */
+void sys_getItmStats(sysItmStats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
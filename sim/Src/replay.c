@@ -0,0 +1,339 @@
+/**
+ * @file replay.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Replay of an input trace (see trc.h) by the host simulation
+ *
+ * Writes the recorded configuration into the flash, boots the application at
+ * the recorded time and feeds the inputs and commands of the trace at their
+ * CPU cycle: the levels of SW1 and SW2 are set by the read which recorded
+ * them (see sim_setReadHook()), the commands are passed to the application
+ * at the main loop like the console does. No car is
+ * connected, SW2 follows the trace only.
+ *
+ * The simulation records its own trace meanwhile. It must be identical to
+ * the replayed one, otherwise the first difference is reported and the exit
+ * code is 1.
+ *
+ * <code>
+ * elevator-replay [-v] trace.bin
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "main.h"
+#include "app.h"
+#include "stepper.h"
+#include "eeprom.h"
+#include "config.h"
+#include "trc.h"
+
+/**
+ * Virtual address of the configuration variables by their CFG_x_IDX
+ */
+static const uint16_t replayConfig[] = {
+        [CFG_LONGPRESS_TIME_IDX]        = CFG_LONGPRESS_TIME_VADDR,
+        [CFG_POWER_OFF_IDX]             = CFG_POWER_OFF_VADDR,
+        [CFG_FLOOR_0_1_TICKS_IDX]       = CFG_FLOOR_0_1_TICKS_VADDR,
+        [CFG_FLOOR_1_2_TICKS_IDX]       = CFG_FLOOR_1_2_TICKS_VADDR,
+        [CFG_TIMEOUT_FLOOR2_ARRIVE_IDX] = CFG_TIMEOUT_FLOOR2_ARRIVE_VADDR,
+        [CFG_TRIP_COUNT_IDX]            = CFG_TRIP_COUNT_VADDR,
+        [CFG_MODBUS_ADDR_IDX]           = CFG_MODBUS_ADDR_VADDR,
+};
+
+#define REPLAY_CONFIG_COUNT         (sizeof(replayConfig) / sizeof(replayConfig[0]))
+
+/**
+ * Replay data struct type
+ */
+typedef struct replayData_s {
+    trcEntry_t* entries;
+    /**
+     * Time of each entry (see trc_getTime())
+     */
+    uint64_t* times;
+    uint32_t count;
+
+    /**
+     * Next entry of the inputs (SysTick) and of the commands (main loop)
+     */
+    uint32_t input;
+    uint32_t command;
+} replayData_t;
+
+/**
+ * Module data
+ */
+static replayData_t replayData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t replay_load(const char* path);
+static uint8_t replay_boot(void);
+static void replay_inputs(void);
+static void replay_commands(void);
+static uint8_t replay_compare(void);
+static void replay_print(const char* prefix, const trcEntry_t* entry, uint64_t time);
+
+int main(int argc, char** argv)
+{
+    uint64_t end;
+    int opt;
+
+    while((opt = getopt(argc, argv, "v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v] trace.bin\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(optind + 1 != argc)
+    {
+        fprintf(stderr, "usage: %s [-v] trace.bin\n", argv[0]);
+        return 2;
+    }
+
+    if(!replay_load(argv[optind]) || !replay_boot())
+    {
+        return 2;
+    }
+
+    end = replayData.times[replayData.count - 1];
+    while(trc_getTime() <= end)
+    {
+        replay_commands();
+        sim_loop();
+    }
+
+    return replay_compare() ? 0 : 1;
+}
+
+/**
+ * @brief Read the trace and calculate the time of each entry
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t replay_load(const char* path)
+{
+    FILE* file;
+    long size;
+    uint64_t time = 0;
+    uint32_t i;
+
+    if((file = fopen(path, "rb")) == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if(size <= 0 || size % sizeof(trcEntry_t) != 0)
+    {
+        fprintf(stderr, "%s: not a trace\n", path);
+        fclose(file);
+        return 0;
+    }
+
+    replayData.count = size / sizeof(trcEntry_t);
+    replayData.entries = malloc(size);
+    replayData.times = malloc(replayData.count * sizeof(uint64_t));
+
+    if(fread(replayData.entries, sizeof(trcEntry_t), replayData.count, file) != replayData.count)
+    {
+        perror(path);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+
+    for(i = 0; i < replayData.count; i++)
+    {
+        time += replayData.entries[i].delta;
+        replayData.times[i] = time;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Restore the configuration and boot the application at its time
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t replay_boot(void)
+{
+    const trcEntry_t* entry;
+    uint32_t boot;
+    uint32_t i;
+
+    /* The trace starts with app_init(): the state INIT and the configuration */
+    for(i = 0; i < replayData.count && replayData.entries[i].type == TRC_TYPE_TICK; i++);
+
+    if(i == replayData.count || replayData.entries[i].type != TRC_TYPE_STATE ||
+            replayData.entries[i].data != APP_STATE_INIT)
+    {
+        fprintf(stderr, "trace does not start at app_init()\n");
+        return 0;
+    }
+    boot = i;
+
+    sim_init();
+    irq_init();
+    ee_init();
+
+    for(i++; i < replayData.count && replayData.entries[i].type == TRC_TYPE_CONFIG; i++)
+    {
+        entry = &replayData.entries[i];
+        if(entry->data >= REPLAY_CONFIG_COUNT ||
+                ee_writeVariable(replayConfig[entry->data], entry->value) != HAL_OK)
+        {
+            fprintf(stderr, "entry %lu: invalid configuration\n", (unsigned long)i);
+            return 0;
+        }
+    }
+
+    /* Reset with the configured flash */
+    sim_init();
+    sim_setReadHook(replay_inputs);
+    sim_advance(replayData.times[boot]);
+    sim_boot();
+
+    return 1;
+}
+
+/**
+ * @brief Set the inputs which are recorded up to the current time
+ *
+ * Runs before every read of an input pin.
+ */
+static void replay_inputs(void)
+{
+    const trcEntry_t* entry;
+    uint64_t time = trc_getTime();
+
+    for(; replayData.input < replayData.count && replayData.times[replayData.input] <= time; replayData.input++)
+    {
+        entry = &replayData.entries[replayData.input];
+        if(entry->type != TRC_TYPE_INPUT)
+        {
+            continue;
+        }
+
+        /* The inputs are low active */
+        sim_setInput(entry->data == TRC_INPUT_SW1 ? SW1_IN_GPIO_Port : SW2_IN_GPIO_Port,
+                entry->data == TRC_INPUT_SW1 ? SW1_IN_Pin : SW2_IN_Pin,
+                entry->value ? GPIO_PIN_RESET : GPIO_PIN_SET);
+    }
+}
+
+/**
+ * @brief Pass the commands which are recorded up to the current time
+ */
+static void replay_commands(void)
+{
+    const trcEntry_t* entry;
+    uint64_t time = trc_getTime();
+    stpCmd_t cmd;
+    uint32_t steps;
+
+    for(; replayData.command < replayData.count && replayData.times[replayData.command] <= time; replayData.command++)
+    {
+        entry = &replayData.entries[replayData.command];
+        if(entry->type == TRC_TYPE_DRIVE_UP || entry->type == TRC_TYPE_DRIVE_DOWN)
+        {
+            cmd = (entry->type == TRC_TYPE_DRIVE_UP) ? STP_CMD_DRIVE_UP : STP_CMD_DRIVE_DOWN;
+            steps = ((uint32_t)entry->data << 16) | entry->value;
+
+            app_requServiceMove(cmd, steps);
+        }else if(entry->type == TRC_TYPE_STOP)
+        {
+            app_requStop();
+        }
+    }
+}
+
+/**
+ * @brief Compare the trace of the simulation with the replayed one
+ *
+ * @return 1 if identical otherwise 0
+ */
+static uint8_t replay_compare(void)
+{
+    const trcEntry_t* entries = trc_getEntries();
+    uint32_t count = trc_getCount();
+    uint64_t time = 0;
+    uint32_t states = 0;
+    uint32_t i;
+
+    if(trc_getLost())
+    {
+        fprintf(stderr, "trace of the simulation is full (TRC_SIZE)\n");
+        return 0;
+    }
+
+    for(i = 0; i < replayData.count; i++)
+    {
+        if(i < count)
+        {
+            time += entries[i].delta;
+        }
+
+        if(i >= count || entries[i].delta != replayData.entries[i].delta ||
+                entries[i].type != replayData.entries[i].type ||
+                entries[i].data != replayData.entries[i].data ||
+                entries[i].value != replayData.entries[i].value)
+        {
+            fprintf(stderr, "replay differs at entry %lu of %lu\n",
+                    (unsigned long)i, (unsigned long)replayData.count);
+            replay_print("trace ", &replayData.entries[i], replayData.times[i]);
+            if(i < count)
+            {
+                replay_print("replay", &entries[i], time);
+            }else
+            {
+                fprintf(stderr, "replay  no entry\n");
+            }
+            return 0;
+        }
+
+        if(entries[i].type == TRC_TYPE_STATE)
+        {
+            states++;
+        }
+    }
+
+    printf("replayed %lu entries, %lu states, %.3f s: identical\n",
+            (unsigned long)replayData.count, (unsigned long)states,
+            (double)replayData.times[replayData.count - 1] / SIM_CPU_CLOCK);
+
+    return 1;
+}
+
+/**
+ * @brief Print an entry to stderr
+ */
+static void replay_print(const char* prefix, const trcEntry_t* entry, uint64_t time)
+{
+    static const char* const types[] = { "tick", "input", "state", "config", "up", "down", "stop" };
+
+    fprintf(stderr, "%s  %12.6f s  %-6s  %3u  %lu\n", prefix, (double)time / SIM_CPU_CLOCK,
+            entry->type < sizeof(types) / sizeof(types[0]) ? types[entry->type] : "?",
+            entry->data, (unsigned long)entry->value);
+}
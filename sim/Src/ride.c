@@ -0,0 +1,319 @@
+/**
+ * @file ride.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Ride cycle regression of the host simulation
+ *
+ * Powers the simulated elevator on at floor 0 with the default configuration
+ * (the first boot writes it into the blank flash), waits for the drive to
+ * the idle position and runs the given number of rides by short presses of
+ * SW1 (2 -> 1 -> 0 -> 1 -> 2 ...). After every ride the car must
+ * stand at its floor. The exit code is 1 if a ride fails or a warning is
+ * logged. With -w the pins are dumped to a VCD file (see vcd.h), with -t
+ * the input trace is written for elevator-replay (see trc.h).
+ *
+ * <code>
+ * elevator-sim [-n rides] [-v] [-w file.vcd] [-t trace.bin]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "sim.h"
+#include "car.h"
+#include "main.h"
+#include "app.h"
+#include "stepper.h"
+#include "eeprom.h"
+#include "config.h"
+#include "io.h"
+#include "vcd.h"
+#include "trc.h"
+
+/**
+ * Time of a short press of SW1 in ms
+ */
+#define RIDE_PRESS_TIME             (100)
+
+/**
+ * Maximum time of a ride and of the drive to the idle position in ms
+ */
+#define RIDE_TIMEOUT                (30 * 1000)
+
+/**
+ * Maximum deviation of the car from its floor (sixteenth steps)
+ */
+#define RIDE_TOLERANCE              (8)
+
+/**
+ * Ride data struct type
+ */
+typedef struct rideData_s {
+    /**
+     * Expected position of the floors
+     */
+    int32_t floors[3];
+
+    struct {
+        uint32_t rides;
+        uint32_t failed;
+        uint32_t minTime;
+        uint32_t maxTime;
+        uint64_t sumTime;
+    } stats;
+} rideData_t;
+
+/**
+ * Module data
+ */
+static rideData_t rideData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t ride_waitState(uint8_t idle, uint32_t timeout);
+static void ride_press(uint32_t time);
+static uint8_t ride_run(void);
+
+int main(int argc, char** argv)
+{
+    struct timespec start, end;
+    simStats_t simStats;
+    carStats_t carStats;
+    const char* vcd = NULL;
+    const char* trace = NULL;
+    FILE* file;
+    uint32_t rides = 100;
+    uint16_t level0_1, level1_2;
+    double host, virt;
+    uint32_t i;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:vw:t:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            rides = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        case 'w':
+            vcd = optarg;
+            break;
+        case 't':
+            trace = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n rides] [-v] [-w file.vcd] [-t trace.bin]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* The first power on writes the default configuration into the blank
+     * flash, the rides start at a configured board like in the field
+     */
+    sim_init();
+    sim_boot();
+
+    sim_init();
+    car_init(CAR_FLOOR0);
+    if(vcd != NULL && !vcd_open(vcd))
+    {
+        perror(vcd);
+        return 2;
+    }
+    sim_boot();
+
+    if(!ride_waitState(1, RIDE_TIMEOUT))
+    {
+        fprintf(stderr, "idle position not arrived\n");
+        return 1;
+    }
+
+    ee_readVariable(CFG_FLOOR_0_1_TICKS_VADDR, &level0_1);
+    ee_readVariable(CFG_FLOOR_1_2_TICKS_VADDR, &level1_2);
+
+    rideData.floors[APP_FLOOR_2] = car_getPosition();
+    rideData.floors[APP_FLOOR_1] = rideData.floors[APP_FLOOR_2] - level1_2;
+    rideData.floors[APP_FLOOR_0] = rideData.floors[APP_FLOOR_1] - level0_1;
+    rideData.stats.minTime = UINT32_MAX;
+
+    for(i = 0; i < rides; i++)
+    {
+        if(!ride_run())
+        {
+            rideData.stats.failed++;
+            break;
+        }
+    }
+
+    vcd_close();
+
+    if(trace != NULL)
+    {
+        if((file = fopen(trace, "wb")) == NULL ||
+                fwrite(trc_getEntries(), sizeof(trcEntry_t), trc_getCount(), file) != trc_getCount())
+        {
+            perror(trace);
+            return 2;
+        }
+        fclose(file);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    sim_getStats(&simStats);
+    car_getStats(&carStats);
+
+    host = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    virt = (double)sim_getCycles() / SIM_CPU_CLOCK;
+
+    printf("rides           %lu\n", (unsigned long)rideData.stats.rides);
+    printf("failed          %lu\n", (unsigned long)rideData.stats.failed);
+    if(rideData.stats.rides)
+    {
+        printf("ride time ms    %lu / %.1f / %lu (min / mean / max)\n",
+                (unsigned long)rideData.stats.minTime,
+                (double)rideData.stats.sumTime / rideData.stats.rides,
+                (unsigned long)rideData.stats.maxTime);
+    }
+    printf("warnings        %lu\n", (unsigned long)simStats.warnings);
+    printf("steps           %lu (lost %lu)\n", (unsigned long)carStats.steps, (unsigned long)carStats.lostSteps);
+    printf("tim3 events     %llu\n", (unsigned long long)simStats.tim3Events);
+    printf("main loops      %llu\n", (unsigned long long)simStats.loops);
+    printf("lost ticks      %lu\n", (unsigned long)simStats.lostTicks);
+    printf("flash           %lu programs, %lu erases\n",
+            (unsigned long)simStats.flashPrograms, (unsigned long)simStats.flashErases);
+#ifdef IO_RECORD
+    {
+        ioEdge_t edges[64];
+        uint32_t n = io_recGetLost();
+        uint16_t read;
+
+        while((read = io_recRead(edges, 64)) != 0)
+        {
+            n += read;
+        }
+        printf("pin edges       %lu\n", (unsigned long)n);
+    }
+#endif
+    if(vcd != NULL)
+    {
+        printf("vcd changes     %llu\n", (unsigned long long)vcd_getChanges());
+    }
+    if(trace != NULL)
+    {
+        printf("trace entries   %u (lost %lu)\n", trc_getCount(), (unsigned long)trc_getLost());
+    }
+    printf("virtual time s  %.3f\n", virt);
+    printf("host time s     %.3f (%.0fx real time)\n", host, host > 0 ? virt / host : 0.0);
+
+    return (rideData.stats.failed || simStats.warnings) ? 1 : 0;
+}
+
+/**
+ * @brief Run the main loop until the application enters or leaves the idle
+ * state with a stopped motor
+ *
+ * @param idle 1 to wait for the idle state, 0 to wait for a drive
+ * @param timeout Timeout in ms
+ *
+ * @return 1 on success, 0 on timeout
+ */
+static uint8_t ride_waitState(uint8_t idle, uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+    uint8_t state;
+
+    while(HAL_GetTick() - start < timeout)
+    {
+        sim_loop();
+
+        state = (app_getState() == APP_STATE_IDLE &&
+                (stp_getState() == STP_STATE_IDLE || stp_getState() == STP_STATE_ARRIVED));
+        if(state == idle)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Press and release SW1
+ *
+ * @param time Press time in ms
+ */
+static void ride_press(uint32_t time)
+{
+    uint32_t start = HAL_GetTick();
+
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_RESET);
+    while(HAL_GetTick() - start < time)
+    {
+        sim_loop();
+    }
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_SET);
+}
+
+/**
+ * @brief Ride to the next floor and check the position of the car
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t ride_run(void)
+{
+    uint32_t start;
+    uint32_t time;
+    int32_t deviation;
+
+    ride_press(RIDE_PRESS_TIME);
+
+    if(!ride_waitState(0, RIDE_TIMEOUT))
+    {
+        fprintf(stderr, "ride %lu: no drive started\n", (unsigned long)rideData.stats.rides);
+        return 0;
+    }
+
+    start = HAL_GetTick();
+
+    if(!ride_waitState(1, RIDE_TIMEOUT))
+    {
+        fprintf(stderr, "ride %lu: floor not arrived\n", (unsigned long)rideData.stats.rides);
+        return 0;
+    }
+
+    time = HAL_GetTick() - start;
+
+    deviation = car_getPosition() - rideData.floors[app_getFloor()];
+    if(deviation < -RIDE_TOLERANCE || deviation > RIDE_TOLERANCE)
+    {
+        fprintf(stderr, "ride %lu: car at %ld, floor %u at %ld\n", (unsigned long)rideData.stats.rides,
+                (long)car_getPosition(), app_getFloor(), (long)rideData.floors[app_getFloor()]);
+        return 0;
+    }
+
+    rideData.stats.rides++;
+    rideData.stats.sumTime += time;
+    if(time < rideData.stats.minTime)
+    {
+        rideData.stats.minTime = time;
+    }
+    if(time > rideData.stats.maxTime)
+    {
+        rideData.stats.maxTime = time;
+    }
+
+    return 1;
+}
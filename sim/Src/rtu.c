@@ -0,0 +1,456 @@
+/**
+ * @file rtu.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Modbus RTU slave regression of the host simulation
+ *
+ * Runs modbus.c at the simulated USART1 (see sim.h) of a board with the
+ * slave address RTU_ADDRESS. A recorded stream of requests is sent by the
+ * SysTick interrupt, every request after a silent interval of the line
+ * which is a little longer than 3.5 characters:
+ *
+ * - reads and writes of the holding registers, writes out of the range of
+ *   a variable (exception 0x03), an unknown function, an illegal address,
+ *   requests to another slave and to the broadcast address and a request
+ *   with a wrong crc,
+ * - first at a fast main loop, then again at a main loop which stalls for
+ *   several requests. The frames must be split by the silence at the line,
+ *   not by the time the main loop sees the input.
+ *
+ * The responses must match the recorded responses in order. The exit code
+ * is 1 if a check fails or a warning is logged.
+ *
+ * <code>
+ * elevator-rtu [-b baud] [-v]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "car.h"
+#include "irq.h"
+#include "app.h"
+#include "usart.h"
+#include "cli.h"
+#include "modbus.h"
+#include "syscalls.h"
+#include "eeprom.h"
+#include "config.h"
+
+/**
+ * Address of the slave and of another slave at the line
+ */
+#define RTU_ADDRESS                 (17)
+#define RTU_OTHER_ADDRESS           (18)
+
+/**
+ * Maximum time until the board is idle and until a stream is sent in ms
+ */
+#define RTU_TIMEOUT                 (30 * 1000)
+
+/**
+ * Time until the response of the last request is complete in ms
+ */
+#define RTU_RESPONSE_TIME           (50)
+
+/**
+ * Number of requests which arrive while the main loop stalls
+ */
+#define RTU_STALL_REQUESTS          (3)
+
+/**
+ * Maximum size of a request or response PDU of the stream
+ */
+#define RTU_PDU_SIZE                (16)
+
+/**
+ * Size of the captured output
+ */
+#define RTU_OUTPUT_SIZE             (4096)
+
+/**
+ * Recorded request and its response
+ */
+typedef struct rtuRecord_s {
+    const char* name;
+    uint8_t address;
+    uint8_t request[RTU_PDU_SIZE];
+    uint8_t requestLen;
+    uint8_t response[RTU_PDU_SIZE];
+    uint8_t responseLen;    /* 0 if no response is sent */
+    uint8_t badCrc;         /* 1 to send the request with a wrong crc */
+} rtuRecord_t;
+
+/**
+ * Modbus test data struct type
+ */
+typedef struct rtuData_s {
+    /**
+     * Captured output
+     */
+    uint8_t output[RTU_OUTPUT_SIZE];
+    uint32_t outputLen;
+
+    /**
+     * Stream sent by the SysTick interrupt: the next record, the cycle when
+     * it is due and the silent interval before a request
+     */
+    uint32_t next;
+    uint64_t due;
+    uint64_t gapCycles;
+
+    /**
+     * Stall of the main loop in ms (0 for a fast main loop)
+     */
+    uint32_t stall;
+} rtuData_t;
+
+/**
+ * Module data
+ */
+static rtuData_t rtuData;
+
+/**
+ * Recorded stream, the responses follow the state of the writes before
+ */
+static const rtuRecord_t rtuStream[] = {
+        { "read holding", RTU_ADDRESS, { 0x03, 0x00, 0x00, 0x00, 0x02 }, 5,
+                { 0x03, 0x04, 0x03, 0xE8, 0x00, 0x1E }, 6, 0 },
+        { "write single", RTU_ADDRESS, { 0x06, 0x00, 0x01, 0x00, 0x3C }, 5,
+                { 0x06, 0x00, 0x01, 0x00, 0x3C }, 5, 0 },
+        { "read back", RTU_ADDRESS, { 0x03, 0x00, 0x01, 0x00, 0x01 }, 5,
+                { 0x03, 0x02, 0x00, 0x3C }, 4, 0 },
+        { "single out of range", RTU_ADDRESS, { 0x06, 0x00, 0x01, 0x01, 0xF4 }, 5,
+                { 0x86, 0x03 }, 2, 0 },
+        { "slave address out of range", RTU_ADDRESS, { 0x06, 0x00, 0x06, 0x00, 0xF8 }, 5,
+                { 0x86, 0x03 }, 2, 0 },
+        { "write multiple", RTU_ADDRESS, { 0x10, 0x00, 0x00, 0x00, 0x02, 0x04, 0x07, 0xD0, 0x00, 0x0A }, 10,
+                { 0x10, 0x00, 0x00, 0x00, 0x02 }, 5, 0 },
+        { "multiple out of range", RTU_ADDRESS, { 0x10, 0x00, 0x00, 0x00, 0x02, 0x04, 0x00, 0x64, 0x00, 0x14 }, 10,
+                { 0x90, 0x03 }, 2, 0 },
+        { "read unchanged", RTU_ADDRESS, { 0x03, 0x00, 0x00, 0x00, 0x02 }, 5,
+                { 0x03, 0x04, 0x07, 0xD0, 0x00, 0x0A }, 6, 0 },
+        { "illegal function", RTU_ADDRESS, { 0x05, 0x00, 0x00, 0xFF, 0x00 }, 5,
+                { 0x85, 0x01 }, 2, 0 },
+        { "illegal address", RTU_ADDRESS, { 0x03, 0x00, 0x07, 0x00, 0x01 }, 5,
+                { 0x83, 0x02 }, 2, 0 },
+        { "other slave", RTU_OTHER_ADDRESS, { 0x06, 0x00, 0x01, 0x00, 0x50 }, 5,
+                { 0 }, 0, 0 },
+        { "broadcast", MB_ADDR_BROADCAST, { 0x06, 0x00, 0x01, 0x00, 0x14 }, 5,
+                { 0 }, 0, 0 },
+        { "wrong crc", RTU_ADDRESS, { 0x06, 0x00, 0x01, 0x00, 0x28 }, 5,
+                { 0 }, 0, 1 },
+        { "read broadcast", RTU_ADDRESS, { 0x03, 0x00, 0x01, 0x00, 0x01 }, 5,
+                { 0x03, 0x02, 0x00, 0x14 }, 4, 0 },
+        { "restore", RTU_ADDRESS, { 0x10, 0x00, 0x00, 0x00, 0x02, 0x04, 0x03, 0xE8, 0x00, 0x1E }, 10,
+                { 0x10, 0x00, 0x00, 0x00, 0x02 }, 5, 0 },
+};
+
+#define RTU_RECORDS                 (sizeof(rtuStream) / sizeof(rtuStream[0]))
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void rtu_loop(void);
+static void rtu_usartIrq(void);
+static void rtu_output(uint8_t data);
+static void rtu_tick(void);
+static uint8_t rtu_stream(uint32_t stall);
+static uint16_t rtu_frame(uint8_t address, const uint8_t* pdu, uint8_t len, uint8_t* frame);
+static uint16_t rtu_crc16(const uint8_t* data, uint16_t len);
+
+int main(int argc, char** argv)
+{
+    simStats_t simStats;
+    cliStats_t cliStats;
+    mbStats_t mbStats;
+    uint32_t baudRate = 115200;
+    uint32_t t35;
+    uint8_t ok;
+    int opt;
+
+    while((opt = getopt(argc, argv, "b:v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'b':
+            baudRate = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-b baud] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    /* Configured board at floor 0 with the slave address, see ride.c */
+    sim_init();
+    sim_boot();
+
+    if(ee_writeVariable(CFG_MODBUS_ADDR_VADDR, RTU_ADDRESS) != HAL_OK || ee_flush() != HAL_OK)
+    {
+        fprintf(stderr, "address not written\n");
+        return 1;
+    }
+
+    sim_init();
+    car_init(CAR_FLOOR0);
+    sim_boot();
+
+    /* Like main() and USART1_IRQHandler() */
+    huart1.Init.BaudRate = baudRate;
+    HAL_UART_Init(&huart1);
+    irq_setHandler(USART1_IRQn, rtu_usartIrq);
+    cli_init();
+    mb_init();
+    sim_setLoopHook(rtu_loop);
+    sim_setUartHook(rtu_output);
+
+    while(app_getState() != APP_STATE_IDLE)
+    {
+        if(HAL_GetTick() >= RTU_TIMEOUT)
+        {
+            fprintf(stderr, "idle position not arrived\n");
+            return 1;
+        }
+        sim_loop();
+    }
+
+    /* The silent interval of modbus.c and a character time more */
+    t35 = (baudRate > 19200) ? 2 : (35 * 11 * 1000 / 10 + baudRate - 1) / baudRate;
+    rtuData.gapCycles = (uint64_t)SIM_CPU_CLOCK * (t35 + 1) / 1000 + (uint64_t)SIM_CPU_CLOCK * 11 / baudRate;
+    sim_setTickHook(rtu_tick);
+
+    /* The main loop stalls while several requests arrive */
+    ok = rtu_stream(0) &&
+            rtu_stream(RTU_STALL_REQUESTS * (t35 + 2 + RTU_PDU_SIZE * 11 * 1000 / baudRate));
+
+    sim_getStats(&simStats);
+    cli_getStats(&cliStats);
+    mb_getStats(&mbStats);
+
+    printf("baud rate       %lu (t3.5 %lu ms)\n", (unsigned long)baudRate, (unsigned long)t35);
+    printf("requests        %lu\n", (unsigned long)(2 * RTU_RECORDS));
+    printf("frames          %lu (crc errors %lu, overruns %lu, exceptions %lu)\n",
+            (unsigned long)mbStats.frames, (unsigned long)mbStats.crcErrors,
+            (unsigned long)mbStats.overruns, (unsigned long)mbStats.exceptions);
+    printf("received        %lu bytes (lost %lu, errors %lu)\n", (unsigned long)cliStats.received,
+            (unsigned long)cliStats.rxLost, (unsigned long)cliStats.rxErrors);
+    printf("sent            %lu bytes\n", (unsigned long)cliStats.sent);
+    printf("warnings        %lu\n", (unsigned long)simStats.warnings);
+
+    /* Every stream has one request with a wrong crc and one to another slave */
+    if(ok && (mbStats.crcErrors != 2 || mbStats.overruns != 0 || mbStats.frames != 2 * (RTU_RECORDS - 2)))
+    {
+        fprintf(stderr, "statistics of the slave wrong\n");
+        ok = 0;
+    }
+
+    return (!ok || simStats.warnings || cliStats.rxLost || cliStats.rxErrors) ? 1 : 0;
+}
+
+/**
+ * @brief Handlers of the main loop which are not part of the core
+ */
+static void rtu_loop(void)
+{
+    cli_handler();
+    mb_handler();
+
+    if(rtuData.stall)
+    {
+        sim_advance((uint64_t)SIM_CPU_CLOCK * rtuData.stall / 1000);
+    }
+}
+
+/**
+ * @brief Interrupt handler of USART1
+ */
+static void rtu_usartIrq(void)
+{
+    cli_uartIrqHandler();
+    HAL_UART_IRQHandler(&huart1);
+}
+
+/**
+ * @brief Capture a byte sent at USART1
+ */
+static void rtu_output(uint8_t data)
+{
+    if(rtuData.outputLen < RTU_OUTPUT_SIZE)
+    {
+        rtuData.output[rtuData.outputLen++] = data;
+    }
+}
+
+/**
+ * @brief Send the next request of the stream when it is due
+ *
+ * The request is due when the request before and the silent interval have
+ * passed at the line.
+ */
+static void rtu_tick(void)
+{
+    const rtuRecord_t* record;
+    uint8_t frame[RTU_PDU_SIZE + 3];
+    uint16_t len;
+
+    if(rtuData.next >= RTU_RECORDS || sim_getCycles() < rtuData.due)
+    {
+        return;
+    }
+
+    record = &rtuStream[rtuData.next++];
+    len = rtu_frame(record->address, record->request, record->requestLen, frame);
+    if(record->badCrc)
+    {
+        frame[len - 1] ^= 0x01;
+    }
+
+    sim_uartInput(frame, len);
+    rtuData.due = sim_getCycles() + (uint64_t)SIM_CPU_CLOCK * len * 11 / huart1.Init.BaudRate +
+            rtuData.gapCycles;
+}
+
+/**
+ * @brief Send the recorded stream and compare the responses
+ *
+ * @param stall Stall of the main loop in ms
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t rtu_stream(uint32_t stall)
+{
+    const rtuRecord_t* record;
+    uint8_t expected[RTU_PDU_SIZE + 3];
+    uint32_t start = HAL_GetTick();
+    uint32_t pos = 0;
+    uint16_t len;
+    uint32_t i;
+
+    rtuData.outputLen = 0;
+    rtuData.next = 0;
+    rtuData.due = sim_getCycles() + rtuData.gapCycles;
+    rtuData.stall = stall;
+
+    while(rtuData.next < RTU_RECORDS)
+    {
+        if(HAL_GetTick() - start >= RTU_TIMEOUT)
+        {
+            fprintf(stderr, "stall %lu ms: stream not sent\n", (unsigned long)stall);
+            return 0;
+        }
+        sim_loop();
+    }
+
+    /* The last response is complete */
+    start = HAL_GetTick();
+    while(HAL_GetTick() - start < RTU_RESPONSE_TIME + stall)
+    {
+        sim_loop();
+    }
+
+    rtuData.stall = 0;
+
+    for(i = 0; i < RTU_RECORDS; i++)
+    {
+        record = &rtuStream[i];
+        if(record->responseLen == 0)
+        {
+            continue;
+        }
+
+        len = rtu_frame(RTU_ADDRESS, record->response, record->responseLen, expected);
+        if(pos + len > rtuData.outputLen || memcmp(&rtuData.output[pos], expected, len) != 0)
+        {
+            fprintf(stderr, "stall %lu ms: %s: response wrong or missing\n", (unsigned long)stall,
+                    record->name);
+            return 0;
+        }
+        pos += len;
+    }
+
+    if(pos != rtuData.outputLen)
+    {
+        fprintf(stderr, "stall %lu ms: %lu bytes more than the responses\n", (unsigned long)stall,
+                (unsigned long)(rtuData.outputLen - pos));
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Build a RTU frame
+ *
+ * @param address Slave address
+ * @param pdu PDU
+ * @param len PDU length
+ * @param frame Frame, at least len + 3 bytes
+ *
+ * @return Frame length
+ */
+static uint16_t rtu_frame(uint8_t address, const uint8_t* pdu, uint8_t len, uint8_t* frame)
+{
+    uint16_t crc;
+
+    frame[0] = address;
+    memcpy(&frame[1], pdu, len);
+    len++;
+
+    crc = rtu_crc16(frame, len);
+    frame[len++] = crc & 0xFF;
+    frame[len++] = crc >> 8;
+
+    return len;
+}
+
+/**
+ * @brief Calculate the CRC-16/MODBUS like a master
+ *
+ * @param data Data
+ * @param len Number of bytes
+ *
+ * @return CRC
+ */
+static uint16_t rtu_crc16(const uint8_t* data, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    while(len--)
+    {
+        crc ^= *data++;
+        for(i = 0; i < 8; i++)
+        {
+            crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+    }
+
+    return crc;
+}
+
+/**
+ * @brief ITM output of syscalls.c, there is no debugger at the host
+ */
+int _write(int file, char* ptr, int len)
+{
+    return len;
+}
+
+/**
+ * @brief Statistics of the ITM output, see _write()
+ */
+void sys_getItmStats(sysItmStats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
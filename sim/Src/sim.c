@@ -0,0 +1,1399 @@
+/**
+ * @file sim.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Simulated microcontroller implementation
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "sim.h"
+#include "tim.h"
+#include "irq.h"
+#include "eeprom.h"
+#include "app.h"
+#include "btn.h"
+#include "stepper.h"
+#include "io.h"
+#include "trc.h"
+
+/**
+ * Pending flag of the SysTick interrupt
+ */
+#define SIM_PENDING_SYSTICK         (1 << 0)
+#define SIM_PENDING_FLASH           (1 << 1)
+
+/**
+ * Simulation data struct type
+ */
+typedef struct simData_s {
+    /**
+     * Virtual time in CPU cycles
+     */
+    uint64_t cycles;
+
+    struct {
+        uint64_t next;
+        volatile uint32_t tick;
+    } sysTick;
+
+    struct {
+        uint64_t nextUpdate;
+        /**
+         * Active auto reload value, loaded from ARR at the update event
+         */
+        uint32_t shadowArr;
+    } tim3;
+
+    struct {
+        uint32_t primask;
+        uint64_t enabled;
+        uint8_t pending;
+        uint8_t active;
+        irqHandler_t vectors[IRQ_VECTOR_COUNT];
+    } nvic;
+
+    struct {
+        uint8_t locked;
+        /**
+         * The CPU is stalled by a flash operation
+         */
+        uint8_t busy;
+        /**
+         * Background erase: running, its page address and its end
+         */
+        uint8_t erasing;
+        uint32_t eraseAddress;
+        uint64_t eraseEnd;
+    } flash;
+
+    struct {
+        /**
+         * CPU cycles of a character frame
+         */
+        uint32_t charCycles;
+
+        /**
+         * Transmission: DMA transfer, the next byte and the end of the
+         * character at the shift register (0 if none)
+         */
+        const uint8_t* txData;
+        uint16_t txLen;
+        uint16_t txPos;
+        uint64_t txNext;
+
+        /**
+         * Reception: queued bytes at the line, the end of the next character
+         * and the end of the idle frame after the last one (0 if none)
+         */
+        uint8_t input[SIM_UART_INPUT_SIZE];
+        uint32_t inputHead;
+        uint32_t inputTail;
+        uint64_t rxNext;
+        uint64_t idleEnd;
+        uint8_t* rxBuffer;
+        uint16_t rxSize;
+
+        /**
+         * Pending interrupts of the DMA channel of the reception
+         * (DMA_CCR_HTIE, DMA_CCR_TCIE)
+         */
+        uint8_t dmaRxPending;
+    } uart;
+
+    struct {
+        /**
+         * Flash operations up to the power cut
+         */
+        uint32_t operations;
+        simPowerCutHook_t hook;
+    } powerCut;
+
+    /**
+     * Output data registers at the last call of the output hooks
+     */
+    uint32_t odr[SIM_GPIO_PORTS];
+    simOutputHook_t outputHooks[SIM_MAX_OUTPUT_HOOKS];
+    simInputHook_t inputHooks[SIM_MAX_INPUT_HOOKS];
+    simTickHook_t tickHook;
+    simReadHook_t readHook;
+    simLoopHook_t loopHook;
+    simUartHook_t uartHook;
+
+    uint8_t verbose;
+
+    simStats_t stats;
+} simData_t;
+
+/**
+ * Flash image, kept by sim_init() like the flash keeps its content on a reset
+ */
+static uint8_t simFlash[SIM_FLASH_SIZE];
+static uint8_t simFlashValid;
+
+/**
+ * Module data
+ */
+static simData_t simData;
+
+/**
+ * Peripherals
+ */
+GPIO_TypeDef simGpio[SIM_GPIO_PORTS];
+TIM_TypeDef simTim3;
+TIM_HandleTypeDef htim3;
+USART_TypeDef simUsart1;
+DMA_Channel_TypeDef simDma1Channel4;
+DMA_Channel_TypeDef simDma1Channel5;
+UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_rx;
+DMA_HandleTypeDef hdma_usart1_tx;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void sim_runUntil(uint64_t end);
+static void sim_service(void);
+static void sim_syncOutputs(void);
+static void sim_stall(uint64_t cycles);
+static uint64_t sim_nextEvent(void);
+static void sim_endErase(void);
+static void sim_checkPowerCut(void);
+static void sim_uartTxEvent(void);
+static void sim_uartRxEvent(void);
+static uint8_t sim_uartIsPending(void);
+static uint32_t sim_flashOffset(uint32_t address, uint32_t size);
+static void sim_fault(const char* fmt, ...);
+
+/**
+ * @brief Reset the microcontroller
+ *
+ * The peripherals, the virtual time, the statistics and the hooks are reset.
+ * The flash image is erased by the first call only.
+ */
+void sim_init(void)
+{
+    uint8_t verbose = simData.verbose;
+
+    memset(&simData, 0, sizeof(simData));
+    simData.verbose = verbose;
+    memset(simGpio, 0, sizeof(simGpio));
+    memset(&simTim3, 0, sizeof(simTim3));
+    memset(&simUsart1, 0, sizeof(simUsart1));
+    memset(&simDma1Channel4, 0, sizeof(simDma1Channel4));
+    memset(&simDma1Channel5, 0, sizeof(simDma1Channel5));
+
+    simData.sysTick.next = SIM_TICK_CYCLES;
+    simData.flash.locked = 1;
+
+    /* The inputs have pull-ups */
+    simGpio[0].IDR =
+    simGpio[1].IDR =
+    simGpio[2].IDR = 0xFFFF;
+
+    /* Like MX_TIM3_Init() and its MSP */
+    htim3.Instance = TIM3;
+    htim3.Init.Prescaler = 0;
+    htim3.Init.CounterMode = TIM_COUNTERMODE_UP;
+    htim3.Init.Period = 65535;
+    htim3.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    htim3.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    HAL_TIM_Base_Init(&htim3);
+    HAL_NVIC_EnableIRQ(TIM3_IRQn);
+
+    /* Like MX_DMA_Init(), MX_USART1_UART_Init() and its MSP */
+    hdma_usart1_rx.Instance = DMA1_Channel5;
+    hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart1_tx.Instance = DMA1_Channel4;
+    hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+    huart1.Instance = USART1;
+    huart1.Init.BaudRate = 115200;
+    huart1.Init.WordLength = UART_WORDLENGTH_8B;
+    huart1.Init.StopBits = UART_STOPBITS_1;
+    huart1.Init.Parity = UART_PARITY_NONE;
+    huart1.Init.Mode = UART_MODE_TX_RX;
+    huart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    huart1.Init.OverSampling = UART_OVERSAMPLING_16;
+    huart1.hdmarx = &hdma_usart1_rx;
+    huart1.hdmatx = &hdma_usart1_tx;
+    HAL_UART_Init(&huart1);
+    HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+    HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+
+    if(!simFlashValid)
+    {
+        sim_eraseFlash();
+    }
+}
+
+/**
+ * @brief Run the init functions of the application core like main()
+ */
+void sim_boot(void)
+{
+    irq_init();
+
+#ifdef IO_RECORD
+    io_recInit();
+#endif
+#ifdef TRC_RECORD
+    trc_init();
+#endif
+
+    btn_init();
+    ee_init();
+    stp_init();
+    app_init(); /* This must be the last init function call */
+}
+
+/**
+ * @brief Run one iteration of the main loop and wait for the next interrupt
+ */
+void sim_loop(void)
+{
+    app_handler();
+    stp_handler();
+    ee_handler();
+
+    if(simData.loopHook != NULL)
+    {
+        simData.loopHook();
+    }
+
+    simData.stats.loops++;
+
+    sim_runUntil(sim_nextEvent());
+}
+
+/**
+ * @brief Let the virtual time pass and serve the interrupts
+ *
+ * @param cycles Number of CPU cycles
+ */
+void sim_advance(uint64_t cycles)
+{
+    if(simData.nvic.active)
+    {
+        /* Interrupts are served in zero time */
+        simData.cycles += cycles;
+        return;
+    }
+
+    sim_runUntil(simData.cycles + cycles);
+}
+
+/**
+ * @brief Returns the virtual time in CPU cycles
+ */
+uint64_t sim_getCycles(void)
+{
+    return simData.cycles;
+}
+
+/**
+ * @brief Set the level of an input pin
+ */
+void sim_setInput(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state)
+{
+    uint32_t idr = port->IDR;
+    uint8_t i;
+
+    if(state == GPIO_PIN_SET)
+    {
+        port->IDR |= pin;
+    }else
+    {
+        port->IDR &= ~(uint32_t)pin;
+    }
+
+    if(port->IDR == idr)
+    {
+        return;
+    }
+
+    for(i = 0; i < SIM_MAX_INPUT_HOOKS && simData.inputHooks[i] != NULL; i++)
+    {
+        simData.inputHooks[i](port, (uint16_t)(port->IDR ^ idr));
+    }
+}
+
+/**
+ * @brief Returns the level of an output pin
+ */
+GPIO_PinState sim_getOutput(GPIO_TypeDef* port, uint16_t pin)
+{
+    return (port->ODR & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+/**
+ * @brief Register an observer of the output pins
+ *
+ * The hooks are called at the virtual time of the change.
+ *
+ * @return 1 if the hook is registered otherwise 0
+ */
+uint8_t sim_addOutputHook(simOutputHook_t hook)
+{
+    uint8_t i;
+
+    for(i = 0; i < SIM_MAX_OUTPUT_HOOKS; i++)
+    {
+        if(simData.outputHooks[i] == hook)
+        {
+            return 1;
+        }
+    }
+
+    for(i = 0; i < SIM_MAX_OUTPUT_HOOKS; i++)
+    {
+        if(simData.outputHooks[i] == NULL)
+        {
+            simData.outputHooks[i] = hook;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Register an observer of the input pins
+ *
+ * The hooks are called by sim_setInput() if the level changes.
+ *
+ * @return 1 if the hook is registered otherwise 0
+ */
+uint8_t sim_addInputHook(simInputHook_t hook)
+{
+    uint8_t i;
+
+    for(i = 0; i < SIM_MAX_INPUT_HOOKS; i++)
+    {
+        if(simData.inputHooks[i] == hook)
+        {
+            return 1;
+        }
+    }
+
+    for(i = 0; i < SIM_MAX_INPUT_HOOKS; i++)
+    {
+        if(simData.inputHooks[i] == NULL)
+        {
+            simData.inputHooks[i] = hook;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Set the function which runs at the end of every SysTick interrupt
+ */
+void sim_setTickHook(simTickHook_t hook)
+{
+    simData.tickHook = hook;
+}
+
+/**
+ * @brief Set the function which runs before an input pin is sampled
+ *
+ * The hook runs at the virtual time of the sample, e.g. to set the inputs of
+ * a recorded trace.
+ */
+void sim_setReadHook(simReadHook_t hook)
+{
+    simData.readHook = hook;
+}
+
+/**
+ * @brief Set the function which runs at every iteration of the main loop
+ */
+void sim_setLoopHook(simLoopHook_t hook)
+{
+    simData.loopHook = hook;
+}
+
+/**
+ * @brief Set the receiver of the bytes sent at USART1
+ *
+ * The hook runs at the virtual time of the stop bit of the byte.
+ */
+void sim_setUartHook(simUartHook_t hook)
+{
+    simData.uartHook = hook;
+}
+
+/**
+ * @brief Queue bytes at the receive line of USART1
+ *
+ * The bytes follow the queued bytes back to back, the first one starts now
+ * if the line is idle. An idle frame after the last byte raises the IDLE
+ * flag.
+ *
+ * @param data Bytes
+ * @param len Number of bytes
+ *
+ * @return Number of queued bytes, less than len if the queue is full
+ */
+uint16_t sim_uartInput(const uint8_t* data, uint16_t len)
+{
+    uint16_t i;
+
+    for(i = 0; i < len && simData.uart.inputHead - simData.uart.inputTail < SIM_UART_INPUT_SIZE; i++)
+    {
+        simData.uart.input[simData.uart.inputHead++ % SIM_UART_INPUT_SIZE] = data[i];
+    }
+
+    if(i != 0 && simData.uart.rxNext == 0)
+    {
+        simData.uart.rxNext = simData.cycles + simData.uart.charCycles;
+        simData.uart.idleEnd = 0;
+    }
+
+    return i;
+}
+
+/**
+ * @brief Inject a power loss
+ *
+ * The given number of half word programs and page erases complete, the power
+ * fails before the next one: the hook runs instead and the flash image keeps
+ * its content. sim_init() disarms the power cut.
+ *
+ * @param operations Flash operations before the power cut
+ * @param hook Function which runs at the power cut, NULL to disarm
+ */
+void sim_setPowerCut(uint32_t operations, simPowerCutHook_t hook)
+{
+    simData.powerCut.operations = operations;
+    simData.powerCut.hook = hook;
+}
+
+/**
+ * @brief Erase the flash image (blank device)
+ */
+void sim_eraseFlash(void)
+{
+    memset(simFlash, 0xFF, sizeof(simFlash));
+    simFlashValid = 1;
+}
+
+/**
+ * @brief Copy the flash image
+ *
+ * @param image Destination of SIM_FLASH_SIZE bytes
+ */
+void sim_saveFlash(uint8_t* image)
+{
+    memcpy(image, simFlash, sizeof(simFlash));
+}
+
+/**
+ * @brief Restore a flash image copied by sim_saveFlash()
+ *
+ * @param image Image of SIM_FLASH_SIZE bytes
+ */
+void sim_loadFlash(const uint8_t* image)
+{
+    memcpy(simFlash, image, sizeof(simFlash));
+    simFlashValid = 1;
+}
+
+/**
+ * @brief Print the log messages of the modules
+ */
+void sim_setVerbose(uint8_t verbose)
+{
+    simData.verbose = verbose;
+}
+
+/**
+ * @brief Output of the log messages (MLOG_PRINTF_FUNC)
+ *
+ * The message is prefixed with the virtual time in ms. Warnings are counted
+ * also if the output is off.
+ */
+int sim_log(const char* fmt, ...)
+{
+    va_list ap;
+    int len;
+
+    if(strncmp(fmt, "[warn]", 6) == 0)
+    {
+        simData.stats.warnings++;
+    }
+
+    if(!simData.verbose)
+    {
+        return 0;
+    }
+
+    len = printf("%12.3f ", (double)simData.cycles / SIM_TICK_CYCLES);
+
+    va_start(ap, fmt);
+    len += vprintf(fmt, ap);
+    va_end(ap);
+
+    return len;
+}
+
+/**
+ * @brief Copy the statistics of the simulation
+ */
+void sim_getStats(simStats_t* stats)
+{
+    *stats = simData.stats;
+}
+
+/* Flash port ----------------------------------------------------------------*/
+
+/**
+ * @brief Read a half word of the flash image
+ */
+uint16_t sim_flashRead(uint32_t address)
+{
+    uint32_t offset = sim_flashOffset(address, 2);
+
+    /* A read waits for the end of a background erase */
+    if(simData.flash.erasing)
+    {
+        sim_stall(simData.flash.eraseEnd - simData.cycles);
+    }
+
+    return simFlash[offset] | ((uint16_t)simFlash[offset + 1] << 8);
+}
+
+/**
+ * @brief Program a half word
+ *
+ * Like the flash controller a half word which is not erased can only be
+ * programmed to 0x0000.
+ */
+HAL_StatusTypeDef sim_flashProgram(uint32_t address, uint16_t data)
+{
+    uint32_t offset = sim_flashOffset(address, 2);
+
+    if(simData.flash.erasing)
+    {
+        return HAL_BUSY;
+    }
+
+    if(simData.flash.locked || (sim_flashRead(address) != 0xFFFF && data != 0x0000))
+    {
+        return HAL_ERROR;
+    }
+
+    sim_checkPowerCut();
+    sim_stall(SIM_FLASH_PROGRAM_CYCLES);
+
+    simFlash[offset] = data & 0xFF;
+    simFlash[offset + 1] = data >> 8;
+
+    simData.stats.flashPrograms++;
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Erase pages (blocking)
+ */
+HAL_StatusTypeDef sim_flashErase(FLASH_EraseInitTypeDef* init, uint32_t* pageError)
+{
+    uint32_t i;
+
+    *pageError = 0xFFFFFFFF;
+
+    if(simData.flash.erasing)
+    {
+        return HAL_BUSY;
+    }
+
+    if(simData.flash.locked)
+    {
+        return HAL_ERROR;
+    }
+
+    for(i = 0; i < init->NbPages; i++)
+    {
+        sim_checkPowerCut();
+        sim_stall(SIM_FLASH_ERASE_CYCLES);
+
+        memset(&simFlash[sim_flashOffset(init->PageAddress + i * FLASH_PAGE_SIZE, FLASH_PAGE_SIZE)],
+                0xFF, FLASH_PAGE_SIZE);
+
+        simData.stats.flashErases++;
+    }
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Start the erase of a page in the background
+ *
+ * The flash interrupt calls HAL_FLASH_EndOfOperationCallback() after
+ * SIM_FLASH_ERASE_CYCLES. Only single pages are supported like by eeprom.c.
+ *
+ * The main loop fetches its instructions from the flash: the caller stalls
+ * until the end of the erase and only the interrupt running from RAM (TIM3)
+ * is served. The flash interrupt follows before the caller continues.
+ */
+HAL_StatusTypeDef sim_flashEraseIT(FLASH_EraseInitTypeDef* init)
+{
+    if(simData.flash.erasing)
+    {
+        return HAL_BUSY;
+    }
+
+    if(simData.flash.locked || init->NbPages != 1)
+    {
+        return HAL_ERROR;
+    }
+
+    sim_flashOffset(init->PageAddress, FLASH_PAGE_SIZE);
+    sim_checkPowerCut();
+
+    simData.flash.erasing = 1;
+    simData.flash.eraseAddress = init->PageAddress;
+    simData.flash.eraseEnd = simData.cycles + SIM_FLASH_ERASE_CYCLES;
+
+    sim_stall(SIM_FLASH_ERASE_CYCLES);
+
+    return HAL_OK;
+}
+
+/* HAL -----------------------------------------------------------------------*/
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority, uint32_t SubPriority)
+{
+    /* TIM3 is the only interrupt which preempts the main loop code */
+    UNUSED(IRQn);
+    UNUSED(PreemptPriority);
+    UNUSED(SubPriority);
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    simData.nvic.enabled |= (uint64_t)1 << IRQn;
+}
+
+void HAL_NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    simData.nvic.enabled &= ~((uint64_t)1 << IRQn);
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return simData.nvic.primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+    simData.nvic.primask = priMask & 1;
+    sim_service();
+}
+
+void __disable_irq(void)
+{
+    simData.nvic.primask = 1;
+}
+
+void __enable_irq(void)
+{
+    __set_PRIMASK(0);
+}
+
+SysTick_Type* sim_getSysTick(void)
+{
+    static SysTick_Type sysTick;
+
+    /* Counts down from LOAD to 0, reloaded at the SysTick event */
+    sysTick.LOAD = SIM_TICK_CYCLES - 1;
+    sysTick.VAL = simData.sysTick.next - simData.cycles - 1;
+
+    return &sysTick;
+}
+
+uint32_t HAL_GetTick(void)
+{
+    return simData.sysTick.tick;
+}
+
+void HAL_IncTick(void)
+{
+    simData.sysTick.tick++;
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    sim_advance(SIM_GPIO_READ_CYCLES);
+
+    if(simData.readHook != NULL)
+    {
+        simData.readHook();
+    }
+
+    return (GPIOx->IDR & GPIO_Pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if(PinState != GPIO_PIN_RESET)
+    {
+        GPIOx->ODR |= GPIO_Pin;
+    }else
+    {
+        GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+    }
+}
+
+void HAL_GPIO_TogglePin(GPIO_TypeDef* GPIOx, uint16_t GPIO_Pin)
+{
+    GPIOx->ODR ^= GPIO_Pin;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim)
+{
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    htim->Instance->CR1 = (htim->Instance->CR1 & TIM_CR1_CEN) | htim->Init.AutoReloadPreload;
+
+    /* The update generation reloads the counter and sets the update flag */
+    htim->Instance->CNT = 0;
+    htim->Instance->SR |= TIM_SR_UIF;
+    simData.tim3.shadowArr = htim->Instance->ARR;
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Init(TIM_HandleTypeDef* htim)
+{
+    return HAL_TIM_Base_Init(htim);
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef* htim)
+{
+    uint32_t psc = htim->Instance->PSC + 1;
+
+    if(!(htim->Instance->CR1 & TIM_CR1_CEN))
+    {
+        htim->Instance->CR1 |= TIM_CR1_CEN;
+        simData.tim3.nextUpdate = simData.cycles +
+                (uint64_t)(simData.tim3.shadowArr + 1 - htim->Instance->CNT) * psc;
+    }
+
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef* htim)
+{
+    uint32_t psc = htim->Instance->PSC + 1;
+
+    if(htim->Instance->CR1 & TIM_CR1_CEN)
+    {
+        htim->Instance->CR1 &= ~TIM_CR1_CEN;
+        htim->Instance->CNT = simData.tim3.shadowArr + 1 -
+                (uint32_t)((simData.tim3.nextUpdate - simData.cycles + psc - 1) / psc);
+    }
+
+    return HAL_OK;
+}
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef* htim)
+{
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) && (htim->Instance->DIER & TIM_IT_UPDATE))
+    {
+        __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+        HAL_TIM_PeriodElapsedCallback(htim);
+    }
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void)
+{
+    simData.flash.locked = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void)
+{
+    simData.flash.locked = 1;
+    return HAL_OK;
+}
+
+/**
+ * @brief Initialize the frame format of USART1
+ *
+ * The word length includes the parity bit like at the target.
+ */
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef* huart)
+{
+    uint32_t bits;
+
+    if(huart->Instance != USART1 || huart->Init.BaudRate == 0)
+    {
+        return HAL_ERROR;
+    }
+
+    /* Start bit, data bits and stop bits */
+    bits = 1 + ((huart->Init.WordLength == UART_WORDLENGTH_9B) ? 9 : 8) +
+            ((huart->Init.StopBits == UART_STOPBITS_2) ? 2 : 1);
+    simData.uart.charCycles = (SIM_CPU_CLOCK * bits + huart->Init.BaudRate - 1) / huart->Init.BaudRate;
+
+    huart->Instance->CR1 = huart->Init.WordLength | huart->Init.Parity | huart->Init.Mode;
+    huart->Instance->SR = USART_SR_TC;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Start a DMA transmission
+ *
+ * The DMA reads a byte when its character starts, the first one at once.
+ * The transmission complete interrupt ends the transfer.
+ */
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+    if(huart->gState != HAL_UART_STATE_READY)
+    {
+        return HAL_BUSY;
+    }
+
+    if(pData == NULL || Size == 0)
+    {
+        return HAL_ERROR;
+    }
+
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    huart->Instance->SR &= ~USART_SR_TC;
+    huart->hdmatx->Instance->CNDTR = Size;
+    huart->hdmatx->Instance->CCR |= DMA_CCR_EN;
+
+    simData.uart.txData = pData;
+    simData.uart.txLen = Size;
+    simData.uart.txPos = 0;
+    simData.uart.txNext = simData.cycles + simData.uart.charCycles;
+
+    simData.stats.uartTxBursts++;
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Start a DMA reception
+ *
+ * The mode (normal or circular) is taken from the DMA handle.
+ */
+HAL_StatusTypeDef HAL_UART_Receive_DMA(UART_HandleTypeDef* huart, uint8_t* pData, uint16_t Size)
+{
+    if(huart->RxState != HAL_UART_STATE_READY)
+    {
+        return HAL_BUSY;
+    }
+
+    if(pData == NULL || Size == 0)
+    {
+        return HAL_ERROR;
+    }
+
+    huart->RxState = HAL_UART_STATE_BUSY_RX;
+    huart->hdmarx->Instance->CNDTR = Size;
+    huart->hdmarx->Instance->CCR = DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | huart->hdmarx->Init.Mode;
+
+    simData.uart.rxBuffer = pData;
+    simData.uart.rxSize = Size;
+    simData.uart.dmaRxPending = 0;
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Abort both DMA transfers
+ *
+ * A character at the shift register is cut.
+ */
+HAL_StatusTypeDef HAL_UART_DMAStop(UART_HandleTypeDef* huart)
+{
+    huart->hdmatx->Instance->CCR &= ~DMA_CCR_EN;
+    huart->hdmarx->Instance->CCR &= ~DMA_CCR_EN;
+    huart->Instance->CR1 &= ~USART_CR1_TCIE;
+    huart->gState = HAL_UART_STATE_READY;
+    huart->RxState = HAL_UART_STATE_READY;
+
+    simData.uart.txData = NULL;
+    simData.uart.txNext = 0;
+    simData.uart.dmaRxPending = 0;
+
+    return HAL_OK;
+}
+
+/**
+ * @brief Interrupt handler of USART1
+ *
+ * Ends the DMA transmission. The IDLE flag is not handled like by the HAL.
+ */
+void HAL_UART_IRQHandler(UART_HandleTypeDef* huart)
+{
+    if((huart->Instance->SR & USART_SR_TC) && (huart->Instance->CR1 & USART_CR1_TCIE))
+    {
+        huart->Instance->CR1 &= ~USART_CR1_TCIE;
+        huart->gState = HAL_UART_STATE_READY;
+        HAL_UART_TxCpltCallback(huart);
+    }
+}
+
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+    UNUSED(huart);
+}
+
+__weak void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef* huart)
+{
+    UNUSED(huart);
+}
+
+__weak void HAL_UART_RxCpltCallback(UART_HandleTypeDef* huart)
+{
+    UNUSED(huart);
+}
+
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+    UNUSED(huart);
+}
+
+/* Interrupt vector table (irq.h) --------------------------------------------*/
+
+void irq_init(void)
+{
+    memset(simData.nvic.vectors, 0, sizeof(simData.nvic.vectors));
+}
+
+void irq_setHandler(IRQn_Type irqn, irqHandler_t handler)
+{
+    simData.nvic.vectors[16 + irqn] = handler;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief Run the timers up to the given time and serve their interrupts
+ */
+static void sim_runUntil(uint64_t end)
+{
+    uint64_t next;
+    uint64_t n;
+
+    sim_syncOutputs();
+    sim_service();
+
+    for(;;)
+    {
+        next = sim_nextEvent();
+
+        if(next > end)
+        {
+            break;
+        }
+
+        if(next > simData.cycles)
+        {
+            simData.cycles = next;
+        }
+
+        /* Count the SysTick interrupts up to the last one at once if nothing
+         * else happens meanwhile, e.g. a long sim_advance() in idle
+         */
+        if(next == simData.sysTick.next && end - next >= SIM_TICK_CYCLES &&
+                !(simTim3.CR1 & TIM_CR1_CEN) && simData.tickHook == NULL &&
+                !simData.nvic.primask && !simData.nvic.active && !simData.nvic.pending &&
+                !simData.flash.busy && !simData.flash.erasing &&
+                !simData.uart.txNext && !simData.uart.rxNext && !simData.uart.idleEnd)
+        {
+            n = (end - next) / SIM_TICK_CYCLES;
+            simData.sysTick.tick += n;
+            simData.sysTick.next += n * SIM_TICK_CYCLES;
+            simData.cycles = next = simData.sysTick.next;
+        }
+
+        if(next == simData.sysTick.next)
+        {
+            simData.sysTick.next += SIM_TICK_CYCLES;
+
+            if(simData.nvic.pending & SIM_PENDING_SYSTICK)
+            {
+                simData.stats.lostTicks++;
+            }
+            simData.nvic.pending |= SIM_PENDING_SYSTICK;
+        }
+
+        if((simTim3.CR1 & TIM_CR1_CEN) && next == simData.tim3.nextUpdate)
+        {
+            /* Preload: the new auto reload value is active from now */
+            simData.tim3.shadowArr = simTim3.ARR;
+            simData.tim3.nextUpdate += (uint64_t)(simData.tim3.shadowArr + 1) * (simTim3.PSC + 1);
+            simTim3.SR |= TIM_SR_UIF;
+        }
+
+        if(simData.flash.erasing && next == simData.flash.eraseEnd)
+        {
+            sim_endErase();
+        }
+
+        if(next == simData.uart.txNext)
+        {
+            sim_uartTxEvent();
+        }
+
+        if(next == simData.uart.rxNext)
+        {
+            sim_uartRxEvent();
+        }
+
+        if(next == simData.uart.idleEnd)
+        {
+            simData.uart.idleEnd = 0;
+            simUsart1.SR |= USART_SR_IDLE;
+        }
+
+        sim_service();
+    }
+
+    if(end > simData.cycles)
+    {
+        simData.cycles = end;
+    }
+}
+
+/**
+ * @brief Serve the pending interrupts
+ *
+ * TIM3 has the highest priority and runs from RAM, so it is also served
+ * while the flash stalls the CPU. The interrupt of TIM3 is pending while its
+ * update flag and interrupt enable are set. The flash interrupt
+ * (IRQ_PRIO_FLASH) comes next, then the DMA reception, USART1 and the
+ * SysTick.
+ */
+static void sim_service(void)
+{
+    irqHandler_t handler;
+    uint8_t pending;
+
+    if(simData.nvic.primask || simData.nvic.active)
+    {
+        return;
+    }
+
+    simData.nvic.active = 1;
+
+    for(;;)
+    {
+        if((simTim3.SR & TIM_SR_UIF) && (simTim3.DIER & TIM_DIER_UIE) &&
+                (simData.nvic.enabled & ((uint64_t)1 << TIM3_IRQn)))
+        {
+            if((handler = simData.nvic.vectors[16 + TIM3_IRQn]) != NULL)
+            {
+                handler();
+            }else
+            {
+                HAL_TIM_IRQHandler(&htim3);
+            }
+
+            if(simTim3.SR & TIM_SR_UIF)
+            {
+                sim_fault("TIM3 interrupt does not clear the update flag\n");
+            }
+
+            simData.stats.tim3Events++;
+        }else if((simData.nvic.pending & SIM_PENDING_FLASH) && !simData.flash.busy &&
+                (simData.nvic.enabled & ((uint64_t)1 << FLASH_IRQn)))
+        {
+            simData.nvic.pending &= ~SIM_PENDING_FLASH;
+
+            /* Like HAL_FLASH_IRQHandler() at the end of the last page */
+            HAL_FLASH_EndOfOperationCallback(0xFFFFFFFF);
+        }else if(simData.uart.dmaRxPending && !simData.flash.busy &&
+                (simData.nvic.enabled & ((uint64_t)1 << DMA1_Channel5_IRQn)))
+        {
+            pending = simData.uart.dmaRxPending;
+            simData.uart.dmaRxPending = 0;
+
+            /* Like HAL_DMA_IRQHandler() of the reception */
+            if(pending & DMA_CCR_HTIE)
+            {
+                HAL_UART_RxHalfCpltCallback(&huart1);
+            }
+            if(pending & DMA_CCR_TCIE)
+            {
+                HAL_UART_RxCpltCallback(&huart1);
+            }
+        }else if(sim_uartIsPending() && !simData.flash.busy &&
+                (simData.nvic.enabled & ((uint64_t)1 << USART1_IRQn)))
+        {
+            if((handler = simData.nvic.vectors[16 + USART1_IRQn]) != NULL)
+            {
+                handler();
+            }else
+            {
+                HAL_UART_IRQHandler(&huart1);
+            }
+
+            if(sim_uartIsPending())
+            {
+                sim_fault("USART1 interrupt does not clear its flags\n");
+            }
+        }else if((simData.nvic.pending & SIM_PENDING_SYSTICK) && !simData.flash.busy)
+        {
+            simData.nvic.pending &= ~SIM_PENDING_SYSTICK;
+
+            HAL_IncTick();
+
+            if(simData.tickHook != NULL)
+            {
+                simData.tickHook();
+            }
+        }else
+        {
+            break;
+        }
+
+        sim_syncOutputs();
+    }
+
+    simData.nvic.active = 0;
+}
+
+/**
+ * @brief Pass the changes of the output data registers to the hooks
+ */
+static void sim_syncOutputs(void)
+{
+    uint32_t changed;
+    uint8_t port;
+    uint8_t i;
+
+    for(port = 0; port < SIM_GPIO_PORTS; port++)
+    {
+        if((changed = simGpio[port].ODR ^ simData.odr[port]) == 0)
+        {
+            continue;
+        }
+
+        simData.odr[port] = simGpio[port].ODR;
+
+        for(i = 0; i < SIM_MAX_OUTPUT_HOOKS && simData.outputHooks[i] != NULL; i++)
+        {
+            simData.outputHooks[i](&simGpio[port], changed);
+        }
+    }
+}
+
+/**
+ * @brief Stall the CPU by a flash operation
+ */
+static void sim_stall(uint64_t cycles)
+{
+    if(simData.nvic.active)
+    {
+        simData.cycles += cycles;
+        return;
+    }
+
+    simData.flash.busy = 1;
+    sim_runUntil(simData.cycles + cycles);
+    simData.flash.busy = 0;
+
+    sim_service();
+}
+
+/**
+ * @brief Returns the time of the next timer or flash event
+ */
+static uint64_t sim_nextEvent(void)
+{
+    uint64_t next = simData.sysTick.next;
+
+    if((simTim3.CR1 & TIM_CR1_CEN) && simData.tim3.nextUpdate < next)
+    {
+        next = simData.tim3.nextUpdate;
+    }
+
+    if(simData.flash.erasing && simData.flash.eraseEnd < next)
+    {
+        next = simData.flash.eraseEnd;
+    }
+
+    if(simData.uart.txNext && simData.uart.txNext < next)
+    {
+        next = simData.uart.txNext;
+    }
+
+    if(simData.uart.rxNext && simData.uart.rxNext < next)
+    {
+        next = simData.uart.rxNext;
+    }
+
+    if(simData.uart.idleEnd && simData.uart.idleEnd < next)
+    {
+        next = simData.uart.idleEnd;
+    }
+
+    return next;
+}
+
+/**
+ * @brief Finish the background erase and pend the flash interrupt
+ */
+static void sim_endErase(void)
+{
+    memset(&simFlash[sim_flashOffset(simData.flash.eraseAddress, FLASH_PAGE_SIZE)], 0xFF, FLASH_PAGE_SIZE);
+
+    simData.flash.erasing = 0;
+    simData.nvic.pending |= SIM_PENDING_FLASH;
+
+    simData.stats.flashErases++;
+    simData.stats.flashBgErases++;
+}
+
+/**
+ * @brief End of a character sent by the DMA
+ *
+ * Passes the byte to the hook and starts the next character. After the last
+ * one the DMA requests the transmission complete interrupt like
+ * UART_DMATransmitCplt() of the HAL.
+ */
+static void sim_uartTxEvent(void)
+{
+    uint8_t data = simData.uart.txData[simData.uart.txPos++];
+
+    simData.stats.uartTxBytes++;
+    hdma_usart1_tx.Instance->CNDTR--;
+
+    if(simData.uartHook != NULL)
+    {
+        simData.uartHook(data);
+    }
+
+    if(simData.uart.txPos < simData.uart.txLen)
+    {
+        simData.uart.txNext += simData.uart.charCycles;
+        return;
+    }
+
+    simData.uart.txData = NULL;
+    simData.uart.txNext = 0;
+    hdma_usart1_tx.Instance->CCR &= ~DMA_CCR_EN;
+    simUsart1.SR |= USART_SR_TC;
+    simUsart1.CR1 |= USART_CR1_TCIE;
+}
+
+/**
+ * @brief End of a received character
+ *
+ * The DMA writes the byte and raises the half transfer and transfer
+ * complete interrupts. The next queued byte follows back to back, otherwise
+ * the idle frame starts.
+ */
+static void sim_uartRxEvent(void)
+{
+    DMA_Channel_TypeDef* dma = hdma_usart1_rx.Instance;
+    uint8_t data = simData.uart.input[simData.uart.inputTail++ % SIM_UART_INPUT_SIZE];
+
+    if(huart1.RxState == HAL_UART_STATE_BUSY_RX && (dma->CCR & DMA_CCR_EN))
+    {
+        simData.uart.rxBuffer[simData.uart.rxSize - dma->CNDTR] = data;
+        simData.stats.uartRxBytes++;
+
+        if(--dma->CNDTR == simData.uart.rxSize / 2)
+        {
+            simData.uart.dmaRxPending |= dma->CCR & DMA_CCR_HTIE;
+        }else if(dma->CNDTR == 0)
+        {
+            simData.uart.dmaRxPending |= dma->CCR & DMA_CCR_TCIE;
+
+            if(dma->CCR & DMA_CIRCULAR)
+            {
+                dma->CNDTR = simData.uart.rxSize;
+            }else
+            {
+                dma->CCR &= ~DMA_CCR_EN;
+                huart1.RxState = HAL_UART_STATE_READY;
+            }
+        }
+    }else
+    {
+        simData.stats.uartRxLost++;
+    }
+
+    if(simData.uart.inputTail != simData.uart.inputHead)
+    {
+        simData.uart.rxNext += simData.uart.charCycles;
+    }else
+    {
+        simData.uart.rxNext = 0;
+        simData.uart.idleEnd = simData.cycles + simData.uart.charCycles;
+    }
+}
+
+/**
+ * @brief Check if the interrupt of USART1 is pending
+ */
+static uint8_t sim_uartIsPending(void)
+{
+    return ((simUsart1.SR & USART_SR_IDLE) && (simUsart1.CR1 & USART_CR1_IDLEIE)) ||
+            ((simUsart1.SR & USART_SR_TC) && (simUsart1.CR1 & USART_CR1_TCIE));
+}
+
+/**
+ * @brief Count a flash operation and cut the power before it if armed
+ */
+static void sim_checkPowerCut(void)
+{
+    if(simData.powerCut.hook == NULL)
+    {
+        return;
+    }
+
+    if(simData.powerCut.operations-- == 0)
+    {
+        simData.powerCut.hook();
+        sim_fault("power cut hook returned\n");
+    }
+}
+
+/**
+ * @brief Returns the offset of an address at the flash image
+ */
+static uint32_t sim_flashOffset(uint32_t address, uint32_t size)
+{
+    if(address < EEPROM_START_ADDRESS || address - EEPROM_START_ADDRESS + size > SIM_FLASH_SIZE)
+    {
+        sim_fault("flash access out of the EEPROM pages at 0x%08lX\n", (unsigned long)address);
+    }
+
+    return address - EEPROM_START_ADDRESS;
+}
+
+/**
+ * @brief Stop the simulation on an access which would fault on the target
+ */
+static void sim_fault(const char* fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "sim: fault at %.3f ms: ", (double)simData.cycles / SIM_TICK_CYCLES);
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    abort();
+}
@@ -0,0 +1,622 @@
+/**
+ * @file sweep.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Ride cycle benchmark over a grid of ramp parameters
+ *
+ * Every point of the grid (start period of the ramp, end period of the ramp,
+ * decrement of the period per step and ticks between the floors) powers the
+ * simulated elevator on at floor 0 with the floor ticks written into the
+ * flash, overrides the ramp set by app_init() and runs the given number of
+ * rides like elevator-sim. A point fails if a ride fails or a warning is
+ * logged. The points are split across worker processes (the simulation is a
+ * single instance per process), the results are ranked by rides per hour:
+ *
+ * - rides/h: rides per hour of virtual time from the press to the arrival
+ * - f2f ms: mean time from the start of the drive to the arrival
+ * - isr/ride: TIM3 events per ride
+ *
+ * A list is either "a,b,c" or a range "from:to:increment". The car has no
+ * torque model, the table ranks the timing only and the fastest ramps still
+ * have to be verified on the real ride.
+ *
+ * <code>
+ * elevator-sweep [-n rides] [-j jobs] [-o table.txt]
+ *                [-s start periods] [-e end periods] [-p period steps]
+ *                [-f floor ticks]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "sim.h"
+#include "car.h"
+#include "main.h"
+#include "app.h"
+#include "stepper.h"
+#include "eeprom.h"
+#include "config.h"
+#include "irq.h"
+
+/**
+ * Time of a short press of SW1 in ms
+ */
+#define SWEEP_PRESS_TIME            (100)
+
+/**
+ * Maximum time of a ride and of the drive to the idle position in ms
+ */
+#define SWEEP_TIMEOUT               (30 * 1000)
+
+/**
+ * Maximum deviation of the car from its floor (sixteenth steps)
+ */
+#define SWEEP_TOLERANCE             (8)
+
+/**
+ * Maximum number of values of a parameter
+ */
+#define SWEEP_VALUES_MAX            (64)
+
+/**
+ * Maximum number of worker processes
+ */
+#define SWEEP_JOBS_MAX              (256)
+
+/**
+ * Number of points printed if the table is written to a file
+ */
+#define SWEEP_TOP                   (10)
+
+/**
+ * Grid parameters
+ */
+enum {
+    SWEEP_START = 0,
+    SWEEP_END,
+    SWEEP_STEP,
+    SWEEP_TICKS,
+    SWEEP_PARAMS
+};
+
+/**
+ * Result of a point of the grid, a worker writes it as one block into the
+ * pipe
+ */
+typedef struct sweepResult_s {
+    uint16_t params[SWEEP_PARAMS];
+    uint32_t rides;
+    uint8_t failed;
+
+    /**
+     * Virtual cycles from the first press to the last arrival
+     */
+    uint64_t cycles;
+
+    /**
+     * Sum of the drive times in ms
+     */
+    uint64_t sumTime;
+    uint64_t tim3Events;
+} sweepResult_t;
+
+/**
+ * Sweep data struct type
+ */
+typedef struct sweepData_s {
+    struct {
+        uint16_t values[SWEEP_VALUES_MAX];
+        uint8_t count;
+    } params[SWEEP_PARAMS];
+
+    uint32_t rides;
+
+    /**
+     * Expected position of the floors of the current point
+     */
+    int32_t floors[3];
+
+    /**
+     * Configured blank flash, every point starts with a copy of it
+     */
+    uint8_t flash[SIM_FLASH_SIZE];
+} sweepData_t;
+
+/**
+ * Module data
+ */
+static sweepData_t sweepData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t sweep_parse(const char* arg, uint8_t param);
+static void sweep_point(uint32_t index, sweepResult_t* result);
+static uint8_t sweep_waitState(uint8_t idle, uint32_t timeout);
+static void sweep_press(uint32_t time);
+static uint8_t sweep_ride(sweepResult_t* result);
+static double sweep_ridesPerHour(const sweepResult_t* result);
+static int sweep_compare(const void* a, const void* b);
+static void sweep_print(FILE* file, const sweepResult_t* results, uint32_t count);
+
+int main(int argc, char** argv)
+{
+    static const char* const defaults[SWEEP_PARAMS] = {
+        "65535,60000,55000,50000",
+        "45000:25000:5000",
+        "5,10,20,50",
+        "3000"
+    };
+    struct timespec start, end;
+    sweepResult_t* results;
+    sweepResult_t result;
+    const char* out = NULL;
+    FILE* file;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t points = 1;
+    uint16_t minEnd = UINT16_MAX;
+    uint32_t count = 0;
+    uint32_t failed = 0;
+    uint64_t cycles = 0;
+    uint8_t param;
+    int fds[2];
+    pid_t pid;
+    int status;
+    int rc = 0;
+    long job;
+    uint32_t i;
+    int opt;
+
+    sweepData.rides = 20;
+
+    while((opt = getopt(argc, argv, "n:j:o:s:e:p:f:")) != -1)
+    {
+        param = SWEEP_PARAMS;
+
+        switch(opt)
+        {
+        case 'n':
+            sweepData.rides = strtoul(optarg, NULL, 0);
+            break;
+        case 'j':
+            jobs = strtol(optarg, NULL, 0);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 's':
+            param = SWEEP_START;
+            break;
+        case 'e':
+            param = SWEEP_END;
+            break;
+        case 'p':
+            param = SWEEP_STEP;
+            break;
+        case 'f':
+            param = SWEEP_TICKS;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n rides] [-j jobs] [-o table.txt] [-s start periods] "
+                    "[-e end periods] [-p period steps] [-f floor ticks]\n", argv[0]);
+            return 2;
+        }
+
+        if(param != SWEEP_PARAMS && !sweep_parse(optarg, param))
+        {
+            fprintf(stderr, "invalid list -%c %s\n", opt, optarg);
+            return 2;
+        }
+    }
+
+    for(param = 0; param < SWEEP_PARAMS; param++)
+    {
+        if(sweepData.params[param].count == 0)
+        {
+            sweep_parse(defaults[param], param);
+        }
+        points *= sweepData.params[param].count;
+    }
+
+    /* The ramp must not decrement the period below zero and the floor 0 must
+     * be above the bottom end stop
+     */
+    for(i = 0; i < sweepData.params[SWEEP_END].count; i++)
+    {
+        if(sweepData.params[SWEEP_END].values[i] < minEnd)
+        {
+            minEnd = sweepData.params[SWEEP_END].values[i];
+        }
+    }
+    for(i = 0; i < sweepData.params[SWEEP_STEP].count; i++)
+    {
+        if(sweepData.params[SWEEP_STEP].values[i] == 0 ||
+                sweepData.params[SWEEP_STEP].values[i] > minEnd)
+        {
+            fprintf(stderr, "period step %u out of range\n", sweepData.params[SWEEP_STEP].values[i]);
+            return 2;
+        }
+    }
+    for(i = 0; i < sweepData.params[SWEEP_TICKS].count; i++)
+    {
+        if(2 * sweepData.params[SWEEP_TICKS].values[i] > CAR_SWITCH_TOP - CAR_END_BOTTOM - 2 * SWEEP_TOLERANCE)
+        {
+            fprintf(stderr, "floor ticks %u out of range\n", sweepData.params[SWEEP_TICKS].values[i]);
+            return 2;
+        }
+    }
+
+    if(jobs < 1)
+    {
+        jobs = 1;
+    }
+    if(jobs > SWEEP_JOBS_MAX)
+    {
+        jobs = SWEEP_JOBS_MAX;
+    }
+    if(jobs > (long)points)
+    {
+        jobs = points;
+    }
+
+    results = malloc(points * sizeof(sweepResult_t));
+    if(results == NULL || pipe(fds) != 0)
+    {
+        perror("sweep");
+        return 2;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* Format the blank flash once, the workers inherit the copy */
+    sim_init();
+    sim_eraseFlash();
+    irq_init();
+    ee_init();
+    sim_saveFlash(sweepData.flash);
+
+    for(job = 0; job < jobs; job++)
+    {
+        pid = fork();
+        if(pid < 0)
+        {
+            perror("fork");
+            return 2;
+        }
+        if(pid == 0)
+        {
+            close(fds[0]);
+
+            for(i = job; i < points; i += jobs)
+            {
+                sweep_point(i, &result);
+
+                /* A write of at most PIPE_BUF bytes is not interleaved with
+                 * the writes of the other workers
+                 */
+                if(write(fds[1], &result, sizeof(result)) != sizeof(result))
+                {
+                    _exit(2);
+                }
+            }
+            _exit(0);
+        }
+    }
+
+    close(fds[1]);
+
+    while(count < points && read(fds[0], &results[count], sizeof(sweepResult_t)) == sizeof(sweepResult_t))
+    {
+        cycles += results[count].cycles;
+        failed += results[count].failed;
+        count++;
+    }
+    close(fds[0]);
+
+    while(wait(&status) > 0)
+    {
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            rc = 2;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if(count != points)
+    {
+        fprintf(stderr, "%lu of %lu points missing\n", (unsigned long)(points - count), (unsigned long)points);
+        return 2;
+    }
+
+    qsort(results, count, sizeof(sweepResult_t), sweep_compare);
+
+    if(out != NULL)
+    {
+        if((file = fopen(out, "w")) == NULL)
+        {
+            perror(out);
+            return 2;
+        }
+        sweep_print(file, results, count);
+        fclose(file);
+        sweep_print(stdout, results, count < SWEEP_TOP ? count : SWEEP_TOP);
+    }
+    else
+    {
+        sweep_print(stdout, results, count);
+    }
+
+    printf("points          %lu (failed %lu)\n", (unsigned long)count, (unsigned long)failed);
+    printf("rides           %lu per point\n", (unsigned long)sweepData.rides);
+    printf("jobs            %ld\n", jobs);
+    printf("virtual time s  %.3f\n", (double)cycles / SIM_CPU_CLOCK);
+    printf("host time s     %.3f\n", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    return rc;
+}
+
+/**
+ * @brief Parse a list of values of a parameter
+ *
+ * @param arg "a,b,c" or "from:to:increment", the range counts down if from
+ * is above to
+ * @param param Parameter
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t sweep_parse(const char* arg, uint8_t param)
+{
+    unsigned long from, to, inc;
+    unsigned long value;
+    uint8_t count = 0;
+    char* end;
+
+    if(sscanf(arg, "%lu:%lu:%lu", &from, &to, &inc) == 3)
+    {
+        if(inc == 0 || from > UINT16_MAX || to > UINT16_MAX)
+        {
+            return 0;
+        }
+
+        for(value = from; count < SWEEP_VALUES_MAX; )
+        {
+            sweepData.params[param].values[count++] = value;
+
+            if(from <= to ? to - value < inc : value - to < inc)
+            {
+                break;
+            }
+            value = from <= to ? value + inc : value - inc;
+        }
+    }
+    else
+    {
+        while(*arg != '\0' && count < SWEEP_VALUES_MAX)
+        {
+            value = strtoul(arg, &end, 0);
+            if(end == arg || value > UINT16_MAX || (*end != ',' && *end != '\0'))
+            {
+                return 0;
+            }
+            sweepData.params[param].values[count++] = value;
+            arg = *end == ',' ? end + 1 : end;
+        }
+    }
+
+    sweepData.params[param].count = count;
+
+    return count != 0;
+}
+
+/**
+ * @brief Run the rides of a point of the grid
+ *
+ * @param index Index of the point, the start period changes slowest
+ * @param result Result of the point
+ */
+static void sweep_point(uint32_t index, sweepResult_t* result)
+{
+    simStats_t simStats;
+    uint64_t cycles;
+    uint64_t events;
+    int8_t param;
+    uint32_t i;
+
+    memset(result, 0, sizeof(sweepResult_t));
+
+    for(param = SWEEP_PARAMS - 1; param >= 0; param--)
+    {
+        result->params[param] = sweepData.params[param].values[index % sweepData.params[param].count];
+        index /= sweepData.params[param].count;
+    }
+
+    sim_loadFlash(sweepData.flash);
+    sim_init();
+    irq_init();
+    ee_init();
+
+    ee_writeVariable(CFG_FLOOR_0_1_TICKS_VADDR, result->params[SWEEP_TICKS]);
+    ee_writeVariable(CFG_FLOOR_1_2_TICKS_VADDR, result->params[SWEEP_TICKS]);
+
+    /* Reset with the configured flash, the ramp of the point applies to the
+     * drive to the idle position already
+     */
+    sim_init();
+    car_init(CAR_FLOOR0);
+    sim_boot();
+
+    stp_setPeriodStartRamp(result->params[SWEEP_START]);
+    stp_setPeriodEndRamp(result->params[SWEEP_END]);
+    stp_setPeriodStep(result->params[SWEEP_STEP]);
+
+    if(!sweep_waitState(1, SWEEP_TIMEOUT))
+    {
+        result->failed = 1;
+        return;
+    }
+
+    sweepData.floors[APP_FLOOR_2] = car_getPosition();
+    sweepData.floors[APP_FLOOR_1] = sweepData.floors[APP_FLOOR_2] - result->params[SWEEP_TICKS];
+    sweepData.floors[APP_FLOOR_0] = sweepData.floors[APP_FLOOR_1] - result->params[SWEEP_TICKS];
+
+    sim_getStats(&simStats);
+    cycles = sim_getCycles();
+    events = simStats.tim3Events;
+
+    for(i = 0; i < sweepData.rides; i++)
+    {
+        if(!sweep_ride(result))
+        {
+            result->failed = 1;
+            break;
+        }
+    }
+
+    sim_getStats(&simStats);
+    result->cycles = sim_getCycles() - cycles;
+    result->tim3Events = simStats.tim3Events - events;
+    if(simStats.warnings)
+    {
+        result->failed = 1;
+    }
+}
+
+/**
+ * @brief Run the main loop until the application enters or leaves the idle
+ * state with a stopped motor
+ *
+ * @param idle 1 to wait for the idle state, 0 to wait for a drive
+ * @param timeout Timeout in ms
+ *
+ * @return 1 on success, 0 on timeout
+ */
+static uint8_t sweep_waitState(uint8_t idle, uint32_t timeout)
+{
+    uint32_t start = HAL_GetTick();
+    uint8_t state;
+
+    while(HAL_GetTick() - start < timeout)
+    {
+        sim_loop();
+
+        state = (app_getState() == APP_STATE_IDLE &&
+                (stp_getState() == STP_STATE_IDLE || stp_getState() == STP_STATE_ARRIVED));
+        if(state == idle)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Press and release SW1
+ *
+ * @param time Press time in ms
+ */
+static void sweep_press(uint32_t time)
+{
+    uint32_t start = HAL_GetTick();
+
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_RESET);
+    while(HAL_GetTick() - start < time)
+    {
+        sim_loop();
+    }
+    sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_SET);
+}
+
+/**
+ * @brief Ride to the next floor and check the position of the car
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t sweep_ride(sweepResult_t* result)
+{
+    uint32_t start;
+    int32_t deviation;
+
+    sweep_press(SWEEP_PRESS_TIME);
+
+    if(!sweep_waitState(0, SWEEP_TIMEOUT))
+    {
+        return 0;
+    }
+
+    start = HAL_GetTick();
+
+    if(!sweep_waitState(1, SWEEP_TIMEOUT))
+    {
+        return 0;
+    }
+
+    deviation = car_getPosition() - sweepData.floors[app_getFloor()];
+    if(deviation < -SWEEP_TOLERANCE || deviation > SWEEP_TOLERANCE)
+    {
+        return 0;
+    }
+
+    result->rides++;
+    result->sumTime += HAL_GetTick() - start;
+
+    return 1;
+}
+
+/**
+ * @brief Returns the rides per hour of virtual time of a point
+ */
+static double sweep_ridesPerHour(const sweepResult_t* result)
+{
+    return result->cycles ? result->rides * 3600.0 * SIM_CPU_CLOCK / result->cycles : 0.0;
+}
+
+/**
+ * @brief Order of the table, the failed points are ranked last
+ */
+static int sweep_compare(const void* a, const void* b)
+{
+    const sweepResult_t* x = a;
+    const sweepResult_t* y = b;
+    double rx = sweep_ridesPerHour(x);
+    double ry = sweep_ridesPerHour(y);
+
+    if(x->failed != y->failed)
+    {
+        return x->failed - y->failed;
+    }
+
+    return (rx < ry) - (rx > ry);
+}
+
+/**
+ * @brief Print the ranked table
+ */
+static void sweep_print(FILE* file, const sweepResult_t* results, uint32_t count)
+{
+    const sweepResult_t* r;
+    uint32_t i;
+
+    fprintf(file, "rank  start    end  step  ticks   rides/h    f2f ms  isr/ride  result\n");
+
+    for(i = 0; i < count; i++)
+    {
+        r = &results[i];
+        fprintf(file, "%4lu  %5u  %5u  %4u  %5u  %8.1f  %8.1f  %8.1f  %s\n",
+                (unsigned long)(i + 1),
+                r->params[SWEEP_START], r->params[SWEEP_END], r->params[SWEEP_STEP], r->params[SWEEP_TICKS],
+                sweep_ridesPerHour(r),
+                r->rides ? (double)r->sumTime / r->rides : 0.0,
+                r->rides ? (double)r->tim3Events / r->rides : 0.0,
+                r->failed ? "failed" : "ok");
+    }
+}
@@ -0,0 +1,545 @@
+/**
+ * @file torture.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Power loss torture test of the EEPROM emulation
+ *
+ * Runs random writes of single variables and of transactions on the
+ * simulated flash (see sim.h) and cuts the power at a random half word
+ * program or page erase, also during the recovery of ee_init() and during
+ * background erases. After every power cut the board is reset and ee_init()
+ * must recover the log. Every TORTURE_LEGACY_INTERVAL cycles the flash is
+ * replaced by a random page of the two page emulation of older firmware
+ * versions and the power is cut during its migration. The invariant checker
+ * compares every variable with a model of the stored values:
+ *
+ * - a write which returned HAL_OK is stored, a write which returned HAL_BUSY
+ *   left no trace,
+ * - the variables of the write interrupted by the power cut show either all
+ *   old or all new values,
+ * - the variables of a legacy page are kept,
+ * - no other variable changed and ee_init() and all writes succeed.
+ *
+ * The exit code is 1 at the first violation, the seed and the cycle
+ * reproduce it. The throughput of the host is printed at the end.
+ *
+ * <code>
+ * elevator-torture [-n cycles] [-s seed] [-v]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "sim.h"
+#include "irq.h"
+#include "eeprom.h"
+
+/**
+ * Maximum number of flash operations up to a power cut. A write programs two
+ * half words per record, so the power cuts spread over several pages.
+ */
+#define TORTURE_MAX_OPERATIONS      (1200)
+
+/**
+ * Cycles between two migrations of a legacy page and maximum number of flash
+ * operations up to the power cut of a migration
+ */
+#define TORTURE_LEGACY_INTERVAL     (16)
+#define TORTURE_LEGACY_OPERATIONS   (40)
+
+/**
+ * Maximum number of records of a legacy page
+ */
+#define TORTURE_LEGACY_RECORDS      ((FLASH_PAGE_SIZE - 4) / EE_RECORD_SIZE)
+
+/**
+ * Maximum number of variables of a transaction
+ */
+#define TORTURE_MAX_TXN             (4)
+
+/**
+ * Writes between two checks of all variables
+ */
+#define TORTURE_CHECK_INTERVAL      (64)
+
+/**
+ * Variables of the user (see config.c)
+ */
+extern uint16_t VirtAddVarTab[];
+
+/**
+ * Model of a stored variable
+ */
+typedef struct tortureVar_s {
+    uint16_t data;
+    uint8_t stored;
+} tortureVar_t;
+
+/**
+ * Torture data struct type
+ */
+typedef struct tortureData_s {
+    jmp_buf restart;
+    uint32_t cycle;
+
+    /**
+     * Values of the writes which returned HAL_OK
+     */
+    tortureVar_t vars[NumbOfVar];
+
+    /**
+     * Write in progress, resolved by the check after the next recovery
+     */
+    struct {
+        uint8_t index[TORTURE_MAX_TXN];
+        uint16_t data[TORTURE_MAX_TXN];
+        uint8_t count;
+    } pending;
+
+    /**
+     * Variables of the last write
+     */
+    uint8_t last[TORTURE_MAX_TXN];
+    uint8_t lastCount;
+
+    struct {
+        uint32_t cuts;
+        uint32_t recoveries;
+        uint32_t migrations;
+        uint32_t writes;
+        uint32_t transactions;
+        uint32_t busy;
+        uint32_t waits;
+        uint32_t checks;
+        uint32_t interrupted;   /* Writes interrupted by a power cut */
+        uint32_t applied;       /* Interrupted writes found complete after the recovery */
+        uint64_t programs;
+        uint32_t erases;
+        uint32_t bgErases;
+    } stats;
+} tortureData_t;
+
+/**
+ * Module data
+ */
+static tortureData_t tortureData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void torture_powerCut(void);
+static uint8_t torture_write(void);
+static void torture_wait(void);
+static uint8_t torture_check(uint8_t all);
+static uint8_t torture_checkVar(uint8_t index, uint8_t* state);
+static void torture_fail(const char* msg, uint8_t index);
+static void torture_addStats(void);
+static void torture_loadLegacy(void);
+
+int main(int argc, char** argv)
+{
+    struct timespec start, end;
+    uint32_t cycles = 10000;
+    uint32_t seed = 1;
+    uint32_t operations;
+    uint32_t ops;
+    double host;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:s:v")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            cycles = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n cycles] [-s seed] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    srand(seed);
+
+    /* Blank device */
+    sim_init();
+
+    for(tortureData.cycle = 0; tortureData.cycle < cycles; tortureData.cycle++)
+    {
+        torture_addStats();
+
+        operations = TORTURE_MAX_OPERATIONS;
+        if(tortureData.cycle % TORTURE_LEGACY_INTERVAL == 0)
+        {
+            torture_loadLegacy();
+            operations = TORTURE_LEGACY_OPERATIONS;
+        }
+
+        /* Power on after the power cut, the flash image is kept */
+        sim_init();
+        irq_init();
+
+        if(setjmp(tortureData.restart) != 0)
+        {
+            tortureData.stats.cuts++;
+            continue;
+        }
+
+        sim_setPowerCut(rand() % operations, torture_powerCut);
+
+        if(ee_init() != HAL_OK)
+        {
+            torture_fail("recovery failed", NumbOfVar);
+        }
+        if(!torture_check(1))
+        {
+            return 1;
+        }
+        tortureData.stats.recoveries++;
+
+        /* Runs up to the power cut. A read waits for the end of a background
+         * erase, the checks are skipped meanwhile to write during the erase.
+         */
+        for(ops = 0; ; ops++)
+        {
+            if(rand() % 8 == 0)
+            {
+                torture_wait();
+            }
+
+            if(!torture_write() ||
+                    (!ee_isBusy() && !torture_check(ops % TORTURE_CHECK_INTERVAL == 0)))
+            {
+                return 1;
+            }
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    torture_addStats();
+    host = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("cycles          %lu (power cuts %lu, recoveries %lu)\n", (unsigned long)cycles,
+            (unsigned long)tortureData.stats.cuts, (unsigned long)tortureData.stats.recoveries);
+    printf("legacy pages    %lu\n", (unsigned long)tortureData.stats.migrations);
+    printf("writes          %lu (transactions %lu, busy %lu)\n", (unsigned long)tortureData.stats.writes,
+            (unsigned long)tortureData.stats.transactions, (unsigned long)tortureData.stats.busy);
+    printf("interrupted     %lu (applied %lu, discarded %lu)\n", (unsigned long)tortureData.stats.interrupted,
+            (unsigned long)tortureData.stats.applied,
+            (unsigned long)(tortureData.stats.interrupted - tortureData.stats.applied));
+    printf("checks          %lu\n", (unsigned long)tortureData.stats.checks);
+    printf("flash           %llu programs, %lu erases (background %lu)\n",
+            (unsigned long long)tortureData.stats.programs, (unsigned long)tortureData.stats.erases,
+            (unsigned long)tortureData.stats.bgErases);
+    printf("host time s     %.3f (%.0f cycles/s, %.0f writes/s)\n", host,
+            host > 0 ? cycles / host : 0.0, host > 0 ? tortureData.stats.writes / host : 0.0);
+
+    return 0;
+}
+
+/**
+ * @brief Power cut hook of the simulation: restart the current cycle
+ */
+static void torture_powerCut(void)
+{
+    longjmp(tortureData.restart, 1);
+}
+
+/**
+ * @brief Write random values to one variable or to a transaction of
+ * variables and update the model
+ *
+ * @return 1 on success, 0 on a violation
+ */
+static uint8_t torture_write(void)
+{
+    eeVar_t vars[TORTURE_MAX_TXN];
+    uint8_t count = 1;
+    uint16_t status;
+    uint8_t index;
+    uint8_t i, j;
+
+    if(rand() % 4 == 0)
+    {
+        count = 2 + rand() % (TORTURE_MAX_TXN - 1);
+    }
+
+    /* Distinct variables */
+    for(i = 0; i < count; i++)
+    {
+        do
+        {
+            index = rand() % NumbOfVar;
+            for(j = 0; j < i && tortureData.pending.index[j] != index; j++)
+            {
+            }
+        }while(j < i);
+
+        tortureData.pending.index[i] = index;
+        tortureData.pending.data[i] = (uint16_t)rand();
+        vars[i].virtAddress = VirtAddVarTab[index];
+        vars[i].data = tortureData.pending.data[i];
+    }
+    tortureData.pending.count = count;
+
+    if(count == 1 && (rand() & 1))
+    {
+        status = ee_writeVariable(vars[0].virtAddress, vars[0].data);
+    }else
+    {
+        status = ee_writeVariables(vars, count);
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        tortureData.last[i] = tortureData.pending.index[i];
+    }
+    tortureData.lastCount = count;
+    tortureData.pending.count = 0;
+
+    if(status == HAL_BUSY)
+    {
+        tortureData.stats.busy++;
+        return 1;
+    }
+
+    if(status != HAL_OK)
+    {
+        torture_fail("write failed", tortureData.last[0]);
+        return 0;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        tortureData.vars[tortureData.pending.index[i]].data = tortureData.pending.data[i];
+        tortureData.vars[tortureData.pending.index[i]].stored = 1;
+    }
+
+    tortureData.stats.writes += count;
+    tortureData.stats.transactions += (count > 1);
+
+    return 1;
+}
+
+/**
+ * @brief Wait for the end of a background erase like the main loop
+ */
+static void torture_wait(void)
+{
+    while(ee_isBusy())
+    {
+        sim_advance(SIM_TICK_CYCLES);
+        ee_handler();
+    }
+
+    tortureData.stats.waits++;
+}
+
+/**
+ * @brief Compare the variables with the model
+ *
+ * The values of an interrupted write are taken into the model if the check
+ * passes.
+ *
+ * @param all 1 to check all variables, 0 the last written variables only
+ *
+ * @return 1 on success, 0 on a violation
+ */
+static uint8_t torture_check(uint8_t all)
+{
+    /* 0 unknown, 1 old values, 2 new values of the interrupted write */
+    uint8_t state = 0;
+    uint8_t index;
+    uint8_t i;
+
+    tortureData.stats.checks++;
+
+    if(all)
+    {
+        for(index = 0; index < NumbOfVar; index++)
+        {
+            if(!torture_checkVar(index, &state))
+            {
+                return 0;
+            }
+        }
+    }else
+    {
+        for(i = 0; i < tortureData.lastCount; i++)
+        {
+            if(!torture_checkVar(tortureData.last[i], &state))
+            {
+                return 0;
+            }
+        }
+    }
+
+    if(all && tortureData.pending.count)
+    {
+        tortureData.stats.interrupted++;
+    }
+
+    if(state == 2)
+    {
+        tortureData.stats.applied++;
+        for(i = 0; i < tortureData.pending.count; i++)
+        {
+            tortureData.vars[tortureData.pending.index[i]].data = tortureData.pending.data[i];
+            tortureData.vars[tortureData.pending.index[i]].stored = 1;
+        }
+    }
+    tortureData.pending.count = 0;
+
+    return 1;
+}
+
+/**
+ * @brief Compare a variable with the model
+ *
+ * @param index Index of the variable
+ * @param state State of the interrupted write found so far, see
+ * torture_check()
+ *
+ * @return 1 on success, 0 on a violation
+ */
+static uint8_t torture_checkVar(uint8_t index, uint8_t* state)
+{
+    const tortureVar_t* var = &tortureData.vars[index];
+    uint16_t data = 0;
+    uint16_t status;
+    uint8_t isOld, isNew = 0;
+    uint8_t pending = 0;
+    uint8_t i;
+
+    status = ee_readVariable(VirtAddVarTab[index], &data);
+    if(status != 0 && status != 1)
+    {
+        torture_fail("read failed", index);
+        return 0;
+    }
+
+    isOld = var->stored ? (status == 0 && data == var->data) : (status == 1);
+
+    for(i = 0; i < tortureData.pending.count; i++)
+    {
+        if(tortureData.pending.index[i] == index)
+        {
+            isNew = (status == 0 && data == tortureData.pending.data[i]);
+            pending = 1;
+            break;
+        }
+    }
+
+    if(!isOld && !isNew)
+    {
+        torture_fail("unexpected value", index);
+        return 0;
+    }
+
+    /* All variables of the interrupted write must agree */
+    if(pending && isOld != isNew)
+    {
+        if(*state == 0)
+        {
+            *state = isNew ? 2 : 1;
+        }else if(*state != (isNew ? 2 : 1))
+        {
+            torture_fail("write partially applied", index);
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Report a violation and exit
+ *
+ * @param index Index of the variable, NumbOfVar if no variable is concerned
+ */
+static void torture_fail(const char* msg, uint8_t index)
+{
+    fprintf(stderr, "cycle %lu: %s", (unsigned long)tortureData.cycle, msg);
+    if(index < NumbOfVar)
+    {
+        fprintf(stderr, ", variable 0x%04X", VirtAddVarTab[index]);
+    }
+    fprintf(stderr, "\n");
+
+    exit(1);
+}
+
+/**
+ * @brief Add the flash statistics of the simulation before its reset
+ */
+static void torture_addStats(void)
+{
+    simStats_t simStats;
+
+    sim_getStats(&simStats);
+
+    tortureData.stats.programs += simStats.flashPrograms;
+    tortureData.stats.erases += simStats.flashErases;
+    tortureData.stats.bgErases += simStats.flashBgErases;
+}
+
+/**
+ * @brief Replace the flash by a legacy page with random records
+ *
+ * The page is page 0 or 1 of the two page emulation, the model takes the
+ * last record of every variable.
+ */
+static void torture_loadLegacy(void)
+{
+    uint8_t image[SIM_FLASH_SIZE];
+    uint8_t* page;
+    uint16_t records;
+    uint16_t data;
+    uint16_t i;
+    uint8_t index;
+
+    memset(image, 0xFF, sizeof(image));
+    memset(tortureData.vars, 0, sizeof(tortureData.vars));
+    tortureData.pending.count = 0;
+    tortureData.lastCount = 0;
+
+    page = &image[(rand() % 2) * FLASH_PAGE_SIZE];
+
+    /* VALID_PAGE, the legacy header has 4 bytes */
+    page[0] = page[1] = 0x00;
+
+    records = 1 + rand() % TORTURE_LEGACY_RECORDS;
+    for(i = 0; i < records; i++)
+    {
+        index = rand() % NumbOfVar;
+        data = (uint16_t)rand();
+
+        page[4 + i * EE_RECORD_SIZE] = data & 0xFF;
+        page[5 + i * EE_RECORD_SIZE] = data >> 8;
+        page[6 + i * EE_RECORD_SIZE] = VirtAddVarTab[index] & 0xFF;
+        page[7 + i * EE_RECORD_SIZE] = VirtAddVarTab[index] >> 8;
+
+        tortureData.vars[index].data = data;
+        tortureData.vars[index].stored = 1;
+    }
+
+    sim_loadFlash(image);
+
+    tortureData.stats.migrations++;
+}
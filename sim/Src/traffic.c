@@ -0,0 +1,1035 @@
+/**
+ * @file traffic.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Passenger traffic of a park day in the host simulation
+ *
+ * The passengers arrive at every floor as a Poisson process with a piecewise
+ * constant rate per hour (the profile) and ride to one of the other floors
+ * with equal probability. The operator of the simulated elevator (powered on
+ * at floor 0 with the default configuration) works like at the real ride:
+ *
+ * - at the arrival of the car the riders of the floor leave it and the
+ *   waiting passengers board up to the capacity, the door time and the
+ *   boarding time of every passenger pass
+ * - passengers which arrive at the standing car board at once
+ * - as long as riders are in the car or passengers wait at any floor, SW1 is
+ *   pressed for a short press and the button handler and the application
+ *   drive the car to its next floor (2 -> 1 -> 0 -> 1 -> 2 ...)
+ *
+ * The day starts at the first line of the profile and the arrivals end at
+ * its last line (closing time), the car serves the remaining passengers
+ * afterwards. A profile file has one line "HH:MM rate0 rate1 rate2" per
+ * segment with the passengers per hour at floor 0, 1 and 2, '#' starts a
+ * comment. -r scales all rates.
+ *
+ * While the car stands the application only runs the button handler, the
+ * virtual time passes up to the next arrival or the end of the door time at
+ * once (see traffic_skip()), so a park day takes well below a second.
+ *
+ * The results are written as JSON: the wait time from the arrival to the
+ * boarding and the ride time from the boarding to the leaving (p50 / p95 /
+ * p99), the number of waiting passengers weighted by time and the
+ * passengers served per hour. The exit code is 1 if a drive fails, a
+ * warning is logged or not all passengers are served. -m writes the metrics
+ * of the application at the end of the day like the dump of the firmware
+ * (see mtr.h).
+ *
+ * <code>
+ * elevator-traffic [-s seed] [-r scale] [-p profile] [-c capacity]
+ *                  [-b boarding ms] [-d door ms] [-o result.json]
+ *                  [-m metrics.txt] [-v]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+
+#include "sim.h"
+#include "car.h"
+#include "main.h"
+#include "app.h"
+#include "btn.h"
+#include "stepper.h"
+#include "tim.h"
+#include "eeprom.h"
+#include "mtr.h"
+
+/**
+ * Time of a short press of SW1 in ms
+ */
+#define TRAFFIC_PRESS_TIME          (100)
+
+/**
+ * Maximum time from the release of SW1 to the start of the drive and of
+ * the drive itself in ms
+ */
+#define TRAFFIC_TIMEOUT             (30 * 1000)
+
+/**
+ * Maximum time to serve the passengers after the closing time in ms
+ */
+#define TRAFFIC_DRAIN_MAX           (2 * 60 * 60 * 1000)
+
+/**
+ * Time after which the standing car with released SW1 is quiet in ms (see
+ * traffic_skip())
+ */
+#define TRAFFIC_QUIET_TIME          (100)
+
+/**
+ * Maximum number of segments of a profile
+ */
+#define TRAFFIC_SEGMENTS_MAX        (96)
+
+/**
+ * Maximum capacity of the car
+ */
+#define TRAFFIC_CAPACITY_MAX        (64)
+
+/**
+ * Queue lengths above are counted as this one
+ */
+#define TRAFFIC_QUEUE_MAX           (4095)
+
+#define TRAFFIC_FLOORS              (3)
+#define TRAFFIC_HOUR                (60 * 60 * 1000)
+
+/**
+ * Operator states
+ */
+typedef enum {
+    TRAFFIC_OP_WAIT = 0,    /* Car stands, nobody to serve */
+    TRAFFIC_OP_DWELL,       /* Door time and boarding */
+    TRAFFIC_OP_PRESS,       /* SW1 pressed */
+    TRAFFIC_OP_START,       /* SW1 released, drive not started yet */
+    TRAFFIC_OP_DRIVE,       /* Car drives */
+} trafficOp_t;
+
+/**
+ * Passenger, the times are in ms since midnight
+ */
+typedef struct trafficPassenger_s {
+    uint32_t arrival;
+    uint32_t board;
+    uint8_t dest;
+} trafficPassenger_t;
+
+/**
+ * Segment of the profile
+ */
+typedef struct trafficSegment_s {
+    uint32_t start;
+    double rates[TRAFFIC_FLOORS];
+} trafficSegment_t;
+
+/**
+ * Traffic data struct type
+ */
+typedef struct trafficData_s {
+    struct {
+        trafficSegment_t segments[TRAFFIC_SEGMENTS_MAX];
+        uint8_t count;
+    } profile;
+
+    struct {
+        uint8_t capacity;
+        uint32_t board;
+        uint32_t door;
+    } cfg;
+
+    /**
+     * Passengers of the day per floor in the order of their arrival. The
+     * passengers up to arrived are at the floor or gone, the ones up to
+     * boarded are in the car or gone.
+     */
+    struct {
+        trafficPassenger_t* passengers;
+        uint32_t count;
+        uint32_t arrived;
+        uint32_t boarded;
+    } floors[TRAFFIC_FLOORS];
+
+    /**
+     * Riders in the car (floor and index of the passenger)
+     */
+    struct {
+        uint8_t floor;
+        uint32_t index;
+    } riders[TRAFFIC_CAPACITY_MAX];
+    uint8_t riderCount;
+
+    /**
+     * Next arrival of all floors, UINT32_MAX if none
+     */
+    struct {
+        uint32_t time;
+        uint8_t floor;
+    } next;
+
+    struct {
+        trafficOp_t op;
+        uint8_t floor;
+        uint32_t until;
+        uint32_t driveStart;
+    } op;
+
+    /**
+     * Time of the opening in ms since midnight and the tick at it
+     */
+    uint32_t open;
+    uint32_t tick0;
+
+    /**
+     * Quiet standing car and the last read of an input pin (ticks)
+     */
+    uint8_t quiet;
+    uint32_t quietSince;
+    uint32_t lastRead;
+
+    /**
+     * Tick at which the write-behind cache got dirty
+     */
+    uint8_t dirty;
+    uint32_t dirtySince;
+
+    struct {
+        uint32_t* wait;
+        uint32_t* ride;
+        uint32_t served;
+        uint32_t drives;
+        uint64_t driveTime;
+        uint32_t waiting;
+        uint32_t maxWaiting;
+        uint32_t lastChange;
+        uint64_t queue[TRAFFIC_QUEUE_MAX + 1];
+        uint32_t perHour[24];
+        uint8_t failed;
+    } stats;
+} trafficData_t;
+
+/**
+ * Module data
+ */
+static trafficData_t trafficData;
+
+/**
+ * Profile of a park day from 09:00 to 19:00, most passengers enter at
+ * floor 0
+ */
+static const trafficSegment_t trafficDefaultProfile[] = {
+    { 9 * TRAFFIC_HOUR,     { 40.0,  10.0,  10.0 } },
+    { 10 * TRAFFIC_HOUR,    { 80.0,  20.0,  20.0 } },
+    { 11 * TRAFFIC_HOUR,    { 110.0, 35.0,  35.0 } },
+    { 12 * TRAFFIC_HOUR,    { 120.0, 50.0,  50.0 } },
+    { 13 * TRAFFIC_HOUR,    { 100.0, 50.0,  50.0 } },
+    { 14 * TRAFFIC_HOUR,    { 130.0, 55.0,  55.0 } },
+    { 15 * TRAFFIC_HOUR,    { 140.0, 60.0,  60.0 } },
+    { 16 * TRAFFIC_HOUR,    { 110.0, 55.0,  55.0 } },
+    { 17 * TRAFFIC_HOUR,    { 70.0,  45.0,  45.0 } },
+    { 18 * TRAFFIC_HOUR,    { 30.0,  40.0,  40.0 } },
+    { 19 * TRAFFIC_HOUR,    { 0.0,   0.0,   0.0 } },
+};
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint8_t traffic_loadProfile(const char* path);
+static uint8_t traffic_generate(double scale);
+static uint32_t traffic_now(void);
+static uint8_t traffic_isStanding(void);
+static void traffic_queue(uint32_t time, int8_t change);
+static void traffic_nextArrival(void);
+static void traffic_arrive(uint32_t now);
+static void traffic_board(uint32_t now);
+static void traffic_leave(uint32_t now);
+static void traffic_operate(uint32_t now);
+static uint8_t traffic_done(uint32_t now);
+static void traffic_read(void);
+static void traffic_skip(void);
+static int traffic_compare(const void* a, const void* b);
+static uint32_t traffic_percentile(const uint32_t* values, uint32_t count, uint8_t p);
+static uint32_t traffic_queuePercentile(uint64_t total, uint8_t p);
+static void traffic_writeTimes(FILE* file, const char* name, uint32_t* values, uint32_t count);
+static void traffic_write(FILE* file, double scale, uint32_t seed, double host);
+static uint8_t traffic_writeMetrics(const char* path);
+
+int main(int argc, char** argv)
+{
+    struct timespec start, end;
+    const char* profile = NULL;
+    const char* out = NULL;
+    const char* metrics = NULL;
+    FILE* file;
+    simStats_t simStats;
+    double scale = 1.0;
+    uint32_t seed = 1;
+    uint32_t now;
+    uint32_t tick;
+    int opt;
+
+    trafficData.cfg.capacity = 8;
+    trafficData.cfg.board = 1500;
+    trafficData.cfg.door = 4000;
+
+    while((opt = getopt(argc, argv, "s:r:p:c:b:d:o:m:v")) != -1)
+    {
+        switch(opt)
+        {
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            scale = strtod(optarg, NULL);
+            break;
+        case 'p':
+            profile = optarg;
+            break;
+        case 'c':
+            trafficData.cfg.capacity = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            trafficData.cfg.board = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            trafficData.cfg.door = strtoul(optarg, NULL, 0);
+            break;
+        case 'o':
+            out = optarg;
+            break;
+        case 'm':
+            metrics = optarg;
+            break;
+        case 'v':
+            sim_setVerbose(1);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s seed] [-r scale] [-p profile] [-c capacity] "
+                    "[-b boarding ms] [-d door ms] [-o result.json] [-m metrics.txt] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if(trafficData.cfg.capacity == 0 || trafficData.cfg.capacity > TRAFFIC_CAPACITY_MAX || scale < 0)
+    {
+        fprintf(stderr, "invalid capacity or scale\n");
+        return 2;
+    }
+
+    if(profile != NULL)
+    {
+        if(!traffic_loadProfile(profile))
+        {
+            return 2;
+        }
+    }
+    else
+    {
+        memcpy(trafficData.profile.segments, trafficDefaultProfile, sizeof(trafficDefaultProfile));
+        trafficData.profile.count = sizeof(trafficDefaultProfile) / sizeof(trafficSegment_t);
+    }
+
+    srand48(seed);
+    if(!traffic_generate(scale))
+    {
+        perror("traffic");
+        return 2;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    /* The first power on writes the default configuration into the blank
+     * flash, the day starts at a configured board like in the field
+     */
+    sim_init();
+    sim_boot();
+
+    sim_init();
+    car_init(CAR_FLOOR0);
+    sim_setReadHook(traffic_read);
+    sim_boot();
+
+    /* The elevator is switched on before the opening */
+    for(tick = HAL_GetTick(); !traffic_isStanding() || app_getState() != APP_STATE_IDLE; )
+    {
+        if(HAL_GetTick() - tick >= TRAFFIC_TIMEOUT)
+        {
+            fprintf(stderr, "idle position not arrived\n");
+            return 1;
+        }
+        sim_loop();
+    }
+
+    trafficData.open = trafficData.profile.segments[0].start;
+    trafficData.tick0 = HAL_GetTick();
+    trafficData.op.op = TRAFFIC_OP_WAIT;
+    trafficData.op.floor = app_getFloor();
+    trafficData.stats.lastChange = trafficData.open;
+    traffic_nextArrival();
+
+    for(;;)
+    {
+        now = traffic_now();
+
+        traffic_arrive(now);
+        traffic_operate(now);
+
+        if(trafficData.stats.failed || traffic_done(now))
+        {
+            break;
+        }
+
+        tick = HAL_GetTick();
+        sim_loop();
+
+        /* The flush of the write-behind cache is due EE_CACHE_FLUSH_DELAY_MS
+         * after the write which made it dirty
+         */
+        if(!trafficData.dirty && ee_getDirtyCount() != 0)
+        {
+            trafficData.dirtySince = tick;
+        }
+        trafficData.dirty = ee_getDirtyCount() != 0;
+
+        traffic_skip();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    sim_getStats(&simStats);
+    if(simStats.warnings)
+    {
+        trafficData.stats.failed = 1;
+    }
+
+    if(out != NULL)
+    {
+        if((file = fopen(out, "w")) == NULL)
+        {
+            perror(out);
+            return 2;
+        }
+    }
+    else
+    {
+        file = stdout;
+    }
+
+    traffic_write(file, scale, seed,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    if(file != stdout)
+    {
+        fclose(file);
+    }
+
+    if(metrics != NULL && !traffic_writeMetrics(metrics))
+    {
+        return 2;
+    }
+
+    return trafficData.stats.failed ? 1 : 0;
+}
+
+/**
+ * @brief Write the metrics of the application as text
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t traffic_writeMetrics(const char* path)
+{
+    mtrCursor_t cursor;
+    char line[MTR_LINE_SIZE];
+    uint8_t len;
+    FILE* file;
+
+    if((file = fopen(path, "w")) == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    mtr_formatStart(&cursor);
+    while((len = mtr_formatLine(&cursor, line)) != 0)
+    {
+        fwrite(line, 1, len, file);
+    }
+
+    fclose(file);
+
+    return 1;
+}
+
+/**
+ * @brief Load a profile file
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t traffic_loadProfile(const char* path)
+{
+    trafficSegment_t* segment;
+    unsigned int hours, minutes;
+    char line[256];
+    char* comment;
+    uint32_t number = 0;
+    FILE* file;
+    int n;
+
+    if((file = fopen(path, "r")) == NULL)
+    {
+        perror(path);
+        return 0;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        number++;
+
+        if((comment = strchr(line, '#')) != NULL)
+        {
+            *comment = '\0';
+        }
+        if(strspn(line, " \t\r\n") == strlen(line))
+        {
+            continue;
+        }
+
+        if(trafficData.profile.count == TRAFFIC_SEGMENTS_MAX)
+        {
+            fprintf(stderr, "%s:%lu: too many segments\n", path, (unsigned long)number);
+            fclose(file);
+            return 0;
+        }
+
+        segment = &trafficData.profile.segments[trafficData.profile.count];
+        n = sscanf(line, "%u:%u %lf %lf %lf", &hours, &minutes,
+                &segment->rates[0], &segment->rates[1], &segment->rates[2]);
+        segment->start = (hours * 60 + minutes) * 60 * 1000;
+
+        if(n != 5 || hours > 24 || minutes > 59 ||
+                segment->rates[0] < 0 || segment->rates[1] < 0 || segment->rates[2] < 0 ||
+                (trafficData.profile.count && segment->start <= segment[-1].start))
+        {
+            fprintf(stderr, "%s:%lu: invalid segment\n", path, (unsigned long)number);
+            fclose(file);
+            return 0;
+        }
+
+        trafficData.profile.count++;
+    }
+
+    fclose(file);
+
+    if(trafficData.profile.count < 2)
+    {
+        fprintf(stderr, "%s: the profile needs the opening and the closing time\n", path);
+        return 0;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Generate the arrivals of the day
+ *
+ * The time to the next arrival is exponentially distributed with the rate of
+ * the segment. At the end of the segment the process continues with the
+ * rate of the next segment, which is exact for a Poisson process.
+ *
+ * @return 1 on success otherwise 0
+ */
+static uint8_t traffic_generate(double scale)
+{
+    const trafficSegment_t* segments = trafficData.profile.segments;
+    trafficPassenger_t* passenger;
+    uint32_t size;
+    uint8_t floor;
+    uint8_t i;
+    double rate;
+    double time;
+    double total = 0;
+
+    for(floor = 0; floor < TRAFFIC_FLOORS; floor++)
+    {
+        size = 64;
+        trafficData.floors[floor].passengers = malloc(size * sizeof(trafficPassenger_t));
+        if(trafficData.floors[floor].passengers == NULL)
+        {
+            return 0;
+        }
+
+        time = segments[0].start;
+        for(i = 0; i + 1 < trafficData.profile.count; )
+        {
+            rate = segments[i].rates[floor] * scale / TRAFFIC_HOUR;
+            if(rate > 0)
+            {
+                time += -log(1.0 - drand48()) / rate;
+            }
+            if(rate <= 0 || time >= segments[i + 1].start)
+            {
+                time = segments[++i].start;
+                continue;
+            }
+
+            if(trafficData.floors[floor].count == size)
+            {
+                size *= 2;
+                passenger = realloc(trafficData.floors[floor].passengers, size * sizeof(trafficPassenger_t));
+                if(passenger == NULL)
+                {
+                    return 0;
+                }
+                trafficData.floors[floor].passengers = passenger;
+            }
+
+            passenger = &trafficData.floors[floor].passengers[trafficData.floors[floor].count++];
+            passenger->arrival = (uint32_t)time;
+            passenger->dest = (floor + 1 + (drand48() < 0.5)) % TRAFFIC_FLOORS;
+        }
+
+        total += trafficData.floors[floor].count;
+    }
+
+    trafficData.stats.wait = malloc((total + 1) * sizeof(uint32_t));
+    trafficData.stats.ride = malloc((total + 1) * sizeof(uint32_t));
+
+    return trafficData.stats.wait != NULL && trafficData.stats.ride != NULL;
+}
+
+/**
+ * @brief Returns the time of the day in ms since midnight
+ */
+static uint32_t traffic_now(void)
+{
+    return trafficData.open + (HAL_GetTick() - trafficData.tick0);
+}
+
+/**
+ * @brief Returns 1 if the car stands at a floor
+ */
+static uint8_t traffic_isStanding(void)
+{
+    return app_getState() == APP_STATE_IDLE &&
+            (stp_getState() == STP_STATE_IDLE || stp_getState() == STP_STATE_ARRIVED);
+}
+
+/**
+ * @brief Count the time of the current queue length and change it
+ */
+static void traffic_queue(uint32_t time, int8_t change)
+{
+    uint32_t waiting = trafficData.stats.waiting;
+
+    trafficData.stats.queue[waiting < TRAFFIC_QUEUE_MAX ? waiting : TRAFFIC_QUEUE_MAX] +=
+            time - trafficData.stats.lastChange;
+    trafficData.stats.lastChange = time;
+
+    trafficData.stats.waiting += change;
+    if(trafficData.stats.waiting > trafficData.stats.maxWaiting)
+    {
+        trafficData.stats.maxWaiting = trafficData.stats.waiting;
+    }
+}
+
+/**
+ * @brief Find the next arrival of all floors
+ */
+static void traffic_nextArrival(void)
+{
+    uint8_t floor;
+
+    trafficData.next.time = UINT32_MAX;
+
+    for(floor = 0; floor < TRAFFIC_FLOORS; floor++)
+    {
+        if(trafficData.floors[floor].arrived < trafficData.floors[floor].count &&
+                trafficData.floors[floor].passengers[trafficData.floors[floor].arrived].arrival < trafficData.next.time)
+        {
+            trafficData.next.time = trafficData.floors[floor].passengers[trafficData.floors[floor].arrived].arrival;
+            trafficData.next.floor = floor;
+        }
+    }
+}
+
+/**
+ * @brief Take the passengers up to the current time to their floors in the
+ * order of their arrival
+ */
+static void traffic_arrive(uint32_t now)
+{
+    while(trafficData.next.time <= now)
+    {
+        trafficData.floors[trafficData.next.floor].arrived++;
+        traffic_queue(trafficData.next.time, 1);
+        traffic_nextArrival();
+    }
+
+    /* The passengers at the standing car board at once */
+    if(trafficData.op.op == TRAFFIC_OP_WAIT || trafficData.op.op == TRAFFIC_OP_DWELL)
+    {
+        traffic_board(now);
+    }
+}
+
+/**
+ * @brief Board the waiting passengers at the floor of the car up to its
+ * capacity, every passenger extends the dwell by the boarding time
+ */
+static void traffic_board(uint32_t now)
+{
+    uint8_t floor = trafficData.op.floor;
+    trafficPassenger_t* passenger;
+
+    while(trafficData.floors[floor].boarded < trafficData.floors[floor].arrived &&
+            trafficData.riderCount < trafficData.cfg.capacity)
+    {
+        if(trafficData.op.op != TRAFFIC_OP_DWELL)
+        {
+            trafficData.op.op = TRAFFIC_OP_DWELL;
+            trafficData.op.until = now + trafficData.cfg.door;
+        }
+
+        passenger = &trafficData.floors[floor].passengers[trafficData.floors[floor].boarded];
+        passenger->board = now;
+
+        trafficData.riders[trafficData.riderCount].floor = floor;
+        trafficData.riders[trafficData.riderCount].index = trafficData.floors[floor].boarded;
+        trafficData.riderCount++;
+        trafficData.floors[floor].boarded++;
+
+        traffic_queue(now, -1);
+
+        trafficData.op.until += trafficData.cfg.board;
+    }
+}
+
+/**
+ * @brief The riders of the floor of the car leave it
+ */
+static void traffic_leave(uint32_t now)
+{
+    trafficPassenger_t* passenger;
+    uint8_t i = 0;
+
+    while(i < trafficData.riderCount)
+    {
+        passenger = &trafficData.floors[trafficData.riders[i].floor].passengers[trafficData.riders[i].index];
+        if(passenger->dest != trafficData.op.floor)
+        {
+            i++;
+            continue;
+        }
+
+        if(trafficData.op.op != TRAFFIC_OP_DWELL)
+        {
+            trafficData.op.op = TRAFFIC_OP_DWELL;
+            trafficData.op.until = now + trafficData.cfg.door;
+        }
+
+        trafficData.stats.wait[trafficData.stats.served] = passenger->board - passenger->arrival;
+        trafficData.stats.ride[trafficData.stats.served] = now - passenger->board;
+        trafficData.stats.served++;
+        trafficData.stats.perHour[(now / TRAFFIC_HOUR) % 24]++;
+
+        trafficData.riders[i] = trafficData.riders[--trafficData.riderCount];
+    }
+}
+
+/**
+ * @brief Operate the elevator
+ */
+static void traffic_operate(uint32_t now)
+{
+    switch(trafficData.op.op)
+    {
+    case TRAFFIC_OP_DWELL:
+        if((int32_t)(now - trafficData.op.until) < 0)
+        {
+            break;
+        }
+        trafficData.op.op = TRAFFIC_OP_WAIT;
+        /* no break */
+
+    case TRAFFIC_OP_WAIT:
+        if(trafficData.riderCount != 0 || trafficData.stats.waiting != 0)
+        {
+            sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_RESET);
+            trafficData.op.op = TRAFFIC_OP_PRESS;
+            trafficData.op.until = now + TRAFFIC_PRESS_TIME;
+        }
+        break;
+
+    case TRAFFIC_OP_PRESS:
+        if((int32_t)(now - trafficData.op.until) >= 0)
+        {
+            sim_setInput(SW1_IN_GPIO_Port, SW1_IN_Pin, GPIO_PIN_SET);
+            trafficData.op.op = TRAFFIC_OP_START;
+        }
+        break;
+
+    case TRAFFIC_OP_START:
+        if(!traffic_isStanding())
+        {
+            trafficData.op.op = TRAFFIC_OP_DRIVE;
+            trafficData.op.driveStart = now;
+            trafficData.stats.drives++;
+        }else if(now - trafficData.op.until >= TRAFFIC_TIMEOUT)
+        {
+            fprintf(stderr, "%lu ms: no drive started\n", (unsigned long)now);
+            trafficData.stats.failed = 1;
+        }
+        break;
+
+    case TRAFFIC_OP_DRIVE:
+        if(traffic_isStanding())
+        {
+            trafficData.stats.driveTime += now - trafficData.op.driveStart;
+            trafficData.op.op = TRAFFIC_OP_WAIT;
+            trafficData.op.floor = app_getFloor();
+
+            traffic_leave(now);
+            traffic_board(now);
+        }else if(now - trafficData.op.driveStart >= TRAFFIC_TIMEOUT)
+        {
+            fprintf(stderr, "%lu ms: floor not arrived\n", (unsigned long)now);
+            trafficData.stats.failed = 1;
+        }
+        break;
+    }
+}
+
+/**
+ * @brief Returns 1 if the day is over
+ */
+static uint8_t traffic_done(uint32_t now)
+{
+    uint32_t close = trafficData.profile.segments[trafficData.profile.count - 1].start;
+
+    if(now >= close + TRAFFIC_DRAIN_MAX)
+    {
+        fprintf(stderr, "%lu passengers not served\n",
+                (unsigned long)(trafficData.stats.waiting + trafficData.riderCount));
+        trafficData.stats.failed = 1;
+        return 1;
+    }
+
+    return now >= close && trafficData.op.op == TRAFFIC_OP_WAIT && trafficData.next.time == UINT32_MAX &&
+            trafficData.riderCount == 0 && trafficData.stats.waiting == 0;
+}
+
+/**
+ * @brief Remember the last read of an input pin (read hook)
+ */
+static void traffic_read(void)
+{
+    trafficData.lastRead = HAL_GetTick();
+}
+
+/**
+ * @brief Skip the main loops of the standing car
+ *
+ * The idle application with a stopped motor and idle flash only runs the
+ * button handler every APP_BUTTON_TRIGGER_INTERVAL. Once SW1 is released
+ * for TRAFFIC_QUIET_TIME without a pending press, the handler reads the same
+ * level without an effect. The virtual time passes up to the last run of
+ * the button handler before the next arrival, the end of the dwell or the
+ * flush of the write-behind cache, so the day continues like without the
+ * skip.
+ */
+static void traffic_skip(void)
+{
+    uint32_t tick = HAL_GetTick();
+    uint32_t next;
+    uint32_t target;
+
+    if((trafficData.op.op != TRAFFIC_OP_WAIT && trafficData.op.op != TRAFFIC_OP_DWELL) ||
+            !traffic_isStanding() || (htim3.Instance->CR1 & TIM_CR1_CEN) ||
+            ee_isBusy() || btn_isPressed() != BTN_OK)
+    {
+        trafficData.quiet = 0;
+        return;
+    }
+
+    if(!trafficData.quiet)
+    {
+        trafficData.quiet = 1;
+        trafficData.quietSince = tick;
+        return;
+    }
+
+    /* The last read must be one of the button handler */
+    if(tick - trafficData.quietSince < TRAFFIC_QUIET_TIME || trafficData.lastRead <= trafficData.quietSince)
+    {
+        return;
+    }
+
+    next = trafficData.next.time;
+    if(trafficData.op.op == TRAFFIC_OP_DWELL && trafficData.op.until < next)
+    {
+        next = trafficData.op.until;
+    }
+    if(next == UINT32_MAX)
+    {
+        return;
+    }
+
+    /* Stop one tick before the event at a run of the handler */
+    target = trafficData.tick0 + (next - trafficData.open) - 1;
+    if(trafficData.dirty && (int32_t)(trafficData.dirtySince + EE_CACHE_FLUSH_DELAY_MS - 1 - target) < 0)
+    {
+        target = trafficData.dirtySince + EE_CACHE_FLUSH_DELAY_MS - 1;
+    }
+    target -= (target - trafficData.lastRead) % APP_BUTTON_TRIGGER_INTERVAL;
+
+    if((int32_t)(target - tick) > 0)
+    {
+        sim_advance((uint64_t)(target - tick) * SIM_TICK_CYCLES);
+    }
+}
+
+/**
+ * @brief Order of the times
+ */
+static int traffic_compare(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Returns the percentile of the sorted values (nearest rank)
+ */
+static uint32_t traffic_percentile(const uint32_t* values, uint32_t count, uint8_t p)
+{
+    uint32_t rank;
+
+    if(count == 0)
+    {
+        return 0;
+    }
+
+    rank = (uint32_t)ceil(p / 100.0 * count);
+
+    return values[rank ? rank - 1 : 0];
+}
+
+/**
+ * @brief Returns the percentile of the queue length weighted by time
+ *
+ * @param total Sum of the times of all queue lengths
+ */
+static uint32_t traffic_queuePercentile(uint64_t total, uint8_t p)
+{
+    uint64_t sum = 0;
+    uint32_t i;
+
+    for(i = 0; i < TRAFFIC_QUEUE_MAX; i++)
+    {
+        sum += trafficData.stats.queue[i];
+        if(sum * 100 >= total * p)
+        {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/**
+ * @brief Write the distribution of the times in s as a JSON object
+ */
+static void traffic_writeTimes(FILE* file, const char* name, uint32_t* values, uint32_t count)
+{
+    uint64_t sum = 0;
+    uint32_t i;
+
+    qsort(values, count, sizeof(uint32_t), traffic_compare);
+
+    for(i = 0; i < count; i++)
+    {
+        sum += values[i];
+    }
+
+    fprintf(file, "  \"%s\": { \"mean\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n",
+            name, count ? sum / 1000.0 / count : 0.0,
+            traffic_percentile(values, count, 50) / 1000.0,
+            traffic_percentile(values, count, 95) / 1000.0,
+            traffic_percentile(values, count, 99) / 1000.0,
+            count ? values[count - 1] / 1000.0 : 0.0);
+}
+
+/**
+ * @brief Write the results as JSON
+ */
+static void traffic_write(FILE* file, double scale, uint32_t seed, double host)
+{
+    const trafficSegment_t* segments = trafficData.profile.segments;
+    uint32_t close = segments[trafficData.profile.count - 1].start;
+    uint32_t now = traffic_now();
+    uint64_t total = 0;
+    uint64_t weighted = 0;
+    uint32_t arrived = 0;
+    uint32_t i;
+    uint8_t first = 1;
+
+    for(i = 0; i < TRAFFIC_FLOORS; i++)
+    {
+        arrived += trafficData.floors[i].arrived;
+    }
+    for(i = 0; i <= TRAFFIC_QUEUE_MAX; i++)
+    {
+        total += trafficData.stats.queue[i];
+        weighted += (uint64_t)i * trafficData.stats.queue[i];
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"config\": { \"seed\": %lu, \"scale\": %g, \"capacity\": %u, \"boarding_ms\": %lu, "
+            "\"door_ms\": %lu, \"open\": \"%02lu:%02lu\", \"close\": \"%02lu:%02lu\" },\n",
+            (unsigned long)seed, scale, trafficData.cfg.capacity,
+            (unsigned long)trafficData.cfg.board, (unsigned long)trafficData.cfg.door,
+            (unsigned long)(segments[0].start / TRAFFIC_HOUR), (unsigned long)(segments[0].start / 60000 % 60),
+            (unsigned long)(close / TRAFFIC_HOUR), (unsigned long)(close / 60000 % 60));
+    fprintf(file, "  \"passengers\": { \"arrived\": %lu, \"served\": %lu, \"unserved\": %lu },\n",
+            (unsigned long)arrived, (unsigned long)trafficData.stats.served,
+            (unsigned long)(arrived - trafficData.stats.served));
+    traffic_writeTimes(file, "wait_s", trafficData.stats.wait, trafficData.stats.served);
+    traffic_writeTimes(file, "ride_s", trafficData.stats.ride, trafficData.stats.served);
+    fprintf(file, "  \"queue\": { \"mean\": %.3f, \"p50\": %lu, \"p95\": %lu, \"p99\": %lu, \"max\": %lu },\n",
+            total ? (double)weighted / total : 0.0,
+            (unsigned long)traffic_queuePercentile(total, 50),
+            (unsigned long)traffic_queuePercentile(total, 95),
+            (unsigned long)traffic_queuePercentile(total, 99),
+            (unsigned long)trafficData.stats.maxWaiting);
+    fprintf(file, "  \"car\": { \"drives\": %lu, \"drive_s\": %.3f, \"utilization\": %.4f },\n",
+            (unsigned long)trafficData.stats.drives, trafficData.stats.driveTime / 1000.0,
+            now > trafficData.open ? (double)trafficData.stats.driveTime / (now - trafficData.open) : 0.0);
+
+    fprintf(file, "  \"served_per_hour\": {");
+    for(i = 0; i < 24; i++)
+    {
+        if(trafficData.stats.perHour[i])
+        {
+            fprintf(file, "%s \"%02lu:00\": %lu", first ? "" : ",", (unsigned long)i,
+                    (unsigned long)trafficData.stats.perHour[i]);
+            first = 0;
+        }
+    }
+    fprintf(file, " },\n");
+
+    fprintf(file, "  \"end\": \"%02lu:%02lu:%02lu\",\n", (unsigned long)(now / TRAFFIC_HOUR),
+            (unsigned long)(now / 60000 % 60), (unsigned long)(now / 1000 % 60));
+    fprintf(file, "  \"virtual_s\": %.3f,\n", (double)sim_getCycles() / SIM_CPU_CLOCK);
+    fprintf(file, "  \"host_s\": %.3f,\n", host);
+    fprintf(file, "  \"ok\": %s\n", trafficData.stats.failed ? "false" : "true");
+    fprintf(file, "}\n");
+}
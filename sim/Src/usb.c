@@ -0,0 +1,307 @@
+/**
+ * @file usb.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief USB host and bulk endpoint model implementation
+ */
+#include <string.h>
+
+#include "usb.h"
+#include "usb_device.h"
+#include "usbd_cdc_if.h"
+
+/**
+ * USB data struct type
+ */
+typedef struct usbData_s {
+    USBD_CDC_HandleTypeDef cdc;
+
+    /**
+     * Packets queued by the host, free running indices
+     */
+    struct {
+        struct {
+            uint8_t data[CDC_DATA_FS_MAX_PACKET_SIZE];
+            uint8_t len;
+        } packets[USB_OUT_PACKETS];
+        uint16_t head;
+        uint16_t tail;
+
+        /**
+         * The receive buffer is armed by the device
+         */
+        uint8_t armed;
+    } out;
+
+    /**
+     * Bytes of the running IN transfer which are sent
+     */
+    uint32_t inSent;
+
+    usbInHook_t inHook;
+
+    usbStats_t stats;
+} usbData_t;
+
+/**
+ * Module data
+ */
+static usbData_t usbData;
+
+/**
+ * USB device core handle (see usb_device.h)
+ */
+USBD_HandleTypeDef hUsbDeviceFS;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void usb_frameIn(void);
+static void usb_frameOut(void);
+
+/**
+ * @brief Reset the model, the device is not connected
+ */
+void usb_init(void)
+{
+    memset(&usbData, 0, sizeof(usbData));
+    memset(&hUsbDeviceFS, 0, sizeof(hUsbDeviceFS));
+
+    hUsbDeviceFS.dev_state = USBD_STATE_DEFAULT;
+}
+
+/**
+ * @brief Configure the device like the host does after the enumeration
+ *
+ * Initializes the interface (CDC_Init_FS()) and arms the OUT endpoint like
+ * the CDC class does.
+ */
+void usb_connect(void)
+{
+    usbData.cdc.TxState = 0;
+    usbData.cdc.RxState = 0;
+    usbData.inSent = 0;
+
+    hUsbDeviceFS.pClassData = &usbData.cdc;
+    hUsbDeviceFS.pUserData = &USBD_Interface_fops_FS;
+    hUsbDeviceFS.dev_state = USBD_STATE_CONFIGURED;
+
+    USBD_Interface_fops_FS.Init();
+    usbData.out.armed = 1;
+}
+
+/**
+ * @brief Disconnect the device, the queued packets of the host stay
+ */
+void usb_disconnect(void)
+{
+    if(hUsbDeviceFS.pClassData == NULL)
+    {
+        return;
+    }
+
+    USBD_Interface_fops_FS.DeInit();
+
+    hUsbDeviceFS.dev_state = USBD_STATE_DEFAULT;
+    hUsbDeviceFS.pClassData = NULL;
+    usbData.out.armed = 0;
+}
+
+/**
+ * @brief Serve the bulk endpoints for one frame
+ *
+ * Run this function from the SysTick hook.
+ */
+void usb_frame(void)
+{
+    if(hUsbDeviceFS.dev_state != USBD_STATE_CONFIGURED)
+    {
+        return;
+    }
+
+    usb_frameIn();
+    usb_frameOut();
+}
+
+/**
+ * @brief Queue a transfer of the host at the OUT endpoint
+ *
+ * The data is queued completely or not at all.
+ *
+ * @param data Data
+ * @param len Number of bytes
+ *
+ * @return Number of queued bytes (len or 0)
+ */
+uint16_t usb_hostWrite(const uint8_t* data, uint16_t len)
+{
+    uint16_t packets = len / CDC_DATA_FS_MAX_PACKET_SIZE + 1;
+    uint16_t pos = 0;
+    uint8_t chunk;
+
+    if(len == 0 || packets > USB_OUT_PACKETS - (uint16_t)(usbData.out.head - usbData.out.tail))
+    {
+        return 0;
+    }
+
+    /* A transfer of a multiple of the packet size ends with a zero length packet */
+    while(packets--)
+    {
+        chunk = (len - pos > CDC_DATA_FS_MAX_PACKET_SIZE) ? CDC_DATA_FS_MAX_PACKET_SIZE : len - pos;
+
+        memcpy(usbData.out.packets[usbData.out.head % USB_OUT_PACKETS].data, &data[pos], chunk);
+        usbData.out.packets[usbData.out.head % USB_OUT_PACKETS].len = chunk;
+        usbData.out.head++;
+        pos += chunk;
+    }
+
+    return len;
+}
+
+/**
+ * @brief Returns the number of packets queued by the host
+ */
+uint16_t usb_getOutPending(void)
+{
+    return usbData.out.head - usbData.out.tail;
+}
+
+/**
+ * @brief Set the receiver of the IN packets
+ *
+ * @param hook Receiver or NULL
+ */
+void usb_setInHook(usbInHook_t hook)
+{
+    usbData.inHook = hook;
+}
+
+/**
+ * @brief Copy the statistics of the USB model
+ *
+ * @param stats Destination of the statistics
+ */
+void usb_getStats(usbStats_t* stats)
+{
+    *stats = usbData.stats;
+}
+
+uint8_t USBD_CDC_SetTxBuffer(USBD_HandleTypeDef* pdev, uint8_t* pbuff, uint16_t length)
+{
+    usbData.cdc.TxBuffer = pbuff;
+    usbData.cdc.TxLength = length;
+
+    return USBD_OK;
+}
+
+uint8_t USBD_CDC_SetRxBuffer(USBD_HandleTypeDef* pdev, uint8_t* pbuff)
+{
+    usbData.cdc.RxBuffer = pbuff;
+
+    return USBD_OK;
+}
+
+uint8_t USBD_CDC_ReceivePacket(USBD_HandleTypeDef* pdev)
+{
+    if(pdev->pClassData == NULL)
+    {
+        return USBD_FAIL;
+    }
+
+    if(usbData.out.armed)
+    {
+        usbData.stats.errors++;
+    }
+    usbData.out.armed = 1;
+
+    return USBD_OK;
+}
+
+uint8_t USBD_CDC_TransmitPacket(USBD_HandleTypeDef* pdev)
+{
+    if(pdev->pClassData == NULL)
+    {
+        return USBD_FAIL;
+    }
+
+    if(usbData.cdc.TxState != 0)
+    {
+        usbData.stats.errors++;
+        return USBD_BUSY;
+    }
+
+    usbData.cdc.TxState = 1;
+    usbData.inSent = 0;
+    usbData.stats.inTransfers++;
+
+    return USBD_OK;
+}
+
+/**
+ * @brief Send the packets of the running IN transfers
+ *
+ * The transfer complete callback may start the next transfer in the same
+ * frame.
+ */
+static void usb_frameIn(void)
+{
+    uint32_t len;
+    uint16_t n;
+
+    for(n = 0; n < USB_FRAME_PACKETS && usbData.cdc.TxState != 0; n++)
+    {
+        len = usbData.cdc.TxLength - usbData.inSent;
+        if(len > CDC_DATA_FS_MAX_PACKET_SIZE)
+        {
+            len = CDC_DATA_FS_MAX_PACKET_SIZE;
+        }
+
+        if(usbData.inHook != NULL)
+        {
+            usbData.inHook(&usbData.cdc.TxBuffer[usbData.inSent], len);
+        }
+        usbData.inSent += len;
+        usbData.stats.inPackets++;
+        if(len == 0)
+        {
+            usbData.stats.inZlps++;
+        }
+
+        if(usbData.inSent >= usbData.cdc.TxLength)
+        {
+            usbData.cdc.TxState = 0;
+            USBD_Interface_fops_FS.TransmitCplt(usbData.cdc.TxBuffer, &usbData.cdc.TxLength,
+                    CDC_IN_EP & 0x7F);
+        }
+    }
+}
+
+/**
+ * @brief Receive the queued packets of the host into the armed buffer
+ */
+static void usb_frameOut(void)
+{
+    uint16_t n;
+
+    for(n = 0; n < USB_FRAME_PACKETS && usbData.out.tail != usbData.out.head; n++)
+    {
+        if(!usbData.out.armed)
+        {
+            usbData.stats.outNaks++;
+            break;
+        }
+
+        usbData.cdc.RxLength = usbData.out.packets[usbData.out.tail % USB_OUT_PACKETS].len;
+        memcpy(usbData.cdc.RxBuffer, usbData.out.packets[usbData.out.tail % USB_OUT_PACKETS].data,
+                usbData.cdc.RxLength);
+        usbData.out.tail++;
+        usbData.out.armed = 0;
+        usbData.stats.outPackets++;
+
+        USBD_Interface_fops_FS.Receive(usbData.cdc.RxBuffer, &usbData.cdc.RxLength);
+    }
+}
@@ -0,0 +1,246 @@
+/**
+ * @file vcd.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Value change dump of the pins of the host simulation implementation
+ */
+#include <stdio.h>
+
+#include "vcd.h"
+#include "sim.h"
+#include "main.h"
+
+/**
+ * Maximum length of a line of the dump (time or change)
+ */
+#define VCD_LINE_SIZE               (32)
+
+/**
+ * Signal of the dump
+ */
+typedef struct vcdSignal_s {
+    const char* name;
+    GPIO_TypeDef* port;
+    uint16_t pin;
+    uint8_t output;
+} vcdSignal_t;
+
+/**
+ * Dumped pins, the identifier of a signal is '!' + index
+ */
+static const vcdSignal_t vcdSignals[] = {
+    { "MTR_STEP",       MTR_STEP_GPIO_Port,     MTR_STEP_Pin,       1 },
+    { "MTR_DIR",        MTR_DIR_GPIO_Port,      MTR_DIR_Pin,        1 },
+    { "MTR_nENABLE",    MTR_nENABLE_GPIO_Port,  MTR_nENABLE_Pin,    1 },
+    { "MTR_nSLEEP",     MTR_nSLEEP_GPIO_Port,   MTR_nSLEEP_Pin,     1 },
+    { "MTR_nRESET",     MTR_nRESET_GPIO_Port,   MTR_nRESET_Pin,     1 },
+    { "MTR_MS1",        MTR_MS1_GPIO_Port,      MTR_MS1_Pin,        1 },
+    { "MTR_MS2",        MTR_MS2_GPIO_Port,      MTR_MS2_Pin,        1 },
+    { "MTR_MS3",        MTR_MS3_GPIO_Port,      MTR_MS3_Pin,        1 },
+    { "SW1_IN",         SW1_IN_GPIO_Port,       SW1_IN_Pin,         0 },
+    { "SW2_IN",         SW2_IN_GPIO_Port,       SW2_IN_Pin,         0 },
+    { "LD1_OUT",        LD1_OUT_GPIO_Port,      LD1_OUT_Pin,        1 },
+};
+
+#define VCD_SIGNAL_COUNT            (sizeof(vcdSignals) / sizeof(vcdSignals[0]))
+
+/**
+ * VCD data struct type
+ */
+typedef struct vcdData_s {
+    FILE* file;
+
+    /**
+     * Time of the last change in ns
+     */
+    uint64_t time;
+
+    uint64_t changes;
+
+    uint32_t length;
+    char buffer[VCD_BUFFER_SIZE];
+} vcdData_t;
+
+/**
+ * Module data
+ */
+static vcdData_t vcdData;
+
+/* Forward declarations ------------------------------------------------------*/
+
+static void vcd_output(GPIO_TypeDef* port, uint16_t changed);
+static void vcd_input(GPIO_TypeDef* port, uint16_t changed);
+static void vcd_change(GPIO_TypeDef* port, uint16_t changed, uint8_t output);
+static void vcd_flush(void);
+static uint64_t vcd_time(void);
+
+/**
+ * @brief Create the dump and start to record the pins
+ *
+ * The header and the current levels are written at once.
+ *
+ * @warning Run sim_init() before you run this function.
+ *
+ * @param path File of the dump
+ *
+ * @return 1 on success otherwise 0
+ */
+uint8_t vcd_open(const char* path)
+{
+    uint32_t level;
+    uint8_t i;
+
+    vcd_close();
+
+    if((vcdData.file = fopen(path, "w")) == NULL)
+    {
+        return 0;
+    }
+
+    vcdData.time = vcd_time();
+    vcdData.changes = 0;
+    vcdData.length = 0;
+
+    fprintf(vcdData.file, "$version elevator-sim $end\n");
+    fprintf(vcdData.file, "$timescale 1 ns $end\n");
+    fprintf(vcdData.file, "$scope module elevator $end\n");
+    for(i = 0; i < VCD_SIGNAL_COUNT; i++)
+    {
+        fprintf(vcdData.file, "$var wire 1 %c %s $end\n", '!' + i, vcdSignals[i].name);
+    }
+    fprintf(vcdData.file, "$upscope $end\n");
+    fprintf(vcdData.file, "$enddefinitions $end\n");
+
+    fprintf(vcdData.file, "#%llu\n$dumpvars\n", (unsigned long long)vcdData.time);
+    for(i = 0; i < VCD_SIGNAL_COUNT; i++)
+    {
+        level = vcdSignals[i].output ? vcdSignals[i].port->ODR : vcdSignals[i].port->IDR;
+        fprintf(vcdData.file, "%c%c\n", (level & vcdSignals[i].pin) ? '1' : '0', '!' + i);
+    }
+    fprintf(vcdData.file, "$end\n");
+
+    sim_addOutputHook(vcd_output);
+    sim_addInputHook(vcd_input);
+
+    return 1;
+}
+
+/**
+ * @brief Write the buffered changes and close the dump
+ *
+ * The hooks stay registered until the next sim_init() but record nothing.
+ */
+void vcd_close(void)
+{
+    if(vcdData.file == NULL)
+    {
+        return;
+    }
+
+    vcd_flush();
+    fclose(vcdData.file);
+    vcdData.file = NULL;
+}
+
+/**
+ * @brief Returns the number of recorded changes since vcd_open()
+ */
+uint64_t vcd_getChanges(void)
+{
+    return vcdData.changes;
+}
+
+/* Private functions ---------------------------------------------------------*/
+
+static void vcd_output(GPIO_TypeDef* port, uint16_t changed)
+{
+    vcd_change(port, changed, 1);
+}
+
+static void vcd_input(GPIO_TypeDef* port, uint16_t changed)
+{
+    vcd_change(port, changed, 0);
+}
+
+/**
+ * @brief Append the changed signals of a port to the buffer
+ */
+static void vcd_change(GPIO_TypeDef* port, uint16_t changed, uint8_t output)
+{
+    char digits[20];
+    uint32_t level;
+    uint64_t time;
+    uint8_t n;
+    uint8_t i;
+
+    if(vcdData.file == NULL)
+    {
+        return;
+    }
+
+    level = output ? port->ODR : port->IDR;
+
+    for(i = 0; i < VCD_SIGNAL_COUNT; i++)
+    {
+        if(vcdSignals[i].port != port || vcdSignals[i].output != output || !(changed & vcdSignals[i].pin))
+        {
+            continue;
+        }
+
+        if(vcdData.length > VCD_BUFFER_SIZE - 2 * VCD_LINE_SIZE)
+        {
+            vcd_flush();
+        }
+
+        /* Formatted by hand, this runs for every step pulse */
+        if((time = vcd_time()) != vcdData.time)
+        {
+            vcdData.time = time;
+
+            n = 0;
+            do
+            {
+                digits[n++] = '0' + time % 10;
+                time /= 10;
+            }while(time);
+
+            vcdData.buffer[vcdData.length++] = '#';
+            while(n)
+            {
+                vcdData.buffer[vcdData.length++] = digits[--n];
+            }
+            vcdData.buffer[vcdData.length++] = '\n';
+        }
+
+        vcdData.buffer[vcdData.length++] = (level & vcdSignals[i].pin) ? '1' : '0';
+        vcdData.buffer[vcdData.length++] = '!' + i;
+        vcdData.buffer[vcdData.length++] = '\n';
+
+        vcdData.changes++;
+    }
+}
+
+/**
+ * @brief Write the buffer to the file
+ */
+static void vcd_flush(void)
+{
+    fwrite(vcdData.buffer, 1, vcdData.length, vcdData.file);
+    vcdData.length = 0;
+}
+
+/**
+ * @brief Returns the virtual time in ns
+ */
+static uint64_t vcd_time(void)
+{
+    uint64_t cycles = sim_getCycles();
+
+    return cycles / SIM_CPU_CLOCK * 1000000000ULL +
+            cycles % SIM_CPU_CLOCK * 1000000000ULL / SIM_CPU_CLOCK;
+}
@@ -0,0 +1,186 @@
+/**
+ * @file wear.c
+ * @author fl0mll
+ * @date 2026/10/19
+ *
+ * This document contains proprietary information belonging to mllapps.com
+ * Passing on and copying of this document, use and communication of its
+ * contents is not permitted without prior written authorization.
+ *
+ * @brief Wear report of the EEPROM emulation
+ *
+ * Runs a synthetic update workload on the simulated flash (see sim.h) and
+ * reports the write amplification and the erase counts of the pages:
+ *
+ * - 90 % updates of the trip count,
+ * - 5 % updates of both floor positions in one transaction,
+ * - 5 % updates of one of the other variables.
+ *
+ * The write amplification is the number of programmed flash bytes per byte
+ * of the records written by the user, i.e. the overhead of the page headers,
+ * the transaction markers, the erase counters and the live records copied by
+ * the garbage collection. The endurance is the number of variable writes
+ * until the most erased page reaches WEAR_ENDURANCE erase cycles at this
+ * rate. The exit code is 1 if a write fails or the erase counters of the
+ * pages differ by more than one.
+ *
+ * <code>
+ * elevator-wear [-n updates] [-s seed]
+ * </code>
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "irq.h"
+#include "eeprom.h"
+#include "config.h"
+
+/**
+ * Guaranteed erase cycles of a flash page (STM32F103 datasheet)
+ */
+#define WEAR_ENDURANCE              (10000)
+
+/**
+ * Variables of the user (see config.c)
+ */
+extern uint16_t VirtAddVarTab[];
+
+/* Forward declarations ------------------------------------------------------*/
+
+static uint16_t wear_update(void);
+
+int main(int argc, char** argv)
+{
+    eeStats_t stats;
+    uint32_t updates = 100000;
+    uint32_t seed = 1;
+    uint32_t busy = 0;
+    uint16_t erases[EE_PAGE_COUNT];
+    uint16_t minErases = UINT16_MAX;
+    uint16_t maxErases = 0;
+    uint16_t status;
+    uint16_t page;
+    double amplification;
+    uint32_t i;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch(opt)
+        {
+        case 'n':
+            updates = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            seed = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n updates] [-s seed]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    srand(seed);
+
+    /* Blank device */
+    sim_init();
+    irq_init();
+    ee_init();
+
+    for(i = 0; i < updates; i++)
+    {
+        /* The main loop completes the background erase */
+        while((status = wear_update()) == HAL_BUSY)
+        {
+            busy++;
+            sim_advance(SIM_TICK_CYCLES);
+            ee_handler();
+        }
+
+        if(status != HAL_OK)
+        {
+            fprintf(stderr, "update %lu: write failed (%u)\n", (unsigned long)i, status);
+            return 1;
+        }
+    }
+
+    while(ee_isBusy())
+    {
+        sim_advance(SIM_TICK_CYCLES);
+        ee_handler();
+    }
+
+    ee_getStats(&stats);
+
+    for(page = 0; page < EE_PAGE_COUNT; page++)
+    {
+        erases[page] = ee_getPageEraseCount(page);
+        if(erases[page] < minErases)
+        {
+            minErases = erases[page];
+        }
+        if(erases[page] > maxErases)
+        {
+            maxErases = erases[page];
+        }
+    }
+
+    amplification = stats.writes ? (double)stats.programs * 2 / ((double)stats.writes * EE_RECORD_SIZE) : 0.0;
+
+    printf("updates         %lu (busy %lu)\n", (unsigned long)updates, (unsigned long)busy);
+    printf("variable writes %lu (transactions %lu)\n", (unsigned long)stats.writes,
+            (unsigned long)stats.transactions);
+    printf("programs        %lu half words\n", (unsigned long)stats.programs);
+    printf("write amp.      %.3f\n", amplification);
+    printf("reclaims        %lu (%lu live records copied, %.2f per reclaim)\n", (unsigned long)stats.reclaims,
+            (unsigned long)stats.copies, stats.reclaims ? (double)stats.copies / stats.reclaims : 0.0);
+    printf("erases          %lu (pages", (unsigned long)stats.erases);
+    for(page = 0; page < EE_PAGE_COUNT; page++)
+    {
+        printf(" %u", erases[page]);
+    }
+    printf(")\n");
+    if(maxErases)
+    {
+        printf("endurance       %.3g variable writes (%u erase cycles per page)\n",
+                (double)stats.writes * WEAR_ENDURANCE / maxErases, WEAR_ENDURANCE);
+    }
+
+    return (maxErases - minErases > 1) ? 1 : 0;
+}
+
+/**
+ * @brief Write one update of the workload
+ *
+ * @return Status of the write, HAL_BUSY if nothing was written
+ */
+static uint16_t wear_update(void)
+{
+    static uint16_t trips;
+    eeVar_t floors[2];
+    uint16_t status;
+    uint32_t r = rand() % 100;
+
+    if(r < 90)
+    {
+        if((status = ee_writeVariable(CFG_TRIP_COUNT_VADDR, trips + 1)) == HAL_OK)
+        {
+            trips++;
+        }
+        return status;
+    }
+
+    if(r < 95)
+    {
+        floors[0].virtAddress = CFG_FLOOR_1_2_TICKS_VADDR;
+        floors[0].data = 2900 + rand() % 200;
+        floors[1].virtAddress = CFG_FLOOR_0_1_TICKS_VADDR;
+        floors[1].data = 2900 + rand() % 200;
+
+        return ee_writeVariables(floors, 2);
+    }
+
+    return ee_writeVariable(VirtAddVarTab[rand() % NumbOfVar], (uint16_t)rand());
+}
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# Capture the motion telemetry of the USB CDC interface (see Inc/tlm.h) into a
+# CSV file. Requires pyserial. Stop the capture with Ctrl+C.
+#
+#   python3 tlm-capture.py /dev/ttyACM0 ramp.csv
+#   python3 tlm-capture.py /dev/ttyACM0 ramp.csv 2     (sample every 2 ms)
+
+import importlib.util
+import os
+import struct
+import sys
+
+CMD_TELEMETRY = 0x08
+
+MAGIC = 0x4D54
+SAMPLES = 7
+PACKET = struct.Struct("<HHI" + "IHBB" * SAMPLES)
+
+INPUT_SW1 = 1 << 0
+INPUT_SW2 = 1 << 1
+INPUT_DIR = 1 << 2
+
+
+def load_client():
+    path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "proto-client.py")
+    spec = importlib.util.spec_from_file_location("proto_client", path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def decode(data, divider, out, last_seq):
+    pos = 0
+    while pos + PACKET.size <= len(data):
+        values = PACKET.unpack_from(data, pos)
+        magic, seq, tick = values[:3]
+
+        # Resync on a byte basis
+        if magic != MAGIC:
+            pos += 1
+            continue
+        pos += PACKET.size
+
+        if last_seq is not None and seq != (last_seq + 1) & 0xFFFF:
+            sys.stderr.write("%d packets lost\n" % ((seq - last_seq - 1) & 0xFFFF))
+        last_seq = seq
+
+        for i in range(SAMPLES):
+            steps, period, state, inputs = values[3 + 4 * i:7 + 4 * i]
+            out.write("%d,%d,%d,%d,%d,%d,%d,%d\n" % (
+                tick + i * divider, seq, steps, period, state,
+                1 if inputs & INPUT_SW1 else 0,
+                1 if inputs & INPUT_SW2 else 0,
+                1 if inputs & INPUT_DIR else 0))
+
+    return pos, last_seq
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write("usage: %s <port> <csv> [divider]\n" % sys.argv[0])
+        return 1
+
+    divider = int(sys.argv[3], 0) if len(sys.argv) > 3 else 1
+    client = load_client().Client(sys.argv[1])
+
+    with open(sys.argv[2], "w") as out:
+        out.write("time_ms,seq,steps,period,state,sw1,sw2,dir\n")
+
+        client.request(CMD_TELEMETRY, bytes([divider]))
+        client.ser.timeout = 0.1
+
+        # The packets are sent raw and follow the response
+        data = client.rx
+        client.rx = b""
+        last_seq = None
+        try:
+            while True:
+                data += client.ser.read(max(PACKET.size, client.ser.in_waiting))
+                used, last_seq = decode(data, divider, out, last_seq)
+                data = data[used:]
+        except KeyboardInterrupt:
+            pass
+
+    # The response follows the remaining packets and a zero byte
+    client.ser.timeout = 1.0
+    client.request(CMD_TELEMETRY, b"\0")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())